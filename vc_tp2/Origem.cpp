@@ -8,6 +8,13 @@ Autores:
 // Headers "normais"
 #include <iostream> // Header para input e output streams
 #include <string> // Classe string do C++
+#include <chrono> // Relgio para medir o tempo de processamento de cada frame
+#include <thread> // Threads para construir a tabela de cores em paralelo
+#include <vector>
+#include <atomic>
+#include <random> // Rudo do benchmark dos filtros
+#include <cstdio>
+#include <cstdlib>
 
 // Mdulos do openCV
 #include <opencv2\opencv.hpp>  // Funes principais do OpenCV (Open Source Computer Vision Library)
@@ -20,13 +27,450 @@ extern "C" {
 #include "vc.h"
 }
 
-int main(void)
+#include "fluxos.h" // Vrios vdeos em simultneo (quando so dadas fontes na linha de comandos)
+#include "gravacao.h" // Gravao das frames e mscaras numa thread prpria (auditoria)
+#include "imagem.h" // Imagens e blobs em C++ (libertados sozinhos)
+#include "parametros.h" // Limites e regras recarregados de um ficheiro sem parar o vdeo
+
+// Texto que aparece no ecr para cada sinal identificado ("" para INDEFINIDO)
+static std::string textoSinal(Sinal sinal)
+{
+	switch (sinal)
+	{
+	case (VIRAR_D):
+		return std::string("Obrigatorio Virar a Direita");
+	case (VIRAR_E):
+		return std::string("Obrigatorio Virar a Esquerda");
+	case (AUTOMOVEIS_MOTOCICLOS):
+		return std::string("Via Reservada a Automoveis e Motociclos");
+	case (AUTO_ESTRADA):
+		return std::string("Entrada para Auto-Estrada");
+	case (SENTIDO_PROIBIDO):
+		return std::string("Sentido Proibido");
+	case (STOP):
+		return std::string("Paragem Obrigatoria");
+	default:
+		return std::string("");
+	}
+}
+
+// Escreve texto sobre o vdeo com contorno a preto
+static void escreverTexto(cv::Mat& frame, const std::string& texto, int x, int y)
+{
+	// putText: escreve texto sobre o vdeo
+	// cv::putText(imagem, texto, ponto, fonte, tamanhoFonte, vetorCor, espessuraTexto)
+	// contorno a preto (espessura = 2)
+	cv::putText(frame, texto, cv::Point(x, y), cv::FONT_HERSHEY_SIMPLEX, 0.9, cv::Scalar(0, 0, 0), 2);
+	// texto branco interior (espessura = 1)
+	cv::putText(frame, texto, cv::Point(x, y), cv::FONT_HERSHEY_SIMPLEX, 0.9, cv::Scalar(255, 255, 255), 1);
+}
+
+// Mapeia a tabela de cores do ficheiro (se foi construda com os mesmos limites) ou constri-a
+// em paralelo (uma parte dos valores de vermelho por thread) e guarda-a para os prximos arranques.
+// Mostra quanto tempo demorou; devolve NULL se no havia memria (segmenta-se por HSV)
+static TCVC* prepararTabelaCores(const LVC* limites, const char* ficheiro)
+{
+	auto inicio = std::chrono::steady_clock::now();
+	TCVC* tabela = vc_tabela_cores_carregar(ficheiro, limites);
+	std::vector<std::thread> threads;
+	std::atomic<int> falhas(0);
+	int nthreads = (int)std::thread::hardware_concurrency(), t;
+
+	if (tabela != NULL)
+	{
+		std::cout << "Tabela de cores mapeada de " << ficheiro << " em "
+			<< std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - inicio).count() << " ms\n";
+		return tabela;
+	}
+
+	tabela = vc_tabela_cores_nova(limites);
+	if (tabela == NULL) return NULL;
+
+	if (nthreads < 1) nthreads = 1;
+	for (t = 0; t < nthreads; t++)
+	{
+		threads.emplace_back([tabela, t, nthreads, &falhas] {
+			if (!vc_tabela_cores_construir(tabela, 256 * t / nthreads, 256 * (t + 1) / nthreads)) falhas++;
+		});
+	}
+	for (std::thread& thread : threads) thread.join();
+
+	if (falhas > 0) return vc_tabela_cores_libertar(tabela);
+
+	std::cout << "Tabela de cores construida com " << nthreads << " threads em "
+		<< std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - inicio).count() << " ms\n";
+
+	if (!vc_tabela_cores_guardar(tabela, ficheiro)) std::cerr << "Erro ao guardar a tabela de cores em " << ficheiro << "!\n";
+
+	return tabela;
+}
+
+// Compara os filtros de rudo (mediana, abertura e abertura + fecho) numa mscara 640x480 com
+// um sinal (crculo com uma seta) e rudo "salt-and-pepper": tempo por mscara e percentagem de
+// pxeis diferentes da mscara sem rudo
+static int benchmarkRuido()
+{
+	const int width = 640, height = 480, repeticoes = 20;
+	const int filtros[3] = { VC_FILTRO_MEDIANA, VC_FILTRO_ABERTURA, VC_FILTRO_ABERTURA_FECHO };
+	const char* nomes[3] = { "mediana", "abertura", "abertura+fecho" };
+	const double densidades[3] = { 0.02, 0.05, 0.10 };
+	vc::ImagemCinzentos limpa(width, height), ruidosa(width, height), filtrada(width, height);
+	std::mt19937 gerador(12345);
+	std::uniform_real_distribution<double> uniforme(0.0, 1.0);
+	int raio = 150, x, y, dx, dy, d, f, k, r, erros;
+	double ms;
+
+	if (!limpa.valida() || !ruidosa.valida() || !filtrada.valida()) return 1;
+
+	for (y = 0; y < height; y++)
+	{
+		for (x = 0; x < width; x++)
+		{
+			dx = x - width / 2;
+			dy = y - height / 2;
+			// Dentro do crculo, fora da seta (haste e ponta para a esquerda)
+			limpa(x, y) = ((dx * dx + dy * dy < raio * raio) &&
+				!(((-dx > -raio * 7 / 10) && (-dx <= raio / 5) && (std::abs(dy) < raio / 6)) ||
+				((-dx > raio / 5) && (-dx < raio * 7 / 10) && (std::abs(dy) < raio * 7 / 10 + dx)))) ? 255 : 0;
+		}
+	}
+
+	std::printf("%-6s %-16s %-6s %10s %10s\n", "ruido", "filtro", "kernel", "ms/mascara", "erro");
+	for (d = 0; d < 3; d++)
+	{
+		for (y = 0; y < height; y++)
+		{
+			for (x = 0; x < width; x++)
+			{
+				ruidosa(x, y) = limpa(x, y);
+				if (uniforme(gerador) < densidades[d]) ruidosa(x, y) = (uniforme(gerador) < 0.5) ? 255 : 0;
+			}
+		}
+
+		for (f = 0; f < 3; f++)
+		{
+			for (k = 3; k <= 7; k += 2)
+			{
+				auto inicio = std::chrono::steady_clock::now();
+				for (r = 0; r < repeticoes; r++) vc::filtrarRuido(ruidosa, filtrada, filtros[f], k);
+				ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - inicio).count() / repeticoes;
+
+				// A mediana no escreve a primeira linha e a primeira coluna: compara-se s o interior
+				erros = 0;
+				for (y = 1; y < height - 1; y++)
+				{
+					for (x = 1; x < width - 1; x++) erros += (filtrada(x, y) != limpa(x, y));
+				}
+
+				std::printf("%4.0f%%  %-16s %dx%d    %10.2f %9.3f%%\n", densidades[d] * 100.0, nomes[f], k, k, ms,
+					100.0 * erros / ((width - 2) * (height - 2)));
+			}
+		}
+	}
+
+	return 0;
+}
+
+// Compara a segmentao HSV (converso + limites), a tabela de cores e as caixas de crominncia
+// (YCbCr e rg) numa frame 1280x720 com fundos de vrias cores e discos azuis e vermelhos com
+// sombra: tempo por frame, pxeis diferentes da mscara HSV na frame e cores diferentes nas 2^24
+static int benchmarkCroma(TCVC* tabela, const LVC* limites)
+{
+	const int width = 1280, height = 720, repeticoes = 20;
+	const char* espacos[2] = { "ycbcr", "rg" };
+	vc::ImagemBGR frame(width, height), hsv(width, height);
+	vc::ImagemCinzentos referencia(width, height), mascara(width, height);
+	std::mt19937 gerador(12345);
+	std::uniform_int_distribution<int> canal(0, 255);
+	CXVC caixas[2][3];
+	long falsosPositivos[2][3], falsosNegativos[2][3];
+	int x, y, dx, dy, c, e, r, k, cor, erros, fundos[height / 80][width / 80][3], centros[6][2];
+	double sombra, ms;
+
+	if (!frame.valida() || !hsv.valida() || !referencia.valida() || !mascara.valida()) return 1;
+
+	for (e = 0; e < 2; e++)
+	{
+		for (cor = AZUL; cor <= VERMELHO; cor++)
+		{
+			if (!vc_croma_calibrar(&limites[cor], e, &caixas[e][cor], &falsosPositivos[e][cor], &falsosNegativos[e][cor])) return 1;
+		}
+	}
+
+	// Fundo em blocos de 80x80 com cores ao acaso (com rudo) e 6 discos, metade de cada cor
+	for (y = 0; y < height / 80; y++) for (x = 0; x < width / 80; x++) for (c = 0; c < 3; c++) fundos[y][x][c] = canal(gerador);
+	for (k = 0; k < 6; k++)
+	{
+		centros[k][0] = 120 + k * 200;
+		centros[k][1] = (k % 2) ? 220 : 500;
+	}
+	for (y = 0; y < height; y++)
+	{
+		for (x = 0; x < width; x++)
+		{
+			for (c = 0; c < 3; c++)
+			{
+				k = fundos[y / 80][x / 80][c] + canal(gerador) / 16 - 8;
+				frame(x, y, c) = (unsigned char)((k < 0) ? 0 : ((k > 255) ? 255 : k));
+			}
+
+			for (k = 0; k < 6; k++)
+			{
+				dx = x - centros[k][0];
+				dy = y - centros[k][1];
+				if (dx * dx + dy * dy >= 90 * 90) continue;
+
+				// Sombra da esquerda (escura) para a direita (clara)
+				sombra = 0.35 + 0.65 * (dx + 90) / 180.0;
+				frame(x, y, 0) = (unsigned char)((k % 2) ? 40 * sombra : 200 * sombra);
+				frame(x, y, 1) = (unsigned char)((k % 2) ? 30 * sombra : 60 * sombra);
+				frame(x, y, 2) = (unsigned char)((k % 2) ? 210 * sombra : 20 * sombra);
+			}
+		}
+	}
+
+	std::printf("%-8s %-10s %10s %10s %12s %12s\n", "cor", "motor", "ms/frame", "erro", "falsos +", "falsos -");
+	for (cor = AZUL; cor <= VERMELHO; cor++)
+	{
+		const char* nomeCor = (cor == AZUL) ? "azul" : "vermelho";
+
+		auto inicio = std::chrono::steady_clock::now();
+		for (r = 0; r < repeticoes; r++)
+		{
+			vc::bgrParaHsv(frame, hsv);
+			vc_hsv_segmentar_limites(hsv.ivc(), referencia.ivc(), &limites[cor]);
+		}
+		ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - inicio).count() / repeticoes;
+		std::printf("%-8s %-10s %10.2f %9.3f%% %12d %12d\n", nomeCor, "hsv", ms, 0.0, 0, 0);
+
+		if (vc_tabela_cores_atual(tabela, limites))
+		{
+			inicio = std::chrono::steady_clock::now();
+			for (r = 0; r < repeticoes; r++) vc::segmentar(tabela, frame, mascara, (Cor)cor);
+			ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - inicio).count() / repeticoes;
+
+			erros = 0;
+			for (y = 0; y < height; y++) for (x = 0; x < width; x++) erros += (mascara(x, y) != referencia(x, y));
+			std::printf("%-8s %-10s %10.2f %9.3f%% %12d %12d\n", nomeCor, "tabela", ms, 100.0 * erros / (width * height), 0, 0);
+		}
+
+		for (e = 0; e < 2; e++)
+		{
+			inicio = std::chrono::steady_clock::now();
+			for (r = 0; r < repeticoes; r++) vc::segmentar(caixas[e][cor], frame, mascara);
+			ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - inicio).count() / repeticoes;
+
+			erros = 0;
+			for (y = 0; y < height; y++) for (x = 0; x < width; x++) erros += (mascara(x, y) != referencia(x, y));
+			std::printf("%-8s %-10s %10.2f %9.3f%% %12ld %12ld\n", nomeCor, espacos[e], ms, 100.0 * erros / (width * height),
+				falsosPositivos[e][cor], falsosNegativos[e][cor]);
+		}
+	}
+
+	return 0;
+}
+
+// Volta a passar as mscaras gravadas (tecla m) pela etiquetagem e pela classificao, sem vdeo nem
+// filtros: mostra quanto tempo demora a descodificao e quanto demoram estas etapas por mscara
+static int reproduzirMascaras(const char* ficheiro, int repeticoes)
+{
+	RMVC* reproducao = vc_mascaras_reproducao_abrir(ficheiro);
+	PVC* processamento;
+	IVC mascara;
+	Cor cor;
+	long frame, mascaras = 0, deteccoes = 0, pixeis = 0;
+	double msDescodificar = 0.0, msProcessar = 0.0;
+	int r;
+
+	if ((reproducao == NULL) || (reproducao->registos == 0))
+	{
+		std::cerr << "Erro ao abrir as mscaras de " << ficheiro << "!\n";
+		vc_mascaras_reproducao_libertar(reproducao);
+		return 1;
+	}
+
+	// As opes de classificao so as do vdeo nico
+	processamento = vc_processamento_novo(reproducao->width, reproducao->height);
+	if (processamento == NULL)
+	{
+		vc_mascaras_reproducao_libertar(reproducao);
+		return 1;
+	}
+	processamento->modoVerificacao = 1;
+
+	for (r = 0; r < repeticoes; r++)
+	{
+		vc_mascaras_reproducao_reiniciar(reproducao);
+
+		while (true)
+		{
+			auto inicio = std::chrono::steady_clock::now();
+			if (!vc_mascaras_reproduzir(reproducao, processamento->imagemSemRuido, &mascara, &frame, &cor)) break;
+			auto meio = std::chrono::steady_clock::now();
+			deteccoes += vc_processar_mascara(processamento, &mascara, cor);
+			auto fim = std::chrono::steady_clock::now();
+
+			msDescodificar += std::chrono::duration<double, std::milli>(meio - inicio).count();
+			msProcessar += std::chrono::duration<double, std::milli>(fim - meio).count();
+			pixeis += (long)mascara.width * mascara.height;
+			mascaras++;
+		}
+	}
+
+	std::printf("%ld registos (%ld bytes, frame %dx%d), %d repeties\n", reproducao->registos, reproducao->fim,
+		reproducao->width, reproducao->height, repeticoes);
+	std::printf("descodificao: %.3f ms/mscara\n", msDescodificar / MAX(mascaras, 1));
+	std::printf("etiquetagem + classificao: %.3f ms/mscara (%.0f mscaras/s, %.1f Mpxeis/s), %ld detees\n",
+		msProcessar / MAX(mascaras, 1), mascaras / MAX(msProcessar / 1000.0, 1e-9), pixeis / MAX(msProcessar * 1000.0, 1e-9), deteccoes);
+
+	vc_processamento_libertar(processamento);
+	vc_mascaras_reproducao_libertar(reproducao);
+
+	return 0;
+}
+
+// Imagens de referncia dos modelos binrios (vc_modelos em vc.c): o maior blob da cor d o modelo do
+// sinal e a mesma mscara espelhada na horizontal d o do sinal simtrico (INDEFINIDO = sem espelho)
+static const struct {
+	const char* ficheiro;
+	Cor cor;
+	Sinal sinal, espelho;
+} referenciasModelos[] = {
+	{ "ArrowLeft.ppm", AZUL, VIRAR_E, VIRAR_D },
+};
+
+// Escreve um modelo com o formato de vc_modelos
+static void escreverModelo(const char* cor, const char* sinal, const unsigned long long* bits)
+{
+	int i;
+
+	std::printf("\t{ %s, %s, {\n", cor, sinal);
+	for (i = 0; i < VC_MODELO_PALAVRAS; i++)
+	{
+		std::printf("%s0x%016llXULL%s", (i % 4 == 0) ? "\t\t" : " ", bits[i], (i % 4 == 3) ? ((i + 1 < VC_MODELO_PALAVRAS) ? ",\n" : "\n") : ",");
+	}
+	std::printf("\t} },\n");
+}
+
+// Gera o cdigo de vc_modelos (vc.c) a partir das imagens de referncia, com o mesmo processamento
+// das frames (vc_processar_frame, sem rastreio) e a mesma amostragem da verificao (vc_blob_amostrar)
+static int gerarModelos()
 {
-	IVC* imagemCamera, * imagemHSV, * imagemSegmentada, * imagemSemRuido, * imagemLabels, * imagemBoundingBox;
-	OVC* blobs;
-	int nblobs, maiorBlob;
-	Sinal sinal = INDEFINIDO;
-	Cor cor = AZUL;
+	// Pela ordem dos enums Cor e Sinal
+	static const char* nomesCores[] = { "INDEFINIDA", "AZUL", "VERMELHO" };
+	static const char* nomesSinais[] = { "INDEFINIDO", "VIRAR_E", "VIRAR_D", "AUTO_ESTRADA", "AUTOMOVEIS_MOTOCICLOS", "SENTIDO_PROIBIDO", "STOP" };
+	unsigned long long bits[VC_MODELO_PALAVRAS], espelho[VC_MODELO_PALAVRAS];
+	PVC* processamento;
+	cv::Mat imagem;
+	int r, i, y, maior;
+
+	std::printf("static const vc_modelo_sinal vc_modelos[] = {\n");
+
+	for (r = 0; r < (int)(sizeof(referenciasModelos) / sizeof(referenciasModelos[0])); r++)
+	{
+		// O OpenCV l em BGR, como as frames
+		imagem = cv::imread(referenciasModelos[r].ficheiro, cv::IMREAD_COLOR);
+		if (imagem.empty())
+		{
+			std::cerr << "Erro ao abrir " << referenciasModelos[r].ficheiro << "!\n";
+			return 1;
+		}
+
+		processamento = vc_processamento_novo(imagem.cols, imagem.rows);
+		if (processamento == NULL) return 1;
+		processamento->modoRastreio = 0;
+		processamento->cor = referenciasModelos[r].cor;
+		for (y = 0; y < imagem.rows; y++)
+		{
+			memcpy(processamento->imagemCamera->data + y * processamento->imagemCamera->bytesperline, imagem.ptr(y), imagem.cols * 3);
+		}
+		vc_processar_frame(processamento);
+
+		// Maior blob da cor
+		for (i = 0, maior = -1; i < processamento->ndeteccoes; i++)
+		{
+			if (processamento->deteccoes[i].cor != referenciasModelos[r].cor) continue;
+			if ((maior < 0) || (processamento->deteccoes[i].blob.area > processamento->deteccoes[maior].blob.area)) maior = i;
+		}
+		if ((maior < 0) || !vc_blob_amostrar(processamento->imagemLabels, &processamento->deteccoes[maior].blob, bits))
+		{
+			std::cerr << "Sem blobs da cor em " << referenciasModelos[r].ficheiro << "!\n";
+			vc_processamento_libertar(processamento);
+			return 1;
+		}
+
+		escreverModelo(nomesCores[referenciasModelos[r].cor], nomesSinais[referenciasModelos[r].sinal], bits);
+		if (referenciasModelos[r].espelho != INDEFINIDO)
+		{
+			vc_modelo_espelhar(bits, espelho);
+			escreverModelo(nomesCores[referenciasModelos[r].cor], nomesSinais[referenciasModelos[r].espelho], espelho);
+		}
+
+		vc_processamento_libertar(processamento);
+	}
+
+	std::printf("};\n");
+
+	return 0;
+}
+
+// Escreve o que falta de uma gravao e mostra quantas imagens (ou registos) foram gravadas e descartadas
+// (no espera pelo disco se a thread da gravao j tiver parado: ver gravacao_parar)
+static Gravacao* terminarGravacao(Gravacao* gravacao, const char* nome)
+{
+	long escritas = 0, descartadas = 0, erros = 0;
+
+	if (gravacao == NULL) return NULL;
+
+	gravacao_esvaziar(gravacao);
+	gravacao_estatistica(gravacao, &escritas, &descartadas, &erros, NULL);
+	gravacao = gravacao_terminar(gravacao);
+	std::cout << nome << ": " << escritas << " gravadas, " << descartadas << " descartadas, " << erros << " erros\n";
+
+	return gravacao;
+}
+
+// Entrega um registo das mscaras  thread que os acrescenta a mascaras.rle (ver vc_mascaras_gravacao_encaminhar)
+static int enviarRegistoMascaras(void* destino, const void* registo, long bytes)
+{
+	return gravacao_enviar_dados((Gravacao*)destino, registo, bytes);
+}
+
+// Mostra o perfil de cada etapa desde que foi ligado e liberta-o
+static PFVC* terminarPerfil(PFVC* perfil)
+{
+	if (perfil == NULL) return NULL;
+
+	vc_perfil_relatorio(perfil, stdout);
+
+	return vc_perfil_libertar(perfil);
+}
+
+int main(int argc, char** argv)
+{
+	// Imagens IVC e estado entre frames (rastreio por ROI, seguimento temporal, cor a procurar)
+	PVC* processamento;
+	int ndeteccoes, i;
+	// Tabela de regras do classificador lida de ficheiro (NULL = usa a tabela compilada)
+	RSVC* regras;
+	int nregras;
+	// Limites de segmentao de cada cor e a tabela de cores feita com eles (partilhada por todos os vdeos)
+	LVC limites[3];
+	TCVC* tabelaCores;
+	// Prazo de cada frame (a partir dos fps da fonte): salta frames e degrada a qualidade quando no acompanha
+	EVC escalonador;
+	std::chrono::steady_clock::time_point inicioFrame, fimFrame;
+	// Auditoria (tecla g): frames marcadas e mscaras gravadas sem atrasar o ciclo (descartadas se o disco no acompanhar)
+	Gravacao* auditoria = NULL;
+	std::vector<Gravacao*> auditoriasParadas; // Desligadas com g, ainda a escrever o que tinham na fila
+	// Mscaras (tecla m): a thread que acrescenta os registos a mascaras.rle fica at ao fim (criada quando  precisa)
+	Gravacao* escritaMascaras = NULL;
+	int sessoesAuditoria = 0;
+	char nomeAuditoria[64];
+	IVC imagemFrame, mascara;
+	// Limites e regras de parametros.txt, recarregados quando o ficheiro muda (ver parametros.h)
+	Parametros* parametros;
+	int leitorParametros;
 
 	// Classe cv::VideoCapture: classe para captura de vdeo a partir de cmaras ou para leitura de ficheiros de vdeo e sequncias de imagens
 	cv::VideoCapture capture;
@@ -43,6 +487,60 @@ int main(void)
 	std::string informacaoSinal = std::string("");
 	int key = 0, nCanais = 3;
 
+	// --verificar-hsv: confirma que o HSV s com inteiros d o mesmo que a verso com floats (2^24 cores)
+	if ((argc > 1) && (std::string(argv[1]) == "--verificar-hsv"))
+	{
+		i = vc_hsv_verificar();
+		std::cout << "HSV: " << i << " cores diferentes\n";
+		return (i == 0) ? 0 : 1;
+	}
+
+	// --verificar-pool: as tarefas de um grupo de threads no acordam as threads dos outros grupos
+	if ((argc > 1) && (std::string(argv[1]) == "--verificar-pool")) return fluxos_verificar_pool();
+
+	// --benchmark-ruido: tempo e erro dos filtros de rudo da mscara
+	if ((argc > 1) && (std::string(argv[1]) == "--benchmark-ruido")) return benchmarkRuido();
+
+	// --reproduzir-mascaras ficheiro [repeties]: mede a etiquetagem e a classificao com as mscaras gravadas
+	if ((argc > 2) && (std::string(argv[1]) == "--reproduzir-mascaras"))
+	{
+		return reproduzirMascaras(argv[2], (argc > 3) ? MAX(std::atoi(argv[3]), 1) : 1);
+	}
+
+	// --gerar-modelos: escreve o cdigo dos modelos binrios de vc.c a partir das imagens de referncia
+	if ((argc > 1) && (std::string(argv[1]) == "--gerar-modelos")) return gerarModelos();
+
+	// --produtor-memoria /nome [fonte] ...: publica frames num anel em memria partilhada, para testar a fonte "memoria:/nome"
+	if ((argc > 1) && (std::string(argv[1]) == "--produtor-memoria")) return fluxos_produzir(argc - 2, argv + 2);
+
+	// Se os limites mudarem, o ficheiro deixa de servir e a tabela  construda outra vez
+	vc_limites_iniciar(limites);
+	tabelaCores = prepararTabelaCores(limites, "cores.tabela");
+
+	// --benchmark-croma: tempo e erro das caixas de crominncia em relao  segmentao HSV
+	if ((argc > 1) && (std::string(argv[1]) == "--benchmark-croma"))
+	{
+		i = benchmarkCroma(tabelaCores, limites);
+		vc_tabela_cores_libertar(tabelaCores);
+		return i;
+	}
+
+	// --offline ... fonte: processa um vdeo inteiro com vrias frames em paralelo e escreve as detees (ver fluxos.h)
+	if ((argc > 1) && (std::string(argv[1]) == "--offline"))
+	{
+		i = fluxos_offline(argc - 2, argv + 2, tabelaCores);
+		vc_tabela_cores_libertar(tabelaCores);
+		return i;
+	}
+
+	// Com argumentos: processa todas as fontes dadas em simultneo, sem janela (ver fluxos.h)
+	if (argc > 1)
+	{
+		i = fluxos_executar(argc - 1, argv + 1, tabelaCores);
+		vc_tabela_cores_libertar(tabelaCores);
+		return i;
+	}
+
 	// usar cmara do pc em vez (s com 0 se der erro, sem ',' e frente)
 	// cmara 0. Se existisse outra cmara ligada por usb, seria a cmara 1
 	/* Em alternativa, abrir captura de vdeo pela Webcam #0 */
@@ -58,24 +556,65 @@ int main(void)
 	/* Resoluo do vdeo */
 	video.width = (int)capture.get(cv::CAP_PROP_FRAME_WIDTH);
 	video.height = (int)capture.get(cv::CAP_PROP_FRAME_HEIGHT);
+	video.fps = (int)capture.get(cv::CAP_PROP_FPS);
 
 	/* Cria uma janela para exibir o vdeo */
 	// cvv:WINDOW_AUTOSIZE: ajusta o tamanho da janela automaticamente para corresponder ao tamanho da imagem. No permite alterar o tamanho da janela manualmente.
 	cv::namedWindow("VC - Video", cv::WINDOW_AUTOSIZE);
 
 	// Criao das imagens IVC
-	imagemCamera = vc_image_new(video.width, video.height, nCanais, 255);
-	imagemHSV = vc_image_new(imagemCamera->width, imagemCamera->height, imagemCamera->channels, imagemCamera->levels);
-	imagemSegmentada = vc_image_new(imagemCamera->width, imagemCamera->height, 1, imagemCamera->levels);
-	imagemSemRuido = vc_image_new(imagemCamera->width, imagemCamera->height, 1, imagemCamera->levels);
-	imagemLabels = vc_image_new(imagemCamera->width, imagemCamera->height, 1, imagemCamera->levels);
-	imagemBoundingBox = vc_image_new(imagemCamera->width, imagemCamera->height, imagemCamera->channels, imagemCamera->levels);
+	processamento = vc_processamento_novo(video.width, video.height);
+	if (processamento == NULL)
+	{
+		std::cerr << "Erro ao alocar as imagens!\n";
+		return 1;
+	}
+
+	// Se existir o ficheiro, as regras do classificador substituem a tabela compilada
+	// (o ficheiro pode ser criado com vc_classificador_guardar)
+	regras = vc_classificador_carregar("sinais.regras", &nregras);
+	if (regras != NULL) vc_classificador_definir(regras, nregras);
+
+	// Modos de processamento
+	// modoRastreio: depois de detetar um sinal, as frames seguintes s so processadas numa ROI  volta dele
+	// modoMultiObjeto: classifica e marca todos os blobs com rea suficiente (e no s o maior)
+	// fatorPiramide: 2 ou 4 procura os sinais na frame reduzida e s refina  volta deles (1 = desligado)
+	// modoVerificacao: as setas s so aceites se a mscara for parecida com o modelo (e o modelo d a direo)
+	// modoAlteracoes: s processa as regies da frame que mudaram (cmara fixa)
+	// modoOcupacao: filtra e etiqueta s  volta dos blocos da mscara com pxeis da cor (mesmo resultado)
+	// filtroRuido: VC_FILTRO_ABERTURA_FECHO  ~40x mais rpido que a mediana, mas s com pouco rudo (--benchmark-ruido)
+	processamento->modoRastreio = 1;
+	processamento->modoMultiObjeto = 0;
+	processamento->fatorPiramide = 1;
+	processamento->modoVerificacao = 1;
+	processamento->modoAlteracoes = 1;
+	processamento->modoOcupacao = 1;
+	processamento->filtroRuido = VC_FILTRO_MEDIANA;
+	processamento->tabelaCores = tabelaCores;
+
+	// Sem o ficheiro ficam os limites de vc_limites_iniciar e as regras acima, at ele ser criado
+	parametros = parametros_iniciar("parametros.txt", tabelaCores, 500);
+	leitorParametros = parametros_leitor(parametros);
+
+	// As opes acima so as do nvel sem degradao
+	vc_escalonador_iniciar(&escalonador, processamento, video.fps);
 
 	cv::Mat frame;
 
+	// Cada frame conta desde o fim da anterior: leitura, descodificao e frames descartadas includas
+	inicioFrame = std::chrono::steady_clock::now();
+
 	// Fecha a captura/leitura de vdeo ao carregar na tecla q
 	while (key != 'q')
 	{
+		// Atrasado em relao  fonte: descarta a frame sem a descodificar
+		if (!vc_escalonador_processar(&escalonador))
+		{
+			if (!capture.grab()) break;
+			key = cv::waitKey(1);
+			continue;
+		}
+
 		/* Leitura de uma frame do vdeo */
 		capture.read(frame);
 
@@ -89,98 +628,124 @@ int main(void)
 		// !CUIDADO! cv::Mat est em BGR ao contrrio de IVC que est em RGB !CUIDADO!
 
 		//// Copia dados de imagem da estrutura cv::Mat para uma estrutura IVC
-		memcpy(imagemCamera->data, frame.data, video.width * nCanais * video.height);
+		memcpy(processamento->imagemCamera->data, frame.data, video.width * nCanais * video.height);
 
-		// Converter BGR para HSV
-		vc_bgr_to_hsv(imagemCamera, imagemHSV);
+		// Segmentao, filtragem, etiquetagem, classificao e marcao dos sinais
+		// (com os parmetros ativos no incio da frame)
+		parametros_aplicar(parametros_entrar(parametros, leitorParametros), processamento);
+		ndeteccoes = vc_processar_frame(processamento);
+		parametros_sair(parametros, leitorParametros);
 
-		// Segmentar imagem HSV
-		if (cor == AZUL) vc_hsv_segmentation(imagemHSV, imagemSegmentada, 192, 289, 10, 100, 15, 100);
-		else if (cor == VERMELHO) vc_hsv_red_segmentation(imagemHSV, imagemSegmentada, 0, 34, 335, 360, 30, 100, 35, 100);
+		// Detetou pelo menos um sinal
+		if (ndeteccoes > 0)
+		{
+			//// Copia dados de imagem da estrutura IVC para uma estrutura cv::Mat
+			memcpy(frame.data, processamento->imagemBoundingBox->data, video.width * nCanais * video.height);
 
-		// Eliminar rudo "salt-and-pepper"
-		vc_gray_lowpass_median_filter(imagemSegmentada, imagemSemRuido, 7);
+			// ESCREVER NO VDEO
+			if (processamento->modoMultiObjeto)
+			{
+				// Nome de cada sinal por cima da sua caixa delimitadora
+				for (i = 0; i < ndeteccoes; i++)
+				{
+					escreverTexto(frame, textoSinal(processamento->deteccoes[i].sinal),
+						processamento->deteccoes[i].blob.x, MAX(processamento->deteccoes[i].blob.y - 8, 25));
+				}
+			}
+			else
+			{
+				// S muda o texto quando o sinal  identificado
+				if (processamento->deteccoes[0].sinal != INDEFINIDO) informacaoSinal = textoSinal(processamento->deteccoes[0].sinal);
 
-		// Etiquetar blobs da imagem
-		blobs = vc_binary_blob_labelling(imagemSemRuido, imagemLabels, &nblobs);
+				escreverTexto(frame, informacaoSinal, 20, 25);
+			}
+		}
 
-		// Procurar o maior blob
-		vc_encontrarMaiorBlob(imagemLabels, blobs, nblobs, &maiorBlob);
+		/* Exibe a frame */
+		cv::imshow("VC - Video", frame);
 
-		// Verificar se o maior blob tem tamanho suficiente para ser um sinal de trnsito
-		if (blobs != NULL && blobs[maiorBlob].area < 6000)
-		{ // No detetou o sinal (tentar a outra cor para a prxima frame)
-			if (cor == AZUL) cor = VERMELHO;
-			else if (cor == VERMELHO) cor = AZUL;
-		}
-		// Detetou o sinal
-		else
+		// Auditoria: a frame como foi mostrada (BGR) e a mscara sem rudo (em PBM)
+		if (auditoria != NULL)
 		{
-			// Clculos de medidas do maior blob
-			vc_maiorBlob_info(imagemLabels, blobs, nblobs, maiorBlob);
-
-			// Marcar bounding box e centro de massa do maior blob
-			vc_marcarMaiorBlob(imagemCamera, imagemBoundingBox, blobs, nblobs, maiorBlob);
+			imagemFrame = *processamento->imagemCamera;
+			imagemFrame.data = frame.data;
+			imagemFrame.bytesperline = (int)frame.step;
+			gravacao_enviar(auditoria, &imagemFrame, "frame");
+
+			mascara = *processamento->imagemSemRuido;
+			mascara.levels = 1;
+			gravacao_enviar(auditoria, &mascara, "mascara");
+		}
 
-			// Identificar o sinal de trnsito
-			sinal = vc_identificarSinal(blobs, nblobs, maiorBlob, cor);
+		// Espera um milissegundo por uma tecla pressionada pelo utilizador. 
+		// Grava a tecla pressionada em key.
+		key = cv::waitKey(1);
 
-			// Escolher o texto que vai aparecer no ecr de acordo com o sinal identificado
-			switch (sinal)
+		// m: liga / desliga a gravao das mscaras filtradas (acrescentadas a mascaras.rle; ver --reproduzir-mascaras)
+		if (key == 'm')
+		{
+			if (processamento->gravacaoMascaras != NULL) processamento->gravacaoMascaras = vc_mascaras_gravacao_libertar(processamento->gravacaoMascaras);
+			else
 			{
-			case (INDEFINIDO):
-				break;
-			case (VIRAR_D):
-				informacaoSinal = std::string("Obrigatorio Virar a Direita");
-				break;
-			case (VIRAR_E):
-				informacaoSinal = std::string("Obrigatorio Virar a Esquerda");
-				break;
-			case (AUTOMOVEIS_MOTOCICLOS):
-				informacaoSinal = std::string("Via Reservada a Automoveis e Motociclos");
-				break;
-			case (AUTO_ESTRADA):
-				informacaoSinal = std::string("Entrada para Auto-Estrada");
-				break;
-			case (SENTIDO_PROIBIDO):
-				informacaoSinal = std::string("Sentido Proibido");
-				break;
-			case (STOP):
-				informacaoSinal = std::string("Paragem Obrigatoria");
-				break;
-			default:
-				break;
+				if (escritaMascaras == NULL) escritaMascaras = gravacao_iniciar("mascaras.rle", GRAVACAO_DADOS, GRAVACAO_DESCARTAR, 64);
+				if (escritaMascaras != NULL) processamento->gravacaoMascaras = vc_mascaras_gravacao_encaminhar("mascaras.rle", enviarRegistoMascaras, escritaMascaras);
+				if (processamento->gravacaoMascaras == NULL) std::cerr << "Erro ao abrir mascaras.rle!\n";
 			}
+		}
 
-			//// Copia dados de imagem da estrutura IVC para uma estrutura cv::Mat
-			memcpy(frame.data, imagemBoundingBox->data, video.width * nCanais * video.height);
-
-			// ESCREVER NO VDEO
-			// putText: escreve texto sobre o vdeo
-			// cv::putText(imagem, texto, ponto, fonte, tamanhoFonte, vetorCor, espessuraTexto)
-			// contorno a preto (espessura = 2)
-			cv::putText(frame, informacaoSinal, cv::Point(20, 25), cv::FONT_HERSHEY_SIMPLEX, 0.9, cv::Scalar(0, 0, 0), 2);
-			// texto branco interior (espessura = 1)
-			cv::putText(frame, informacaoSinal, cv::Point(20, 25), cv::FONT_HERSHEY_SIMPLEX, 0.9, cv::Scalar(255, 255, 255), 1);
+		// p: liga / desliga o perfil de cada etapa (mostrado quando  desligado)
+		if (key == 'p')
+		{
+			if (processamento->perfil == NULL) processamento->perfil = vc_perfil_novo();
+			else processamento->perfil = terminarPerfil(processamento->perfil);
 		}
 
-		free(blobs);
+		// g: liga / desliga a auditoria (um fluxo auditoria_N.pnm por cada vez que  ligada). Ao desligar,
+		// a thread da gravao escreve o que falta sem prender o ciclo;  libertada quando acabar
+		if (key == 'g')
+		{
+			if (auditoria == NULL)
+			{
+				std::snprintf(nomeAuditoria, sizeof(nomeAuditoria), "auditoria_%d.pnm", ++sessoesAuditoria);
+				auditoria = gravacao_iniciar(nomeAuditoria, GRAVACAO_FLUXO, GRAVACAO_DESCARTAR, 8);
+			}
+			else
+			{
+				gravacao_parar(auditoria);
+				auditoriasParadas.push_back(auditoria);
+				auditoria = NULL;
+			}
+		}
 
-		/* Exibe a frame */
-		cv::imshow("VC - Video", frame);
+		for (i = (int)auditoriasParadas.size() - 1; i >= 0; i--)
+		{
+			if (!gravacao_parada(auditoriasParadas[i])) continue;
+			terminarGravacao(auditoriasParadas[i], "Auditoria");
+			auditoriasParadas.erase(auditoriasParadas.begin() + i);
+		}
 
-		// Espera um milissegundo por uma tecla pressionada pelo utilizador. 
-		// Grava a tecla pressionada em key.
-		key = cv::waitKey(1);
+		// Tempo gasto com a frame (leitura, processamento e exibio); ajusta a qualidade da prxima
+		fimFrame = std::chrono::steady_clock::now();
+		vc_escalonador_registar(&escalonador, processamento, std::chrono::duration<double>(fimFrame - inicioFrame).count());
+		inicioFrame = fimFrame;
 	}
 
+	std::cout << "Frames processadas: " << escalonador.framesProcessadas << " (degradadas: " << escalonador.framesDegradadas
+		<< ", fora do prazo: " << escalonador.framesForaDoPrazo << "), saltadas: " << escalonador.framesSaltadas
+		<< ", sem alteraes: " << processamento->alteracoes->framesReutilizadas << "\n";
+
+	auditoria = terminarGravacao(auditoria, "Auditoria");
+	for (Gravacao* parada : auditoriasParadas) terminarGravacao(parada, "Auditoria");
+	parametros_terminar(parametros);
+	vc_mascaras_gravacao_libertar(processamento->gravacaoMascaras);
+	escritaMascaras = terminarGravacao(escritaMascaras, "Mscaras");
+	terminarPerfil(processamento->perfil);
+
 	//// Liberta a memria das imagens IVC
-	vc_image_free(imagemCamera);
-	vc_image_free(imagemHSV);
-	vc_image_free(imagemSegmentada);
-	vc_image_free(imagemSemRuido);
-	vc_image_free(imagemLabels);
-	vc_image_free(imagemBoundingBox);
+	vc_processamento_libertar(processamento);
+	vc_tabela_cores_libertar(tabelaCores);
+	vc_classificador_definir(NULL, 0);
+	free(regras);
 
 	/* Fecha a janela */
 	cv::destroyWindow("VC - Video");
@@ -0,0 +1,1045 @@
+﻿/*
+Autores:
+-Filipe Gajo
+-Ricardo Sampaio
+-Cláudio Silva
+*/
+
+// Headers "normais"
+#include <iostream> // Header para input e output streams
+#include <string> // Classe string do C++
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+
+// Módulos do openCV
+#include <opencv2\opencv.hpp>  // Funções principais do OpenCV (Open Source Computer Vision Library)
+#include <opencv2\videoio.hpp> // Funções de leitura/escrita de vídeo
+
+extern "C" {
+#include "vc.h"
+}
+
+#include "fluxos.h"
+#include "parametros.h"
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//          CONJUNTO DE THREADS COM ROUBO DE TAREFAS
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+// Cada thread tem a sua fila; as tarefas de uma fila são executadas por ordem de chegada e uma
+// thread sem trabalho rouba a tarefa mais antiga da fila de outra thread do mesmo grupo
+// (grupo = thread % ngrupos; com um grupo por nó NUMA, uma tarefa nunca muda de nó).
+// Cada grupo tem as suas tarefas pendentes e a sua variável de condição: uma tarefa só acorda
+// threads que a podem executar, e as threads dos outros grupos continuam a dormir
+class PoolTarefas
+{
+public:
+	// iniciar (opcional) corre no início de cada thread, com o número dela
+	explicit PoolTarefas(int nthreads, int ngrupos = 1, std::function<void(int)> iniciar = nullptr) : iniciar(iniciar), terminar(false)
+	{
+		int i;
+
+		for (i = 0; i < MAX(ngrupos, 1); i++) grupos.push_back(std::unique_ptr<Grupo>(new Grupo()));
+		for (i = 0; i < nthreads; i++) filas.push_back(std::unique_ptr<Fila>(new Fila()));
+		for (i = 0; i < nthreads; i++) threads.push_back(std::thread(&PoolTarefas::trabalhar, this, i));
+	}
+
+	// As tarefas que ainda estiverem nas filas são descartadas
+	~PoolTarefas()
+	{
+		terminar = true;
+		for (std::unique_ptr<Grupo>& grupo : grupos)
+		{
+			// Com o mutex: uma thread que já testou a condição mas ainda não dorme não perde o aviso
+			{
+				std::lock_guard<std::mutex> lock(grupo->mutex);
+			}
+			grupo->espera.notify_all();
+		}
+
+		for (std::thread& t : threads) t.join();
+	}
+
+	// Acrescenta uma tarefa ao fim da fila da thread indicada e acorda uma thread do grupo dela
+	void submeter(std::function<void()> tarefa, int thread)
+	{
+		int indice = thread % (int)filas.size();
+		Fila& fila = *filas[indice];
+		Grupo& grupo = grupoDe(indice);
+
+		{
+			std::lock_guard<std::mutex> lock(fila.mutex);
+			fila.tarefas.push_back(std::move(tarefa));
+		}
+		{
+			std::lock_guard<std::mutex> lock(grupo.mutex);
+			grupo.pendentes++;
+		}
+		grupo.espera.notify_one();
+	}
+
+	int numeroThreads() const { return (int)filas.size(); }
+
+	// Quantas vezes as threads do grupo acordaram à procura de trabalho (para a verificação)
+	long despertares(int grupo)
+	{
+		Grupo& g = *grupos[grupo % grupos.size()];
+		std::lock_guard<std::mutex> lock(g.mutex);
+
+		return g.despertares;
+	}
+
+private:
+	struct Fila
+	{
+		std::mutex mutex;
+		std::deque<std::function<void()>> tarefas;
+	};
+
+	struct Grupo
+	{
+		Grupo() : pendentes(0), despertares(0) {}
+
+		std::mutex mutex;
+		std::condition_variable espera;
+		std::atomic<int> pendentes;		// Tarefas nas filas do grupo (ainda não começadas); sobe com o mutex
+		long despertares;				// Protegido pelo mutex
+	};
+
+	Grupo& grupoDe(int thread) { return *grupos[thread % grupos.size()]; }
+
+	// Tira a tarefa mais antiga de uma fila
+	bool tirar(Fila& fila, std::function<void()>& tarefa)
+	{
+		std::lock_guard<std::mutex> lock(fila.mutex);
+
+		if (fila.tarefas.empty()) return false;
+
+		tarefa = std::move(fila.tarefas.front());
+		fila.tarefas.pop_front();
+
+		return true;
+	}
+
+	// Primeiro a fila da própria thread, depois as outras do mesmo grupo (a começar pela seguinte)
+	bool obter(int thread, std::function<void()>& tarefa)
+	{
+		int n = (int)filas.size(), ngrupos = (int)grupos.size(), k;
+
+		for (k = 0; k < n; k++)
+		{
+			if (((thread + k) % n) % ngrupos != thread % ngrupos) continue;
+
+			if (tirar(*filas[(thread + k) % n], tarefa))
+			{
+				grupoDe(thread).pendentes--;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	void trabalhar(int thread)
+	{
+		std::function<void()> tarefa;
+		Grupo& grupo = grupoDe(thread);
+
+		if (iniciar) iniciar(thread);
+
+		while (true)
+		{
+			if (obter(thread, tarefa))
+			{
+				tarefa();
+				tarefa = nullptr;
+				continue;
+			}
+
+			// Sem tarefas nas filas do grupo: dorme até haver uma nova no grupo
+			std::unique_lock<std::mutex> lock(grupo.mutex);
+			grupo.espera.wait(lock, [this, &grupo] { return (grupo.pendentes > 0) || terminar; });
+			if (terminar) return;
+			grupo.despertares++;
+		}
+	}
+
+	std::vector<std::unique_ptr<Fila>> filas;
+	std::vector<std::unique_ptr<Grupo>> grupos;
+	std::vector<std::thread> threads;
+	std::function<void(int)> iniciar;
+	std::atomic<bool> terminar;
+};
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//                   FLUXOS DE VÍDEO
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+struct Fluxo
+{
+	int id;
+	std::string fonte;
+	int thread;						// Fila onde as tarefas do fluxo são submetidas
+	bool sintetico;					// Frames geradas em vez de lidas
+	FPVC* memoria;					// Frames lidas de um anel em memória partilhada ("memoria:/nome")
+	IVC frameMemoria;				// Vista sobre o slot da frame em processamento
+	IVC* imagemPropria;				// imagemCamera do fluxo, posta de parte enquanto se processa o slot
+	SVC seguimentoAnterior;			// Estado entre frames antes de processar o slot (reposto se o slot for reescrito a meio)
+	RVC rastreioAnterior;
+	Cor corAnterior;
+	cv::VideoCapture captura;
+	cv::Mat frame;
+	bool frameLida;					// A primeira frame já foi lida na abertura (para saber a resolução)
+	int width, height;
+	long nframe;
+
+	// Imagens IVC e estado entre frames (alocados uma única vez para o fluxo)
+	PVC* processamento;
+	int leitor;						// Lugar de leitor dos parâmetros (-1 = sem --parametros)
+
+	// Estatística (lida pela thread principal)
+	std::atomic<long> frames, deteccoes;
+	std::atomic<bool> terminado;
+
+	Fluxo() : id(0), thread(0), sintetico(false), memoria(NULL), frameMemoria(), imagemPropria(NULL), seguimentoAnterior(), rastreioAnterior(),
+		corAnterior(AZUL), frameLida(false), width(0), height(0), nframe(0), processamento(NULL), leitor(-1), frames(0), deteccoes(0), terminado(false) {}
+};
+
+// Gera uma frame sintética: sinal azul com uma seta branca que se desloca na horizontal
+// (a seta muda de sentido a cada 150 frames; cada fluxo tem uma fase diferente)
+static void gerarFrame(IVC* imagem, int id, long nframe)
+{
+	unsigned char* data = (unsigned char*)imagem->data;
+	int width = imagem->width, height = imagem->height;
+	int raio = MIN(width, height) / 4;
+	int cx = width / 2 + (int)((width / 2 - raio - 1) * std::sin(0.02 * nframe + id));
+	int cy = height / 2;
+	int sentido = ((nframe / 150 + id) % 2 == 0) ? -1 : 1; // -1 = esquerda
+	int x, y, dx, dy, ax;
+	long int pos;
+
+	for (y = 0; y < height; y++)
+	{
+		for (x = 0; x < width; x++)
+		{
+			pos = y * imagem->bytesperline + x * 3;
+			dx = x - cx;
+			dy = y - cy;
+			ax = dx * sentido; // Coordenada ao longo da seta (positiva para o lado da ponta)
+
+			// Fundo branco
+			data[pos] = 255;
+			data[pos + 1] = 255;
+			data[pos + 2] = 255;
+
+			if (dx * dx + dy * dy >= raio * raio) continue;
+
+			// Seta branca: haste retangular e ponta triangular
+			if (((ax > -raio * 7 / 10) && (ax <= raio / 5) && (std::abs(dy) < raio / 6)) ||
+				((ax > raio / 5) && (ax < raio * 7 / 10) && (std::abs(dy) < raio * 7 / 10 - ax))) continue;
+
+			// Azul dos sinais (BGR)
+			data[pos] = 0x83;
+			data[pos + 1] = 0x32;
+			data[pos + 2] = 0x1a;
+		}
+	}
+}
+
+// Copia uma frame lida para uma imagem IVC com as mesmas dimensões (linha a linha)
+static bool copiarFrame(const cv::Mat& frame, IVC* imagem)
+{
+	int y;
+
+	if (frame.empty() || (frame.type() != CV_8UC3) || (frame.cols != imagem->width) || (frame.rows != imagem->height)) return false;
+
+	for (y = 0; y < imagem->height; y++)
+	{
+		memcpy(imagem->data + y * imagem->bytesperline, frame.data + y * (size_t)frame.step, imagem->width * 3);
+	}
+
+	return true;
+}
+
+// Abre a fonte e fica a saber a resolução das frames
+static bool abrirFonte(Fluxo* fluxo)
+{
+	const std::string prefixo = "sintetico", prefixoMemoria = "memoria:";
+	std::string fonte = fluxo->fonte;
+
+	if (fonte.compare(0, prefixoMemoria.size(), prefixoMemoria) == 0)
+	{
+		// O anel tem de já ter sido criado pelo produtor
+		fluxo->memoria = vc_memoria_abrir(fonte.c_str() + prefixoMemoria.size());
+		if (fluxo->memoria == NULL) return false;
+		fluxo->width = fluxo->memoria->cabecalho->width;
+		fluxo->height = fluxo->memoria->cabecalho->height;
+	}
+	else if (fonte.compare(0, prefixo.size(), prefixo) == 0)
+	{
+		fluxo->sintetico = true;
+		fluxo->width = 640;
+		fluxo->height = 480;
+		if ((fonte.size() > prefixo.size()) && (std::sscanf(fonte.c_str() + prefixo.size(), ":%dx%d", &fluxo->width, &fluxo->height) != 2)) return false;
+		if ((fluxo->width < 16) || (fluxo->height < 16)) return false;
+	}
+	else
+	{
+		// Um número é o índice de uma câmara; o resto é aberto pelo OpenCV (ficheiro, pipe, URL)
+		if (!fonte.empty() && (fonte.find_first_not_of("0123456789") == std::string::npos)) fluxo->captura.open(std::atoi(fonte.c_str()), cv::CAP_ANY);
+		else fluxo->captura.open(fonte, cv::CAP_ANY);
+
+		if (!fluxo->captura.isOpened()) return false;
+
+		// A resolução é a da primeira frame
+		if (!fluxo->captura.read(fluxo->frame) || fluxo->frame.empty()) return false;
+		fluxo->frameLida = true;
+		fluxo->width = fluxo->frame.cols;
+		fluxo->height = fluxo->frame.rows;
+	}
+
+	return true;
+}
+
+// Abre a fonte e aloca as imagens do fluxo
+static bool abrirFluxo(Fluxo* fluxo)
+{
+	if (!abrirFonte(fluxo)) return false;
+
+	fluxo->processamento = vc_processamento_novo(fluxo->width, fluxo->height);
+	if (fluxo->processamento == NULL) return false;
+
+	// Os mesmos modos do vídeo único
+	fluxo->processamento->modoRastreio = 1;
+	fluxo->processamento->modoMultiObjeto = 0;
+	fluxo->processamento->fatorPiramide = 1;
+	fluxo->processamento->modoVerificacao = 1;
+
+	return true;
+}
+
+// Lê (ou gera) a frame seguinte de uma fonte "sintetico" ou do OpenCV para uma imagem com as
+// dimensões da fonte. Com as mesmas dimensões e tipo, o OpenCV descodifica diretamente para a
+// memória da imagem (quando o backend o permite; senão é copiada)
+static bool lerFrame(Fluxo* fonte, IVC* imagem, long nframe)
+{
+	if (fonte->sintetico)
+	{
+		gerarFrame(imagem, fonte->id, nframe);
+		return true;
+	}
+
+	// A primeira frame já foi lida na abertura
+	if (fonte->frameLida)
+	{
+		fonte->frameLida = false;
+		return copiarFrame(fonte->frame, imagem);
+	}
+
+	cv::Mat destino(imagem->height, imagem->width, CV_8UC3, imagem->data, (size_t)imagem->bytesperline);
+
+	if (!fonte->captura.read(destino)) return false;
+
+	return (destino.data == imagem->data) || copiarFrame(destino, imagem);
+}
+
+// Estado partilhado pelas tarefas
+struct Execucao
+{
+	PoolTarefas* pool;
+	std::atomic<bool> parar;
+	bool comPerfil;					// --perfil (só com uma thread: os contadores medem a thread que cria o perfil)
+	PFVC* perfil;					// Criado na primeira tarefa, partilhado por todas as fontes
+	Parametros* parametros;			// --parametros (recarregados quando o ficheiro muda) ou NULL
+};
+
+static void etapaCaptura(Execucao* execucao, Fluxo* fluxo);
+
+// Etapa 2: processamento completo da frame; depois agenda a captura da frame seguinte
+// (cada fluxo tem no máximo uma tarefa na fila ou a executar, por isso as frames são processadas por ordem)
+static void etapaProcessamento(Execucao* execucao, Fluxo* fluxo)
+{
+	int ndeteccoes;
+
+	if (execucao->comPerfil)
+	{
+		if (execucao->perfil == NULL) execucao->perfil = vc_perfil_novo();
+		fluxo->processamento->perfil = execucao->perfil;
+	}
+
+	// Um slot reescrito a meio obriga a desfazer o que a frame mudou no estado entre frames
+	if (fluxo->memoria != NULL)
+	{
+		fluxo->seguimentoAnterior = fluxo->processamento->seguimento;
+		fluxo->rastreioAnterior = fluxo->processamento->rastreio;
+		fluxo->corAnterior = fluxo->processamento->cor;
+	}
+
+	// Os parâmetros ficam os mesmos durante toda a frame (uma troca só se vê na frame seguinte)
+	parametros_aplicar(parametros_entrar(execucao->parametros, fluxo->leitor), fluxo->processamento);
+	ndeteccoes = vc_processar_frame(fluxo->processamento);
+	parametros_sair(execucao->parametros, fluxo->leitor);
+
+	// O slot volta para o produtor. Se foi reescrito a meio (todos os slots estavam reservados), o
+	// resultado pode não corresponder a nenhuma frame: as deteções são descartadas, o seguimento e o
+	// rastreio voltam ao que eram e as alterações recomeçam do zero (a referência tem píxeis da frame misturada)
+	if (fluxo->memoria != NULL)
+	{
+		fluxo->processamento->imagemCamera = fluxo->imagemPropria;
+		if (!vc_memoria_confirmar(fluxo->memoria))
+		{
+			ndeteccoes = 0;
+			fluxo->processamento->ndeteccoes = 0;
+			fluxo->processamento->seguimento = fluxo->seguimentoAnterior;
+			fluxo->processamento->rastreio = fluxo->rastreioAnterior;
+			fluxo->processamento->cor = fluxo->corAnterior;
+			if (fluxo->processamento->alteracoes != NULL)
+			{
+				vc_alteracoes_invalidar(fluxo->processamento->alteracoes);
+				fluxo->processamento->alteracoes->iniciado = 0;
+			}
+		}
+	}
+
+	fluxo->deteccoes += ndeteccoes;
+	fluxo->frames++;
+
+	execucao->pool->submeter([execucao, fluxo] { etapaCaptura(execucao, fluxo); }, fluxo->thread);
+}
+
+// Etapa 1: lê (ou gera) a frame para as imagens do fluxo
+static void etapaCaptura(Execucao* execucao, Fluxo* fluxo)
+{
+	bool ok;
+
+	if (execucao->parar)
+	{
+		fluxo->terminado = true;
+		return;
+	}
+
+	if (fluxo->sintetico)
+	{
+		gerarFrame(fluxo->processamento->imagemCamera, fluxo->id, fluxo->nframe);
+		ok = true;
+	}
+	else if (fluxo->memoria != NULL)
+	{
+		// A frame é processada diretamente no slot (sem cópia); a espera é feita em intervalos
+		// curtos para que o fluxo veja o pedido de paragem. O fim do produtor termina o fluxo
+		int r;
+
+		do
+		{
+			r = vc_memoria_proxima(fluxo->memoria, &fluxo->frameMemoria, 100);
+		} while ((r == 0) && !execucao->parar);
+
+		ok = (r > 0);
+		if (ok)
+		{
+			fluxo->imagemPropria = fluxo->processamento->imagemCamera;
+			fluxo->processamento->imagemCamera = &fluxo->frameMemoria;
+		}
+	}
+	else
+	{
+		// Fim do vídeo (ou erro de leitura) termina o fluxo
+		ok = fluxo->frameLida || fluxo->captura.read(fluxo->frame);
+		fluxo->frameLida = false;
+		ok = ok && copiarFrame(fluxo->frame, fluxo->processamento->imagemCamera);
+	}
+
+	if (!ok)
+	{
+		fluxo->terminado = true;
+		return;
+	}
+
+	fluxo->nframe++;
+	execucao->pool->submeter([execucao, fluxo] { etapaProcessamento(execucao, fluxo); }, fluxo->thread);
+}
+
+/*
+* Função: fluxos_executar
+* ----------------------------
+* Processa vários vídeos em simultâneo: cada fonte tem as suas imagens IVC (alocadas à
+* partida) e as etapas de cada frame (captura e processamento) são tarefas de um conjunto
+* partilhado de threads com roubo de tarefas. Uma fonte lenta só ocupa uma thread de cada
+* vez, por isso não atrasa as outras. Mostra as frames por segundo de cada fonte a cada segundo
+*
+* argc, argv  : [--threads N] [--segundos S] [--perfil] [--parametros ficheiro] [--memoria modo] [--numa] fonte1 fonte2 ...
+*               (--perfil usa uma só thread e, no fim, mostra o perfil de cada etapa)
+*               (--parametros recarrega os limites e as regras quando o ficheiro muda, sem parar as fontes)
+*               (--memoria normal, grandes ou reservadas: páginas das imagens, ver VC_ALOCACAO_*)
+*               (--numa: cada thread fica num nó, as imagens de cada fonte no nó da sua thread e
+*               as tarefas só são roubadas por threads do mesmo nó)
+* tabelaCores : tabela de cores (só de leitura, por isso pode ser partilhada) ou NULL
+*/
+int fluxos_executar(int argc, char** argv, TCVC* tabelaCores)
+{
+	std::vector<std::unique_ptr<Fluxo>> fluxos;
+	std::vector<long> framesAnteriores;
+	Execucao execucao;
+	int nthreads = (int)std::thread::hardware_concurrency();
+	double segundos = 0.0; // 0 = até todas as fontes terminarem
+	const char* ficheiroParametros = NULL;
+	int modoMemoria = -1, nos = 1; // -1 = sem --memoria
+	bool comNuma = false;
+	double decorrido, intervalo, fpsTotal;
+	long frames;
+	int i, ativos;
+
+	if (nthreads <= 0) nthreads = 4;
+	execucao.comPerfil = false;
+	execucao.perfil = NULL;
+	execucao.parametros = NULL;
+
+	for (i = 0; i < argc; i++)
+	{
+		std::string arg = argv[i];
+
+		if ((arg == "--threads") && (i + 1 < argc))
+		{
+			nthreads = std::atoi(argv[++i]);
+			if (nthreads < 1) nthreads = 1;
+		}
+		else if ((arg == "--segundos") && (i + 1 < argc)) segundos = std::atof(argv[++i]);
+		else if (arg == "--perfil") execucao.comPerfil = true;
+		else if ((arg == "--parametros") && (i + 1 < argc)) ficheiroParametros = argv[++i];
+		else if ((arg == "--memoria") && (i + 1 < argc))
+		{
+			arg = argv[++i];
+			if (arg == "normal") modoMemoria = VC_ALOCACAO_NORMAL;
+			else if (arg == "grandes") modoMemoria = VC_ALOCACAO_GRANDES;
+			else if (arg == "reservadas") modoMemoria = VC_ALOCACAO_RESERVADAS;
+			else
+			{
+				std::cerr << "Modo de memória desconhecido: " << arg << " (normal, grandes ou reservadas)\n";
+				return 1;
+			}
+		}
+		else if (arg == "--numa") comNuma = true;
+		else
+		{
+			fluxos.push_back(std::unique_ptr<Fluxo>(new Fluxo()));
+			fluxos.back()->id = (int)fluxos.size() - 1;
+			fluxos.back()->fonte = arg;
+		}
+	}
+
+	if (execucao.comPerfil) nthreads = 1;
+
+	if (fluxos.empty())
+	{
+		std::cerr << "Uso: [--threads N] [--segundos S] [--perfil] [--parametros ficheiro] [--memoria normal|grandes|reservadas] [--numa] fonte1 fonte2 ... (fonte = câmara, ficheiro, pipe, sintetico[:LxA] ou memoria:/nome)\n";
+		return 1;
+	}
+
+	if (modoMemoria >= 0) vc_alocacao_definir(modoMemoria);
+	if (comNuma) nos = vc_numa_nos();
+
+	for (i = 0; i < (int)fluxos.size(); i++)
+	{
+		fluxos[i]->thread = i % nthreads;
+
+		// A thread principal passa para o nó da thread do fluxo enquanto aloca (e toca) as imagens dele
+		if (comNuma) vc_numa_fixar(fluxos[i]->thread % nos);
+
+		if (!abrirFluxo(fluxos[i].get()))
+		{
+			std::cerr << "Erro ao abrir a fonte " << fluxos[i]->fonte << "!\n";
+			for (std::unique_ptr<Fluxo>& f : fluxos)
+			{
+				vc_processamento_libertar(f->processamento);
+				vc_memoria_fechar(f->memoria);
+			}
+			return 1;
+		}
+
+		fluxos[i]->processamento->tabelaCores = tabelaCores;
+		framesAnteriores.push_back(0);
+	}
+
+	if (comNuma) vc_numa_fixar(-1);
+
+	if (ficheiroParametros != NULL)
+	{
+		execucao.parametros = parametros_iniciar(ficheiroParametros, tabelaCores, 500);
+		if (execucao.parametros == NULL)
+		{
+			std::cerr << "Erro nos parâmetros de " << ficheiroParametros << "!\n";
+			for (std::unique_ptr<Fluxo>& f : fluxos)
+			{
+				vc_processamento_libertar(f->processamento);
+				vc_memoria_fechar(f->memoria);
+			}
+			return 1;
+		}
+
+		for (std::unique_ptr<Fluxo>& f : fluxos) f->leitor = parametros_leitor(execucao.parametros);
+	}
+
+	std::printf("%d fontes, %d threads\n", (int)fluxos.size(), nthreads);
+	if ((modoMemoria >= 0) || comNuma) vc_alocacao_relatorio(stdout);
+
+	execucao.parar = false;
+	{
+		PoolTarefas pool(nthreads, nos, [comNuma, nos](int thread) { if (comNuma) vc_numa_fixar(thread % nos); });
+		auto inicio = std::chrono::steady_clock::now();
+		auto anterior = inicio;
+
+		execucao.pool = &pool;
+
+		// Primeira frame de cada fonte (as seguintes são agendadas pelas próprias tarefas)
+		for (std::unique_ptr<Fluxo>& f : fluxos)
+		{
+			Fluxo* fluxo = f.get();
+			pool.submeter([&execucao, fluxo] { etapaCaptura(&execucao, fluxo); }, fluxo->thread);
+		}
+
+		// Relatório a cada segundo
+		do
+		{
+			std::this_thread::sleep_for(std::chrono::seconds(1));
+
+			auto agora = std::chrono::steady_clock::now();
+			decorrido = std::chrono::duration<double>(agora - inicio).count();
+			intervalo = std::chrono::duration<double>(agora - anterior).count();
+			anterior = agora;
+
+			fpsTotal = 0.0;
+			ativos = 0;
+			for (i = 0; i < (int)fluxos.size(); i++)
+			{
+				frames = fluxos[i]->frames;
+				fpsTotal += (frames - framesAnteriores[i]) / intervalo;
+				std::printf("[%2d] %-28.28s %7.1f fps %8ld frames %8ld deteções%s\n", i, fluxos[i]->fonte.c_str(),
+					(frames - framesAnteriores[i]) / intervalo, frames, (long)fluxos[i]->deteccoes,
+					fluxos[i]->terminado ? " (terminou)" : "");
+				framesAnteriores[i] = frames;
+				if (!fluxos[i]->terminado) ativos++;
+			}
+			std::printf("total: %.1f fps (%.0f s)\n\n", fpsTotal, decorrido);
+		} while ((ativos > 0) && ((segundos <= 0.0) || (decorrido < segundos)));
+
+		// Cada fonte termina na próxima captura
+		execucao.parar = true;
+		for (std::unique_ptr<Fluxo>& f : fluxos)
+		{
+			while (!f->terminado) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+
+	for (std::unique_ptr<Fluxo>& f : fluxos)
+	{
+		if (f->memoria != NULL)
+		{
+			std::printf("%s: %ld frames recebidas, %ld perdidas, %ld reescritas durante o processamento (descartadas)\n", f->fonte.c_str(),
+				f->memoria->frames, f->memoria->perdidas, f->memoria->sobrescritas);
+		}
+
+		f->captura.release();
+		vc_processamento_libertar(f->processamento);
+		vc_memoria_fechar(f->memoria);
+	}
+
+	if (execucao.perfil != NULL)
+	{
+		vc_perfil_relatorio(execucao.perfil, stdout);
+		vc_perfil_libertar(execucao.perfil);
+	}
+
+	parametros_terminar(execucao.parametros);
+
+	return 0;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//          PRODUTOR DE FRAMES EM MEMÓRIA PARTILHADA
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+static volatile std::sig_atomic_t produtorParar = 0;
+
+static void pararProdutor(int)
+{
+	produtorParar = 1;
+}
+
+/*
+* Função: fluxos_produzir
+* ----------------------------
+* Ferramenta de teste do anel em memória partilhada: faz o papel do processo que descodifica o
+* vídeo e publica as frames (geradas ou lidas de uma fonte) num anel, ao ritmo pedido. As frames
+* geradas são escritas diretamente no slot; as lidas pelo OpenCV são descodificadas para o slot
+* quando o backend o permite (senão são copiadas). Termina no fim da fonte, ao fim de S segundos
+* ou com Ctrl+C, e remove o anel
+*
+* argc, argv : /nome [fonte] [--fps F] [--slots N] [--segundos S]
+*/
+int fluxos_produzir(int argc, char** argv)
+{
+	Fluxo fonte;
+	FPVC* memoria;
+	IVC slot;
+	std::string nome;
+	double fps = -1.0, segundos = 0.0, decorrido;
+	long publicadas = 0, anteriores = 0;
+	int nslots = 4, i;
+
+	fonte.fonte = "sintetico";
+	for (i = 0; i < argc; i++)
+	{
+		std::string arg = argv[i];
+
+		if ((arg == "--fps") && (i + 1 < argc)) fps = std::atof(argv[++i]);
+		else if ((arg == "--slots") && (i + 1 < argc)) nslots = std::atoi(argv[++i]);
+		else if ((arg == "--segundos") && (i + 1 < argc)) segundos = std::atof(argv[++i]);
+		else if (nome.empty()) nome = arg;
+		else fonte.fonte = arg;
+	}
+
+	if (nome.empty() || (fonte.fonte.compare(0, 8, "memoria:") == 0))
+	{
+		std::cerr << "Uso: --produtor-memoria /nome [fonte] [--fps F] [--slots N] [--segundos S] (fonte = câmara, ficheiro, pipe ou sintetico[:LxA])\n";
+		return 1;
+	}
+
+	if (!abrirFonte(&fonte))
+	{
+		std::cerr << "Erro ao abrir a fonte " << fonte.fonte << "!\n";
+		return 1;
+	}
+
+	// Sem --fps: 30 nas frames geradas e o ritmo do vídeo nas lidas (0 = o mais depressa possível)
+	if (fps < 0.0) fps = fonte.sintetico ? 30.0 : fonte.captura.get(cv::CAP_PROP_FPS);
+	if (!(fps > 0.0)) fps = 0.0;
+
+	memoria = vc_memoria_criar(nome.c_str(), fonte.width, fonte.height, nslots);
+	if (memoria == NULL)
+	{
+		std::cerr << "Erro ao criar a memória partilhada " << nome << " (só existe em Linux)!\n";
+		return 1;
+	}
+
+	std::signal(SIGINT, pararProdutor);
+	std::printf("%s: %dx%d, %d slots, %.1f fps\n", nome.c_str(), fonte.width, fonte.height, nslots, fps);
+
+	auto inicio = std::chrono::steady_clock::now();
+	auto relatorio = inicio;
+
+	while (!produtorParar)
+	{
+		vc_memoria_slot(memoria, &slot);
+		if (!lerFrame(&fonte, &slot, publicadas)) break;
+
+		vc_memoria_publicar(memoria);
+		publicadas++;
+
+		if (fps > 0.0) std::this_thread::sleep_until(inicio + std::chrono::duration<double>(publicadas / fps));
+
+		auto agora = std::chrono::steady_clock::now();
+		decorrido = std::chrono::duration<double>(agora - inicio).count();
+		if (std::chrono::duration<double>(agora - relatorio).count() >= 1.0)
+		{
+			std::printf("%8ld frames publicadas (%.1f fps)\n", publicadas,
+				(publicadas - anteriores) / std::chrono::duration<double>(agora - relatorio).count());
+			relatorio = agora;
+			anteriores = publicadas;
+		}
+		if ((segundos > 0.0) && (decorrido >= segundos)) break;
+	}
+
+	std::printf("%ld frames publicadas\n", publicadas);
+
+	std::signal(SIGINT, SIG_DFL);
+	vc_memoria_fechar(memoria);
+	fonte.captura.release();
+
+	return 0;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//           MODO OFFLINE (VÁRIAS FRAMES EM PARALELO)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+// Um conjunto de imagens IVC e o resultado da frame que está a ser processada com elas
+struct TrabalhoOffline
+{
+	PVC* processamento;
+	std::unique_ptr<FOVC> resultado;
+	bool pronto;					// Protegido pelo mutex do modo offline
+};
+
+static const char* nomeSinal(Sinal sinal)
+{
+	static const char* nomes[VC_NUM_SINAIS] = { "indefinido", "virar_e", "virar_d", "auto_estrada", "automoveis_motociclos",
+		"sentido_proibido", "stop" };
+
+	return ((sinal >= 0) && (sinal < VC_NUM_SINAIS)) ? nomes[sinal] : "?";
+}
+
+/*
+* Função: fluxos_offline
+* ----------------------------
+* Processa um vídeo inteiro o mais depressa possível (sem janela nem prazo por frame): várias
+* frames são processadas ao mesmo tempo, cada uma com o seu conjunto de imagens IVC, e os
+* resultados são juntos pela ordem das frames. Cada frame é processada sem depender das
+* anteriores (as duas cores na frame inteira, sem ROI nem alterações: vc_processar_independente);
+* o seguimento, que depende da ordem, é feito ao juntar (vc_processar_resultado). Por isso as
+* deteções são as mesmas com qualquer número de threads. Escreve uma linha por deteção:
+* frame;cor;sinal;trajeto;x;y;largura;altura;distanciaModelo
+*
+* argc, argv  : [--threads N] [--saida ficheiro] [--frames N] [--croma ycbcr|rg] fonte (ficheiro, pipe ou sintetico[:LxA])
+*               (sem --saida, escreve em stdout; --frames limita o número de frames, obrigatório com sintetico)
+*               (--croma segmenta com caixas de crominância calibradas a partir dos limites HSV, ver vc_croma_calibrar)
+* tabelaCores : tabela de cores partilhada (ou NULL)
+*/
+int fluxos_offline(int argc, char** argv, TCVC* tabelaCores)
+{
+	std::vector<TrabalhoOffline> trabalhos;
+	std::deque<int> emCurso;		// Trabalhos submetidos, pela ordem das frames
+	std::vector<int> livres;
+	std::mutex mutex;
+	std::condition_variable pronto;
+	Fluxo fonte;
+	PVC* sequencia;					// Estado entre frames (seguimento), só usado ao juntar
+	FILE* saida = stdout;
+	const char* nomeSaida = NULL;
+	int nthreads = (int)std::thread::hardware_concurrency();
+	long nframe = 0, deteccoes = 0, maxFrames = 0;
+	int espacoCroma = -1; // -1 = sem --croma
+	CXVC caixas[3];
+	long falsosPositivos, falsosNegativos;
+	int i, t, n, cor;
+	bool ok = true;
+
+	if (nthreads <= 0) nthreads = 4;
+
+	for (i = 0; i < argc; i++)
+	{
+		std::string arg = argv[i];
+
+		if ((arg == "--threads") && (i + 1 < argc))
+		{
+			nthreads = std::atoi(argv[++i]);
+			if (nthreads < 1) nthreads = 1;
+		}
+		else if ((arg == "--saida") && (i + 1 < argc)) nomeSaida = argv[++i];
+		else if ((arg == "--frames") && (i + 1 < argc)) maxFrames = std::atol(argv[++i]);
+		else if ((arg == "--croma") && (i + 1 < argc))
+		{
+			arg = argv[++i];
+			if (arg == "ycbcr") espacoCroma = VC_CROMA_YCBCR;
+			else if (arg == "rg") espacoCroma = VC_CROMA_RG;
+			else
+			{
+				std::cerr << "Espaço de crominância desconhecido: " << arg << " (ycbcr ou rg)\n";
+				return 1;
+			}
+		}
+		else fonte.fonte = arg;
+	}
+
+	// Sem --frames, uma fonte sintética nunca acaba (e a saída cresceria sem limite)
+	if (fonte.fonte.empty() || (fonte.fonte.compare(0, 8, "memoria:") == 0) ||
+		((maxFrames <= 0) && (fonte.fonte.compare(0, 9, "sintetico") == 0)))
+	{
+		std::cerr << "Uso: --offline [--threads N] [--saida ficheiro] [--frames N] [--croma ycbcr|rg] fonte (ficheiro, pipe ou sintetico[:LxA], este só com --frames)\n";
+		return 1;
+	}
+
+	if (!abrirFonte(&fonte))
+	{
+		std::cerr << "Erro ao abrir a fonte " << fonte.fonte << "!\n";
+		return 1;
+	}
+
+	if ((nomeSaida != NULL) && ((saida = std::fopen(nomeSaida, "w")) == NULL))
+	{
+		std::cerr << "Erro ao criar " << nomeSaida << "!\n";
+		return 1;
+	}
+
+	// Dois conjuntos de imagens por thread: enquanto uma frame é processada, a seguinte já está lida
+	trabalhos.resize(2 * nthreads);
+	for (t = 0; t < (int)trabalhos.size(); t++)
+	{
+		trabalhos[t].processamento = vc_processamento_novo(fonte.width, fonte.height);
+		trabalhos[t].resultado.reset(new FOVC());
+		trabalhos[t].pronto = false;
+		if (trabalhos[t].processamento == NULL)
+		{
+			ok = false;
+			continue;
+		}
+
+		// Os mesmos modos do vídeo único (a ROI e as alterações não servem: dependem da frame anterior)
+		trabalhos[t].processamento->modoMultiObjeto = 0;
+		trabalhos[t].processamento->fatorPiramide = 1;
+		trabalhos[t].processamento->tabelaCores = tabelaCores;
+		livres.push_back(t);
+	}
+
+	// Caixas de crominância calibradas uma vez (os limites são os mesmos em todos os trabalhos)
+	if (ok && (espacoCroma >= 0))
+	{
+		for (cor = AZUL; cor <= VERMELHO; cor++)
+		{
+			if (!vc_croma_calibrar(&trabalhos[0].processamento->limites[cor], espacoCroma, &caixas[cor], &falsosPositivos, &falsosNegativos))
+			{
+				ok = false;
+				break;
+			}
+			std::fprintf(stderr, "Caixa %s: [%d, %d] x [%d, %d] x [%d, %d] (%ld falsos positivos, %ld falsos negativos em 2^24 cores)\n",
+				(cor == AZUL) ? "azul" : "vermelho", caixas[cor].minimo[0], caixas[cor].maximo[0], caixas[cor].minimo[1], caixas[cor].maximo[1],
+				caixas[cor].minimo[2], caixas[cor].maximo[2], falsosPositivos, falsosNegativos);
+		}
+
+		for (t = 0; ok && (t < (int)trabalhos.size()); t++)
+		{
+			trabalhos[t].processamento->modoCroma = 1;
+			std::memcpy(trabalhos[t].processamento->caixas, caixas, sizeof(caixas));
+		}
+	}
+
+	sequencia = vc_processamento_novo(fonte.width, fonte.height);
+	if (!ok || (sequencia == NULL))
+	{
+		std::cerr << "Erro ao alocar as imagens!\n";
+		for (TrabalhoOffline& trabalho : trabalhos) vc_processamento_libertar(trabalho.processamento);
+		vc_processamento_libertar(sequencia);
+		if (saida != stdout) std::fclose(saida);
+		return 1;
+	}
+	sequencia->modoVerificacao = 1;
+
+	std::fprintf(saida, "frame;cor;sinal;trajeto;x;y;largura;altura;distanciaModelo\n");
+
+	auto inicio = std::chrono::steady_clock::now();
+	{
+		PoolTarefas pool(nthreads);
+
+		// Junta o resultado da frame mais antiga (espera que esteja pronta) e liberta o trabalho
+		auto juntar = [&]()
+		{
+			TrabalhoOffline& trabalho = trabalhos[emCurso.front()];
+			FOVC* r = trabalho.resultado.get();
+
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				pronto.wait(lock, [&trabalho] { return trabalho.pronto; });
+			}
+
+			n = vc_processar_resultado(sequencia, r);
+			for (i = 0; i < n; i++)
+			{
+				DVC* d = &sequencia->deteccoes[i];
+				std::fprintf(saida, "%ld;%s;%s;%d;%d;%d;%d;%d;%d\n", r->frame, (d->cor == AZUL) ? "azul" : "vermelho", nomeSinal(d->sinal),
+					d->trajeto, d->blob.x, d->blob.y, d->blob.width, d->blob.height, d->distanciaModelo);
+			}
+			deteccoes += n;
+
+			trabalho.pronto = false;
+			livres.push_back(emCurso.front());
+			emCurso.pop_front();
+		};
+
+		while (true)
+		{
+			// Sem conjuntos livres, o próximo a libertar é o da frame mais antiga
+			if (livres.empty()) juntar();
+
+			t = livres.back();
+			if ((maxFrames > 0) && (nframe >= maxFrames)) break;
+			if (!lerFrame(&fonte, trabalhos[t].processamento->imagemCamera, nframe)) break;
+			livres.pop_back();
+
+			trabalhos[t].resultado->frame = nframe++;
+			emCurso.push_back(t);
+			pool.submeter([&trabalhos, &mutex, &pronto, t]
+			{
+				vc_processar_independente(trabalhos[t].processamento, trabalhos[t].resultado.get());
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					trabalhos[t].pronto = true;
+				}
+				pronto.notify_all();
+			}, t);
+		}
+
+		// Fim da fonte: junta as frames que faltam
+		while (!emCurso.empty()) juntar();
+	}
+	double segundos = std::chrono::duration<double>(std::chrono::steady_clock::now() - inicio).count();
+
+	std::fprintf(stderr, "%ld frames em %.2f s (%.1f fps, %d threads), %ld deteções\n", nframe, segundos,
+		nframe / MAX(segundos, 1e-9), nthreads, deteccoes);
+
+	if (saida != stdout) std::fclose(saida);
+	for (TrabalhoOffline& trabalho : trabalhos) vc_processamento_libertar(trabalho.processamento);
+	vc_processamento_libertar(sequencia);
+	fonte.captura.release();
+
+	return 0;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//            VERIFICAÇÃO DO CONJUNTO DE THREADS
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+// Número da thread do conjunto que está a correr (posto por iniciar)
+static thread_local int threadPool = -1;
+
+/*
+* Função: fluxos_verificar_pool
+* ----------------------------
+* Conjunto com 4 threads em 2 grupos (como com --numa em 2 nós) e todas as tarefas submetidas às
+* filas do grupo 0: as tarefas têm de ser todas executadas, só por threads do grupo 0, e as
+* threads do grupo 1 têm de continuar a dormir (sem acordar nem girar à procura de trabalho)
+*/
+int fluxos_verificar_pool(void)
+{
+	const int nthreads = 4, ngrupos = 2, ntarefas = 400;
+	std::atomic<int> feitas(0), foraDoGrupo(0);
+	long despertaresGrupo0, despertaresGrupo1;
+	int i, espera;
+
+	{
+		PoolTarefas pool(nthreads, ngrupos, [](int thread) { threadPool = thread; });
+
+		for (i = 0; i < ntarefas; i++)
+		{
+			// Threads 0 e 2 (grupo 0), em rajadas para as threads do grupo adormecerem entre elas
+			pool.submeter([&feitas, &foraDoGrupo, ngrupos] {
+				if (threadPool % ngrupos != 0) foraDoGrupo++;
+				std::this_thread::sleep_for(std::chrono::microseconds(50));
+				feitas++;
+			}, (i % 2) * ngrupos);
+
+			if (i % 20 == 19) std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		}
+
+		// Uma tarefa perdida (grupo 0 a dormir com trabalho na fila) nunca acabaria: no máximo 10 s
+		for (espera = 0; (feitas < ntarefas) && (espera < 10000); espera++) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+		despertaresGrupo0 = pool.despertares(0);
+		despertaresGrupo1 = pool.despertares(1);
+	}
+
+	std::printf("Conjunto de threads: %d/%d tarefas, %d fora do grupo, %ld despertares no grupo 0, %ld no grupo 1\n",
+		(int)feitas, ntarefas, (int)foraDoGrupo, despertaresGrupo0, despertaresGrupo1);
+
+	return ((feitas == ntarefas) && (foraDoGrupo == 0) && (despertaresGrupo1 == 0)) ? 0 : 1;
+}
@@ -0,0 +1,37 @@
+﻿/*
+Autores:
+-Filipe Gajo
+-Ricardo Sampaio
+-Cláudio Silva
+*/
+
+// Processamento de vários vídeos em simultâneo (sem janelas), num conjunto partilhado de threads
+#pragma once
+
+extern "C" {
+#include "vc.h"
+}
+
+// Argumentos: [--threads N] [--segundos S] [--perfil] [--parametros ficheiro] [--memoria modo] [--numa] fonte1 fonte2 ...
+// --perfil: uma só thread e, no fim, o perfil de cada etapa (tempo e contadores do processador)
+// --parametros: limites da segmentação e regras do classificador recarregados quando o ficheiro muda (ver parametros.h)
+// --memoria normal|grandes|reservadas: páginas usadas nas imagens (ver VC_ALOCACAO_*); --numa: threads e imagens
+// de cada fonte fixadas a um nó NUMA. Com qualquer um dos dois, mostra a estatística da memória
+// Cada fonte é um número (câmara), "sintetico" ou "sintetico:LxA" (frames geradas), "memoria:/nome"
+// (anel de frames em memória partilhada, só em Linux) ou qualquer outro nome que o cv::VideoCapture
+// abra (ficheiro, pipe, URL)
+// tabelaCores (opcional) é partilhada por todas as fontes
+// Devolve o código de saída do programa
+int fluxos_executar(int argc, char** argv, TCVC* tabelaCores);
+
+// Produtor de teste para as fontes "memoria:/nome"
+// Argumentos: /nome [fonte] [--fps F] [--slots N] [--segundos S]
+int fluxos_produzir(int argc, char** argv);
+
+// Um vídeo inteiro, com várias frames processadas em paralelo e os resultados pela ordem das frames
+// Argumentos: [--threads N] [--saida ficheiro] [--frames N] [--croma ycbcr|rg] fonte; escreve uma linha por deteção (ver fluxos.cpp)
+int fluxos_offline(int argc, char** argv, TCVC* tabelaCores);
+
+// Verificação do conjunto de threads com 2 grupos (tarefas só num grupo: o outro não pode acordar)
+// Devolve 0 se passou
+int fluxos_verificar_pool(void);
@@ -0,0 +1,375 @@
+﻿/*
+Autores:
+-Filipe Gajo
+-Ricardo Sampaio
+-Cláudio Silva
+*/
+
+// Headers "normais"
+#include <string> // Classe string do C++
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+extern "C" {
+#include "vc.h"
+}
+
+#include "gravacao.h"
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//              GRAVAÇÃO ASSÍNCRONA DE IMAGENS
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+// Imagem copiada à espera de ser escrita (os dados ficam alocados e são reaproveitados)
+struct Buffer
+{
+	std::vector<unsigned char> dados;
+	IVC imagem;						// Aponta para dados (sem vista: bytesperline = width * channels)
+	size_t bytes;					// Só em GRAVACAO_DADOS: bytes a escrever de dados
+	long numero;					// Ordem de chegada
+	char nome[64];
+};
+
+// Os buffers circulam entre a lista dos livres, a fila (por ordem de chegada) e a thread que escreve
+struct Gravacao
+{
+	std::string destino;
+	int modo, politica;
+	FILE* fluxo;					// Só em GRAVACAO_FLUXO
+
+	std::vector<Buffer> buffers;
+	std::vector<int> livres;
+	std::vector<int> fila;			// Circular, com capacidade = número de buffers
+	int inicio, nfila;
+
+	std::mutex mutex;
+	std::condition_variable haTrabalho, haLivres;
+	bool terminar;
+	bool parada;					// A thread escreveu tudo e fechou o destino
+	std::thread thread;
+
+	// Estatística (protegida por mutex)
+	long enviadas, escritas, descartadas, erros;
+	double espera;
+};
+
+// Escreve um buffer (na thread da gravação, sem o mutex)
+static bool escreverBuffer(Gravacao* gravacao, Buffer& buffer)
+{
+	FILE* ficheiro;
+	char nome[512];
+	const char* extensao;
+	bool ok;
+
+	if (gravacao->modo == GRAVACAO_DADOS) return std::fwrite(buffer.dados.data(), 1, buffer.bytes, gravacao->fluxo) == buffer.bytes;
+	if (gravacao->modo == GRAVACAO_FLUXO) return vc_write_image_file(gravacao->fluxo, &buffer.imagem) == 1;
+
+	if (buffer.imagem.levels == 1) extensao = "pbm";
+	else extensao = (buffer.imagem.channels == 1) ? "pgm" : "ppm";
+
+	if (buffer.nome[0] != '\0') std::snprintf(nome, sizeof(nome), "%s_%06ld_%s.%s", gravacao->destino.c_str(), buffer.numero, buffer.nome, extensao);
+	else std::snprintf(nome, sizeof(nome), "%s_%06ld.%s", gravacao->destino.c_str(), buffer.numero, extensao);
+
+	ficheiro = std::fopen(nome, "wb");
+	if (ficheiro == NULL) return false;
+
+	ok = vc_write_image_file(ficheiro, &buffer.imagem) == 1;
+
+	return (std::fclose(ficheiro) == 0) && ok;
+}
+
+// Thread da gravação: tira o buffer mais antigo da fila, escreve-o e devolve-o aos livres
+static void gravar(Gravacao* gravacao)
+{
+	int b;
+	bool ok;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(gravacao->mutex);
+			gravacao->haTrabalho.wait(lock, [gravacao] { return (gravacao->nfila > 0) || gravacao->terminar; });
+
+			// Só termina depois de a fila estar vazia (e fecha o destino na própria thread)
+			if (gravacao->nfila == 0)
+			{
+				if (gravacao->fluxo != NULL) std::fclose(gravacao->fluxo);
+				gravacao->fluxo = NULL;
+				gravacao->parada = true;
+				return;
+			}
+
+			b = gravacao->fila[gravacao->inicio];
+			gravacao->inicio = (gravacao->inicio + 1) % (int)gravacao->fila.size();
+			gravacao->nfila--;
+		}
+
+		ok = escreverBuffer(gravacao, gravacao->buffers[b]);
+
+		{
+			std::lock_guard<std::mutex> lock(gravacao->mutex);
+			if (ok) gravacao->escritas++;
+			else gravacao->erros++;
+			gravacao->livres.push_back(b);
+		}
+		gravacao->haLivres.notify_all();
+	}
+}
+
+// Tira um buffer dos livres (sem nenhum, descarta ou espera, conforme a política) e numera-o; -1 = descartado
+static int tirarLivre(Gravacao* gravacao)
+{
+	std::unique_lock<std::mutex> lock(gravacao->mutex);
+	int b;
+
+	if (gravacao->terminar) return -1;
+
+	gravacao->enviadas++;
+	if (gravacao->livres.empty())
+	{
+		if (gravacao->politica != GRAVACAO_ESPERAR)
+		{
+			gravacao->descartadas++;
+			return -1;
+		}
+
+		auto inicio = std::chrono::steady_clock::now();
+		gravacao->haLivres.wait(lock, [gravacao] { return !gravacao->livres.empty(); });
+		gravacao->espera += std::chrono::duration<double>(std::chrono::steady_clock::now() - inicio).count();
+	}
+
+	b = gravacao->livres.back();
+	gravacao->livres.pop_back();
+	gravacao->buffers[b].numero = gravacao->enviadas;
+
+	return b;
+}
+
+// Põe um buffer já preenchido no fim da fila e acorda a thread da gravação
+static void porNaFila(Gravacao* gravacao, int b)
+{
+	{
+		std::lock_guard<std::mutex> lock(gravacao->mutex);
+		gravacao->fila[(gravacao->inicio + gravacao->nfila) % (int)gravacao->fila.size()] = b;
+		gravacao->nfila++;
+	}
+	gravacao->haTrabalho.notify_one();
+}
+
+/*
+* Função: gravacao_iniciar
+* ----------------------------
+* Abre o destino e arranca a thread que escreve as imagens. Os buffers são alocados
+* à medida que são precisos e depois reaproveitados (sem alocações em regime normal)
+*
+* destino    : prefixo dos ficheiros (GRAVACAO_FICHEIROS) ou ficheiro do fluxo (GRAVACAO_FLUXO ou GRAVACAO_DADOS)
+* modo       : GRAVACAO_FICHEIROS, GRAVACAO_FLUXO ou GRAVACAO_DADOS
+* politica   : GRAVACAO_DESCARTAR ou GRAVACAO_ESPERAR (quando não há buffers livres)
+* capacidade : número de buffers (>= 1)
+*/
+Gravacao* gravacao_iniciar(const char* destino, int modo, int politica, int capacidade)
+{
+	Gravacao* gravacao;
+	int b;
+
+	if ((destino == NULL) || (capacidade < 1)) return NULL;
+	if ((modo != GRAVACAO_FICHEIROS) && (modo != GRAVACAO_FLUXO) && (modo != GRAVACAO_DADOS)) return NULL;
+
+	gravacao = new Gravacao();
+	gravacao->destino = destino;
+	gravacao->modo = modo;
+	gravacao->politica = politica;
+	gravacao->fluxo = NULL;
+	gravacao->inicio = 0;
+	gravacao->nfila = 0;
+	gravacao->terminar = false;
+	gravacao->parada = false;
+	gravacao->enviadas = 0;
+	gravacao->escritas = 0;
+	gravacao->descartadas = 0;
+	gravacao->erros = 0;
+	gravacao->espera = 0.0;
+
+	if (modo != GRAVACAO_FICHEIROS)
+	{
+		// Os dados são acrescentados (o ficheiro já pode ter um cabeçalho e registos anteriores)
+		gravacao->fluxo = std::fopen(destino, (modo == GRAVACAO_DADOS) ? "ab" : "wb");
+		if (gravacao->fluxo == NULL)
+		{
+			delete gravacao;
+			return NULL;
+		}
+	}
+
+	gravacao->buffers.resize(capacidade);
+	gravacao->fila.resize(capacidade);
+	for (b = capacidade - 1; b >= 0; b--) gravacao->livres.push_back(b);
+
+	gravacao->thread = std::thread(gravar, gravacao);
+
+	return gravacao;
+}
+
+/*
+* Função: gravacao_enviar
+* ----------------------------
+* Copia a imagem para um buffer livre e põe-no na fila da thread da gravação.
+* Sem buffers livres, descarta a imagem ou espera, conforme a política
+*
+* gravacao : gravação
+* imagem   : imagem a gravar (pode ser uma vista; não é usada depois de a função devolver)
+* nome     : (opcional) acrescentado ao nome do ficheiro
+*/
+int gravacao_enviar(Gravacao* gravacao, IVC* imagem, const char* nome)
+{
+	Buffer* buffer;
+	size_t linha;
+	int b, y;
+
+	if ((gravacao == NULL) || (gravacao->modo == GRAVACAO_DADOS) || (imagem == NULL) || (imagem->data == NULL)) return 0;
+	if ((b = tirarLivre(gravacao)) < 0) return 0;
+
+	// A cópia é feita fora do mutex (o buffer é só de quem o tirou dos livres)
+	buffer = &gravacao->buffers[b];
+	linha = (size_t)imagem->width * imagem->channels;
+	if (buffer->dados.size() < linha * imagem->height) buffer->dados.resize(linha * imagem->height);
+
+	for (y = 0; y < imagem->height; y++)
+	{
+		std::memcpy(buffer->dados.data() + y * linha, imagem->data + (size_t)y * imagem->bytesperline, linha);
+	}
+
+	buffer->imagem = *imagem;
+	buffer->imagem.data = buffer->dados.data();
+	buffer->imagem.bytesperline = (int)linha;
+	buffer->imagem.xoffset = 0;
+	buffer->imagem.yoffset = 0;
+	std::snprintf(buffer->nome, sizeof(buffer->nome), "%s", (nome != NULL) ? nome : "");
+
+	porNaFila(gravacao, b);
+
+	return 1;
+}
+
+/*
+* Função: gravacao_enviar_dados
+* ----------------------------
+* Copia um bloco de bytes para um buffer livre e põe-no na fila (GRAVACAO_DADOS).
+* Sem buffers livres, descarta o bloco ou espera, conforme a política
+*
+* gravacao : gravação
+* dados    : bytes a acrescentar ao ficheiro (não são usados depois de a função devolver)
+* bytes    : número de bytes
+*/
+int gravacao_enviar_dados(Gravacao* gravacao, const void* dados, long bytes)
+{
+	Buffer* buffer;
+	int b;
+
+	if ((gravacao == NULL) || (gravacao->modo != GRAVACAO_DADOS) || (dados == NULL) || (bytes <= 0)) return 0;
+	if ((b = tirarLivre(gravacao)) < 0) return 0;
+
+	buffer = &gravacao->buffers[b];
+	if (buffer->dados.size() < (size_t)bytes) buffer->dados.resize((size_t)bytes);
+	std::memcpy(buffer->dados.data(), dados, (size_t)bytes);
+	buffer->bytes = (size_t)bytes;
+
+	porNaFila(gravacao, b);
+
+	return 1;
+}
+
+/*
+* Função: gravacao_esvaziar
+* ----------------------------
+* Espera que todas as imagens enviadas até agora estejam escritas
+*
+* gravacao : gravação
+*/
+void gravacao_esvaziar(Gravacao* gravacao)
+{
+	if (gravacao == NULL) return;
+
+	std::unique_lock<std::mutex> lock(gravacao->mutex);
+	gravacao->haLivres.wait(lock, [gravacao] { return gravacao->livres.size() == gravacao->buffers.size(); });
+}
+
+/*
+* Função: gravacao_estatistica
+* ----------------------------
+* Contadores da gravação até agora
+*
+* gravacao    : gravação
+* escritas    : imagens já escritas
+* descartadas : imagens descartadas por não haver buffers livres
+* erros       : imagens que não foi possível escrever
+* espera      : segundos que gravacao_enviar esteve à espera de buffers livres
+*/
+void gravacao_estatistica(Gravacao* gravacao, long* escritas, long* descartadas, long* erros, double* espera)
+{
+	if (gravacao == NULL) return;
+
+	std::lock_guard<std::mutex> lock(gravacao->mutex);
+	if (escritas != NULL) *escritas = gravacao->escritas;
+	if (descartadas != NULL) *descartadas = gravacao->descartadas;
+	if (erros != NULL) *erros = gravacao->erros;
+	if (espera != NULL) *espera = gravacao->espera;
+}
+
+/*
+* Função: gravacao_parar
+* ----------------------------
+* Pede à thread que escreva o que está na fila e feche o destino, sem esperar por ela.
+* As imagens enviadas a seguir são recusadas
+*
+* gravacao : gravação
+*/
+void gravacao_parar(Gravacao* gravacao)
+{
+	if (gravacao == NULL) return;
+
+	{
+		std::lock_guard<std::mutex> lock(gravacao->mutex);
+		gravacao->terminar = true;
+	}
+	gravacao->haTrabalho.notify_one();
+}
+
+/*
+* Função: gravacao_parada
+* ----------------------------
+* Indica se a thread já escreveu tudo e fechou o destino
+*
+* gravacao : gravação
+*/
+int gravacao_parada(Gravacao* gravacao)
+{
+	if (gravacao == NULL) return 1;
+
+	std::lock_guard<std::mutex> lock(gravacao->mutex);
+	return gravacao->parada ? 1 : 0;
+}
+
+/*
+* Função: gravacao_terminar
+* ----------------------------
+* Espera que a thread escreva o que está na fila, fecha o destino e liberta os buffers
+*
+* gravacao : gravação
+*/
+Gravacao* gravacao_terminar(Gravacao* gravacao)
+{
+	if (gravacao == NULL) return NULL;
+
+	gravacao_parar(gravacao);
+	gravacao->thread.join();
+
+	delete gravacao;
+
+	return NULL;
+}
@@ -0,0 +1,55 @@
+﻿/*
+Autores:
+-Filipe Gajo
+-Ricardo Sampaio
+-Cláudio Silva
+*/
+
+// Gravação assíncrona de imagens (frames marcadas, máscaras) numa thread própria, para
+// a escrita em disco nunca atrasar o processamento das frames
+#pragma once
+
+extern "C" {
+#include "vc.h"
+}
+
+// Destino das imagens
+#define GRAVACAO_FICHEIROS 0	// Um ficheiro por imagem: <destino>_<número>_<nome>.pbm/.pgm/.ppm
+#define GRAVACAO_FLUXO 1		// Todas as imagens no ficheiro <destino>, em PBM/PGM/PPM concatenados
+#define GRAVACAO_DADOS 2		// Blocos de bytes (gravacao_enviar_dados) acrescentados ao fim do ficheiro <destino>
+
+// O que acontece quando a fila está cheia (o disco não acompanha)
+#define GRAVACAO_DESCARTAR 0	// A imagem é descartada (e contada); quem envia nunca espera
+#define GRAVACAO_ESPERAR 1		// Quem envia espera que um buffer fique livre
+
+typedef struct Gravacao Gravacao;
+
+// capacidade = número de buffers (imagens na fila ou a ser escritas); NULL se não conseguir abrir o destino
+Gravacao* gravacao_iniciar(const char* destino, int modo, int politica, int capacidade);
+
+// Copia a imagem (pode ser uma vista) para um buffer livre e põe-na na fila; devolve 0 se foi descartada
+// O formato segue vc_write_image: levels == 1 grava em PBM (uma máscara 0/255 pode ser enviada
+// com uma cópia da IVC com levels = 1), senão PGM (1 canal) ou PPM (3 canais, escritos como estão:
+// uma frame do OpenCV fica em BGR)
+// nome (opcional) entra no nome do ficheiro (só em GRAVACAO_FICHEIROS)
+int gravacao_enviar(Gravacao* gravacao, IVC* imagem, const char* nome);
+
+// Copia um bloco de bytes para um buffer livre e põe-no na fila (só em GRAVACAO_DADOS; ex: os registos
+// das máscaras, ver vc_mascaras_gravacao_encaminhar); devolve 0 se foi descartado
+int gravacao_enviar_dados(Gravacao* gravacao, const void* dados, long bytes);
+
+// Espera que todas as imagens enviadas até agora estejam escritas
+void gravacao_esvaziar(Gravacao* gravacao);
+
+// Contadores até agora (qualquer um pode ser NULL); espera = segundos que quem envia esteve à espera
+void gravacao_estatistica(Gravacao* gravacao, long* escritas, long* descartadas, long* erros, double* espera);
+
+// Deixa de aceitar imagens e devolve logo: a thread escreve o que estiver na fila e fecha o destino
+// (para desligar a gravação sem esperar pelo disco; depois, gravacao_terminar liberta tudo)
+void gravacao_parar(Gravacao* gravacao);
+
+// 1 se a thread já escreveu tudo e fechou o destino (depois de gravacao_parar, gravacao_terminar já não espera)
+int gravacao_parada(Gravacao* gravacao);
+
+// Escreve o que ainda estiver na fila, termina a thread e liberta tudo
+Gravacao* gravacao_terminar(Gravacao* gravacao);
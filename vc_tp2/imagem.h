@@ -0,0 +1,771 @@
+﻿/*
+Autores:
+-Filipe Gajo
+-Ricardo Sampaio
+-Cláudio Silva
+*/
+
+// Camada C++ (só header) sobre as IVC e os blobs: imagens com o tipo do píxel e o número de
+// canais no tipo, libertadas sozinhas e movidas em vez de copiadas. Os núcleos mais pesados
+// (conversão HSV, segmentação e morfologia binária) são templates sobre o píxel e os canais:
+// os canais e o passo entre píxeis são constantes de compilação. As funções de vc.c verificam
+// as IVC e chamam as instâncias de nucleos.cpp; as funções daqui chamam os templates diretamente
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <utility>
+#include <type_traits>
+
+extern "C" {
+#include "vc.h"
+}
+
+namespace vc {
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//                          PÍXEIS
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+// O que os núcleos recebem: ponteiro, dimensões e bytes por linha de uma imagem com Canais canais
+// (não é dono de nada). Pixeis<const T, Canais> só deixa ler
+template <typename T, int Canais>
+struct Pixeis
+{
+	static_assert(std::is_same<typename std::remove_const<T>::type, unsigned char>::value, "as IVC guardam um byte por canal");
+	static_assert((Canais == 1) || (Canais == 3), "as IVC têm 1 ou 3 canais");
+
+	T* data;
+	int width, height, bytesperline;
+
+	T* linha(int y) const { return data + (long)y * bytesperline; }
+
+	// Os canais da IVC já têm de ter sido verificados
+	static Pixeis de(const IVC* imagem)
+	{
+		Pixeis p = { imagem->data, imagem->width, imagem->height, imagem->bytesperline };
+		return p;
+	}
+};
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//                          IMAGEM
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+// Imagem<unsigned char, 3> = BGR ou HSV; Imagem<unsigned char, 1> = cinzentos, máscara ou etiquetas
+// É dona dos dados (criada com vc_image_new) ou uma vista sobre outra imagem (não liberta nada)
+// Não pode ser copiada, só movida; uma imagem vazia (movida ou que não conseguiu alocar) não é válida()
+template <typename T, int Canais>
+class Imagem
+{
+	static_assert(std::is_same<T, unsigned char>::value, "as IVC guardam um byte por canal");
+	static_assert((Canais == 1) || (Canais == 3), "as IVC têm 1 ou 3 canais");
+
+public:
+	typedef T Pixel;
+	static const int canais = Canais;
+
+	Imagem() : imagem(NULL), dona(false) {}
+
+	Imagem(int width, int height, int levels = 255) : imagem(vc_image_new(width, height, Canais, levels)), dona(true) {}
+
+	Imagem(Imagem&& outra) noexcept : imagem(outra.imagem), dona(outra.dona)
+	{
+		outra.imagem = NULL;
+	}
+
+	Imagem& operator=(Imagem&& outra) noexcept
+	{
+		if (this != &outra)
+		{
+			libertar();
+			imagem = outra.imagem;
+			dona = outra.dona;
+			outra.imagem = NULL;
+		}
+
+		return *this;
+	}
+
+	Imagem(const Imagem&) = delete;
+	Imagem& operator=(const Imagem&) = delete;
+
+	~Imagem() { libertar(); }
+
+	// Vista (sem cópia) sobre um retângulo desta imagem; só é válida enquanto esta existir
+	// (não é const: os píxeis da vista podem ser alterados)
+	Imagem vista(int x, int y, int width, int height)
+	{
+		Imagem v;
+
+		if (!valida()) return v;
+
+		v.imagem = new IVC();
+		if (!vc_image_view(imagem, v.imagem, x, y, width, height))
+		{
+			delete v.imagem;
+			v.imagem = NULL;
+		}
+
+		return v;
+	}
+
+	// Vista sobre uma IVC que pertence a outro (ex: as imagens de um PVC); NULL ou canais errados dão uma imagem vazia
+	static Imagem sobre(IVC* outra)
+	{
+		Imagem v;
+
+		if ((outra == NULL) || (outra->channels != Canais)) return v;
+
+		v.imagem = new IVC(*outra);
+		return v;
+	}
+
+	// Garante uma imagem com estas dimensões: a que já existe (própria ou vista) é reaproveitada e
+	// só se aloca uma nova se as dimensões forem outras
+	bool garantir(int width, int height, int levels = 255)
+	{
+		if (valida() && (imagem->width == width) && (imagem->height == height))
+		{
+			imagem->levels = levels;
+			return true;
+		}
+
+		*this = Imagem(width, height, levels);
+		return valida();
+	}
+
+	bool valida() const { return imagem != NULL; }
+	int largura() const { return imagem->width; }
+	int altura() const { return imagem->height; }
+	int bytesPorLinha() const { return imagem->bytesperline; }
+
+	T* linha(int y) { return imagem->data + (long)y * imagem->bytesperline; }
+	const T* linha(int y) const { return imagem->data + (long)y * imagem->bytesperline; }
+	T& operator()(int x, int y, int c = 0) { return linha(y)[x * Canais + c]; }
+	T operator()(int x, int y, int c = 0) const { return linha(y)[x * Canais + c]; }
+
+	// Para os núcleos (a versão const só deixa ler)
+	Pixeis<T, Canais> pixeis() { return Pixeis<T, Canais>::de(imagem); }
+	Pixeis<const T, Canais> pixeis() const { return Pixeis<const T, Canais>::de(imagem); }
+
+	// Para chamar diretamente as funções de vc.c
+	IVC* ivc() const { return imagem; }
+
+private:
+	void libertar()
+	{
+		if (imagem == NULL) return;
+
+		if (dona) vc_image_free(imagem);
+		else delete imagem;
+		imagem = NULL;
+	}
+
+	IVC* imagem;
+	bool dona;		// false = vista (a estrutura foi alocada aqui, os dados não)
+};
+
+typedef Imagem<unsigned char, 3> ImagemBGR;		// Também usada para HSV
+typedef Imagem<unsigned char, 1> ImagemCinzentos;	// Máscaras (0/255) e etiquetas
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//                          BLOBS
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+// Os blobs (e, se foram pedidos, os momentos) devolvidos pela etiquetagem; libertados sozinhos
+class Blobs
+{
+public:
+	Blobs() : blobs(NULL), momentos(NULL), n(0) {}
+	Blobs(OVC* blobs, MVC* momentos, int n) : blobs(blobs), momentos(momentos), n((blobs != NULL) ? n : 0) {}
+
+	Blobs(Blobs&& outros) noexcept : blobs(outros.blobs), momentos(outros.momentos), n(outros.n)
+	{
+		outros.blobs = NULL;
+		outros.momentos = NULL;
+		outros.n = 0;
+	}
+
+	Blobs& operator=(Blobs&& outros) noexcept
+	{
+		if (this != &outros)
+		{
+			std::free(blobs);
+			std::free(momentos);
+			blobs = outros.blobs;
+			momentos = outros.momentos;
+			n = outros.n;
+			outros.blobs = NULL;
+			outros.momentos = NULL;
+			outros.n = 0;
+		}
+
+		return *this;
+	}
+
+	Blobs(const Blobs&) = delete;
+	Blobs& operator=(const Blobs&) = delete;
+
+	~Blobs()
+	{
+		std::free(blobs);
+		std::free(momentos);
+	}
+
+	int size() const { return n; }
+	bool empty() const { return n == 0; }
+	OVC& operator[](int i) { return blobs[i]; }
+	const OVC& operator[](int i) const { return blobs[i]; }
+	OVC* begin() { return blobs; }
+	OVC* end() { return blobs + n; }
+	const OVC* begin() const { return blobs; }
+	const OVC* end() const { return blobs + n; }
+
+	// Momentos paralelos aos blobs (NULL se não foram pedidos)
+	MVC* momentosBlobs() const { return momentos; }
+
+	// Para chamar diretamente as funções de vc.c
+	OVC* ovc() const { return blobs; }
+
+private:
+	OVC* blobs;
+	MVC* momentos;
+	int n;
+};
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//                          NÚCLEOS
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+// Os ciclos por píxel da conversão, da segmentação e da morfologia. Não verificam as dimensões
+// (quem chama já o fez); os canais errados não compilam
+namespace nucleos {
+
+// Hues (em bytes) em que a conversão com floats, com uma divisão exata, dava um valor abaixo
+// (o float de hue / 360 * 255 ficava ligeiramente abaixo do inteiro). Cada bit é um hue: [hue >> 6], bit hue & 63
+static const unsigned long long hsvArredondamento[4] = {
+	0x0842909248448a00ULL, 0x204852842b08638cULL, 0x24c5084294a548d2ULL, 0x0481024091244892ULL
+};
+
+// BGR para HSV (H, S e V entre 0 e 255) só com inteiros (ver vc_bgr_to_hsv)
+template <typename T, int Canais>
+inline void bgrParaHsv(Pixeis<const T, Canais> src, Pixeis<T, Canais> dst)
+{
+	static_assert(Canais == 3, "BGR e HSV têm 3 canais");
+
+	// inversos[d] = 2^32 / d arredondado para cima: (x * inversos[d]) >> 32 = x / d para x < 2^17 e d < 2^9
+	unsigned long long inversos[511];
+	unsigned long long numerador;
+	int r, g, b, hue, saturation, value;
+	int rgb_max, rgb_min, diferenca, divisor;
+	int x, y, i;
+	const T* s;
+	T* d;
+
+	for (i = 1; i < 511; i++) inversos[i] = ((1ULL << 32) + i - 1) / i;
+
+	for (y = 0; y < src.height; y++)
+	{
+		s = src.linha(y);
+		d = dst.linha(y);
+
+		for (x = 0; x < src.width; x++, s += Canais, d += Canais)
+		{
+			b = s[0];
+			g = s[1];
+			r = s[2];
+
+			rgb_max = (r > g ? (r > b ? r : b) : (g > b ? g : b));
+			rgb_min = (r < g ? (r < b ? r : b) : (g < b ? g : b));
+			diferenca = rgb_max - rgb_min;
+
+			value = rgb_max;
+			if ((value == 0) || (diferenca == 0))
+			{
+				hue = 0;
+				saturation = 0;
+			}
+			else
+			{
+				// Saturation = diferenca / rgb_max, entre [0, 255]
+				saturation = (int)(((unsigned long long)(diferenca * 255) * inversos[rgb_max]) >> 32);
+
+				// Hue = 85 * numerador / (2 * diferenca), com o numerador em unidades de diferenca / 60 (0 a 6 * diferenca)
+				if ((rgb_max == r) && (g >= b)) numerador = g - b;
+				else if (rgb_max == r) numerador = 6 * diferenca + g - b; // b > g
+				else if (rgb_max == g) numerador = 2 * diferenca + b - r;
+				else numerador = 4 * diferenca + r - g; // rgb_max == b
+
+				numerador *= 85;
+				divisor = 2 * diferenca;
+				hue = (int)((numerador * inversos[divisor]) >> 32);
+
+				// Quando a divisão é exata, a conversão com floats ficava um abaixo em alguns valores
+				if (((unsigned long long)hue * divisor == numerador) && ((hsvArredondamento[hue >> 6] >> (hue & 63)) & 1)) hue--;
+			}
+
+			d[0] = (T)hue;
+			d[1] = (T)saturation;
+			d[2] = (T)value;
+		}
+	}
+}
+
+// Segmentação HSV com os limites já em bytes: hmin1, hmax1, hmin2, hmax2, smin, smax, vmin, vmax
+// (Intervalos = 1 ignora o segundo intervalo de tonalidade)
+template <int Intervalos, typename T, int Canais>
+inline void hsvSegmentar(Pixeis<const T, Canais> src, Pixeis<T, 1> dst, const int* limites)
+{
+	static_assert(Canais == 3, "a imagem HSV tem 3 canais");
+	static_assert((Intervalos == 1) || (Intervalos == 2), "um ou dois intervalos de tonalidade");
+
+	int x, y, hue, saturation, value, tonalidade;
+	const T* s;
+	T* d;
+
+	for (y = 0; y < src.height; y++)
+	{
+		s = src.linha(y);
+		d = dst.linha(y);
+
+		for (x = 0; x < src.width; x++, s += Canais)
+		{
+			hue = s[0];
+			saturation = s[1];
+			value = s[2];
+
+			tonalidade = (hue >= limites[0]) && (hue <= limites[1]);
+			if (Intervalos == 2) tonalidade = tonalidade || ((hue >= limites[2]) && (hue <= limites[3]));
+
+			d[x] = (tonalidade && (saturation >= limites[4]) && (saturation <= limites[5]) &&
+				(value >= limites[6]) && (value <= limites[7])) ? (T)255 : (T)0;
+		}
+	}
+}
+
+// Segmentação pela tabela de classes de cor; com ocupacao (já preparada), soma os píxeis da cor de cada bloco
+template <typename T, int Canais>
+inline void tabelaSegmentar(const unsigned char* classes, Pixeis<const T, Canais> src, Pixeis<T, 1> dst, int cor, OCVC* ocupacao)
+{
+	static_assert(Canais == 3, "a tabela é indexada pelo BGR");
+
+	int x, y, xfim, bx, c, soma;
+	int* linha = NULL;
+	const T* s;
+	T* d;
+
+	for (y = 0; y < src.height; y++)
+	{
+		s = src.linha(y);
+		d = dst.linha(y);
+		if (ocupacao != NULL) linha = ocupacao->contagem + (y / VC_BLOCO_OCUPACAO) * ocupacao->blocosX;
+
+		// Um bloco de cada vez, para somar os píxeis da cor sem dividir por píxel
+		for (x = 0, bx = 0; x < src.width; bx++)
+		{
+			xfim = std::min(x + VC_BLOCO_OCUPACAO, src.width);
+			for (soma = 0; x < xfim; x++, s += Canais)
+			{
+				c = (classes[s[0] | (s[1] << 8) | (s[2] << 16)] >> cor) & 1;
+				d[x] = (T)(c * 255);
+				soma += c;
+			}
+			if (linha != NULL) linha[bx] += soma;
+		}
+	}
+}
+
+// Converte a caixa em limites inteiros sobre combinações lineares do BGR, para que cada píxel só
+// precise de somas, multiplicações e comparações (sem divisões); minimo inclusive, maximo exclusive:
+// - YCbCr: 256 * Y = 77R + 150G + 29B; 256 * Cb = 128B - 43R - 85G + 32768; 256 * Cr = 128R - 107G - 21B + 32768
+//   (Y, Cb e Cr são estes valores >> 8, por isso Cb >= m é o mesmo que 256 * Cb >= 256 * m)
+// - rg: I = R + G + B; intensidade = I / 3 e r = 255 * R / I (truncados), ou seja, r >= m é
+//   255 * R >= m * I e r <= M é 255 * R < (M + 1) * I (um píxel preto nunca passa)
+inline void cromaTestes(const CXVC& caixa, int* minimo, int* maximo)
+{
+	int e;
+
+	for (e = 0; e < 3; e++)
+	{
+		if (caixa.espaco == VC_CROMA_RG)
+		{
+			minimo[e] = (e == 0) ? caixa.minimo[e] * 3 : caixa.minimo[e];
+			maximo[e] = (e == 0) ? (caixa.maximo[e] + 1) * 3 : caixa.maximo[e] + 1;
+		}
+		else
+		{
+			minimo[e] = caixa.minimo[e] << 8;
+			maximo[e] = (caixa.maximo[e] + 1) << 8;
+		}
+	}
+}
+
+// Segmentação com a caixa de crominância no espaço Espaco (VC_CROMA_*); ocupacao como em tabelaSegmentar
+template <int Espaco, typename T, int Canais>
+inline void cromaSegmentar(const CXVC& caixa, Pixeis<const T, Canais> src, Pixeis<T, 1> dst, OCVC* ocupacao)
+{
+	static_assert(Canais == 3, "a caixa é sobre o BGR");
+	static_assert((Espaco == VC_CROMA_YCBCR) || (Espaco == VC_CROMA_RG), "espaço de crominância desconhecido");
+
+	int minimo[3], maximo[3];
+	int x, y, xfim, bx, b, g, r, c0, c1, c2, soma, dentro;
+	int* linha = NULL;
+	const T* s;
+	T* d;
+
+	cromaTestes(caixa, minimo, maximo);
+
+	for (y = 0; y < src.height; y++)
+	{
+		s = src.linha(y);
+		d = dst.linha(y);
+		if (ocupacao != NULL) linha = ocupacao->contagem + (y / VC_BLOCO_OCUPACAO) * ocupacao->blocosX;
+
+		for (x = 0, bx = 0; x < src.width; bx++)
+		{
+			xfim = std::min(x + VC_BLOCO_OCUPACAO, src.width);
+
+			// Os testes de cada píxel são juntos com &, sem saltos
+			for (soma = 0; x < xfim; x++, s += Canais)
+			{
+				b = s[0];
+				g = s[1];
+				r = s[2];
+
+				if (Espaco == VC_CROMA_RG)
+				{
+					c0 = b + g + r;
+					dentro = (c0 >= minimo[0]) & (c0 < maximo[0]) &
+						(255 * r >= minimo[1] * c0) & (255 * r < maximo[1] * c0) &
+						(255 * g >= minimo[2] * c0) & (255 * g < maximo[2] * c0);
+				}
+				else
+				{
+					c0 = 77 * r + 150 * g + 29 * b;
+					c1 = 128 * b - 43 * r - 85 * g + 32768;
+					c2 = 128 * r - 107 * g - 21 * b + 32768;
+					dentro = (c0 >= minimo[0]) & (c0 < maximo[0]) &
+						(c1 >= minimo[1]) & (c1 < maximo[1]) &
+						(c2 >= minimo[2]) & (c2 < maximo[2]);
+				}
+
+				d[x] = (T)(dentro * 255);
+				soma += dentro;
+			}
+
+			if (linha != NULL) linha[bx] += soma;
+		}
+	}
+}
+
+// Numa linha de bits, bit x passa a ser o AND (erosão) ou o OR (dilatação) dos bits x a x + k - 1.
+// Janelas duplicadas em cada passo (1, 2, 4, ...) e uma última de k - comprimento: log2(k)
+// deslocamentos por palavra em vez de k. A linha tem de ter bits suficientes depois do último usado
+inline void bitsJanelaLinha(unsigned long long* linha, int npalavras, int k, int erosao)
+{
+	int comprimento = 1, passo, deslocamento, palavras, i;
+	unsigned long long vizinho;
+
+	while (comprimento < k)
+	{
+		// O último passo só completa a janela (pode sobrepor-se ao anterior: AND e OR não se importam)
+		passo = (2 * comprimento <= k) ? comprimento : k - comprimento;
+		palavras = passo >> 6;
+		deslocamento = passo & 63;
+
+		// Da esquerda para a direita: as palavras seguintes ainda não foram alteradas
+		for (i = 0; i < npalavras; i++)
+		{
+			vizinho = (i + palavras < npalavras) ? (linha[i + palavras] >> deslocamento) : 0;
+			if ((deslocamento > 0) && (i + palavras + 1 < npalavras)) vizinho |= linha[i + palavras + 1] << (64 - deslocamento);
+
+			if (erosao) linha[i] &= vizinho;
+			else linha[i] |= vizinho;
+		}
+
+		comprimento += passo;
+	}
+}
+
+// Passagem horizontal de uma erosão/dilatação com janela kw (centrada) em todas as linhas. Cada
+// linha é copiada para auxiliar (pelo menos (width + kw - 1 + 63) / 64 + 1 palavras) com raio bits
+// de margem de cada lado, preenchida com o elemento neutro (1 para a erosão, 0 para a dilatação:
+// fora da imagem não conta), e a janela que começa no bit x da linha com margem é a centrada no píxel x
+inline void bitsHorizontal(unsigned long long* bits, int width, int height, int npalavras, unsigned long long* auxiliar,
+	int kw, int erosao)
+{
+	int raio = kw / 2, naux = (width + kw - 1 + 63) / 64 + 1;
+	int palavras = raio >> 6, deslocamento = raio & 63, y, i, fim;
+	unsigned long long* linha;
+	unsigned long long ultima = (width & 63) ? ((1ULL << (width & 63)) - 1) : ~0ULL;
+
+	if (kw <= 1) return;
+
+	for (y = 0; y < height; y++)
+	{
+		linha = bits + (long)y * npalavras;
+
+		// Linha deslocada de raio bits, com a margem preenchida com o elemento neutro
+		std::memset(auxiliar, 0, naux * sizeof(unsigned long long));
+		for (i = 0; i < npalavras; i++)
+		{
+			unsigned long long valor = (i == npalavras - 1) ? (linha[i] & ultima) : linha[i];
+
+			auxiliar[i + palavras] |= valor << deslocamento;
+			if (deslocamento > 0) auxiliar[i + palavras + 1] |= valor >> (64 - deslocamento);
+		}
+		if (erosao)
+		{
+			// Bits [0, raio) e [raio + width, fim)
+			for (i = 0; i < palavras; i++) auxiliar[i] = ~0ULL;
+			if (deslocamento > 0) auxiliar[palavras] |= (1ULL << deslocamento) - 1;
+			fim = raio + width;
+			if (fim & 63) auxiliar[fim >> 6] |= ~((1ULL << (fim & 63)) - 1);
+			for (i = (fim + 63) >> 6; i < naux; i++) auxiliar[i] = ~0ULL;
+		}
+
+		bitsJanelaLinha(auxiliar, naux, kw, erosao);
+		std::memcpy(linha, auxiliar, npalavras * sizeof(unsigned long long));
+	}
+}
+
+// Passagem vertical de uma erosão/dilatação com janela kh (centrada), com o algoritmo de van Herk /
+// Gil-Werman: a sequência de linhas (com raio linhas neutras de cada lado) é dividida em blocos
+// de kh linhas; g = acumulado desde o início do bloco, h = acumulado até ao fim do bloco, e a janela
+// que começa na linha s é h[s] op g[s + kh - 1]. São 3 operações por palavra, seja qual for kh
+// (g e h com (height + kh - 1) * npalavras palavras cada)
+inline void bitsVertical(unsigned long long* bits, int height, int npalavras, unsigned long long* g, unsigned long long* h,
+	int kh, int erosao)
+{
+	int raio = kh / 2, n = height + kh - 1, s, i;
+	long base;
+	unsigned long long neutro = erosao ? ~0ULL : 0ULL;
+	unsigned long long* linha, * anterior;
+
+	if (kh <= 1) return;
+
+	// Sequência com margem (copiada para g e h)
+	for (s = 0; s < n; s++)
+	{
+		if ((s < raio) || (s >= raio + height))
+		{
+			for (i = 0; i < npalavras; i++) g[(long)s * npalavras + i] = neutro;
+		}
+		else std::memcpy(g + (long)s * npalavras, bits + (long)(s - raio) * npalavras, npalavras * sizeof(unsigned long long));
+	}
+	std::memcpy(h, g, (long)n * npalavras * sizeof(unsigned long long));
+
+	// g: acumulado para a frente dentro de cada bloco
+	for (s = 0; s < n; s++)
+	{
+		if (s % kh == 0) continue;
+		linha = g + (long)s * npalavras;
+		anterior = linha - npalavras;
+		if (erosao) for (i = 0; i < npalavras; i++) linha[i] &= anterior[i];
+		else for (i = 0; i < npalavras; i++) linha[i] |= anterior[i];
+	}
+
+	// h: acumulado para trás dentro de cada bloco
+	for (s = n - 2; s >= 0; s--)
+	{
+		if ((s + 1) % kh == 0) continue;
+		linha = h + (long)s * npalavras;
+		anterior = linha + npalavras;
+		if (erosao) for (i = 0; i < npalavras; i++) linha[i] &= anterior[i];
+		else for (i = 0; i < npalavras; i++) linha[i] |= anterior[i];
+	}
+
+	for (s = 0; s < height; s++)
+	{
+		linha = bits + (long)s * npalavras;
+		base = (long)s * npalavras;
+		if (erosao) for (i = 0; i < npalavras; i++) linha[i] = h[base + i] & g[base + (long)(kh - 1) * npalavras + i];
+		else for (i = 0; i < npalavras; i++) linha[i] = h[base + i] | g[base + (long)(kh - 1) * npalavras + i];
+	}
+}
+
+// Empacota a máscara (1 bit por píxel, != 0 = objeto), aplica a sequência de VC_MORF_EROSAO /
+// VC_MORF_DILATACAO com o elemento retangular kw x kh (ímpares; separável: passagem horizontal e
+// vertical) e desempacota para dst (0 ou 255). false se não houver memória
+template <typename T, int Canais>
+inline bool morfologia(Pixeis<const T, Canais> src, Pixeis<T, Canais> dst, int kw, int kh, const int* operacoes, int noperacoes)
+{
+	static_assert(Canais == 1, "a morfologia binária é sobre máscaras de 1 canal");
+
+	int width = src.width, height = src.height;
+	int npalavras = (width + 63) / 64, x, y, i;
+	unsigned long long* bits, * auxiliar, * g, * h, palavra;
+	const T* s;
+	T* d;
+
+	bits = (unsigned long long*)std::malloc((long)height * npalavras * sizeof(unsigned long long));
+	auxiliar = (unsigned long long*)std::malloc(((width + kw - 1 + 63) / 64 + 1) * sizeof(unsigned long long));
+	g = (unsigned long long*)std::malloc((long)(height + kh - 1) * npalavras * sizeof(unsigned long long));
+	h = (unsigned long long*)std::malloc((long)(height + kh - 1) * npalavras * sizeof(unsigned long long));
+
+	if ((bits == NULL) || (auxiliar == NULL) || (g == NULL) || (h == NULL))
+	{
+		std::free(bits);
+		std::free(auxiliar);
+		std::free(g);
+		std::free(h);
+		return false;
+	}
+
+	// Empacotar: píxel x da linha y no bit x & 63 da palavra x >> 6
+	for (y = 0; y < height; y++)
+	{
+		s = src.linha(y);
+		for (i = 0; i < npalavras; i++)
+		{
+			palavra = 0;
+			for (x = i * 64; (x < i * 64 + 64) && (x < width); x++)
+			{
+				palavra |= (unsigned long long)(s[x] != 0) << (x & 63);
+			}
+			bits[(long)y * npalavras + i] = palavra;
+		}
+	}
+
+	for (i = 0; i < noperacoes; i++)
+	{
+		bitsHorizontal(bits, width, height, npalavras, auxiliar, kw, operacoes[i] == VC_MORF_EROSAO);
+		bitsVertical(bits, height, npalavras, g, h, kh, operacoes[i] == VC_MORF_EROSAO);
+	}
+
+	// Desempacotar
+	for (y = 0; y < height; y++)
+	{
+		d = dst.linha(y);
+		for (x = 0; x < width; x++)
+		{
+			d[x] = (T)(((bits[(long)y * npalavras + (x >> 6)] >> (x & 63)) & 1) * 255);
+		}
+	}
+
+	std::free(bits);
+	std::free(auxiliar);
+	std::free(g);
+	std::free(h);
+
+	return true;
+}
+
+} // namespace nucleos
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//                          FUNÇÕES
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+// Cada função só aceita imagens com os canais certos (o erro passa a ser de compilação).
+// As versões com destino reaproveitam-no; as que devolvem a imagem alocam uma nova e movem-na
+
+// Copia os píxeis (de uma vista, por exemplo) linha a linha
+template <int Canais>
+inline bool copiar(const Imagem<unsigned char, Canais>& src, Imagem<unsigned char, Canais>& dst)
+{
+	int y;
+
+	if (!src.valida() || !dst.garantir(src.largura(), src.altura(), src.ivc()->levels)) return false;
+
+	for (y = 0; y < src.altura(); y++) std::memcpy(dst.linha(y), src.linha(y), (size_t)src.largura() * Canais);
+
+	return true;
+}
+
+template <int Canais>
+inline Imagem<unsigned char, Canais> copia(const Imagem<unsigned char, Canais>& src)
+{
+	Imagem<unsigned char, Canais> dst;
+
+	copiar(src, dst);
+	return dst;
+}
+
+inline bool bgrParaHsv(const ImagemBGR& src, ImagemBGR& dst)
+{
+	if (!src.valida() || !dst.garantir(src.largura(), src.altura())) return false;
+
+	nucleos::bgrParaHsv(src.pixeis(), dst.pixeis());
+	return true;
+}
+
+inline ImagemBGR hsv(const ImagemBGR& src)
+{
+	ImagemBGR dst;
+
+	bgrParaHsv(src, dst);
+	return dst;
+}
+
+// Segmenta uma cor com a tabela de classes de cor (ocupacao opcional, como em vc_tabela_cores_segmentar)
+inline bool segmentar(TCVC* tabela, const ImagemBGR& src, ImagemCinzentos& dst, Cor cor, OCVC* ocupacao = NULL)
+{
+	if ((tabela == NULL) || (tabela->classes == NULL) || (cor < INDEFINIDA) || (cor > VERMELHO)) return false;
+	if (!src.valida() || !dst.garantir(src.largura(), src.altura())) return false;
+	if ((ocupacao != NULL) && !vc_ocupacao_preparar(ocupacao, src.largura(), src.altura())) return false;
+
+	nucleos::tabelaSegmentar(tabela->classes, src.pixeis(), dst.pixeis(), cor, ocupacao);
+
+	if (ocupacao != NULL) vc_ocupacao_fechar(ocupacao);
+	return true;
+}
+
+// Segmenta com uma caixa de crominância (ver vc_croma_calibrar)
+inline bool segmentar(const CXVC& caixa, const ImagemBGR& src, ImagemCinzentos& dst, OCVC* ocupacao = NULL)
+{
+	if (!src.valida() || !dst.garantir(src.largura(), src.altura())) return false;
+	if ((ocupacao != NULL) && !vc_ocupacao_preparar(ocupacao, src.largura(), src.altura())) return false;
+
+	if (caixa.espaco == VC_CROMA_RG) nucleos::cromaSegmentar<VC_CROMA_RG>(caixa, src.pixeis(), dst.pixeis(), ocupacao);
+	else nucleos::cromaSegmentar<VC_CROMA_YCBCR>(caixa, src.pixeis(), dst.pixeis(), ocupacao);
+
+	if (ocupacao != NULL) vc_ocupacao_fechar(ocupacao);
+	return true;
+}
+
+// Filtros de ruído da máscara (ver VC_FILTRO_*)
+inline bool filtrarRuido(const ImagemCinzentos& src, ImagemCinzentos& dst, int filtro, int kernel)
+{
+	static const int abertura[2] = { VC_MORF_EROSAO, VC_MORF_DILATACAO };
+	static const int aberturaFecho[4] = { VC_MORF_EROSAO, VC_MORF_DILATACAO, VC_MORF_DILATACAO, VC_MORF_EROSAO };
+
+	if (!src.valida() || !dst.garantir(src.largura(), src.altura())) return false;
+
+	if ((filtro == VC_FILTRO_ABERTURA) || (filtro == VC_FILTRO_ABERTURA_FECHO))
+	{
+		if ((kernel < 1) || (kernel % 2 == 0)) return false;
+
+		if (filtro == VC_FILTRO_ABERTURA) return nucleos::morfologia(src.pixeis(), dst.pixeis(), kernel, kernel, abertura, 2);
+		return nucleos::morfologia(src.pixeis(), dst.pixeis(), kernel, kernel, aberturaFecho, 4);
+	}
+	return vc_gray_lowpass_median_filter(src.ivc(), dst.ivc(), kernel) != 0;
+}
+
+// Etiqueta a máscara (etiquetas em dst) e devolve os blobs que cumprem as dimensões mínimas
+inline Blobs etiquetar(const ImagemCinzentos& src, ImagemCinzentos& dst, int areaMinima = 0, int larguraMinima = 0,
+	int alturaMinima = 0, bool comMomentos = false)
+{
+	MVC* momentos = NULL;
+	OVC* blobs;
+	int n = 0;
+
+	if (!src.valida() || !dst.garantir(src.largura(), src.altura())) return Blobs();
+
+	blobs = vc_binary_blob_labelling_filtrado(src.ivc(), dst.ivc(), &n, areaMinima, larguraMinima, alturaMinima,
+		comMomentos ? &momentos : NULL);
+
+	return Blobs(blobs, momentos, n);
+}
+
+// Grava em PBM (levels == 1), PGM (1 canal) ou PPM (3 canais), como vc_write_image_file
+template <int Canais>
+inline bool gravar(std::FILE* file, const Imagem<unsigned char, Canais>& imagem)
+{
+	return imagem.valida() && vc_write_image_file(file, imagem.ivc());
+}
+
+} // namespace vc
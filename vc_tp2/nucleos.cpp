@@ -0,0 +1,45 @@
+﻿/*
+Autores:
+-Filipe Gajo
+-Ricardo Sampaio
+-Cláudio Silva
+*/
+
+// Instâncias dos núcleos de imagem.h para as funções de vc.c (que é C e não pode usar os
+// templates): cada uma fixa os canais (3 para BGR/HSV, 1 para as máscaras) e, na crominância,
+// o espaço, por isso os ciclos são compilados com o passo entre píxeis constante
+#include "imagem.h"
+
+using vc::Pixeis;
+
+typedef Pixeis<const unsigned char, 3> PixeisBGR;
+typedef Pixeis<unsigned char, 3> PixeisSaidaBGR;
+typedef Pixeis<const unsigned char, 1> PixeisMascara;
+typedef Pixeis<unsigned char, 1> PixeisSaidaMascara;
+
+void vc_nucleo_bgr_to_hsv(IVC* src, IVC* dst)
+{
+	vc::nucleos::bgrParaHsv(PixeisBGR::de(src), PixeisSaidaBGR::de(dst));
+}
+
+void vc_nucleo_hsv_segmentar(IVC* src, IVC* dst, const int* limites, int intervalos)
+{
+	if (intervalos == 2) vc::nucleos::hsvSegmentar<2>(PixeisBGR::de(src), PixeisSaidaMascara::de(dst), limites);
+	else vc::nucleos::hsvSegmentar<1>(PixeisBGR::de(src), PixeisSaidaMascara::de(dst), limites);
+}
+
+void vc_nucleo_tabela_cores_segmentar(const unsigned char* classes, IVC* src, IVC* dst, Cor cor, OCVC* ocupacao)
+{
+	vc::nucleos::tabelaSegmentar(classes, PixeisBGR::de(src), PixeisSaidaMascara::de(dst), cor, ocupacao);
+}
+
+void vc_nucleo_croma_segmentar(const CXVC* caixa, IVC* src, IVC* dst, OCVC* ocupacao)
+{
+	if (caixa->espaco == VC_CROMA_RG) vc::nucleos::cromaSegmentar<VC_CROMA_RG>(*caixa, PixeisBGR::de(src), PixeisSaidaMascara::de(dst), ocupacao);
+	else vc::nucleos::cromaSegmentar<VC_CROMA_YCBCR>(*caixa, PixeisBGR::de(src), PixeisSaidaMascara::de(dst), ocupacao);
+}
+
+int vc_nucleo_morfologia(IVC* src, IVC* dst, int kw, int kh, const int* operacoes, int noperacoes)
+{
+	return vc::nucleos::morfologia(PixeisMascara::de(src), PixeisSaidaMascara::de(dst), kw, kh, operacoes, noperacoes) ? 1 : 0;
+}
@@ -0,0 +1,482 @@
+﻿/*
+Autores:
+-Filipe Gajo
+-Ricardo Sampaio
+-Cláudio Silva
+*/
+
+// Headers "normais"
+#include <string> // Classe string do C++
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+extern "C" {
+#include "vc.h"
+}
+
+#include "parametros.h"
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//       PARÂMETROS RECARREGADOS SEM PARAR O PROCESSAMENTO
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+// Conjunto com a memória das regras e a tabela de cores (partilhada entre conjuntos com os mesmos limites)
+struct Conjunto
+{
+	ConjuntoParametros publico;
+	std::vector<RSVC> regras;
+	std::shared_ptr<TCVC> tabela;
+	std::string ficheiroRegras;
+};
+
+// Estado de um ficheiro vigiado (mudou = outro tamanho ou outra data de modificação)
+struct Assinatura
+{
+	bool existe;
+	long long tamanho;
+	long long modificacao;
+
+	bool operator==(const Assinatura& outra) const
+	{
+		return (existe == outra.existe) && (tamanho == outra.tamanho) && (modificacao == outra.modificacao);
+	}
+	bool operator!=(const Assinatura& outra) const { return !(*this == outra); }
+};
+
+// Época em que o leitor entrou (0 = fora); cada lugar ocupa a sua linha de cache
+struct Leitor
+{
+	std::atomic<unsigned long> epoca;
+	std::atomic<bool> ocupado;
+	char preenchimento[64 - sizeof(std::atomic<unsigned long>) - sizeof(std::atomic<bool>)];
+};
+
+// Só a thread que vigia o ficheiro troca e liberta os conjuntos; os leitores só leem atual e o seu lugar
+struct Parametros
+{
+	std::string ficheiro;
+	int intervaloMs;
+	TCVC* tabelaInicial;
+
+	std::atomic<Conjunto*> atual;
+	std::atomic<unsigned long> epoca;
+	Leitor leitores[PARAMETROS_MAX_LEITORES];
+
+	// Conjuntos substituídos e a época a partir da qual nenhum leitor novo os vê
+	std::vector<std::pair<Conjunto*, unsigned long>> retirados;
+	Assinatura assinatura, assinaturaRegras;
+
+	std::mutex mutex;
+	std::condition_variable acordar;
+	bool terminar;
+	std::thread thread;
+};
+
+static Assinatura assinaturaFicheiro(const std::string& nome)
+{
+	Assinatura assinatura = { false, 0, 0 };
+	struct stat info;
+
+	if (nome.empty() || (stat(nome.c_str(), &info) != 0)) return assinatura;
+
+	assinatura.existe = true;
+	assinatura.tamanho = (long long)info.st_size;
+#ifdef __linux__
+	// Em Linux a data tem nanossegundos (duas gravações no mesmo segundo também contam)
+	assinatura.modificacao = (long long)info.st_mtim.tv_sec * 1000000000LL + info.st_mtim.tv_nsec;
+#else
+	assinatura.modificacao = (long long)info.st_mtime;
+#endif
+
+	return assinatura;
+}
+
+// Lê o ficheiro de parâmetros para conjunto (que já tem os valores por omissão); false se tiver erros
+static bool lerFicheiro(const std::string& nome, Conjunto* conjunto)
+{
+	FILE* ficheiro = std::fopen(nome.c_str(), "r");
+	char linha[512], chave[32], valor[400];
+	LVC l;
+	int nlinha = 0, n;
+	bool ok = true;
+
+	// Sem ficheiro ficam os valores por omissão
+	if (ficheiro == NULL) return true;
+
+	while (std::fgets(linha, sizeof(linha), ficheiro) != NULL)
+	{
+		char* comentario = std::strchr(linha, '#');
+
+		nlinha++;
+		if (comentario != NULL) *comentario = '\0';
+		if (std::sscanf(linha, "%31s", chave) != 1) continue;
+
+		if ((std::strcmp(chave, "azul") == 0) || (std::strcmp(chave, "vermelho") == 0))
+		{
+			n = std::sscanf(linha, "%*s %d %d %d %d %d %d %d %d", &l.hmin1, &l.hmax1, &l.hmin2, &l.hmax2, &l.smin, &l.smax, &l.vmin, &l.vmax);
+			if (n != 8)
+			{
+				std::fprintf(stderr, "%s:%d: são precisos 8 valores (hmin1 hmax1 hmin2 hmax2 smin smax vmin vmax)\n", nome.c_str(), nlinha);
+				ok = false;
+				continue;
+			}
+			conjunto->publico.limites[(chave[0] == 'a') ? AZUL : VERMELHO] = l;
+		}
+		else if ((std::strcmp(chave, "regras") == 0) && (std::sscanf(linha, "%*s %399s", valor) == 1))
+		{
+			conjunto->ficheiroRegras = valor;
+		}
+		else
+		{
+			std::fprintf(stderr, "%s:%d: linha desconhecida\n", nome.c_str(), nlinha);
+			ok = false;
+		}
+	}
+
+	std::fclose(ficheiro);
+
+	return ok;
+}
+
+// Conjunto novo a partir do ficheiro (a tabela de cores fica por construir); NULL se tiver erros
+static Conjunto* carregarConjunto(Parametros* parametros)
+{
+	std::unique_ptr<Conjunto> conjunto(new Conjunto());
+	RSVC* regras;
+	int nregras;
+
+	vc_limites_iniciar(conjunto->publico.limites);
+	conjunto->publico.tabelaCores = NULL;
+	conjunto->publico.regras = NULL;
+	conjunto->publico.nregras = 0;
+	conjunto->publico.versao = 1;
+
+	if (!lerFicheiro(parametros->ficheiro, conjunto.get())) return NULL;
+
+	if (!conjunto->ficheiroRegras.empty())
+	{
+		regras = vc_classificador_carregar(conjunto->ficheiroRegras.c_str(), &nregras);
+		if (regras == NULL)
+		{
+			std::fprintf(stderr, "Erro ao ler as regras de %s!\n", conjunto->ficheiroRegras.c_str());
+			return NULL;
+		}
+
+		conjunto->regras.assign(regras, regras + nregras);
+		std::free(regras);
+
+		conjunto->publico.regras = conjunto->regras.data();
+		conjunto->publico.nregras = nregras;
+	}
+
+	return conjunto.release();
+}
+
+// Reaproveita a tabela de cores do conjunto ativo (ou a inicial) se os limites forem os mesmos
+static void reaproveitarTabela(Parametros* parametros, Conjunto* conjunto, Conjunto* anterior)
+{
+	if ((anterior != NULL) && (anterior->tabela != nullptr) && vc_tabela_cores_atual(anterior->tabela.get(), conjunto->publico.limites))
+	{
+		conjunto->tabela = anterior->tabela;
+	}
+	else if ((parametros->tabelaInicial != NULL) && vc_tabela_cores_atual(parametros->tabelaInicial, conjunto->publico.limites))
+	{
+		// A tabela inicial pertence a quem a deu
+		conjunto->tabela = std::shared_ptr<TCVC>(parametros->tabelaInicial, [](TCVC*) {});
+	}
+
+	conjunto->publico.tabelaCores = conjunto->tabela.get();
+}
+
+// Constrói a tabela de cores do conjunto (na thread que vigia o ficheiro, antes da troca)
+static void construirTabela(Conjunto* conjunto)
+{
+	TCVC* tabela = vc_tabela_cores_nova(conjunto->publico.limites);
+
+	if (tabela == NULL) return;
+
+	if (!vc_tabela_cores_construir(tabela, 0, 256))
+	{
+		vc_tabela_cores_libertar(tabela);
+		return;
+	}
+
+	conjunto->tabela = std::shared_ptr<TCVC>(tabela, vc_tabela_cores_libertar);
+	conjunto->publico.tabelaCores = tabela;
+}
+
+// Liberta os conjuntos retirados que já nenhum leitor pode estar a usar
+static void recolher(Parametros* parametros)
+{
+	unsigned long minima = 0, e;
+	int l;
+	size_t i;
+
+	// Época mais antiga de um leitor dentro de uma frame (0 = nenhum)
+	for (l = 0; l < PARAMETROS_MAX_LEITORES; l++)
+	{
+		e = parametros->leitores[l].epoca.load();
+		if ((e != 0) && ((minima == 0) || (e < minima))) minima = e;
+	}
+
+	// Um conjunto retirado na época E só pode estar a ser usado por quem entrou antes de E
+	for (i = 0; i < parametros->retirados.size();)
+	{
+		if ((minima == 0) || (minima >= parametros->retirados[i].second))
+		{
+			delete parametros->retirados[i].first;
+			parametros->retirados[i] = parametros->retirados.back();
+			parametros->retirados.pop_back();
+		}
+		else i++;
+	}
+}
+
+// Troca o conjunto ativo; o anterior é retirado e libertado quando não tiver leitores
+static void publicar(Parametros* parametros, Conjunto* conjunto)
+{
+	Conjunto* anterior = parametros->atual.exchange(conjunto);
+	unsigned long epoca = parametros->epoca.fetch_add(1) + 1;
+
+	parametros->retirados.push_back(std::make_pair(anterior, epoca));
+	recolher(parametros);
+}
+
+// Uma verificação do ficheiro (e do das regras); recarrega se algum mudou
+static void verificar(Parametros* parametros)
+{
+	Conjunto* atual = parametros->atual.load();
+	Assinatura assinatura = assinaturaFicheiro(parametros->ficheiro);
+	Assinatura assinaturaRegras = assinaturaFicheiro(atual->ficheiroRegras);
+	Conjunto* conjunto;
+
+	// Nada mudou: só falta trocar o conjunto se ainda não tiver tabela de cores (por uma cópia com ela)
+	if ((assinatura == parametros->assinatura) && (assinaturaRegras == parametros->assinaturaRegras))
+	{
+		if (atual->publico.tabelaCores != NULL) return;
+
+		conjunto = new Conjunto(*atual);
+		construirTabela(conjunto);
+		if (conjunto->publico.tabelaCores == NULL)
+		{
+			delete conjunto;
+			return;
+		}
+	}
+	else
+	{
+		parametros->assinatura = assinatura;
+		parametros->assinaturaRegras = assinaturaRegras;
+
+		// Com erros, fica o conjunto ativo (o ficheiro volta a ser lido quando mudar outra vez)
+		conjunto = carregarConjunto(parametros);
+		if (conjunto == NULL) return;
+
+		parametros->assinaturaRegras = assinaturaFicheiro(conjunto->ficheiroRegras);
+
+		reaproveitarTabela(parametros, conjunto, atual);
+		if (conjunto->publico.tabelaCores == NULL) construirTabela(conjunto);
+
+		std::printf("Parâmetros de %s recarregados (versão %ld)\n", parametros->ficheiro.c_str(), atual->publico.versao + 1);
+	}
+
+	conjunto->publico.versao = atual->publico.versao + 1;
+	if (!conjunto->regras.empty()) conjunto->publico.regras = conjunto->regras.data();
+
+	publicar(parametros, conjunto);
+}
+
+// Thread que vigia o ficheiro
+static void vigiar(Parametros* parametros)
+{
+	std::unique_lock<std::mutex> lock(parametros->mutex);
+
+	while (!parametros->terminar)
+	{
+		lock.unlock();
+		verificar(parametros);
+		recolher(parametros);
+		lock.lock();
+
+		parametros->acordar.wait_for(lock, std::chrono::milliseconds(parametros->intervaloMs), [parametros] { return parametros->terminar; });
+	}
+}
+
+/*
+* Função: parametros_iniciar
+* ----------------------------
+* Lê o ficheiro de parâmetros (ou usa os valores por omissão, se não existir) e arranca a
+* thread que o vigia. Quando o ficheiro muda, o conjunto novo é preparado nessa thread
+* (regras lidas e tabela de cores construída) e só depois é trocado pelo ativo
+*
+* ficheiro      : ficheiro de parâmetros (ver parametros.h)
+* tabelaInicial : (opcional) tabela de cores já construída, usada enquanto os limites forem os dela
+* intervaloMs   : intervalo entre verificações do ficheiro
+*/
+Parametros* parametros_iniciar(const char* ficheiro, TCVC* tabelaInicial, int intervaloMs)
+{
+	Parametros* parametros;
+	Conjunto* conjunto;
+	int l;
+
+	if ((ficheiro == NULL) || (intervaloMs < 1)) return NULL;
+
+	parametros = new Parametros();
+	parametros->ficheiro = ficheiro;
+	parametros->intervaloMs = intervaloMs;
+	parametros->tabelaInicial = tabelaInicial;
+	parametros->epoca = 1;
+	parametros->terminar = false;
+	for (l = 0; l < PARAMETROS_MAX_LEITORES; l++)
+	{
+		parametros->leitores[l].epoca = 0;
+		parametros->leitores[l].ocupado = false;
+	}
+
+	parametros->assinatura = assinaturaFicheiro(parametros->ficheiro);
+	conjunto = carregarConjunto(parametros);
+	if (conjunto == NULL)
+	{
+		delete parametros;
+		return NULL;
+	}
+	parametros->assinaturaRegras = assinaturaFicheiro(conjunto->ficheiroRegras);
+
+	// Sem tabela que sirva, começa a segmentar por HSV até a thread a construir
+	reaproveitarTabela(parametros, conjunto, NULL);
+	parametros->atual = conjunto;
+
+	parametros->thread = std::thread(vigiar, parametros);
+
+	return parametros;
+}
+
+/*
+* Função: parametros_leitor
+* ----------------------------
+* Reserva um lugar de leitor (cada fluxo de frames usa o seu)
+*
+* parametros : parâmetros
+*/
+int parametros_leitor(Parametros* parametros)
+{
+	int l;
+	bool livre;
+
+	if (parametros == NULL) return -1;
+
+	for (l = 0; l < PARAMETROS_MAX_LEITORES; l++)
+	{
+		livre = false;
+		if (parametros->leitores[l].ocupado.compare_exchange_strong(livre, true)) return l;
+	}
+
+	return -1;
+}
+
+/*
+* Função: parametros_entrar
+* ----------------------------
+* Devolve o conjunto ativo, que não é libertado até o leitor sair. O leitor anuncia a época
+* antes de ler o ponteiro (tudo seq_cst: a leitura do ponteiro não passa à frente do anúncio) e
+* volta a ler a época depois: se mudou entretanto, anuncia a nova e lê outra vez o ponteiro. Assim
+* a época anunciada nunca é mais recente que o conjunto lido, e quem o retirou vê o leitor dentro
+*
+* parametros : parâmetros
+* leitor     : lugar de leitor (parametros_leitor)
+*/
+const ConjuntoParametros* parametros_entrar(Parametros* parametros, int leitor)
+{
+	Conjunto* conjunto;
+	unsigned long epoca, depois;
+
+	if ((parametros == NULL) || (leitor < 0) || (leitor >= PARAMETROS_MAX_LEITORES)) return NULL;
+
+	epoca = parametros->epoca.load();
+	while (true)
+	{
+		parametros->leitores[leitor].epoca.store(epoca);
+		conjunto = parametros->atual.load();
+
+		depois = parametros->epoca.load();
+		if (depois == epoca) break;
+		epoca = depois;
+	}
+
+	return &conjunto->publico;
+}
+
+/*
+* Função: parametros_sair
+* ----------------------------
+* O leitor deixa de usar o conjunto devolvido por parametros_entrar
+*
+* parametros : parâmetros
+* leitor     : lugar de leitor
+*/
+void parametros_sair(Parametros* parametros, int leitor)
+{
+	if ((parametros == NULL) || (leitor < 0) || (leitor >= PARAMETROS_MAX_LEITORES)) return;
+
+	parametros->leitores[leitor].epoca.store(0, std::memory_order_release);
+}
+
+/*
+* Função: parametros_aplicar
+* ----------------------------
+* Passa os parâmetros do conjunto para o processamento de um fluxo
+*
+* conjunto      : conjunto devolvido por parametros_entrar
+* processamento : processamento do fluxo
+*/
+void parametros_aplicar(const ConjuntoParametros* conjunto, PVC* processamento)
+{
+	if ((conjunto == NULL) || (processamento == NULL)) return;
+
+	if ((std::memcmp(processamento->limites, conjunto->limites, sizeof(conjunto->limites)) != 0) ||
+		(processamento->regras != conjunto->regras) || (processamento->nregras != conjunto->nregras))
+	{
+		if (processamento->alteracoes != NULL) vc_alteracoes_invalidar(processamento->alteracoes);
+		std::memcpy(processamento->limites, conjunto->limites, sizeof(conjunto->limites));
+		processamento->regras = conjunto->regras;
+		processamento->nregras = conjunto->nregras;
+	}
+
+	processamento->tabelaCores = conjunto->tabelaCores;
+}
+
+/*
+* Função: parametros_terminar
+* ----------------------------
+* Termina a thread que vigia o ficheiro e liberta todos os conjuntos
+* (os leitores já não podem estar dentro de uma frame)
+*
+* parametros : parâmetros
+*/
+Parametros* parametros_terminar(Parametros* parametros)
+{
+	if (parametros == NULL) return NULL;
+
+	{
+		std::lock_guard<std::mutex> lock(parametros->mutex);
+		parametros->terminar = true;
+	}
+	parametros->acordar.notify_all();
+	parametros->thread.join();
+
+	for (std::pair<Conjunto*, unsigned long>& retirado : parametros->retirados) delete retirado.first;
+	delete parametros->atual.load();
+	delete parametros;
+
+	return NULL;
+}
@@ -0,0 +1,52 @@
+﻿/*
+Autores:
+-Filipe Gajo
+-Ricardo Sampaio
+-Cláudio Silva
+*/
+
+// Parâmetros da segmentação e do classificador recarregados de um ficheiro sem parar o processamento:
+// o conjunto ativo é lido através de um ponteiro atómico (sem locks nas frames) e os conjuntos
+// substituídos só são libertados quando nenhum leitor os pode estar a usar (épocas, como no RCU)
+#pragma once
+
+extern "C" {
+#include "vc.h"
+}
+
+// Máximo de leitores (fluxos ou threads que processam frames) de um ficheiro de parâmetros
+#define PARAMETROS_MAX_LEITORES 64
+
+// Conjunto de parâmetros (só de leitura; válido entre parametros_entrar e parametros_sair)
+typedef struct {
+	LVC limites[3];				// Limites da segmentação de cada cor (índice = Cor)
+	TCVC* tabelaCores;			// Construída com estes limites (NULL enquanto não estiver pronta: segmenta por HSV)
+	const RSVC* regras;			// Tabela de regras do classificador (NULL = tabela ativa)
+	int nregras;
+	long versao;				// 1 = o conjunto inicial; aumenta a cada recarregamento
+} ConjuntoParametros;
+
+typedef struct Parametros Parametros;
+
+// Formato do ficheiro (texto; '#' começa um comentário; as linhas que faltam ficam com os valores por omissão):
+//   azul hmin1 hmax1 hmin2 hmax2 smin smax vmin vmax
+//   vermelho hmin1 hmax1 hmin2 hmax2 smin smax vmin vmax
+//   regras ficheiro.regras     (tabela de regras do classificador; ver vc_classificador_guardar)
+// O ficheiro (e o das regras) é verificado a cada intervaloMs; pode não existir à partida
+// tabelaInicial (opcional) é usada enquanto os limites forem os dela (não é libertada aqui); se não servir,
+// a tabela é construída numa thread à parte e só depois o conjunto é trocado
+Parametros* parametros_iniciar(const char* ficheiro, TCVC* tabelaInicial, int intervaloMs);
+
+// Reserva um lugar de leitor (um por fluxo de frames; -1 se já não houver lugares)
+int parametros_leitor(Parametros* parametros);
+
+// Conjunto ativo, que fica protegido até parametros_sair (uma frame); nunca espera
+const ConjuntoParametros* parametros_entrar(Parametros* parametros, int leitor);
+void parametros_sair(Parametros* parametros, int leitor);
+
+// Copia os limites, a tabela de cores e as regras do conjunto para o processamento
+// (se mudaram, os resultados guardados por blocos deixam de servir)
+void parametros_aplicar(const ConjuntoParametros* conjunto, PVC* processamento);
+
+// Termina a thread que vigia o ficheiro e liberta os conjuntos (já sem leitores)
+Parametros* parametros_terminar(Parametros* parametros);
@@ -11,13 +11,467 @@ Autores:
    no caso de algo correr mal no processo de abertura. É mais segura que a variante original pois tem em conta mais cenários de "erro" */
    // Desabilita (no MSVC++) warnings de funções não seguras (fopen, sscanf, etc...)
 #define _CRT_SECURE_NO_WARNINGS
+#ifdef __linux__
+// Declarações que não são do C11 (MAP_ANONYMOUS, syscall, ftruncate, shm_open, sched_getaffinity):
+// tem de vir antes do primeiro include
+#define _GNU_SOURCE
+#endif
 
 #include <stdio.h> // Funções de input/output (exs: printf, fopen)
 #include <ctype.h> // Funções para testagem e manipulação de caracteres(exs: isdigit, tolower)
 #include <string.h> // Funções para manipulação de arrays de caracteres(strings) (exs: strcmp, strlen)
 #include <malloc.h> // Header obsoleto. Substituído por stdlib.h (ex: malloc)
+#include <stdlib.h> // Funções gerais (ex: abs)
 #include "vc.h" // Header com as declarações das funções de Visão por Computador que definimos
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h> // Mapeamento de ficheiros em memória (CreateFileMapping, MapViewOfFile)
+#else
+#include <fcntl.h> // open
+#include <unistd.h> // close
+#include <sys/stat.h> // fstat
+#include <sys/mman.h> // Mapeamento de ficheiros em memória (mmap) e memória partilhada (shm_open)
+#endif
+#ifdef __linux__
+#include <sys/syscall.h> // syscall(SYS_futex, ...), syscall(SYS_perf_event_open, ...)
+#include <linux/futex.h> // FUTEX_WAIT, FUTEX_WAKE
+#include <linux/perf_event.h> // Contadores do processador (perf_event_attr)
+#include <linux/mempolicy.h> // MPOL_PREFERRED, MPOL_DEFAULT (nó NUMA das alocações)
+#include <sched.h> // sched_getaffinity, sched_setaffinity (CPUs de cada thread)
+#endif
+#include <time.h> // timespec, clock_gettime
 #include <math.h> // Funções matemáticas (exs: pow, sqrt)
+#include <float.h> // Limites dos floats (FLT_MAX)
+#include <limits.h> // INT_MAX
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//   FUNÇÕES: ALOCAÇÃO DOS DADOS (PÁGINAS GRANDES E NÓS NUMA)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+// Tamanho de uma página grande em x86-64
+#define VC_PAGINA_GRANDE (2 * 1024 * 1024)
+// Os dados ficam a seguir a um cabeçalho com o que é preciso para os libertar (múltiplo de 64: os dados ficam alinhados à linha de cache)
+#define VC_ALOCACAO_CABECALHO 128
+
+typedef struct {
+	void* base;					// Início da zona alocada (malloc, mmap ou VirtualAlloc)
+	size_t tamanho;				// Tamanho da zona
+	int tipo;					// VC_ALOCACAO_* que ficou (pode ser menos do que foi pedido)
+	long long bytes;			// Bytes pedidos
+	long long bytesNo[VC_NUMA_MAX_NOS]; // Bytes em cada nó (só nas zonas tocadas ao alocar)
+} vc_cabecalho_alocacao;
+
+// Modo das próximas alocações e totais das alocações que existem agora
+// (atualizados de forma atómica: as imagens podem ser criadas e libertadas em várias threads)
+static int vc_alocacao_modo = VC_ALOCACAO_NORMAL;
+static long long vc_alocacao_blocos = 0, vc_alocacao_bytes = 0, vc_alocacao_bytesNormais = 0, vc_alocacao_bytesGrandes = 0, vc_alocacao_bytesReservadas = 0, vc_alocacao_falhas = 0;
+static long long vc_alocacao_bytesNo[VC_NUMA_MAX_NOS] = { 0 };
+
+#ifdef _WIN32
+#define VC_SOMAR(variavel, valor) InterlockedExchangeAdd64((volatile LONG64*)&(variavel), (LONG64)(valor))
+#define VC_LER(variavel) InterlockedCompareExchange64((volatile LONG64*)&(variavel), 0, 0)
+#else
+#define VC_SOMAR(variavel, valor) __atomic_fetch_add(&(variavel), (long long)(valor), __ATOMIC_RELAXED)
+#define VC_LER(variavel) __atomic_load_n(&(variavel), __ATOMIC_RELAXED)
+#endif
+
+/*
+* Função: vc_zona_alocar
+* ----------------------------
+* Aloca uma zona com páginas grandes, conforme o modo atual: reservadas (MAP_HUGETLB em Linux,
+* MEM_LARGE_PAGES em Windows) ou transparentes (Linux: zona alinhada a 2 MiB com MADV_HUGEPAGE).
+* Devolve NULL se não conseguir (quem chama usa malloc)
+*
+* tamanho : bytes pedidos (arredondado para páginas grandes)
+* tipo    : endereço onde guardar o VC_ALOCACAO_* que ficou
+*/
+static void* vc_zona_alocar(size_t* tamanho, int* tipo)
+{
+#if defined(__linux__)
+	size_t grande = (*tamanho + VC_PAGINA_GRANDE - 1) / VC_PAGINA_GRANDE * VC_PAGINA_GRANDE;
+	unsigned char* zona;
+	unsigned char* inicio;
+
+#ifdef MAP_HUGETLB
+	// Páginas reservadas (vm.nr_hugepages): se não houver livres, ficam as transparentes
+	if (vc_alocacao_modo == VC_ALOCACAO_RESERVADAS)
+	{
+		zona = (unsigned char*)mmap(NULL, grande, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (zona != (unsigned char*)MAP_FAILED)
+		{
+			*tamanho = grande;
+			*tipo = VC_ALOCACAO_RESERVADAS;
+			return zona;
+		}
+		VC_SOMAR(vc_alocacao_falhas, 1);
+	}
+#endif
+
+	// Com mais uma página grande, há sempre um início alinhado; o que sobra dos lados é devolvido
+	zona = (unsigned char*)mmap(NULL, grande + VC_PAGINA_GRANDE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (zona == (unsigned char*)MAP_FAILED) return NULL;
+
+	inicio = (unsigned char*)(((size_t)zona + VC_PAGINA_GRANDE - 1) & ~(size_t)(VC_PAGINA_GRANDE - 1));
+	if (inicio > zona) munmap(zona, inicio - zona);
+	if (inicio + grande < zona + grande + VC_PAGINA_GRANDE) munmap(inicio + grande, (zona + grande + VC_PAGINA_GRANDE) - (inicio + grande));
+
+#ifdef MADV_HUGEPAGE
+	if (madvise(inicio, grande, MADV_HUGEPAGE) != 0) VC_SOMAR(vc_alocacao_falhas, 1);
+#else
+	VC_SOMAR(vc_alocacao_falhas, 1);
+#endif
+
+	*tamanho = grande;
+	*tipo = VC_ALOCACAO_GRANDES;
+	return inicio;
+#elif defined(_WIN32)
+	// Em Windows só há páginas grandes reservadas (precisam do privilégio SeLockMemoryPrivilege)
+	size_t grande = GetLargePageMinimum();
+	void* zona = NULL;
+
+	if (grande > 0)
+	{
+		grande = (*tamanho + grande - 1) / grande * grande;
+		zona = VirtualAlloc(NULL, grande, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+	}
+	if (zona == NULL)
+	{
+		VC_SOMAR(vc_alocacao_falhas, 1);
+		return NULL;
+	}
+
+	*tamanho = grande;
+	*tipo = VC_ALOCACAO_RESERVADAS;
+	return zona;
+#else
+	(void)tamanho;
+	(void)tipo;
+	VC_SOMAR(vc_alocacao_falhas, 1);
+	return NULL;
+#endif
+}
+
+/*
+* Função: vc_zona_nos
+* ----------------------------
+* Conta os bytes da zona que ficaram em cada nó NUMA (o nó da primeira página de cada
+* bloco de 2 MiB; move_pages sem destino só consulta). Noutros sistemas conta tudo no nó 0
+*
+* cabecalho : cabeçalho da zona (já tocada)
+*/
+static void vc_zona_nos(vc_cabecalho_alocacao* cabecalho)
+{
+#ifdef __linux__
+	void* paginas[64];
+	int estados[64], n, i;
+	size_t inicio;
+	long long bytes;
+
+	for (inicio = 0; inicio < cabecalho->tamanho; inicio += 64 * (size_t)VC_PAGINA_GRANDE)
+	{
+		for (n = 0; (n < 64) && (inicio + (size_t)n * VC_PAGINA_GRANDE < cabecalho->tamanho); n++)
+		{
+			paginas[n] = (unsigned char*)cabecalho->base + inicio + (size_t)n * VC_PAGINA_GRANDE;
+		}
+
+		if (syscall(SYS_move_pages, 0, (unsigned long)n, paginas, NULL, estados, 0) != 0)
+		{
+			for (i = 0; i < n; i++) estados[i] = 0;
+		}
+
+		for (i = 0; i < n; i++)
+		{
+			bytes = (long long)MIN((size_t)VC_PAGINA_GRANDE, cabecalho->tamanho - (inicio + (size_t)i * VC_PAGINA_GRANDE));
+			if ((estados[i] >= 0) && (estados[i] < VC_NUMA_MAX_NOS)) cabecalho->bytesNo[estados[i]] += bytes;
+		}
+	}
+#else
+	cabecalho->bytesNo[0] = (long long)cabecalho->tamanho;
+#endif
+}
+
+/*
+* Função: vc_dados_alocar
+* ----------------------------
+* Aloca os dados de uma imagem ou tabela no modo atual (vc_alocacao_definir). As zonas com
+* páginas grandes são tocadas aqui pela thread que aloca, por isso as páginas ficam no nó NUMA
+* dela (ou no nó fixado com vc_numa_fixar), e não no da primeira thread que lá escrever
+*
+* bytes : tamanho dos dados
+*/
+static unsigned char* vc_dados_alocar(size_t bytes)
+{
+	vc_cabecalho_alocacao* cabecalho;
+	size_t tamanho = bytes + VC_ALOCACAO_CABECALHO;
+	int tipo = VC_ALOCACAO_NORMAL, no;
+	void* base = NULL;
+
+	if (vc_alocacao_modo != VC_ALOCACAO_NORMAL) base = vc_zona_alocar(&tamanho, &tipo);
+
+	if (base == NULL)
+	{
+		tamanho = bytes + VC_ALOCACAO_CABECALHO;
+		tipo = VC_ALOCACAO_NORMAL;
+		base = malloc(tamanho);
+		if (base == NULL) return NULL;
+	}
+
+	cabecalho = (vc_cabecalho_alocacao*)base;
+	memset(cabecalho, 0, sizeof(vc_cabecalho_alocacao));
+	cabecalho->base = base;
+	cabecalho->tamanho = tamanho;
+	cabecalho->tipo = tipo;
+	cabecalho->bytes = (long long)bytes;
+
+	if (tipo != VC_ALOCACAO_NORMAL)
+	{
+		// Primeiro toque em todas as páginas
+		memset((unsigned char*)base + VC_ALOCACAO_CABECALHO, 0, tamanho - VC_ALOCACAO_CABECALHO);
+		vc_zona_nos(cabecalho);
+
+		VC_SOMAR(*((tipo == VC_ALOCACAO_RESERVADAS) ? &vc_alocacao_bytesReservadas : &vc_alocacao_bytesGrandes), tamanho);
+		for (no = 0; no < VC_NUMA_MAX_NOS; no++) VC_SOMAR(vc_alocacao_bytesNo[no], cabecalho->bytesNo[no]);
+	}
+	else VC_SOMAR(vc_alocacao_bytesNormais, tamanho);
+
+	VC_SOMAR(vc_alocacao_blocos, 1);
+	VC_SOMAR(vc_alocacao_bytes, bytes);
+
+	return (unsigned char*)base + VC_ALOCACAO_CABECALHO;
+}
+
+/*
+* Função: vc_dados_libertar
+* ----------------------------
+* Liberta dados alocados com vc_dados_alocar
+*
+* dados : dados (NULL não faz nada)
+*/
+static void vc_dados_libertar(void* dados)
+{
+	vc_cabecalho_alocacao* cabecalho;
+	int no;
+
+	if (dados == NULL) return;
+
+	cabecalho = (vc_cabecalho_alocacao*)((unsigned char*)dados - VC_ALOCACAO_CABECALHO);
+
+	VC_SOMAR(vc_alocacao_blocos, -1);
+	VC_SOMAR(vc_alocacao_bytes, -cabecalho->bytes);
+
+	if (cabecalho->tipo == VC_ALOCACAO_NORMAL)
+	{
+		VC_SOMAR(vc_alocacao_bytesNormais, -(long long)cabecalho->tamanho);
+		free(cabecalho->base);
+		return;
+	}
+
+	VC_SOMAR(*((cabecalho->tipo == VC_ALOCACAO_RESERVADAS) ? &vc_alocacao_bytesReservadas : &vc_alocacao_bytesGrandes), -(long long)cabecalho->tamanho);
+	for (no = 0; no < VC_NUMA_MAX_NOS; no++) VC_SOMAR(vc_alocacao_bytesNo[no], -cabecalho->bytesNo[no]);
+
+#ifdef _WIN32
+	VirtualFree(cabecalho->base, 0, MEM_RELEASE);
+#else
+	munmap(cabecalho->base, cabecalho->tamanho);
+#endif
+}
+
+/*
+* Função: vc_alocacao_definir
+* ----------------------------
+* Escolhe como são alocados os dados das imagens e das tabelas de cores criadas a seguir
+* (as que já existem ficam como estão)
+*
+* modo : VC_ALOCACAO_*
+*/
+int vc_alocacao_definir(int modo)
+{
+	if ((modo < VC_ALOCACAO_NORMAL) || (modo > VC_ALOCACAO_RESERVADAS)) return 0;
+
+	vc_alocacao_modo = modo;
+
+	return 1;
+}
+
+/*
+* Função: vc_alocacao_estatistica
+* ----------------------------
+* Preenche a estatística das alocações que existem agora
+*
+* estatistica : estrutura a preencher
+*/
+void vc_alocacao_estatistica(MAVC* estatistica)
+{
+	int no;
+#ifdef __linux__
+	FILE* file;
+	char linha[256];
+	long long kb;
+#endif
+
+	if (estatistica == NULL) return;
+
+	estatistica->modo = vc_alocacao_modo;
+	estatistica->blocos = (long)VC_LER(vc_alocacao_blocos);
+	estatistica->bytes = VC_LER(vc_alocacao_bytes);
+	estatistica->bytesNormais = VC_LER(vc_alocacao_bytesNormais);
+	estatistica->bytesGrandes = VC_LER(vc_alocacao_bytesGrandes);
+	estatistica->bytesReservadas = VC_LER(vc_alocacao_bytesReservadas);
+	estatistica->falhas = (long)VC_LER(vc_alocacao_falhas);
+	for (no = 0; no < VC_NUMA_MAX_NOS; no++) estatistica->bytesNo[no] = VC_LER(vc_alocacao_bytesNo[no]);
+	estatistica->nos = vc_numa_nos();
+	estatistica->paginasGrandesProcesso = -1;
+
+#ifdef __linux__
+	// Páginas grandes transparentes que o núcleo deu de facto (o madvise é só um pedido)
+	file = fopen("/proc/self/smaps_rollup", "r");
+	if (file != NULL)
+	{
+		while (fgets(linha, sizeof(linha), file) != NULL)
+		{
+			if (sscanf(linha, "AnonHugePages: %lld kB", &kb) == 1) estatistica->paginasGrandesProcesso = kb * 1024 / VC_PAGINA_GRANDE;
+		}
+		fclose(file);
+	}
+#endif
+}
+
+/*
+* Função: vc_alocacao_relatorio
+* ----------------------------
+* Escreve a estatística das alocações: blocos, páginas de cada tamanho e bytes por nó NUMA
+*
+* file : ficheiro onde escrever (ex: stdout)
+*/
+void vc_alocacao_relatorio(FILE* file)
+{
+	const char* modos[3] = { "normal", "paginas grandes", "paginas reservadas" };
+	MAVC estatistica;
+	int no;
+
+	vc_alocacao_estatistica(&estatistica);
+
+	fprintf(file, "Memoria (%s): %ld blocos, %.1f MiB\n", modos[estatistica.modo], estatistica.blocos, estatistica.bytes / (1024.0 * 1024.0));
+	fprintf(file, "  paginas de 4 KiB: %lld; zonas com paginas grandes pedidas: %lld x 2 MiB; reservadas: %lld x 2 MiB; falhas: %ld\n",
+		(estatistica.bytesNormais + 4095) / 4096, estatistica.bytesGrandes / VC_PAGINA_GRANDE, estatistica.bytesReservadas / VC_PAGINA_GRANDE, estatistica.falhas);
+	if (estatistica.paginasGrandesProcesso >= 0) fprintf(file, "  paginas grandes transparentes no processo: %lld\n", estatistica.paginasGrandesProcesso);
+
+	for (no = 0; (no < estatistica.nos) && (no < VC_NUMA_MAX_NOS); no++)
+	{
+		fprintf(file, "  no %d: %.1f MiB\n", no, estatistica.bytesNo[no] / (1024.0 * 1024.0));
+	}
+}
+
+/*
+* Função: vc_numa_nos
+* ----------------------------
+* Número de nós NUMA do sistema (1 se não se souber ou fora de Linux)
+*/
+int vc_numa_nos(void)
+{
+	int nos = 1;
+#ifdef __linux__
+	char nome[64];
+	struct stat estado;
+
+	while (nos < VC_NUMA_MAX_NOS)
+	{
+		sprintf(nome, "/sys/devices/system/node/node%d", nos);
+		if (stat(nome, &estado) != 0) break;
+		nos++;
+	}
+#endif
+
+	return nos;
+}
+
+/*
+* Função: vc_numa_no
+* ----------------------------
+* Nó NUMA da CPU onde a thread que chama está a correr (0 fora de Linux)
+*/
+int vc_numa_no(void)
+{
+#ifdef __linux__
+	unsigned int cpu, no;
+
+	if (syscall(SYS_getcpu, &cpu, &no, NULL) == 0) return (int)no;
+#endif
+
+	return 0;
+}
+
+/*
+* Função: vc_numa_fixar
+* ----------------------------
+* Fixa a thread que chama às CPUs de um nó e faz com que as páginas que ela tocar sejam
+* preferencialmente desse nó (só em Linux; noutros sistemas não faz nada e devolve 0).
+* Na primeira vez, guarda as CPUs que a thread tinha (por exemplo, as dadas com taskset)
+*
+* no : nó NUMA (< 0 = as CPUs que a thread tinha antes e a política de memória por omissão)
+*/
+int vc_numa_fixar(int no)
+{
+#ifdef __linux__
+	static _Thread_local cpu_set_t originais;
+	static _Thread_local int guardadas = 0;
+	cpu_set_t cpus;
+	unsigned long nos = 0;
+	char nome[64], lista[1024];
+	char* p;
+	FILE* file;
+	int inicio, fim, c, lidos;
+
+	if (no >= VC_NUMA_MAX_NOS) return 0;
+
+	if (no < 0)
+	{
+		syscall(SYS_set_mempolicy, MPOL_DEFAULT, NULL, 0);
+		if (!guardadas) return 1; // Nunca foi fixada
+		return sched_setaffinity(0, sizeof(originais), &originais) == 0;
+	}
+	else
+	{
+		if (!guardadas)
+		{
+			if (sched_getaffinity(0, sizeof(originais), &originais) != 0) return 0;
+			guardadas = 1;
+		}
+
+		CPU_ZERO(&cpus);
+
+		// Lista de CPUs do nó, por exemplo "0-7,16-23"
+		sprintf(nome, "/sys/devices/system/node/node%d/cpulist", no);
+		file = fopen(nome, "r");
+		if (file == NULL) return 0;
+		p = fgets(lista, sizeof(lista), file);
+		fclose(file);
+		if (p == NULL) return 0;
+
+		while (sscanf(p, "%d%n", &inicio, &lidos) == 1)
+		{
+			p += lidos;
+			fim = inicio;
+			if ((*p == '-') && (sscanf(p + 1, "%d%n", &fim, &lidos) == 1)) p += 1 + lidos;
+			for (c = inicio; (c <= fim) && (c < CPU_SETSIZE); c++) if (CPU_ISSET(c, &originais)) CPU_SET(c, &cpus);
+			if (*p != ',') break;
+			p++;
+		}
+
+		// Só as CPUs do nó que a thread já podia usar (sem nenhuma, fica com as que tinha)
+		if (CPU_COUNT(&cpus) == 0) cpus = originais;
+
+		nos = 1UL << no;
+		if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, &nos, (unsigned long)(8 * sizeof(nos))) != 0) return 0;
+	}
+
+	return sched_setaffinity(0, sizeof(cpus), &cpus) == 0;
+#else
+	(void)no;
+	return 0;
+#endif
+}
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 //            FUNÇÕES: ALOCAR E LIBERTAR UMA IMAGEM
@@ -45,7 +499,10 @@ IVC* vc_image_new(int width, int height, int channels, int levels)
 	image->channels = channels;
 	image->levels = levels;
 	image->bytesperline = image->width * image->channels;
-	image->data = (unsigned char*)malloc(image->width * image->height * image->channels * sizeof(char));
+	image->xoffset = 0;
+	image->yoffset = 0;
+	// Conforme o modo de vc_alocacao_definir (malloc, por omissão)
+	image->data = vc_dados_alocar((size_t)image->width * image->height * image->channels * sizeof(char));
 
 	if (image->data == NULL)
 	{
@@ -71,7 +528,7 @@ IVC* vc_image_free(IVC* image)
 	{
 		if (image->data != NULL)
 		{
-			free(image->data);
+			vc_dados_libertar(image->data);
 			image->data = NULL;
 		}
 
@@ -82,6 +539,39 @@ IVC* vc_image_free(IVC* image)
 	return image;
 }
 
+/*
+ * Função: vc_image_view
+ * ----------------------------
+ *	 Preenche uma vista (sub-imagem) sobre uma região de outra imagem.
+ *	 A vista aponta para os dados da imagem-mãe e mantém o bytesperline desta,
+ *	 pelo que as funções que percorrem a imagem linha a linha trabalham só na região.
+ *
+ *	 src:		imagem-mãe (pode ser ela própria uma vista)
+ *	 view:		estrutura a preencher (alocada por quem chama, não se liberta com vc_image_free)
+ *	 x, y:		canto superior esquerdo da região na imagem-mãe
+ *	 width:		largura da região
+ *	 height:	altura da região
+ */
+int vc_image_view(IVC* src, IVC* view, int x, int y, int width, int height)
+{
+	// Verificação de erros
+	if ((src == NULL) || (view == NULL) || (src->data == NULL)) return 0;
+	if ((x < 0) || (y < 0) || (width <= 0) || (height <= 0)) return 0;
+	if ((x + width > src->width) || (y + height > src->height)) return 0;
+
+	view->data = src->data + y * src->bytesperline + x * src->channels;
+	view->width = width;
+	view->height = height;
+	view->channels = src->channels;
+	view->levels = src->levels;
+	view->bytesperline = src->bytesperline;
+	// Coordenadas da vista na imagem original (acumula se src também for uma vista)
+	view->xoffset = src->xoffset + x;
+	view->yoffset = src->yoffset + y;
+
+	return 1;
+}
+
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 //    FUNÇÕES: ESCRITA DE IMAGENS (PBM, PGM E PPM)
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
@@ -156,73 +646,98 @@ long int unsigned_char_to_bit(unsigned char* datauchar, unsigned char* databit,
 }
 
 /*
- * Função: vc_write_image
+ * Função: vc_write_image_file
  * ----------------------------
- *	 Escreve uma imagem da estrutura IVC
+ *	 Escreve uma imagem da estrutura IVC (cabeçalho PBM, PGM ou PPM e dados) num ficheiro já aberto.
+ *	 Várias imagens seguidas no mesmo ficheiro formam um fluxo de imagens PNM concatenadas
  *
- *	 filename:	caminho + nome para guardar a imagem
- *	 image:		endereço de memória da imagem
+ *	 file:		ficheiro aberto em modo binário
+ *	 image:		endereço de memória da imagem (pode ser uma vista)
  */
-int vc_write_image(char* filename, IVC* image)
+int vc_write_image_file(FILE* file, IVC* image)
 {
-	FILE* file = NULL;
 	unsigned char* tmp;
 	long int totalbytes, sizeofbinarydata;
+	int y;
 
-	if (image == NULL) return 0;
+	if ((file == NULL) || (image == NULL)) return 0;
 
-	// "wb" = write binary
-	if ((file = fopen(filename, "wb")) != NULL)
+	// Só existe preto e branco
+	if (image->levels == 1)
 	{
-		// Só existe preto e branco
-		if (image->levels == 1)
-		{
-			// image->height + 1 para dar mais uma linha no princípio para preencher com o número mágico, largura e altura da imagem
-			sizeofbinarydata = (image->width / 8 + ((image->width % 8) ? 1 : 0)) * image->height + 1;
-			tmp = (unsigned char*)malloc(sizeofbinarydata);
-			if (tmp == NULL) return 0;
+		// Uma linha de cada vez (+ 1: unsigned_char_to_bit põe a 0 o byte a seguir ao último)
+		sizeofbinarydata = (image->width / 8 + ((image->width % 8) ? 1 : 0)) + 1;
+		tmp = (unsigned char*)malloc(sizeofbinarydata);
+		if (tmp == NULL) return 0;
 
-			// int fprintf(FILE *stream, const char *format, ...)
-			// Começa por escrever no princípio do ficheiro/imagem o número mágico, a largura e a altura da imagem
-			fprintf(file, "%s %d %d\n", "P4", image->width, image->height);
+		// int fprintf(FILE *stream, const char *format, ...)
+		// Começa por escrever no princípio do ficheiro/imagem o número mágico, a largura e a altura da imagem
+		fprintf(file, "%s %d %d\n", "P4", image->width, image->height);
 
-			totalbytes = unsigned_char_to_bit(image->data, tmp, image->width, image->height);
-			printf("Total = %ld\n", totalbytes);
+		// Linha a linha (numa vista, bytesperline é o da imagem-mãe; cada linha PBM acaba num byte)
+		for (y = 0; y < image->height; y++)
+		{
+			totalbytes = unsigned_char_to_bit(image->data + y * image->bytesperline, tmp, image->width, 1);
 			// guarda-se byte a byte porque pode não ser múltiplo de 8 (o total bytes)
-			if (fwrite(tmp, sizeof(unsigned char), totalbytes, file) != totalbytes) // verificar se guardou todos os bytes (totalbytes)
+			if (fwrite(tmp, sizeof(unsigned char), totalbytes, file) != (size_t)totalbytes) // verificar se guardou todos os bytes (totalbytes)
 			{
 #ifdef VC_DEBUG
-				fprintf(stderr, "ERROR -> vc_read_image():\n\tError writing PBM, PGM or PPM file.\n");
+				fprintf(stderr, "ERROR -> vc_write_image_file():\n\tError writing PBM, PGM or PPM file.\n");
 #endif
 
-				fclose(file);
 				free(tmp);
 				return 0;
 			}
-
-			free(tmp);
 		}
-		// Mais de um nível (256)
-		else
-		{
-			fprintf(file, "%s %d %d 255\n", (image->channels == 1) ? "P5" : "P6", image->width, image->height);
 
-			// fwrite devolve o número de elementos escritos
-			// Pode-se guardar linha a linha (porque o tamanho total é múltiplo de 8)
-			if (fwrite(image->data, image->bytesperline, image->height, file) != image->height)
+		free(tmp);
+	}
+	// Mais de um nível (256)
+	else
+	{
+		fprintf(file, "%s %d %d 255\n", (image->channels == 1) ? "P5" : "P6", image->width, image->height);
+
+		// fwrite devolve o número de elementos escritos
+		// Linha a linha (numa vista, bytesperline é o da imagem-mãe)
+		for (y = 0; y < image->height; y++)
+		{
+			if (fwrite(image->data + y * image->bytesperline, image->width * image->channels, 1, file) != 1)
 			{
 #ifdef VC_DEBUG
-				fprintf(stderr, "ERROR -> vc_read_image():\n\tError writing PBM, PGM or PPM file.\n");
+				fprintf(stderr, "ERROR -> vc_write_image_file():\n\tError writing PBM, PGM or PPM file.\n");
 #endif
 
-				fclose(file);
 				return 0;
 			}
 		}
+	}
+
+	return 1;
+}
+
+/*
+ * Função: vc_write_image
+ * ----------------------------
+ *	 Escreve uma imagem da estrutura IVC
+ *
+ *	 filename:	caminho + nome para guardar a imagem
+ *	 image:		endereço de memória da imagem
+ */
+int vc_write_image(char* filename, IVC* image)
+{
+	FILE* file = NULL;
+	int ok;
+
+	if (image == NULL) return 0;
+
+	// "wb" = write binary
+	if ((file = fopen(filename, "wb")) != NULL)
+	{
+		ok = vc_write_image_file(file, image);
 
 		fclose(file);
 
-		return 1;
+		return ok;
 	}
 
 	return 0;
@@ -235,91 +750,105 @@ int vc_write_image(char* filename, IVC* image)
 /*
  * Função: vc_bgr_to_hsv
  * ----------------------------
- *	 Converte uma imagem bgr para hsv
+ *	 Converte uma imagem bgr para hsv (H, S e V entre 0 e 255), só com inteiros.
+ *	 As divisões são feitas com uma tabela de inversos (multiplicação de 64 bits e deslocamento)
+ *	 e dão exatamente os mesmos bytes que a conversão com floats que havia antes (ver vc_hsv_verificar).
+ *	 Verifica as imagens e chama o núcleo (template de imagem.h com 3 canais)
  *
  *	 src:		estrutura da imagem de origem
  *	 dst:		estrutura da imagem de saida
  */
 int vc_bgr_to_hsv(IVC* src, IVC* dst)
+{
+	// Verificação de erros
+	if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL) || (dst->data == NULL)) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height) || (src->channels != dst->channels)) return 0;
+	if (src->channels != 3) return 0;
+
+	// Ciclo por píxel: nucleos::bgrParaHsv (imagem.h)
+	vc_nucleo_bgr_to_hsv(src, dst);
+
+	return 1;
+}
+
+/*
+ * Função: vc_bgr_reduzir
+ * ----------------------------
+ *	 Reduz uma imagem a cores por um fator inteiro: cada píxel de dst é a média
+ *	 (com arredondamento) do bloco fator x fator correspondente em src
+ *
+ *	 src:		estrutura da imagem de origem
+ *	 dst:		estrutura da imagem de saida (width = src->width / fator, height = src->height / fator)
+ *	 fator:		fator de redução (>= 1)
+ */
+int vc_bgr_reduzir(IVC* src, IVC* dst, int fator)
 {
 	unsigned char* data = (unsigned char*)src->data;
-	int width = src->width;
-	int height = src->height;
+	unsigned char* datadst = (unsigned char*)dst->data;
 	int channels = src->channels;
-	float r, g, b, hue, saturation, value;
-	float rgb_max, rgb_min;
-	int i, size;
+	int x, y, kx, ky, c;
+	int soma[3];
+	int npixeis = fator * fator;
+	long int pos, posdst;
 
 	// Verificação de erros
-	if ((width <= 0) || (height <= 0) || (data == NULL) || (dst->data == NULL)) return 0;
-	if ((width != dst->width) || (height != dst->height) || (channels != dst->channels)) return 0;
+	if ((src->width <= 0) || (src->height <= 0) || (data == NULL) || (datadst == NULL)) return 0;
+	if (fator < 1) return 0;
+	if ((dst->width != src->width / fator) || (dst->height != src->height / fator) || (dst->channels != channels)) return 0;
 	if (channels != 3) return 0;
 
-	size = width * height * channels;
-
-	for (i = 0; i < size; i += channels)
+	for (y = 0; y < dst->height; y++)
 	{
-		b = (float)data[i];
-		g = (float)data[i + 1];
-		r = (float)data[i + 2];
-
-		// Calcula valores máximo e mínimo dos canais de cor R, G e B
-		rgb_max = (r > g ? (r > b ? r : b) : (g > b ? g : b));
-		rgb_min = (r < g ? (r < b ? r : b) : (g < b ? g : b));
-
-		// Value toma valores entre [0, 255]
-		value = rgb_max;
-		if (value == 0.0f)
-		{
-			hue = 0.0f;
-			saturation = 0.0f;
-		}
-		else
+		for (x = 0; x < dst->width; x++)
 		{
-			// Saturation toma valores entre [0, 1]
-			saturation = ((rgb_max - rgb_min) / rgb_max);
+			soma[0] = soma[1] = soma[2] = 0;
 
-			if (saturation == 0.0f)
-			{
-				hue = 0.0f;
-			}
-			else
+			// Soma do bloco fator x fator
+			for (ky = 0; ky < fator; ky++)
 			{
-				// Hue toma valores entre [0, 360]
-				if ((rgb_max == r) && (g >= b))
-				{
-					hue = 60.0f * (g - b) / (rgb_max - rgb_min);
-				}
-				else if ((rgb_max == r) && (b > g))
-				{
-					hue = 360.0f + 60.0f * (g - b) / (rgb_max - rgb_min);
-				}
-				else if (rgb_max == g)
-				{
-					hue = 120.0f + 60.0f * (b - r) / (rgb_max - rgb_min);
-				}
-				else // rgb_max == b
+				pos = (y * fator + ky) * src->bytesperline + x * fator * channels;
+
+				for (kx = 0; kx < fator; kx++, pos += channels)
 				{
-					hue = 240.0f + 60.0f * (r - g) / (rgb_max - rgb_min);
+					soma[0] += data[pos];
+					soma[1] += data[pos + 1];
+					soma[2] += data[pos + 2];
 				}
 			}
-		}
 
-		// Atribui valores entre [0, 255]
-		dst->data[i] = (unsigned char)(hue / 360.0f * 255.0f);
-		dst->data[i + 1] = (unsigned char)(saturation * 255.0f);
-		dst->data[i + 2] = (unsigned char)(value);
+			posdst = y * dst->bytesperline + x * channels;
+			for (c = 0; c < 3; c++) datadst[posdst + c] = (unsigned char)((soma[c] + npixeis / 2) / npixeis);
+		}
 	}
 
 	return 1;
 }
 
 /*
-* Função: vc_hsv_segmentation
+* Função: vc_hsv_limites
 * ----------------------------
-* Faz a segmentação de uma imagem hsv pelos valores dados
+* Converte um intervalo [minimo, maximo] numa escala (360 graus ou 100%) no intervalo de
+* bytes (0 a 255) com o mesmo resultado: um byte b vale (b * escala) / 255 (truncado), que
+* cresce com b, por isso o intervalo vai do primeiro byte com valor >= minimo ao último com
+* valor <= maximo (bmin > bmax = intervalo vazio)
 *
-* src   : estrutura da imagem de origem
+* minimo, maximo : intervalo na escala
+* escala         : 360 (hue) ou 100 (saturação e value)
+* bmin, bmax     : intervalo em bytes
+*/
+static void vc_hsv_limites(int minimo, int maximo, int escala, int* bmin, int* bmax)
+{
+	*bmin = (minimo <= 0) ? 0 : (minimo * 255 + escala - 1) / escala;
+	*bmax = (maximo < 0) ? -1 : ((maximo + 1) * 255 - 1) / escala;
+	if (*bmax > 255) *bmax = 255;
+}
+
+/*
+* Função: vc_hsv_segmentation
+* ----------------------------
+* Faz a segmentação de uma imagem hsv pelos valores dados
+*
+* src   : estrutura da imagem de origem
 * dst : estrutura da imagem de saida
 * hmin  : valor minimo para o valor de hue
 * hmax  : valor maximo para o valor de hue
@@ -330,40 +859,21 @@ int vc_bgr_to_hsv(IVC* src, IVC* dst)
 */
 int vc_hsv_segmentation(IVC* src, IVC* dst, int hmin, int hmax, int smin, int smax, int vmin, int vmax)
 {
-	unsigned char* data = (unsigned char*)src->data;
-	unsigned char* datadst = (unsigned char*)dst->data;
-	int width = src->width;
-	int height = src->height;
-	int channels = src->channels;
-	int hue, saturation, value;
-	long int pos_src, pos_dst;
-	int x, y;
-	int bytesperline_src = src->width * src->channels;
-	int bytesperline_dst = dst->width * dst->channels;
+	int limites[8];
 
 	// Verificação de erros
-	if ((width <= 0) || (height <= 0) || (data == NULL) || datadst == NULL) return 0;
-	if ((width != dst->width) || (height != dst->height)) return 0;
-	if ((channels != 3) || (dst->channels != 1)) return 0;
+	if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL) || (dst->data == NULL)) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height)) return 0;
+	if ((src->channels != 3) || (dst->channels != 1)) return 0;
 
-	for (y = 0; y < height; y++)
-	{
-		for (x = 0; x < width; x++)
-		{
-			pos_src = y * bytesperline_src + x * channels;
-			pos_dst = y * bytesperline_dst + x; // * canais = 1
+	// Limites convertidos uma vez para bytes (compara-se diretamente com os bytes da imagem HSV)
+	vc_hsv_limites(hmin, hmax, 360, &limites[0], &limites[1]);
+	limites[2] = 0;
+	limites[3] = -1;
+	vc_hsv_limites(smin, smax, 100, &limites[4], &limites[5]);
+	vc_hsv_limites(vmin, vmax, 100, &limites[6], &limites[7]);
 
-			hue = (int)((float)data[pos_src] / 255.0f * 360.0f);
-			saturation = (int)((float)data[pos_src + 1] / 255.0f * 100.0f);
-			value = (int)((float)data[pos_src + 2] / 255.0f * 100.0f);
-
-			if (hue >= hmin && hue <= hmax &&
-				saturation >= smin && saturation <= smax &&
-				value >= vmin && value <= vmax)
-				datadst[pos_dst] = (unsigned char)255;
-			else datadst[pos_dst] = (unsigned char)0;
-		}
-	}
+	vc_nucleo_hsv_segmentar(src, dst, limites, 1);
 
 	return 1;
 }
@@ -387,650 +897,5591 @@ int vc_hsv_segmentation(IVC* src, IVC* dst, int hmin, int hmax, int smin, int sm
 */
 int vc_hsv_red_segmentation(IVC* src, IVC* dst, int hmin1, int hmax1, int hmin2, int hmax2, int smin, int smax, int vmin, int vmax)
 {
-	unsigned char* data = (unsigned char*)src->data;
-	unsigned char* datadst = (unsigned char*)dst->data;
-	int width = src->width;
-	int height = src->height;
-	int channels = src->channels;
-	int hue, saturation, value;
-	long int pos_src, pos_dst;
-	int x, y;
-	int bytesperline_src = src->width * src->channels;
-	int bytesperline_dst = dst->width * dst->channels;
+	int limites[8];
 
 	// Verificação de erros
-	if ((width <= 0) || (height <= 0) || (data == NULL) || datadst == NULL) return 0;
-	if ((width != dst->width) || (height != dst->height)) return 0;
-	if ((channels != 3) || (dst->channels != 1)) return 0;
-
-	for (y = 0; y < height; y++)
-	{
-		for (x = 0; x < width; x++)
-		{
-			pos_src = y * bytesperline_src + x * channels;
-			pos_dst = y * bytesperline_dst + x; // * canais = 1
+	if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL) || (dst->data == NULL)) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height)) return 0;
+	if ((src->channels != 3) || (dst->channels != 1)) return 0;
 
-			hue = (int)((float)data[pos_src] / 255.0f * 360.0f);
-			saturation = (int)((float)data[pos_src + 1] / 255.0f * 100.0f);
-			value = (int)((float)data[pos_src + 2] / 255.0f * 100.0f);
+	// Limites convertidos uma vez para bytes (compara-se diretamente com os bytes da imagem HSV)
+	vc_hsv_limites(hmin1, hmax1, 360, &limites[0], &limites[1]);
+	vc_hsv_limites(hmin2, hmax2, 360, &limites[2], &limites[3]);
+	vc_hsv_limites(smin, smax, 100, &limites[4], &limites[5]);
+	vc_hsv_limites(vmin, vmax, 100, &limites[6], &limites[7]);
 
-			if (((hue >= hmin1 && hue <= hmax1) || (hue >= hmin2 && hue <= hmax2)) &&
-				saturation >= smin && saturation <= smax &&
-				value >= vmin && value <= vmax)
-				datadst[pos_dst] = (unsigned char)255;
-			else datadst[pos_dst] = (unsigned char)0;
+	vc_nucleo_hsv_segmentar(src, dst, limites, 2);
 
-		}
-	}
+	return 1;
 }
 
-
 /*
-* Função: vc_binary_blob_labelling
+* Função: vc_hsv_referencia
 * ----------------------------
-* Faz o etiquetamento de uma imagem segmentada
+* Converte um píxel com floats, como vc_bgr_to_hsv fazia antes de passar a inteiros
+* (só serve de referência para vc_hsv_verificar)
 *
-* src      : estrutura da imagem de origem
-* dst	   : estrutura da imagem de saida
-* nlabels  : número de objetos encontrados na imagem
+* blue, green, red : canais do píxel
+* hsv              : bytes H, S e V
 */
-OVC* vc_binary_blob_labelling(IVC* src, IVC* dst, int* nlabels)
+static void vc_hsv_referencia(int blue, int green, int red, unsigned char* hsv)
 {
-	unsigned char* datasrc = (unsigned char*)src->data;
-	unsigned char* datadst = (unsigned char*)dst->data;
-	int width = src->width;
-	int height = src->height;
-	int bytesperline = src->bytesperline;
-	int channels = src->channels;
-	int x, y, a, b; // a e b são variáveis auxiliares para percorrer tabela das etiquetas
-	long int i, size; // i = variável auxiliar para percorrer imagem original, etc.
-	// long int posX, posA, posB, posC, posD;
-	long int posX;
-	int A, B, C, D;
-	int labeltable[256] = { 0 }; // { 0 } inicializa todas as posições do array a 0
-	int label = 1; // Etiqueta inicial.
-	int lowestLabel, tmplabel; // lowestLabel = var auxiliar para etiqueta
-	// tmplabel = var auxiliar para percorrer tabela de etiquetas (para ser mais fácil de ler: usa um nome diferente)
-	OVC* blobs; // Apontador para array de blobs (objectos) que será retornado desta função.
-
-	// Verificação de erros
-	if ((width <= 0) || (height <= 0) || (datasrc == NULL) || (datadst == NULL)) return 0;
-	if ((width != dst->width) || (height != dst->height) || (channels != dst->channels)) return NULL;
-	if (channels != 1) return NULL;
-
-	// Copia dados da imagem binária para imagem grayscale
-	memcpy(datadst, datasrc, bytesperline * height);
+	float r = (float)red, g = (float)green, b = (float)blue, hue, saturation, value;
+	float rgb_max, rgb_min;
 
-	// Todos os pixéis de plano de fundo devem obrigatóriamente ter valor 0
-	// Todos os pixéis de primeiro plano devem obrigatóriamente ter valor 255
-	// Serão atribuídas etiquetas no intervalo [1,254]
-	// Este algoritmo está assim limitado a 255 labels
-	for (i = 0, size = bytesperline * height; i < size; i++)
-	{ // para dar se tivermos píxeis com valores iguais a: 0 ou 1 || 0 ou 255
-		if (datadst[i] != 0) datadst[i] = 255;
-	}
+	rgb_max = (r > g ? (r > b ? r : b) : (g > b ? g : b));
+	rgb_min = (r < g ? (r < b ? r : b) : (g < b ? g : b));
 
-	// Limpa os rebordos da imagem binária
-	// (porque não há objetos só com 1 píxel)
-	for (y = 0; y < height; y++) // Limpa rebordos verticais 
+	value = rgb_max;
+	if (value == 0.0f)
 	{
-		datadst[y * bytesperline + 0 * channels] = 0; // Limpa rebordo vertical esquerdo
-		datadst[y * bytesperline + (width - 1) * channels] = 0; // Limpa rebordo vertical direito
+		hue = 0.0f;
+		saturation = 0.0f;
 	}
-	for (x = 0; x < width; x++) // Limpa rebordos horizontais
+	else
 	{
-		datadst[0 * bytesperline + x * channels] = 0; // Limpa rebordo horizontal superior
-		datadst[(height - 1) * bytesperline + x * channels] = 0; // Limpa rebordo horizontal inferior
+		saturation = ((rgb_max - rgb_min) / rgb_max);
+
+		if (saturation == 0.0f) hue = 0.0f;
+		else if ((rgb_max == r) && (g >= b)) hue = 60.0f * (g - b) / (rgb_max - rgb_min);
+		else if ((rgb_max == r) && (b > g)) hue = 360.0f + 60.0f * (g - b) / (rgb_max - rgb_min);
+		else if (rgb_max == g) hue = 120.0f + 60.0f * (b - r) / (rgb_max - rgb_min);
+		else hue = 240.0f + 60.0f * (r - g) / (rgb_max - rgb_min);
 	}
 
-	// Efetua a etiquetagem
-	// (Para cada píxel...)
-	for (y = 1; y < height - 1; y++)
+	hsv[0] = (unsigned char)(hue / 360.0f * 255.0f);
+	hsv[1] = (unsigned char)(saturation * 255.0f);
+	hsv[2] = (unsigned char)(value);
+}
+
+/*
+* Função: vc_hsv_verificar
+* ----------------------------
+* Compara, para as 2^24 cores, a conversão e a segmentação só com inteiros com as antigas
+* (com floats): os bytes HSV e as máscaras do azul e do vermelho com os limites usados no
+* processamento. Devolve o número de cores com alguma diferença (0 = tudo igual) ou -1 se
+* não conseguiu alocar as imagens
+*/
+int vc_hsv_verificar(void)
+{
+	IVC* bgr, * hsv, * azul, * vermelho;
+	unsigned char referencia[3];
+	int r, g, b, pos, hue, saturation, value, mascaraAzul, mascaraVermelho, diferentes = 0;
+
+	// Uma imagem 256x256 para cada valor de vermelho (x = azul, y = verde)
+	bgr = vc_image_new(256, 256, 3, 255);
+	hsv = vc_image_new(256, 256, 3, 255);
+	azul = vc_image_new(256, 256, 1, 255);
+	vermelho = vc_image_new(256, 256, 1, 255);
+
+	if ((bgr == NULL) || (hsv == NULL) || (azul == NULL) || (vermelho == NULL)) diferentes = -1;
+
+	for (r = 0; (r < 256) && (diferentes >= 0); r++)
 	{
-		for (x = 1; x < width - 1; x++)
+		for (g = 0; g < 256; g++)
 		{
-			// Píxel a ser analisado X (Kernel:)
-			// Vizinhos A,B,C,D
-			// A | B | C 
-			// D | X | 
+			for (b = 0; b < 256; b++)
+			{
+				pos = g * bgr->bytesperline + b * 3;
+				bgr->data[pos] = (unsigned char)b;
+				bgr->data[pos + 1] = (unsigned char)g;
+				bgr->data[pos + 2] = (unsigned char)r;
+			}
+		}
 
-			A = (int)datadst[(y - 1) * bytesperline + (x - 1) * channels]; // A
-			B = (int)datadst[(y - 1) * bytesperline + x * channels]; // B
-			C = (int)datadst[(y - 1) * bytesperline + (x + 1) * channels]; // C
-			D = (int)datadst[y * bytesperline + (x - 1) * channels]; // D
-			posX = y * bytesperline + x * channels; // X
+		// Os mesmos limites que vc_processar_regiao
+		vc_bgr_to_hsv(bgr, hsv);
+		vc_hsv_segmentation(hsv, azul, 192, 289, 10, 100, 15, 100);
+		vc_hsv_red_segmentation(hsv, vermelho, 0, 34, 335, 360, 30, 100, 35, 100);
 
-			// Se o píxel a ser analisado for branco (encontramos parte de um blob)
-			if (datadst[posX] != 0)
-			{ // Se vizinhos A,B,C,D = 0
-				if ((A == 0) && (B == 0) && (C == 0) && (D == 0))
+		for (g = 0; g < 256; g++)
+		{
+			for (b = 0; b < 256; b++)
+			{
+				vc_hsv_referencia(b, g, r, referencia);
+
+				// Segmentação antiga: cada byte convertido para graus e percentagem com floats
+				hue = (int)((float)referencia[0] / 255.0f * 360.0f);
+				saturation = (int)((float)referencia[1] / 255.0f * 100.0f);
+				value = (int)((float)referencia[2] / 255.0f * 100.0f);
+				mascaraAzul = (hue >= 192 && hue <= 289 && saturation >= 10 && saturation <= 100 && value >= 15 && value <= 100) ? 255 : 0;
+				mascaraVermelho = (((hue >= 0 && hue <= 34) || (hue >= 335 && hue <= 360)) &&
+					saturation >= 30 && saturation <= 100 && value >= 35 && value <= 100) ? 255 : 0;
+
+				pos = g * hsv->bytesperline + b * 3;
+				if ((hsv->data[pos] != referencia[0]) || (hsv->data[pos + 1] != referencia[1]) || (hsv->data[pos + 2] != referencia[2]) ||
+					(azul->data[g * azul->bytesperline + b] != mascaraAzul) ||
+					(vermelho->data[g * vermelho->bytesperline + b] != mascaraVermelho))
 				{
-					datadst[posX] = label; // Encontrou um novo objeto (atribui-lhe nova etiqueta)
-					labeltable[label] = label; // Adiciona label à tabela das etiquetas
-					//label++; // Limitar aqui ???
-					if (label < 255) label++;
+					diferentes++;
 				}
-				else // píxel X = etiqueta de vizinho A,B,C,D com menor valor (não incluindo 0)
-				{
-					lowestLabel = 255; // Etiqueta de menor valor (inicialização)
+			}
+		}
+	}
 
-					// Se A está marcado
-					if (A != 0) lowestLabel = labeltable[A];
-					// Se B está marcado, e é menor que a etiqueta "lowestLabel"
-					if ((B != 0) && (labeltable[B] < lowestLabel)) lowestLabel = labeltable[B];
-					// Se C está marcado, e é menor que a etiqueta "lowestLabel"
-					if ((C != 0) && (labeltable[C] < lowestLabel)) lowestLabel = labeltable[C];
-					// Se D está marcado, e é menor que a etiqueta "lowestLabel"
-					if ((D != 0) && (labeltable[D] < lowestLabel)) lowestLabel = labeltable[D];
+	vc_image_free(bgr);
+	vc_image_free(hsv);
+	vc_image_free(azul);
+	vc_image_free(vermelho);
 
-					// Atribui a etiqueta ao píxel
-					datadst[posX] = lowestLabel;
-					labeltable[lowestLabel] = lowestLabel;
+	return diferentes;
+}
 
-					// Atualiza a tabela de etiquetas
-					if (A != 0) // Se o vizinho A está marcado
-					{
-						if (labeltable[A] != lowestLabel) // Se o vizinho tiver uma etiqueta diferente da do píxel atual (X)
-						{
-							tmplabel = labeltable[A];
-							for (a = 1; a < label; a++) // Percorre os píxeis já etiquetados na tabela das etiquetas
-							{ // Se esta etiqueta do vizinho A for encontrada
-								if (labeltable[a] == tmplabel)
-								{
-									labeltable[a] = lowestLabel; // Atualiza a etiqueta na tabela para o correto
-								}
-							}
-						}
-					}
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//        FUNÇÕES: MAPA DE OCUPAÇÃO DA MÁSCARA SEGMENTADA
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 
-					if (B != 0) // Se o vizinho B está marcado
-					{
-						if (labeltable[B] != lowestLabel)
-						{
-							tmplabel = labeltable[B];
-							for (a = 1; a < label; a++)
-							{
-								if (labeltable[a] == tmplabel)
-								{
-									labeltable[a] = lowestLabel;
-								}
-							}
-						}
-					}
+/*
+* Função: vc_ocupacao_novo
+* ----------------------------
+* Aloca o mapa de ocupação para máscaras até width x height
+*
+* width, height : dimensões da maior máscara a contar
+*/
+OCVC* vc_ocupacao_novo(int width, int height)
+{
+	OCVC* ocupacao;
 
-					if (C != 0) // Se o vizinho C está marcado
-					{
-						if (labeltable[C] != lowestLabel)
-						{
-							tmplabel = labeltable[C];
-							for (a = 1; a < label; a++)
-							{
-								if (labeltable[a] == tmplabel)
-								{
-									labeltable[a] = lowestLabel;
-								}
-							}
-						}
-					}
+	if ((width <= 0) || (height <= 0)) return NULL;
 
-					if (D != 0) // Se o vizinho D está marcado
-					{
-						if (labeltable[D] != lowestLabel)
-						{
-							tmplabel = labeltable[D];
-							for (a = 1; a < label; a++)
-							{
-								if (labeltable[a] == tmplabel)
-								{
-									labeltable[a] = lowestLabel;
-								}
-							}
-						}
-					}
+	ocupacao = (OCVC*)calloc(1, sizeof(OCVC));
+	if (ocupacao == NULL) return NULL;
 
-				}
-			}
-		}
-	}
+	ocupacao->maxBlocos = ((width + VC_BLOCO_OCUPACAO - 1) / VC_BLOCO_OCUPACAO) * ((height + VC_BLOCO_OCUPACAO - 1) / VC_BLOCO_OCUPACAO);
+	ocupacao->contagem = (int*)calloc(ocupacao->maxBlocos, sizeof(int));
+	ocupacao->janelas = (int(*)[4])malloc(ocupacao->maxBlocos * sizeof(int[4]));
 
-	// Volta a etiquetar a imagem
-	for (y = 1; y < height - 1; y++)
-	{
-		for (x = 1; x < width - 1; x++)
-		{
-			posX = y * bytesperline + x * channels; // X
+	if ((ocupacao->contagem == NULL) || (ocupacao->janelas == NULL)) return vc_ocupacao_libertar(ocupacao);
 
-			if (datadst[posX] != 0)
-			{ // Passa as etiquetas da tabela para os valores nos píxeis
-				datadst[posX] = labeltable[datadst[posX]];
-			}
-		}
-	}
+	return ocupacao;
+}
 
-	// Contagem do número de blobs
-	// Passo 1: Eliminar, da tabela, etiquetas repetidas
-	for (a = 1; a < label - 1; a++) // Para cada etiqueta
+/*
+* Função: vc_ocupacao_libertar
+* ----------------------------
+* Liberta o mapa de ocupação
+*
+* ocupacao : mapa de ocupação
+*/
+OCVC* vc_ocupacao_libertar(OCVC* ocupacao)
+{
+	if (ocupacao != NULL)
 	{
-		for (b = a + 1; b < label; b++) // Compara com todas as etiquetas à frente
-		{
-			if (labeltable[a] == labeltable[b]) labeltable[b] = 0;
-		}
+		free(ocupacao->contagem);
+		free(ocupacao->janelas);
+		free(ocupacao);
 	}
 
-	// Passo 2: Conta etiquetas e organiza a tabela de etiquetas, para que não hajam valores vazios (zero) entre etiquetas
-	*nlabels = 0;
-	for (a = 1; a < label; a++)
-	{
-		if (labeltable[a] != 0)
-		{ // Escreve por cima nos primeiros índices. No fim, os índices > que *nlabels são "lixo"
-			labeltable[*nlabels] = labeltable[a]; // Organiza tabela de etiquetas
-			(*nlabels)++; // Conta etiquetas
-		}
-	}
+	return NULL;
+}
 
-	// Se não há blobs
-	if (*nlabels == 0) return NULL;
+/*
+* Função: vc_ocupacao_preparar
+* ----------------------------
+* Prepara o mapa para uma máscara width x height (blocos a zero). Devolve 0 se não couber
+*
+* ocupacao      : mapa de ocupação
+* width, height : dimensões da máscara
+*/
+int vc_ocupacao_preparar(OCVC* ocupacao, int width, int height)
+{
+	ocupacao->blocosX = (width + VC_BLOCO_OCUPACAO - 1) / VC_BLOCO_OCUPACAO;
+	ocupacao->blocosY = (height + VC_BLOCO_OCUPACAO - 1) / VC_BLOCO_OCUPACAO;
+	ocupacao->nocupados = 0;
+	if (ocupacao->blocosX * ocupacao->blocosY > ocupacao->maxBlocos) return 0;
 
-	// Cria lista de blobs (objectos) e preenche a etiqueta
-	blobs = (OVC*)calloc((*nlabels), sizeof(OVC));
-	if (blobs != NULL)
-	{
-		for (a = 0; a < (*nlabels); a++) blobs[a].label = labeltable[a];
-	}
-	else return NULL;
+	memset(ocupacao->contagem, 0, ocupacao->blocosX * ocupacao->blocosY * sizeof(int));
 
-	return blobs;
+	return 1;
 }
 
 /*
-* Função: vc_encontrarMaiorBlob
+* Função: vc_ocupacao_fechar
 * ----------------------------
-* Encontra a blob com a maior área
+* Conta os blocos ocupados depois de a máscara ter sido contada
 *
-* src       : estrutura da imagem etiquetada
-* blobs	    : estrutura das blobs
-* nblobs    : número de objetos encontrados na imagem
-* maiorBlob : endereço de memória para guardar o index da maior blob na estrutura
+* ocupacao : mapa de ocupação
 */
-int vc_encontrarMaiorBlob(IVC* src, OVC* blobs, int nblobs, int* maiorBlob)
+void vc_ocupacao_fechar(OCVC* ocupacao)
 {
-	unsigned char* data = (unsigned char*)src->data;
-	int width = src->width;
-	int height = src->height;
-	int bytesperline = src->bytesperline;
-	int channels = src->channels;
-	int x, y, i, blobAreaMax = 0;
-	long int pos;
+	int b;
 
-	// Verificação de erros
-	if ((width <= 0) || (height <= 0) || (data == NULL)) return 0;
-	if ((blobs == NULL) || (nblobs <= 0)) return 0;
-	if (channels != 1) return 0;
+	for (b = 0; b < ocupacao->blocosX * ocupacao->blocosY; b++)
+	{
+		if (ocupacao->contagem[b] > 0) ocupacao->nocupados++;
+	}
+}
+
+/*
+* Função: vc_ocupacao_contar
+* ----------------------------
+* Preenche o mapa de ocupação de uma máscara já segmentada (píxeis != 0 em cada bloco)
+*
+* ocupacao : mapa de ocupação
+* mascara  : imagem binária (pode ser uma vista)
+*/
+int vc_ocupacao_contar(OCVC* ocupacao, IVC* mascara)
+{
+	unsigned char* data;
+	int* linha;
+	int x, y, xfim, bx, soma;
+
+	// Verificação de erros
+	if ((ocupacao == NULL) || (mascara == NULL) || (mascara->data == NULL)) return 0;
+	if ((mascara->width <= 0) || (mascara->height <= 0) || (mascara->channels != 1)) return 0;
+	if (!vc_ocupacao_preparar(ocupacao, mascara->width, mascara->height)) return 0;
+
+	for (y = 0; y < mascara->height; y++)
+	{
+		data = mascara->data + y * mascara->bytesperline;
+		linha = ocupacao->contagem + (y / VC_BLOCO_OCUPACAO) * ocupacao->blocosX;
+
+		for (x = 0, bx = 0; x < mascara->width; bx++)
+		{
+			xfim = MIN(x + VC_BLOCO_OCUPACAO, mascara->width);
+			for (soma = 0; x < xfim; x++) soma += (data[x] != 0);
+			linha[bx] += soma;
+		}
+	}
+
+	vc_ocupacao_fechar(ocupacao);
+
+	return 1;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//     FUNÇÕES: LIMITES DE COR E TABELA DE CLASSES DE COR
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+// Cabeçalho do ficheiro da tabela: "VCTC", versão e os limites com que foi construída
+#define VC_TABELA_CORES_CABECALHO (4 + sizeof(int) + 3 * sizeof(LVC))
+
+/*
+* Função: vc_limites_iniciar
+* ----------------------------
+* Preenche os limites de segmentação de cada cor com os valores usados até agora
+* (INDEFINIDA não tem nenhum píxel)
+*
+* limites : array de 3 limites (índice = Cor)
+*/
+void vc_limites_iniciar(LVC* limites)
+{
+	LVC vazio = { 1, 0, -1, -1, 1, 0, 1, 0 };
+	LVC azul = { 192, 289, -1, -1, 10, 100, 15, 100 };
+	LVC vermelho = { 0, 34, 335, 360, 30, 100, 35, 100 };
+
+	limites[INDEFINIDA] = vazio;
+	limites[AZUL] = azul;
+	limites[VERMELHO] = vermelho;
+}
+
+/*
+* Função: vc_hsv_segmentar_limites
+* ----------------------------
+* Segmenta uma imagem HSV com os limites de uma cor (um ou dois intervalos de tonalidade)
+*
+* src     : imagem HSV
+* dst     : imagem binária de saída
+* limites : limites da cor
+*/
+int vc_hsv_segmentar_limites(IVC* src, IVC* dst, const LVC* limites)
+{
+	const LVC* l = limites;
+
+	if (l == NULL) return 0;
+
+	if (l->hmax2 < 0) return vc_hsv_segmentation(src, dst, l->hmin1, l->hmax1, l->smin, l->smax, l->vmin, l->vmax);
+
+	return vc_hsv_red_segmentation(src, dst, l->hmin1, l->hmax1, l->hmin2, l->hmax2, l->smin, l->smax, l->vmin, l->vmax);
+}
+
+/*
+* Função: vc_tabela_cores_nova
+* ----------------------------
+* Aloca uma tabela de cores (ainda por construir) para os limites dados
+*
+* limites : array de 3 limites (índice = Cor)
+*/
+TCVC* vc_tabela_cores_nova(const LVC* limites)
+{
+	TCVC* tabela;
+
+	if (limites == NULL) return NULL;
+
+	tabela = (TCVC*)calloc(1, sizeof(TCVC));
+	if (tabela == NULL) return NULL;
+
+	// Consultada em posições aleatórias dos 16 MiB: é a que mais ganha com páginas grandes
+	tabela->classes = vc_dados_alocar(VC_TABELA_CORES_ENTRADAS);
+	if (tabela->classes == NULL)
+	{
+		free(tabela);
+		return NULL;
+	}
+	memcpy(tabela->limites, limites, 3 * sizeof(LVC));
+
+	return tabela;
+}
+
+/*
+* Função: vc_tabela_cores_construir
+* ----------------------------
+* Preenche as entradas com vermelho entre rinicio e rfim (exclusive) passando cada cor pelo
+* mesmo caminho que as frames (vc_bgr_to_hsv e segmentação), por isso a tabela dá exatamente
+* o mesmo resultado. Cada valor de vermelho é uma parte contínua de 2^16 entradas, por isso
+* partes diferentes podem ser construídas ao mesmo tempo (em threads diferentes)
+*
+* tabela         : tabela alocada com vc_tabela_cores_nova
+* rinicio, rfim  : valores de vermelho a preencher
+*/
+int vc_tabela_cores_construir(TCVC* tabela, int rinicio, int rfim)
+{
+	IVC* bgr, * hsv, * mascara;
+	unsigned char* classes;
+	int r, g, b, pos, cor, ok = 1;
+
+	// Verificação de erros (uma tabela mapeada de um ficheiro é só de leitura)
+	if ((tabela == NULL) || (tabela->classes == NULL) || (tabela->mapa != NULL)) return 0;
+	if ((rinicio < 0) || (rfim > 256) || (rinicio > rfim)) return 0;
+
+	// Uma imagem 256x256 para cada valor de vermelho (x = azul, y = verde)
+	bgr = vc_image_new(256, 256, 3, 255);
+	hsv = vc_image_new(256, 256, 3, 255);
+	mascara = vc_image_new(256, 256, 1, 255);
+
+	if ((bgr == NULL) || (hsv == NULL) || (mascara == NULL)) ok = 0;
+
+	for (r = rinicio; (r < rfim) && ok; r++)
+	{
+		classes = tabela->classes + ((long)r << 16);
+		memset(classes, 0, 1 << 16);
+
+		for (g = 0; g < 256; g++)
+		{
+			for (b = 0; b < 256; b++)
+			{
+				pos = g * bgr->bytesperline + b * 3;
+				bgr->data[pos] = (unsigned char)b;
+				bgr->data[pos + 1] = (unsigned char)g;
+				bgr->data[pos + 2] = (unsigned char)r;
+			}
+		}
+
+		vc_bgr_to_hsv(bgr, hsv);
+
+		for (cor = AZUL; cor <= VERMELHO; cor++)
+		{
+			vc_hsv_segmentar_limites(hsv, mascara, &tabela->limites[cor]);
+
+			for (g = 0; g < 256; g++)
+			{
+				for (b = 0; b < 256; b++)
+				{
+					if (mascara->data[g * mascara->bytesperline + b]) classes[(g << 8) | b] |= (unsigned char)(1 << cor);
+				}
+			}
+		}
+	}
+
+	vc_image_free(bgr);
+	vc_image_free(hsv);
+	vc_image_free(mascara);
+
+	return ok;
+}
+
+/*
+* Função: vc_mapear_ficheiro
+* ----------------------------
+* Mapeia um ficheiro inteiro em memória, só para leitura (NULL se não existir)
+*
+* ficheiro : nome do ficheiro
+* tamanho  : devolve o tamanho do ficheiro
+*/
+static void* vc_mapear_ficheiro(const char* ficheiro, long* tamanho)
+{
+	void* mapa = NULL;
+#ifdef _WIN32
+	HANDLE handleFicheiro, handleMapa;
+	LARGE_INTEGER tamanhoFicheiro;
+
+	handleFicheiro = CreateFileA(ficheiro, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (handleFicheiro == INVALID_HANDLE_VALUE) return NULL;
+
+	if (GetFileSizeEx(handleFicheiro, &tamanhoFicheiro) && (tamanhoFicheiro.QuadPart > 0) && (tamanhoFicheiro.QuadPart < 0x7fffffff))
+	{
+		// A vista mantém o mapeamento aberto depois de fechar os handles
+		handleMapa = CreateFileMappingA(handleFicheiro, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (handleMapa != NULL)
+		{
+			mapa = MapViewOfFile(handleMapa, FILE_MAP_READ, 0, 0, 0);
+			CloseHandle(handleMapa);
+			*tamanho = (long)tamanhoFicheiro.QuadPart;
+		}
+	}
+	CloseHandle(handleFicheiro);
+#else
+	struct stat estado;
+	int descritor = open(ficheiro, O_RDONLY);
+
+	if (descritor < 0) return NULL;
+
+	if ((fstat(descritor, &estado) == 0) && (estado.st_size > 0) && (estado.st_size < 0x7fffffff))
+	{
+		mapa = mmap(NULL, (size_t)estado.st_size, PROT_READ, MAP_SHARED, descritor, 0);
+		if (mapa == MAP_FAILED) mapa = NULL;
+		*tamanho = (long)estado.st_size;
+	}
+	close(descritor);
+#endif
+
+	return mapa;
+}
+
+/*
+* Função: vc_desmapear_ficheiro
+* ----------------------------
+* Desfaz o mapeamento de vc_mapear_ficheiro
+*/
+static void vc_desmapear_ficheiro(void* mapa, long tamanho)
+{
+#ifdef _WIN32
+	(void)tamanho;
+	UnmapViewOfFile(mapa);
+#else
+	munmap(mapa, (size_t)tamanho);
+#endif
+}
+
+/*
+* Função: vc_tabela_cores_carregar
+* ----------------------------
+* Mapeia em memória uma tabela guardada com vc_tabela_cores_guardar (não é lida: as páginas
+* são carregadas do ficheiro, ou da cache do sistema, à medida que são consultadas).
+* Devolve NULL se o ficheiro não existir, estiver incompleto ou tiver outros limites
+*
+* ficheiro : nome do ficheiro
+* limites  : limites que a tabela tem de ter (array de 3, índice = Cor)
+*/
+TCVC* vc_tabela_cores_carregar(const char* ficheiro, const LVC* limites)
+{
+	TCVC* tabela;
+	unsigned char* mapa;
+	long tamanho = 0;
+	int versao;
+
+	if ((ficheiro == NULL) || (limites == NULL)) return NULL;
+
+	mapa = (unsigned char*)vc_mapear_ficheiro(ficheiro, &tamanho);
+	if (mapa == NULL) return NULL;
+
+	memcpy(&versao, mapa + 4, sizeof(int));
+	if ((tamanho != (long)(VC_TABELA_CORES_CABECALHO + VC_TABELA_CORES_ENTRADAS)) || (memcmp(mapa, "VCTC", 4) != 0) || (versao != 1) ||
+		(memcmp(mapa + 4 + sizeof(int), limites, 3 * sizeof(LVC)) != 0) ||
+		((tabela = (TCVC*)calloc(1, sizeof(TCVC))) == NULL))
+	{
+		vc_desmapear_ficheiro(mapa, tamanho);
+		return NULL;
+	}
+
+	memcpy(tabela->limites, limites, 3 * sizeof(LVC));
+	tabela->classes = mapa + VC_TABELA_CORES_CABECALHO;
+	tabela->mapa = mapa;
+	tabela->tamanhoMapa = tamanho;
+
+	return tabela;
+}
+
+/*
+* Função: vc_tabela_cores_guardar
+* ----------------------------
+* Guarda a tabela (cabeçalho com os limites + 2^24 bytes) para ser mapeada nos arranques seguintes
+*
+* tabela   : tabela construída
+* ficheiro : nome do ficheiro
+*/
+int vc_tabela_cores_guardar(TCVC* tabela, const char* ficheiro)
+{
+	FILE* file;
+	int versao = 1, ok;
+
+	if ((tabela == NULL) || (tabela->classes == NULL) || (ficheiro == NULL)) return 0;
+
+	if ((file = fopen(ficheiro, "wb")) == NULL) return 0;
+
+	ok = (fwrite("VCTC", 1, 4, file) == 4) && (fwrite(&versao, sizeof(int), 1, file) == 1) &&
+		(fwrite(tabela->limites, sizeof(LVC), 3, file) == 3) &&
+		(fwrite(tabela->classes, 1, VC_TABELA_CORES_ENTRADAS, file) == VC_TABELA_CORES_ENTRADAS);
+
+	if (fclose(file) != 0) ok = 0;
+	// Um ficheiro incompleto seria recusado ao carregar, mas não vale a pena deixá-lo
+	if (!ok) remove(ficheiro);
+
+	return ok;
+}
+
+/*
+* Função: vc_tabela_cores_libertar
+* ----------------------------
+* Liberta a tabela (ou desfaz o mapeamento do ficheiro)
+*
+* tabela : tabela de cores
+*/
+TCVC* vc_tabela_cores_libertar(TCVC* tabela)
+{
+	if (tabela != NULL)
+	{
+		if (tabela->mapa != NULL) vc_desmapear_ficheiro(tabela->mapa, tabela->tamanhoMapa);
+		else vc_dados_libertar(tabela->classes);
+		free(tabela);
+	}
+
+	return NULL;
+}
+
+/*
+* Função: vc_tabela_cores_atual
+* ----------------------------
+* Indica se a tabela foi construída com os limites dados
+*
+* tabela  : tabela de cores
+* limites : array de 3 limites (índice = Cor)
+*/
+int vc_tabela_cores_atual(TCVC* tabela, const LVC* limites)
+{
+	if ((tabela == NULL) || (limites == NULL)) return 0;
+
+	return memcmp(tabela->limites, limites, 3 * sizeof(LVC)) == 0;
+}
+
+/*
+* Função: vc_tabela_cores_segmentar
+* ----------------------------
+* Segmenta uma imagem BGR consultando a classe de cada píxel na tabela
+* (o mesmo que vc_bgr_to_hsv seguido da segmentação com os limites da cor)
+*
+* tabela   : tabela de cores
+* src      : imagem BGR (pode ser uma vista)
+* dst      : imagem binária de saída com as mesmas dimensões
+* cor      : cor a segmentar
+* ocupacao : (opcional) fica com os píxeis da cor em cada bloco de dst, contados na mesma passagem
+*/
+int vc_tabela_cores_segmentar(TCVC* tabela, IVC* src, IVC* dst, Cor cor, OCVC* ocupacao)
+{
+	// Verificação de erros
+	if ((tabela == NULL) || (tabela->classes == NULL)) return 0;
+	if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL) || (dst->data == NULL)) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height)) return 0;
+	if ((src->channels != 3) || (dst->channels != 1)) return 0;
+	if ((cor < INDEFINIDA) || (cor > VERMELHO)) return 0;
+	if ((ocupacao != NULL) && !vc_ocupacao_preparar(ocupacao, src->width, src->height)) return 0;
+
+	vc_nucleo_tabela_cores_segmentar(tabela->classes, src, dst, cor, ocupacao);
+
+	if (ocupacao != NULL) vc_ocupacao_fechar(ocupacao);
+
+	return 1;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//          FUNÇÕES: SEGMENTAÇÃO POR CROMINÂNCIA
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+// Bins por eixo do histograma da calibração (cada bin = 4 valores)
+#define VC_CROMA_BINS 64
+
+/*
+* Função: vc_croma_coordenadas
+* ----------------------------
+* Coordenadas de uma cor no espaço (de 0 a 255; só para a calibração)
+*
+* espaco      : VC_CROMA_*
+* b, g, r     : canais da cor
+* coordenadas : 3 valores
+*/
+static void vc_croma_coordenadas(int espaco, int b, int g, int r, int* coordenadas)
+{
+	int soma = r + g + b;
+
+	if (espaco == VC_CROMA_RG)
+	{
+		coordenadas[0] = soma / 3;
+		coordenadas[1] = (soma > 0) ? 255 * r / soma : 0;
+		coordenadas[2] = (soma > 0) ? 255 * g / soma : 0;
+	}
+	else
+	{
+		coordenadas[0] = (77 * r + 150 * g + 29 * b) >> 8;
+		coordenadas[1] = (128 * b - 43 * r - 85 * g + 32768) >> 8;
+		coordenadas[2] = (128 * r - 107 * g - 21 * b + 32768) >> 8;
+	}
+}
+
+/*
+* Função: vc_croma_segmentar
+* ----------------------------
+* Segmenta uma imagem BGR com uma caixa de crominância (os testes de cada píxel são juntos
+* com &, sem saltos). O mapa de ocupação é contado na mesma passagem
+*
+* caixa     : caixa calibrada com vc_croma_calibrar
+* src       : imagem BGR (pode ser uma vista)
+* dst       : imagem binária de saída
+* ocupacao  : (opcional) mapa de ocupação de dst
+*/
+int vc_croma_segmentar(const CXVC* caixa, IVC* src, IVC* dst, OCVC* ocupacao)
+{
+	// Verificação de erros
+	if (caixa == NULL) return 0;
+	if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL) || (dst->data == NULL)) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height)) return 0;
+	if ((src->channels != 3) || (dst->channels != 1)) return 0;
+	if ((ocupacao != NULL) && !vc_ocupacao_preparar(ocupacao, src->width, src->height)) return 0;
+
+	vc_nucleo_croma_segmentar(caixa, src, dst, ocupacao);
+
+	if (ocupacao != NULL) vc_ocupacao_fechar(ocupacao);
+
+	return 1;
+}
+
+/*
+* Função: vc_croma_contar
+* ----------------------------
+* Número de cores de um histograma acumulado (VC_CROMA_BINS + 1 por eixo, com um 0 à
+* frente) dentro da caixa [a, b] de bins (inclusive)
+*/
+static long vc_croma_contar(const long* acumulado, const int* a, const int* b)
+{
+	const int n = VC_CROMA_BINS + 1;
+	long soma;
+
+	if ((a[0] > b[0]) || (a[1] > b[1]) || (a[2] > b[2])) return 0;
+
+#define VC_ACUMULADO(i, j, k) acumulado[((long)(i) * n + (j)) * n + (k)]
+	soma = VC_ACUMULADO(b[0] + 1, b[1] + 1, b[2] + 1)
+		- VC_ACUMULADO(a[0], b[1] + 1, b[2] + 1) - VC_ACUMULADO(b[0] + 1, a[1], b[2] + 1) - VC_ACUMULADO(b[0] + 1, b[1] + 1, a[2])
+		+ VC_ACUMULADO(a[0], a[1], b[2] + 1) + VC_ACUMULADO(a[0], b[1] + 1, a[2]) + VC_ACUMULADO(b[0] + 1, a[1], a[2])
+		- VC_ACUMULADO(a[0], a[1], a[2]);
+#undef VC_ACUMULADO
+
+	return soma;
+}
+
+/*
+* Função: vc_croma_calibrar
+* ----------------------------
+* Procura a caixa do espaço dado que mais se aproxima da segmentação HSV com os limites dados.
+* As 2^24 cores passam pelo mesmo caminho que as frames (vc_bgr_to_hsv e segmentação) e são
+* contadas num histograma 3D do espaço (64 bins por eixo), com e sem a cor. Com o histograma
+* acumulado, os erros de uma caixa contam-se em tempo constante: a caixa começa por envolver
+* todas as cores com a cor e cada limite é depois movido para a posição com menos erros, até
+* nenhum mudar. No fim, as 2^24 cores são segmentadas com a caixa para contar as diferenças
+*
+* limites          : limites HSV da cor
+* espaco           : VC_CROMA_*
+* caixa            : caixa calibrada
+* falsosPositivos  : (opcional) cores dentro da caixa que a segmentação HSV não aceita
+* falsosNegativos  : (opcional) cores aceites pela segmentação HSV que ficam fora da caixa
+*/
+int vc_croma_calibrar(const LVC* limites, int espaco, CXVC* caixa, long* falsosPositivos, long* falsosNegativos)
+{
+	const int n = VC_CROMA_BINS + 1;
+	IVC* bgr, * hsv, * mascara, * mascaraCroma;
+	long* acumulado[2]; // 0 = cores sem a cor, 1 = com a cor
+	const long cortes[] = { 0, 10, 20, 50, 100, 200 }; // Cores com a cor deixadas fora de cada ponta, em milésimas
+	long total[2] = { 0, 0 }, erros, valorErros, melhorErros = 0, positivos, negativos;
+	long* h;
+	int a[3], b[3], melhorA[3], melhorB[3], coordenadas[3], melhor, melhorCaixa, inicio, valor, mudou, voltas;
+	int r, g, bl, pos, i, j, k, e, lado, ok = 1;
+
+	// Verificação de erros
+	if ((limites == NULL) || (caixa == NULL)) return 0;
+	if ((espaco != VC_CROMA_YCBCR) && (espaco != VC_CROMA_RG)) return 0;
+
+	bgr = vc_image_new(256, 256, 3, 255);
+	hsv = vc_image_new(256, 256, 3, 255);
+	mascara = vc_image_new(256, 256, 1, 255);
+	mascaraCroma = vc_image_new(256, 256, 1, 255);
+	acumulado[0] = (long*)calloc((size_t)n * n * n, sizeof(long));
+	acumulado[1] = (long*)calloc((size_t)n * n * n, sizeof(long));
+
+	if ((bgr == NULL) || (hsv == NULL) || (mascara == NULL) || (mascaraCroma == NULL) || (acumulado[0] == NULL) || (acumulado[1] == NULL)) ok = 0;
+
+	// Histograma (nas posições [i + 1][j + 1][k + 1], para acumular a seguir)
+	for (r = 0; (r < 256) && ok; r++)
+	{
+		for (g = 0; g < 256; g++)
+		{
+			for (bl = 0; bl < 256; bl++)
+			{
+				pos = g * bgr->bytesperline + bl * 3;
+				bgr->data[pos] = (unsigned char)bl;
+				bgr->data[pos + 1] = (unsigned char)g;
+				bgr->data[pos + 2] = (unsigned char)r;
+			}
+		}
+
+		vc_bgr_to_hsv(bgr, hsv);
+		vc_hsv_segmentar_limites(hsv, mascara, limites);
+
+		for (g = 0; g < 256; g++)
+		{
+			for (bl = 0; bl < 256; bl++)
+			{
+				vc_croma_coordenadas(espaco, bl, g, r, coordenadas);
+				e = mascara->data[g * mascara->bytesperline + bl] ? 1 : 0;
+				acumulado[e][((long)(coordenadas[0] / 4 + 1) * n + coordenadas[1] / 4 + 1) * n + coordenadas[2] / 4 + 1]++;
+				total[e]++;
+			}
+		}
+	}
+
+	if (ok)
+	{
+		// Somas acumuladas nos 3 eixos
+		for (e = 0; e < 2; e++)
+		{
+			h = acumulado[e];
+			for (i = 1; i < n; i++) for (j = 0; j < n; j++) for (k = 0; k < n; k++) h[((long)i * n + j) * n + k] += h[((long)(i - 1) * n + j) * n + k];
+			for (i = 0; i < n; i++) for (j = 1; j < n; j++) for (k = 0; k < n; k++) h[((long)i * n + j) * n + k] += h[((long)i * n + j - 1) * n + k];
+			for (i = 0; i < n; i++) for (j = 0; j < n; j++) for (k = 1; k < n; k++) h[((long)i * n + j) * n + k] += h[((long)i * n + j) * n + k - 1];
+		}
+
+		// A descida só encontra um mínimo local (no rg, a caixa que envolve todas as cores com a cor
+		// tem mais cores sem a cor e encolhe até ficar vazia): começa em várias caixas, cada uma sem
+		// uma percentagem das cores com a cor em cada ponta de cada eixo, e fica a melhor
+		melhorCaixa = -1;
+		for (inicio = 0; (inicio < (int)(sizeof(cortes) / sizeof(cortes[0]))) && (total[1] > 0); inicio++)
+		{
+			for (e = 0; e < 3; e++)
+			{
+				int c0[3] = { 0, 0, 0 }, c1[3] = { VC_CROMA_BINS - 1, VC_CROMA_BINS - 1, VC_CROMA_BINS - 1 };
+
+				// Menor a[e] com mais do que o corte abaixo e maior b[e] com mais do que o corte acima
+				for (c1[e] = 0; (c1[e] < VC_CROMA_BINS - 1) && (vc_croma_contar(acumulado[1], c0, c1) <= total[1] * cortes[inicio] / 1000); c1[e]++);
+				a[e] = c1[e];
+				c1[e] = VC_CROMA_BINS - 1;
+				for (c0[e] = VC_CROMA_BINS - 1; (c0[e] > a[e]) && (vc_croma_contar(acumulado[1], c0, c1) <= total[1] * cortes[inicio] / 1000); c0[e]--);
+				b[e] = c0[e];
+			}
+
+			// Cada limite vai para a posição com menos erros (falsos negativos + falsos positivos), até nenhum mudar
+			erros = total[1] - vc_croma_contar(acumulado[1], a, b) + vc_croma_contar(acumulado[0], a, b);
+			for (voltas = 0, mudou = 1; mudou && (voltas < 100); voltas++)
+			{
+				mudou = 0;
+				for (e = 0; e < 3; e++)
+				{
+					for (lado = 0; lado < 2; lado++)
+					{
+						int* limite = lado ? &b[e] : &a[e];
+
+						melhor = *limite;
+						for (valor = 0; valor < VC_CROMA_BINS; valor++)
+						{
+							*limite = valor;
+							if (a[e] > b[e]) continue;
+							valorErros = total[1] - vc_croma_contar(acumulado[1], a, b) + vc_croma_contar(acumulado[0], a, b);
+							if (valorErros < erros)
+							{
+								erros = valorErros;
+								melhor = valor;
+								mudou = 1;
+							}
+						}
+						*limite = melhor;
+					}
+				}
+			}
+
+			if ((melhorCaixa < 0) || (erros < melhorErros))
+			{
+				melhorCaixa = inicio;
+				melhorErros = erros;
+				memcpy(melhorA, a, sizeof(a));
+				memcpy(melhorB, b, sizeof(b));
+			}
+		}
+
+		// Sem cores com a cor, a caixa fica vazia
+		if (melhorCaixa < 0)
+		{
+			for (e = 0; e < 3; e++)
+			{
+				melhorA[e] = VC_CROMA_BINS - 1;
+				melhorB[e] = 0;
+			}
+		}
+		memcpy(a, melhorA, sizeof(a));
+		memcpy(b, melhorB, sizeof(b));
+
+		caixa->espaco = espaco;
+		for (e = 0; e < 3; e++)
+		{
+			caixa->minimo[e] = a[e] * 4;
+			caixa->maximo[e] = b[e] * 4 + 3;
+		}
+		caixa->limites = *limites;
+
+		// Diferenças exatas, com a segmentação que as frames vão usar
+		positivos = negativos = 0;
+		for (r = 0; r < 256; r++)
+		{
+			for (g = 0; g < 256; g++)
+			{
+				for (bl = 0; bl < 256; bl++)
+				{
+					pos = g * bgr->bytesperline + bl * 3;
+					bgr->data[pos] = (unsigned char)bl;
+					bgr->data[pos + 1] = (unsigned char)g;
+					bgr->data[pos + 2] = (unsigned char)r;
+				}
+			}
+
+			vc_bgr_to_hsv(bgr, hsv);
+			vc_hsv_segmentar_limites(hsv, mascara, limites);
+			vc_croma_segmentar(caixa, bgr, mascaraCroma, NULL);
+
+			for (i = 0; i < 256 * 256; i++)
+			{
+				if (mascaraCroma->data[i] && !mascara->data[i]) positivos++;
+				else if (!mascaraCroma->data[i] && mascara->data[i]) negativos++;
+			}
+		}
+
+		if (falsosPositivos != NULL) *falsosPositivos = positivos;
+		if (falsosNegativos != NULL) *falsosNegativos = negativos;
+	}
+
+	vc_image_free(bgr);
+	vc_image_free(hsv);
+	vc_image_free(mascara);
+	vc_image_free(mascaraCroma);
+	free(acumulado[0]);
+	free(acumulado[1]);
+
+	return ok;
+}
+
+/*
+* Função: vc_croma_atual
+* ----------------------------
+* Indica se a caixa foi calibrada com os limites dados
+*
+* caixa   : caixa de crominância
+* limites : limites HSV da cor
+*/
+int vc_croma_atual(const CXVC* caixa, const LVC* limites)
+{
+	if ((caixa == NULL) || (limites == NULL)) return 0;
+
+	return memcmp(&caixa->limites, limites, sizeof(LVC)) == 0;
+}
+
+// Contribuição de um quad de 2x2 píxeis (A B / D X) para 4 x a característica de Euler dos objetos
+// com vizinhança 8 (Gray): +1 com um píxel de objeto, -1 com três e -2 com dois na diagonal
+static int vc_quad_euler(int A, int B, int D, int X)
+{
+	int n = (A != 0) + (B != 0) + (D != 0) + (X != 0);
+
+	if (n == 1) return 1;
+	if (n == 3) return -1;
+	if ((n == 2) && ((A != 0) == (X != 0)) && ((B != 0) == (D != 0)) && ((A != 0) != (B != 0))) return -2;
+
+	return 0;
+}
+
+/*
+* Função: vc_binary_blob_labelling
+* ----------------------------
+* Faz o etiquetamento de uma imagem segmentada
+*
+* src      : estrutura da imagem de origem
+* dst	   : estrutura da imagem de saida
+* nlabels  : número de objetos encontrados na imagem
+*/
+OVC* vc_binary_blob_labelling(IVC* src, IVC* dst, int* nlabels)
+{
+	// Sem restrições: devolve todos os objetos
+	return vc_binary_blob_labelling_filtrado(src, dst, nlabels, 0, 0, 0, NULL);
+}
+
+/*
+* Função: vc_binary_blob_labelling_filtrado
+* ----------------------------
+* Faz o etiquetamento de uma imagem segmentada, eliminando os objetos que não cumprem
+* as dimensões mínimas. A área, a caixa delimitadora e o centro de massa de cada
+* etiqueta são acumulados durante a etiquetagem; assim que as etiquetas equivalentes
+* estão resolvidas, os objetos pequenos passam a fundo (0) na imagem de saída e não
+* aparecem no array devolvido. Os blobs devolvidos já têm área, caixa, centro de massa,
+* perímetro (a mesma medida de vc_maiorBlob_info) e número de buracos (pela característica de
+* Euler, contada em quads de 2x2 píxeis), por isso os contornos interiores não precisam de ser seguidos.
+* Se for pedido, acumula também os momentos "crus" até à ordem 3 (na mesma passagem)
+*
+* src           : estrutura da imagem de origem
+* dst	        : estrutura da imagem de saida
+* nlabels       : número de objetos que cumprem as restrições
+* areaMinima    : área mínima de um objeto (0 = sem restrição)
+* larguraMinima : largura mínima da caixa delimitadora (0 = sem restrição)
+* alturaMinima  : altura mínima da caixa delimitadora (0 = sem restrição)
+* momentos      : (opcional) endereço onde devolver o array dos momentos, paralelo aos blobs
+*                 (coordenadas de src; libertar com free)
+*/
+OVC* vc_binary_blob_labelling_filtrado(IVC* src, IVC* dst, int* nlabels, int areaMinima, int larguraMinima, int alturaMinima,
+	MVC** momentos)
+{
+	unsigned char* datasrc = (unsigned char*)src->data;
+	unsigned char* datadst = (unsigned char*)dst->data;
+	int width = src->width;
+	int height = src->height;
+	int bytesperline = dst->bytesperline; // Todos os acessos, depois da cópia, são feitos em dst
+	int channels = src->channels;
+	int x, y, a, b; // a e b são variáveis auxiliares para percorrer tabela das etiquetas
+	long int i; // i = variável auxiliar para percorrer imagem original, etc.
+	// long int posX, posA, posB, posC, posD;
+	long int posX;
+	int A, B, C, D;
+	int labeltable[256] = { 0 }; // { 0 } inicializa todas as posições do array a 0
+	int label = 1; // Etiqueta inicial.
+	int lowestLabel, tmplabel; // lowestLabel = var auxiliar para etiqueta
+	// tmplabel = var auxiliar para percorrer tabela de etiquetas (para ser mais fácil de ler: usa um nome diferente)
+	OVC* blobs; // Apontador para array de blobs (objectos) que será retornado desta função.
+	// Medidas acumuladas por etiqueta (primeiro por etiqueta provisória, depois por etiqueta final)
+	int area[256] = { 0 }, xmin[256], ymin[256], xmax[256], ymax[256];
+	long int sumx[256] = { 0 }, sumy[256] = { 0 };
+	int perimetro[256] = { 0 }, euler[256] = { 0 }; // euler = 4 x característica de Euler (1 - buracos)
+	int remap[256] = { 0 }; // Etiqueta final de cada etiqueta provisória (0 = objeto eliminado)
+	int f; // Etiqueta final
+	// Momentos "crus" por etiqueta: m20, m11, m02, m30, m21, m12, m03 (m00, m10 e m01 são area, sumx e sumy)
+	double mom[256][7];
+	double x2, y2;
+	MVC* m;
+
+	// Verificação de erros
+	if ((width <= 0) || (height <= 0) || (datasrc == NULL) || (datadst == NULL)) return 0;
+	if ((width != dst->width) || (height != dst->height) || (channels != dst->channels)) return NULL;
+	if (channels != 1) return NULL;
+
+	*nlabels = 0;
+	if (momentos != NULL)
+	{
+		*momentos = NULL;
+		memset(mom, 0, sizeof(mom));
+	}
+	for (a = 0; a < 256; a++)
+	{
+		xmin[a] = width;
+		ymin[a] = height;
+		xmax[a] = -1;
+		ymax[a] = -1;
+	}
+
+	// Copia dados da imagem binária para imagem grayscale
+	// (linha a linha, porque src e dst podem ser vistas com bytesperline diferentes)
+	for (y = 0; y < height; y++)
+	{
+		memcpy(datadst + y * bytesperline, datasrc + y * src->bytesperline, width * channels);
+	}
+
+	// Todos os pixéis de plano de fundo devem obrigatóriamente ter valor 0
+	// Todos os pixéis de primeiro plano devem obrigatóriamente ter valor 255
+	// Serão atribuídas etiquetas no intervalo [1,254]
+	// Este algoritmo está assim limitado a 255 labels
+	for (y = 0; y < height; y++)
+	{
+		for (x = 0; x < width; x++)
+		{ // para dar se tivermos píxeis com valores iguais a: 0 ou 1 || 0 ou 255
+			i = y * bytesperline + x * channels;
+			if (datadst[i] != 0) datadst[i] = 255;
+		}
+	}
+
+	// Limpa os rebordos da imagem binária
+	// (porque não há objetos só com 1 píxel)
+	for (y = 0; y < height; y++) // Limpa rebordos verticais 
+	{
+		datadst[y * bytesperline + 0 * channels] = 0; // Limpa rebordo vertical esquerdo
+		datadst[y * bytesperline + (width - 1) * channels] = 0; // Limpa rebordo vertical direito
+	}
+	for (x = 0; x < width; x++) // Limpa rebordos horizontais
+	{
+		datadst[0 * bytesperline + x * channels] = 0; // Limpa rebordo horizontal superior
+		datadst[(height - 1) * bytesperline + x * channels] = 0; // Limpa rebordo horizontal inferior
+	}
+
+	// Efetua a etiquetagem
+	// (Para cada píxel...)
+	for (y = 1; y < height - 1; y++)
+	{
+		for (x = 1; x < width - 1; x++)
+		{
+			// Píxel a ser analisado X (Kernel:)
+			// Vizinhos A,B,C,D
+			// A | B | C 
+			// D | X | 
+
+			A = (int)datadst[(y - 1) * bytesperline + (x - 1) * channels]; // A
+			B = (int)datadst[(y - 1) * bytesperline + x * channels]; // B
+			C = (int)datadst[(y - 1) * bytesperline + (x + 1) * channels]; // C
+			D = (int)datadst[y * bytesperline + (x - 1) * channels]; // D
+			posX = y * bytesperline + x * channels; // X
+
+			// Se o píxel a ser analisado for branco (encontramos parte de um blob)
+			if (datadst[posX] != 0)
+			{ // Se vizinhos A,B,C,D = 0
+				if ((A == 0) && (B == 0) && (C == 0) && (D == 0))
+				{
+					datadst[posX] = label; // Encontrou um novo objeto (atribui-lhe nova etiqueta)
+					labeltable[label] = label; // Adiciona label à tabela das etiquetas
+					//label++; // Limitar aqui ???
+					if (label < 255) label++;
+				}
+				else // píxel X = etiqueta de vizinho A,B,C,D com menor valor (não incluindo 0)
+				{
+					lowestLabel = 255; // Etiqueta de menor valor (inicialização)
+
+					// Se A está marcado
+					if (A != 0) lowestLabel = labeltable[A];
+					// Se B está marcado, e é menor que a etiqueta "lowestLabel"
+					if ((B != 0) && (labeltable[B] < lowestLabel)) lowestLabel = labeltable[B];
+					// Se C está marcado, e é menor que a etiqueta "lowestLabel"
+					if ((C != 0) && (labeltable[C] < lowestLabel)) lowestLabel = labeltable[C];
+					// Se D está marcado, e é menor que a etiqueta "lowestLabel"
+					if ((D != 0) && (labeltable[D] < lowestLabel)) lowestLabel = labeltable[D];
+
+					// Atribui a etiqueta ao píxel
+					datadst[posX] = lowestLabel;
+					labeltable[lowestLabel] = lowestLabel;
+
+					// Atualiza a tabela de etiquetas
+					if (A != 0) // Se o vizinho A está marcado
+					{
+						if (labeltable[A] != lowestLabel) // Se o vizinho tiver uma etiqueta diferente da do píxel atual (X)
+						{
+							tmplabel = labeltable[A];
+							for (a = 1; a < label; a++) // Percorre os píxeis já etiquetados na tabela das etiquetas
+							{ // Se esta etiqueta do vizinho A for encontrada
+								if (labeltable[a] == tmplabel)
+								{
+									labeltable[a] = lowestLabel; // Atualiza a etiqueta na tabela para o correto
+								}
+							}
+						}
+					}
+
+					if (B != 0) // Se o vizinho B está marcado
+					{
+						if (labeltable[B] != lowestLabel)
+						{
+							tmplabel = labeltable[B];
+							for (a = 1; a < label; a++)
+							{
+								if (labeltable[a] == tmplabel)
+								{
+									labeltable[a] = lowestLabel;
+								}
+							}
+						}
+					}
+
+					if (C != 0) // Se o vizinho C está marcado
+					{
+						if (labeltable[C] != lowestLabel)
+						{
+							tmplabel = labeltable[C];
+							for (a = 1; a < label; a++)
+							{
+								if (labeltable[a] == tmplabel)
+								{
+									labeltable[a] = lowestLabel;
+								}
+							}
+						}
+					}
+
+					if (D != 0) // Se o vizinho D está marcado
+					{
+						if (labeltable[D] != lowestLabel)
+						{
+							tmplabel = labeltable[D];
+							for (a = 1; a < label; a++)
+							{
+								if (labeltable[a] == tmplabel)
+								{
+									labeltable[a] = lowestLabel;
+								}
+							}
+						}
+					}
+
+				}
+
+				// Acumula as medidas na etiqueta provisória atribuída ao píxel
+				// (à direita e em baixo ainda está a imagem binária: 0 = fundo)
+				tmplabel = datadst[posX];
+				area[tmplabel]++;
+				if ((B == 0) || (D == 0) || (datadst[posX + channels] == 0) || (datadst[posX + bytesperline] == 0)) perimetro[tmplabel]++;
+				sumx[tmplabel] += x;
+				sumy[tmplabel] += y;
+				if (x < xmin[tmplabel]) xmin[tmplabel] = x;
+				if (y < ymin[tmplabel]) ymin[tmplabel] = y;
+				if (x > xmax[tmplabel]) xmax[tmplabel] = x;
+				if (y > ymax[tmplabel]) ymax[tmplabel] = y;
+
+				if (momentos != NULL)
+				{
+					x2 = (double)x * x;
+					y2 = (double)y * y;
+					mom[tmplabel][0] += x2;
+					mom[tmplabel][1] += (double)x * y;
+					mom[tmplabel][2] += y2;
+					mom[tmplabel][3] += x2 * x;
+					mom[tmplabel][4] += x2 * y;
+					mom[tmplabel][5] += x * y2;
+					mom[tmplabel][6] += y2 * y;
+				}
+			}
+
+			// Quad A B / D X: os píxeis de objeto de um quad são vizinhos entre si, por isso é de uma só etiqueta
+			tmplabel = (datadst[posX] != 0) ? datadst[posX] : (D != 0) ? D : (B != 0) ? B : A;
+			if (tmplabel != 0) euler[tmplabel] += vc_quad_euler(A, B, D, datadst[posX]);
+		}
+	}
+
+	// Quads que acabam na última coluna e na última linha (o rebordo é fundo)
+	if ((width >= 3) && (height >= 3))
+	{
+		for (y = 1; y < height; y++)
+		{
+			A = (int)datadst[(y - 1) * bytesperline + (width - 2) * channels];
+			D = (int)datadst[y * bytesperline + (width - 2) * channels];
+			tmplabel = (D != 0) ? D : A;
+			if (tmplabel != 0) euler[tmplabel] += vc_quad_euler(A, 0, D, 0);
+		}
+		for (x = 1; x < width - 1; x++)
+		{
+			A = (int)datadst[(height - 2) * bytesperline + (x - 1) * channels];
+			B = (int)datadst[(height - 2) * bytesperline + x * channels];
+			tmplabel = (B != 0) ? B : A;
+			if (tmplabel != 0) euler[tmplabel] += vc_quad_euler(A, B, 0, 0);
+		}
+	}
+
+	// Junta as medidas de cada etiqueta provisória na sua etiqueta final
+	// (a etiqueta final é a menor do grupo, por isso f <= a e a etiqueta f já foi processada)
+	for (a = 1; a < label; a++)
+	{
+		f = labeltable[a];
+		if ((f == a) || (f == 0)) continue;
+
+		area[f] += area[a];
+		perimetro[f] += perimetro[a];
+		euler[f] += euler[a];
+		sumx[f] += sumx[a];
+		sumy[f] += sumy[a];
+		if (xmin[a] < xmin[f]) xmin[f] = xmin[a];
+		if (ymin[a] < ymin[f]) ymin[f] = ymin[a];
+		if (xmax[a] > xmax[f]) xmax[f] = xmax[a];
+		if (ymax[a] > ymax[f]) ymax[f] = ymax[a];
+		if (momentos != NULL)
+		{
+			for (b = 0; b < 7; b++) mom[f][b] += mom[a][b];
+		}
+	}
+
+	// O tamanho final de cada objeto já é conhecido: só ficam as etiquetas que cumprem as restrições
+	// (a etiqueta 255 só aparece se as etiquetas se esgotarem, e nunca foi devolvida como blob)
+	for (a = 1; a < label; a++)
+	{
+		f = labeltable[a];
+		if ((area[f] >= areaMinima) && (xmax[f] - xmin[f] + 1 >= larguraMinima) && (ymax[f] - ymin[f] + 1 >= alturaMinima))
+		{
+			remap[a] = f;
+			if (f == a) (*nlabels)++; // Conta etiquetas (cada grupo uma única vez)
+		}
+	}
+
+	// Volta a etiquetar a imagem (os objetos eliminados passam a fundo)
+	for (y = 1; y < height - 1; y++)
+	{
+		for (x = 1; x < width - 1; x++)
+		{
+			posX = y * bytesperline + x * channels; // X
+
+			if (datadst[posX] != 0)
+			{ // Passa as etiquetas da tabela para os valores nos píxeis
+				datadst[posX] = remap[datadst[posX]];
+			}
+		}
+	}
+
+	// Se não há blobs
+	if (*nlabels == 0) return NULL;
+
+	// Cria lista de blobs (objectos) só com os que ficaram, e preenche as medidas já calculadas
+	blobs = (OVC*)calloc((*nlabels), sizeof(OVC));
+	if (blobs == NULL) return NULL;
+
+	if (momentos != NULL)
+	{
+		*momentos = (MVC*)calloc((*nlabels), sizeof(MVC));
+		if (*momentos == NULL)
+		{
+			free(blobs);
+			return NULL;
+		}
+	}
+
+	for (a = 1, b = 0; a < label; a++)
+	{
+		if (remap[a] != a) continue;
+
+		blobs[b].label = a;
+		blobs[b].area = area[a];
+		// Coordenadas da imagem inteira (src pode ser uma vista)
+		blobs[b].x = xmin[a] + src->xoffset;
+		blobs[b].y = ymin[a] + src->yoffset;
+		blobs[b].width = (xmax[a] - xmin[a]) + 1;
+		blobs[b].height = (ymax[a] - ymin[a]) + 1;
+		blobs[b].xc = round((float)sumx[a] / (float)MAX(area[a], 1)) + src->xoffset;
+		blobs[b].yc = round((float)sumy[a] / (float)MAX(area[a], 1)) + src->yoffset;
+		blobs[b].perimeter = perimetro[a];
+		blobs[b].nburacos = MAX(1 - euler[a] / 4, 0);
+
+		if (momentos != NULL)
+		{
+			m = &(*momentos)[b];
+			m->m00 = area[a];
+			m->m10 = (double)sumx[a];
+			m->m01 = (double)sumy[a];
+			m->m20 = mom[a][0];
+			m->m11 = mom[a][1];
+			m->m02 = mom[a][2];
+			m->m30 = mom[a][3];
+			m->m21 = mom[a][4];
+			m->m12 = mom[a][5];
+			m->m03 = mom[a][6];
+		}
+		b++;
+	}
+
+	return blobs;
+}
+
+/*
+* Função: vc_momentos_invariantes
+* ----------------------------
+* A partir dos momentos "crus", calcula os momentos centrais, normaliza-os pela área
+* (invariância à escala) e calcula os 7 invariantes de Hu
+*
+* momentos : estrutura com os momentos "crus" preenchidos (m00 ... m03)
+*/
+int vc_momentos_invariantes(MVC* momentos)
+{
+	MVC* m = momentos;
+	double xc, yc;
+	double n20, n11, n02, n30, n21, n12, n03, s2, s3;
+	double a, b, c, d;
+
+	// Verificação de erros
+	if ((m == NULL) || (m->m00 <= 0.0)) return 0;
+
+	// Centro de massa
+	xc = m->m10 / m->m00;
+	yc = m->m01 / m->m00;
+
+	// Momentos centrais
+	m->mu20 = m->m20 - xc * m->m10;
+	m->mu11 = m->m11 - xc * m->m01;
+	m->mu02 = m->m02 - yc * m->m01;
+	m->mu30 = m->m30 - 3.0 * xc * m->m20 + 2.0 * xc * xc * m->m10;
+	m->mu21 = m->m21 - 2.0 * xc * m->m11 - yc * m->m20 + 2.0 * xc * xc * m->m01;
+	m->mu12 = m->m12 - 2.0 * yc * m->m11 - xc * m->m02 + 2.0 * yc * yc * m->m10;
+	m->mu03 = m->m03 - 3.0 * yc * m->m02 + 2.0 * yc * yc * m->m01;
+
+	// Momentos centrais normalizados: nu_pq = mu_pq / m00^(1 + (p + q) / 2)
+	s2 = m->m00 * m->m00;
+	s3 = s2 * sqrt(m->m00);
+	n20 = m->mu20 / s2;
+	n11 = m->mu11 / s2;
+	n02 = m->mu02 / s2;
+	n30 = m->mu30 / s3;
+	n21 = m->mu21 / s3;
+	n12 = m->mu12 / s3;
+	n03 = m->mu03 / s3;
+
+	// Invariantes de Hu
+	a = n30 + n12;
+	b = n21 + n03;
+	c = n30 - 3.0 * n12;
+	d = 3.0 * n21 - n03;
+	m->hu[0] = n20 + n02;
+	m->hu[1] = (n20 - n02) * (n20 - n02) + 4.0 * n11 * n11;
+	m->hu[2] = c * c + d * d;
+	m->hu[3] = a * a + b * b;
+	m->hu[4] = c * a * (a * a - 3.0 * b * b) + d * b * (3.0 * a * a - b * b);
+	m->hu[5] = (n20 - n02) * (a * a - b * b) + 4.0 * n11 * a * b;
+	m->hu[6] = d * a * (a * a - 3.0 * b * b) - c * b * (3.0 * a * a - b * b);
+
+	return 1;
+}
+
+/*
+* Função: vc_encontrarMaiorBlob
+* ----------------------------
+* Encontra a blob com a maior área
+*
+* src       : estrutura da imagem etiquetada
+* blobs	    : estrutura das blobs
+* nblobs    : número de objetos encontrados na imagem
+* maiorBlob : endereço de memória para guardar o index da maior blob na estrutura
+*/
+int vc_encontrarMaiorBlob(IVC* src, OVC* blobs, int nblobs, int* maiorBlob)
+{
+	unsigned char* data = (unsigned char*)src->data;
+	int width = src->width;
+	int height = src->height;
+	int bytesperline = src->bytesperline;
+	int channels = src->channels;
+	int x, y, i, blobAreaMax = 0;
+	long int pos;
+
+	// Verificação de erros
+	if ((width <= 0) || (height <= 0) || (data == NULL)) return 0;
+	if ((blobs == NULL) || (nblobs <= 0)) return 0;
+	if (channels != 1) return 0;
+
+	// Percorre cada blob
+	for (i = 0; i < nblobs; i++)
+	{
+		blobs[i].area = 0;
+
+		// Percorre cada píxel da imagem etiquetada
+		for (y = 1; y < height - 1; y++)
+		{
+			for (x = 1; x < width - 1; x++)
+			{
+				pos = y * bytesperline + x; // * channels; (channels = 1)
+
+				// Se o píxel pertencer ao blob de que estamos à procura
+				if (data[pos] == blobs[i].label)
+				{
+					// Área (= somatório do nº de píxeis do blob)
+					blobs[i].area++;
+				}
+			}
+		}
+
+		// Compara o tamanho do blob atual com o maior até agora
+		if (blobs[i].area > blobAreaMax)
+		{ // Este blob é agora o maior
+			blobAreaMax = blobs[i].area;
+			*maiorBlob = i;
+		}
+	}
+	return 1;
+}
+
+/*
+* Função: vc_maiorBlob_info
+* ----------------------------
+* Calcula o perimetro, centro de massa e caixa delimitadora de uma blob
+*
+* src       : estrutura da imagem etiquetada
+* blobs	    : estrutura das blobs
+* nblobs    : número de objetos encontrados na imagem
+* maiorBlob : index da maior blob na estrutura
+*/
+int vc_maiorBlob_info(IVC* src, OVC* blobs, int nblobs, int maiorBlob)
+{
+	unsigned char* data = (unsigned char*)src->data;
+	int width = src->width;
+	int height = src->height;
+	int bytesperline = src->bytesperline;
+	int channels = src->channels;
+	int x, y, label;
+	long int pos;
+	int xmin, xmax, ymin, ymax;
+	long int sumx, sumy;
+
+	// Verificação de erros
+	if ((width <= 0) || (height <= 0) || (data == NULL)) return 0;
+	if (channels != 1) return 0;
+	if ((blobs == NULL) || (nblobs <= 0) || (maiorBlob >= nblobs)) return 0;
+
+	// Inicialização nos extremos possíveis
+	xmin = width - 1;
+	ymin = height - 1;
+	xmax = 0;
+	ymax = 0;
+
+	sumx = 0;
+	sumy = 0;
+
+	label = blobs[maiorBlob].label;
+
+	// Percorre cada píxel da imagem etiquetada
+	for (y = 1; y < height - 1; y++)
+	{
+		for (x = 1; x < width - 1; x++)
+		{
+			pos = y * bytesperline + x; // *channels; (channels = 1)
+
+			// Se o píxel pertencer ao blob de que estamos à procura
+			if (data[pos] == label)
+			{
+				// Somatórios que vão ser usados no cálculo do centro de massa
+				sumx += x;
+				sumy += y;
+
+				// Coordenadas dos vértices da caixa delimitadora
+				if (xmin > x) xmin = x;
+				if (ymin > y) ymin = y;
+				if (xmax < x) xmax = x;
+				if (ymax < y) ymax = y;
+
+				// Perímetro (está a usar em "cruz", não conta os da diagonal)
+				// Se pelo menos um dos quatro vizinhos não pertence ao mesmo label, então é um pixel de contorno
+				if ((data[pos - 1] != label) || (data[pos + 1] != label) || (data[pos - bytesperline] != label) || (data[pos + bytesperline] != label))
+				{
+					blobs[maiorBlob].perimeter++;
+				}
+			}
+		}
+	}
+
+	// Caixa delimitadora
+	// (se src for uma vista, as coordenadas são passadas para a imagem inteira)
+	blobs[maiorBlob].x = xmin + src->xoffset;
+	blobs[maiorBlob].y = ymin + src->yoffset;
+	blobs[maiorBlob].width = (xmax - xmin) + 1;
+	blobs[maiorBlob].height = (ymax - ymin) + 1;
+
+	// Centro de Massa
+	// x médio (média de todos os valores/coordenadas em x)
+	blobs[maiorBlob].xc = round((float)sumx / (float)MAX(blobs[maiorBlob].area, 1)) + src->xoffset; // Usa-se o MAX para nunca dar 0
+	// y médio (média de todos os valores/coordenadas em y)
+	blobs[maiorBlob].yc = round((float)sumy / (float)MAX(blobs[maiorBlob].area, 1)) + src->yoffset;
+
+	return 1;
+}
+
+
+/*
+* Função: vc_blobs_info
+* ----------------------------
+* Calcula a área, o perímetro, o centro de massa e a caixa delimitadora de todos os
+* blobs numa única passagem pela imagem etiquetada
+*
+* src       : estrutura da imagem etiquetada
+* blobs	    : estrutura das blobs (só é preciso o campo label estar preenchido)
+* nblobs    : número de objetos encontrados na imagem
+* maiorBlob : (opcional) endereço de memória para guardar o index da maior blob
+*/
+int vc_blobs_info(IVC* src, OVC* blobs, int nblobs, int* maiorBlob)
+{
+	unsigned char* data = (unsigned char*)src->data;
+	int width = src->width;
+	int height = src->height;
+	int bytesperline = src->bytesperline;
+	int channels = src->channels;
+	int x, y, i, label, blobAreaMax = 0;
+	long int pos;
+	int indice[256]; // Índice do blob de cada etiqueta (-1 = etiqueta sem blob)
+	long int sumx[256] = { 0 }, sumy[256] = { 0 };
+	int xmax[256], ymax[256];
+	OVC* blob;
+
+	// Verificação de erros
+	if ((width <= 0) || (height <= 0) || (data == NULL)) return 0;
+	if (channels != 1) return 0;
+	if ((blobs == NULL) || (nblobs <= 0) || (nblobs > 255)) return 0;
+
+	for (label = 0; label < 256; label++) indice[label] = -1;
+
+	// Inicialização nos extremos possíveis
+	for (i = 0; i < nblobs; i++)
+	{
+		indice[blobs[i].label] = i;
+		blobs[i].area = 0;
+		blobs[i].perimeter = 0;
+		blobs[i].x = width - 1;
+		blobs[i].y = height - 1;
+		xmax[i] = 0;
+		ymax[i] = 0;
+	}
+
+	// Percorre cada píxel da imagem etiquetada (uma só vez para todos os blobs)
+	for (y = 1; y < height - 1; y++)
+	{
+		for (x = 1; x < width - 1; x++)
+		{
+			pos = y * bytesperline + x; // * channels; (channels = 1)
+			label = data[pos];
+
+			// Fundo ou etiqueta que não está na lista
+			if ((label == 0) || (indice[label] < 0)) continue;
+
+			i = indice[label];
+			blob = &blobs[i];
+
+			blob->area++;
+			sumx[i] += x;
+			sumy[i] += y;
+
+			if (blob->x > x) blob->x = x;
+			if (blob->y > y) blob->y = y;
+			if (xmax[i] < x) xmax[i] = x;
+			if (ymax[i] < y) ymax[i] = y;
+
+			// Perímetro (vizinhança em "cruz", igual a vc_maiorBlob_info)
+			if ((data[pos - 1] != label) || (data[pos + 1] != label) || (data[pos - bytesperline] != label) || (data[pos + bytesperline] != label))
+			{
+				blob->perimeter++;
+			}
+		}
+	}
+
+	for (i = 0; i < nblobs; i++)
+	{
+		blob = &blobs[i];
+
+		// Caixa delimitadora e centro de massa (nas coordenadas da imagem inteira)
+		blob->width = (xmax[i] - blob->x) + 1;
+		blob->height = (ymax[i] - blob->y) + 1;
+		blob->xc = round((float)sumx[i] / (float)MAX(blob->area, 1)) + src->xoffset;
+		blob->yc = round((float)sumy[i] / (float)MAX(blob->area, 1)) + src->yoffset;
+		blob->x += src->xoffset;
+		blob->y += src->yoffset;
+
+		if (blob->area > blobAreaMax)
+		{
+			blobAreaMax = blob->area;
+			if (maiorBlob != NULL) *maiorBlob = i;
+		}
+	}
+
+	return 1;
+}
+
+// Vizinhos de um píxel pela ordem do código de cadeia de Freeman (0 = este, 2 = norte, 4 = oeste, 6 = sul)
+static const int vc_cadeia_dx[8] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+static const int vc_cadeia_dy[8] = { 0, -1, -1, -1, 0, 1, 1, 1 };
+// Direção de um vizinho a partir do deslocamento [dy + 1][dx + 1] (-1 = o próprio píxel)
+static const int vc_cadeia_direcao[3][3] = { { 3, 2, 1 }, { 4, -1, 0 }, { 5, 6, 7 } };
+
+// Pontos percorridos por um contorno (cresce conforme for preciso)
+typedef struct {
+	int* x;
+	int* y;
+	unsigned char* cadeia;
+	int n, capacidade;
+} vc_pontos_contorno;
+
+static int vc_pontos_acrescentar(vc_pontos_contorno* pontos, int x, int y, int direcao)
+{
+	int capacidade;
+	int* nx, * ny;
+	unsigned char* ncadeia;
+
+	if (pontos->n == pontos->capacidade)
+	{
+		capacidade = MAX(pontos->capacidade * 2, 256);
+		nx = (int*)realloc(pontos->x, capacidade * sizeof(int));
+		if (nx != NULL) pontos->x = nx;
+		ny = (int*)realloc(pontos->y, capacidade * sizeof(int));
+		if (ny != NULL) pontos->y = ny;
+		ncadeia = (unsigned char*)realloc(pontos->cadeia, capacidade);
+		if (ncadeia != NULL) pontos->cadeia = ncadeia;
+		if ((nx == NULL) || (ny == NULL) || (ncadeia == NULL)) return 0;
+		pontos->capacidade = capacidade;
+	}
+
+	pontos->x[pontos->n] = x;
+	pontos->y[pontos->n] = y;
+	pontos->cadeia[pontos->n] = (unsigned char)direcao;
+	pontos->n++;
+
+	return 1;
+}
+
+/*
+* Função: vc_seguir_contorno
+* ----------------------------
+* Segue o contorno exterior de um blob (vizinhança de Moore, no sentido dos ponteiros do relógio)
+* a partir do primeiro píxel do blob com um vizinho de fundo conhecido, até voltar a dar o primeiro
+* passo. Só lê píxeis do próprio contorno e os seus vizinhos dentro da caixa delimitadora
+* (fora dela não há píxeis do blob), por isso não precisa de marcar nada: o custo é o do contorno.
+* Devolve 0 se faltar memória para os pontos
+*
+* data, bytesperline : imagem etiquetada
+* label              : etiqueta do blob
+* x0, y0, x1, y1     : caixa delimitadora (inclusive, nas coordenadas de data)
+* xs, ys             : píxel inicial
+* fundo              : direção (0..7) de um vizinho de fundo do píxel inicial
+* pontos             : onde guardar os pontos e o código de cadeia
+*/
+static int vc_seguir_contorno(unsigned char* data, int bytesperline, int label, int x0, int y0, int x1, int y1,
+	int xs, int ys, int fundo, vc_pontos_contorno* pontos)
+{
+	int x = xs, y = ys, nx, ny, d, k, encontrado, primeiro = -1, anterior;
+	long int passos = 0, maxPassos = 4L * (x1 - x0 + 1) * (y1 - y0 + 1) + 8; // Cada píxel entra no contorno no máximo 4 vezes
+
+	while (passos++ < maxPassos)
+	{
+		// Roda à volta do píxel atual, a partir do vizinho de fundo, até encontrar um píxel do blob
+		encontrado = -1;
+		for (k = 1; k < 8; k++)
+		{
+			d = (fundo - k + 8) % 8;
+			nx = x + vc_cadeia_dx[d];
+			ny = y + vc_cadeia_dy[d];
+			if ((nx >= x0) && (nx <= x1) && (ny >= y0) && (ny <= y1) && (data[ny * bytesperline + nx] == label))
+			{
+				encontrado = d;
+				break;
+			}
+		}
+
+		// Píxel isolado
+		if (encontrado < 0) break;
+
+		// Voltou ao início e ia repetir o primeiro passo: o contorno fechou
+		if ((x == xs) && (y == ys) && (encontrado == primeiro)) break;
+		if (primeiro < 0) primeiro = encontrado;
+
+		if (!vc_pontos_acrescentar(pontos, x, y, encontrado)) return 0;
+
+		// O último vizinho de fundo visto passa a ser a referência do píxel seguinte
+		anterior = (encontrado + 1) % 8;
+		nx = x + vc_cadeia_dx[encontrado];
+		ny = y + vc_cadeia_dy[encontrado];
+		fundo = vc_cadeia_direcao[y + vc_cadeia_dy[anterior] - ny + 1][x + vc_cadeia_dx[anterior] - nx + 1];
+		x = nx;
+		y = ny;
+	}
+
+	return 1;
+}
+
+// Produto externo (b - a) x (c - a): > 0 se a, b, c rodam no sentido contrário ao dos ponteiros (com y para cima)
+static long int vc_produto_externo(int ax, int ay, int bx, int by, int cx, int cy)
+{
+	return (long int)(bx - ax) * (cy - ay) - (long int)(by - ay) * (cx - ax);
+}
+
+// Ordena os índices dos pontos por x e, nos empates, por y (aux tem espaço para n inteiros)
+static int vc_contorno_ordenar(vc_pontos_contorno* pontos, int* ordem, int* aux)
+{
+	int n = pontos->n;
+	int i, xmin = pontos->x[0], ymin = pontos->y[0], xmax = xmin, ymax = ymin;
+	int* contagem;
+
+	for (i = 1; i < n; i++)
+	{
+		xmin = MIN(xmin, pontos->x[i]);
+		xmax = MAX(xmax, pontos->x[i]);
+		ymin = MIN(ymin, pontos->y[i]);
+		ymax = MAX(ymax, pontos->y[i]);
+	}
+
+	contagem = (int*)calloc(MAX(xmax - xmin, ymax - ymin) + 2, sizeof(int));
+	if (contagem == NULL) return 0;
+
+	// Por y: aux
+	for (i = 0; i < n; i++) contagem[pontos->y[i] - ymin + 1]++;
+	for (i = 1; i <= ymax - ymin + 1; i++) contagem[i] += contagem[i - 1];
+	for (i = 0; i < n; i++) aux[contagem[pontos->y[i] - ymin]++] = i;
+
+	// Por x (estável): ordem
+	memset(contagem, 0, (MAX(xmax - xmin, ymax - ymin) + 2) * sizeof(int));
+	for (i = 0; i < n; i++) contagem[pontos->x[i] - xmin + 1]++;
+	for (i = 1; i <= xmax - xmin + 1; i++) contagem[i] += contagem[i - 1];
+	for (i = 0; i < n; i++) ordem[contagem[pontos->x[aux[i]] - xmin]++] = aux[i];
+
+	free(contagem);
+
+	return 1;
+}
+
+/*
+* Função: vc_contorno_forma
+* ----------------------------
+* Calcula os descritores de forma do contorno exterior: vértices e área do invólucro
+* convexo (cadeia monótona de Andrew), solidez e número de cantos (ângulo entre as cordas
+* de k pontos para trás e para a frente acima de 45º, com supressão dos não-máximos)
+*
+* pontos   : pontos do contorno exterior, pela ordem em que foram percorridos
+* contorno : estrutura onde guardar os descritores
+*/
+static void vc_contorno_forma(vc_pontos_contorno* pontos, CVC* contorno)
+{
+	int n = pontos->n;
+	int* hull;
+	int* ordem;
+	float* curvatura;
+	int i, j, k, h, t, maximo;
+	long int areaContorno = 0, areaHull = 0;
+	float v1x, v1y, v2x, v2y, norma;
+
+	contorno->verticesHull = n;
+	contorno->cantos = 0;
+	contorno->solidez = 1.0f;
+	if (n < 3) return;
+
+	ordem = (int*)malloc(n * sizeof(int));
+	hull = (int*)malloc((2 * n + 1) * sizeof(int));
+	curvatura = (float*)malloc(n * sizeof(float));
+	if ((ordem == NULL) || (hull == NULL) || (curvatura == NULL))
+	{
+		free(ordem);
+		free(hull);
+		free(curvatura);
+		return;
+	}
+
+	// Área dentro do contorno (fórmula de shoelace sobre os centros dos píxeis)
+	for (i = 0; i < n; i++)
+	{
+		j = (i + 1) % n;
+		areaContorno += (long int)pontos->x[i] * pontos->y[j] - (long int)pontos->x[j] * pontos->y[i];
+	}
+	if (areaContorno < 0) areaContorno = -areaContorno;
+
+	// Invólucro convexo: pontos ordenados por x e depois por y
+	// (ordenação por contagem, primeiro por y e depois, estável, por x: os pontos estão dentro da caixa)
+	if (!vc_contorno_ordenar(pontos, ordem, hull))
+	{
+		free(ordem);
+		free(hull);
+		free(curvatura);
+		return;
+	}
+
+	// Metade inferior e metade superior
+	h = 0;
+	for (i = 0; i < n; i++)
+	{
+		while ((h >= 2) && (vc_produto_externo(pontos->x[hull[h - 2]], pontos->y[hull[h - 2]], pontos->x[hull[h - 1]], pontos->y[hull[h - 1]],
+			pontos->x[ordem[i]], pontos->y[ordem[i]]) <= 0)) h--;
+		hull[h++] = ordem[i];
+	}
+	for (i = n - 2, t = h + 1; i >= 0; i--)
+	{
+		while ((h >= t) && (vc_produto_externo(pontos->x[hull[h - 2]], pontos->y[hull[h - 2]], pontos->x[hull[h - 1]], pontos->y[hull[h - 1]],
+			pontos->x[ordem[i]], pontos->y[ordem[i]]) <= 0)) h--;
+		hull[h++] = ordem[i];
+	}
+	h--; // O primeiro ponto aparece repetido no fim
+
+	for (i = 0; i < h; i++)
+	{
+		j = (i + 1) % h;
+		areaHull += (long int)pontos->x[hull[i]] * pontos->y[hull[j]] - (long int)pontos->x[hull[j]] * pontos->y[hull[i]];
+	}
+	if (areaHull < 0) areaHull = -areaHull;
+
+	contorno->verticesHull = h;
+	contorno->solidez = (areaHull > 0) ? (float)areaContorno / (float)areaHull : 1.0f;
+
+	// Cantos: curvatura = 1 - cos(ângulo entre as cordas), com k proporcional ao comprimento do contorno
+	k = MAX(3, n / 64);
+	for (i = 0; i < n; i++)
+	{
+		j = (i - k + n) % n;
+		v1x = (float)(pontos->x[i] - pontos->x[j]);
+		v1y = (float)(pontos->y[i] - pontos->y[j]);
+		j = (i + k) % n;
+		v2x = (float)(pontos->x[j] - pontos->x[i]);
+		v2y = (float)(pontos->y[j] - pontos->y[i]);
+		norma = sqrtf((v1x * v1x + v1y * v1y) * (v2x * v2x + v2y * v2y));
+		curvatura[i] = (norma > 0.0f) ? 1.0f - (v1x * v2x + v1y * v2y) / norma : 0.0f;
+	}
+	for (i = 0; i < n; i++)
+	{
+		if (curvatura[i] < 0.29f) continue; // cos(45º) = 0.71
+
+		// Só conta o máximo local (nos empates, o primeiro)
+		maximo = 1;
+		for (j = 1; (j <= k) && maximo; j++)
+		{
+			if ((curvatura[(i + j) % n] > curvatura[i]) || (curvatura[(i - j + n) % n] >= curvatura[i])) maximo = 0;
+		}
+		if (maximo) contorno->cantos++;
+	}
+
+	free(ordem);
+	free(hull);
+	free(curvatura);
+}
+
+/*
+* Função: vc_blob_contorno
+* ----------------------------
+* Segue o contorno exterior de um blob a partir do seu primeiro píxel (o primeiro da
+* primeira linha da caixa delimitadora) e calcula os descritores de forma. O custo depende
+* do comprimento do contorno e não da área da caixa: o perímetro e o número de buracos já
+* vêm da etiquetagem (blob->perimeter e blob->nburacos), por isso os buracos não são seguidos.
+* A cadeia tem de ser libertada com vc_contorno_libertar
+*
+* src      : estrutura da imagem etiquetada (pode ser uma vista)
+* blob     : blob da etiquetagem (etiqueta e caixa delimitadora em coordenadas da imagem inteira)
+* contorno : estrutura onde guardar o contorno e os descritores de forma
+*/
+int vc_blob_contorno(IVC* src, OVC* blob, CVC* contorno)
+{
+	unsigned char* data = (unsigned char*)src->data;
+	int bytesperline = src->bytesperline;
+	int x0, y0, x1, y1, x;
+	vc_pontos_contorno pontos = { NULL, NULL, NULL, 0, 0 };
+
+	// Verificação de erros
+	if ((src->width <= 0) || (src->height <= 0) || (data == NULL)) return 0;
+	if (src->channels != 1) return 0;
+	if ((blob == NULL) || (contorno == NULL) || (blob->width <= 0) || (blob->height <= 0)) return 0;
+
+	memset(contorno, 0, sizeof(CVC));
+
+	// Caixa delimitadora nas coordenadas de src
+	x0 = blob->x - src->xoffset;
+	y0 = blob->y - src->yoffset;
+	x1 = x0 + blob->width - 1;
+	y1 = y0 + blob->height - 1;
+	if ((x0 < 0) || (y0 < 0) || (x1 >= src->width) || (y1 >= src->height)) return 0;
+
+	// Primeiro píxel do blob na primeira linha da caixa (o vizinho da esquerda é fundo)
+	for (x = x0; (x <= x1) && (data[y0 * bytesperline + x] != blob->label); x++);
+	if (x > x1) return 0;
+
+	contorno->xinicio = x + src->xoffset;
+	contorno->yinicio = y0 + src->yoffset;
+	if (!vc_seguir_contorno(data, bytesperline, blob->label, x0, y0, x1, y1, x, y0, 4, &pontos))
+	{
+		free(pontos.x);
+		free(pontos.y);
+		free(pontos.cadeia);
+		return 0;
+	}
+
+	contorno->perimetro = blob->perimeter;
+	contorno->nburacos = blob->nburacos;
+	contorno->comprimento = pontos.n;
+	contorno->cadeia = pontos.cadeia;
+	vc_contorno_forma(&pontos, contorno);
+	free(pontos.x);
+	free(pontos.y);
+
+	return 1;
+}
+
+/*
+* Função: vc_contorno_libertar
+* ----------------------------
+* Liberta o código de cadeia de um contorno calculado com vc_blob_contorno
+*
+* contorno : estrutura do contorno
+*/
+void vc_contorno_libertar(CVC* contorno)
+{
+	if (contorno == NULL) return;
+
+	free(contorno->cadeia);
+	contorno->cadeia = NULL;
+	contorno->comprimento = 0;
+}
+
+/*
+* Função: vc_filtrarBlobs
+* ----------------------------
+* Mantém só os blobs com área suficiente, compactando-os no início do array
+* (devolve o novo número de blobs)
+*
+* blobs      : estrutura das blobs (com a área calculada)
+* nblobs     : número de blobs
+* areaMinima : área mínima para o blob ser mantido
+*/
+int vc_filtrarBlobs(OVC* blobs, int nblobs, int areaMinima)
+{
+	int i, n = 0;
+
+	if (blobs == NULL) return 0;
+
+	for (i = 0; i < nblobs; i++)
+	{
+		if (blobs[i].area >= areaMinima) blobs[n++] = blobs[i];
+	}
+
+	return n;
+}
+
+/*
+* Função: vc_classificarBlobs
+* ----------------------------
+* Classifica todos os blobs dados e preenche a lista de deteções da frame
+* (devolve o número de deteções)
+*
+* seguimento : (opcional) seguimento temporal; se existir, usa a decisão estável de cada trajeto
+* blobs      : blobs candidatos (com vc_blobs_info calculado e já filtrados)
+* nblobs     : número de blobs
+* caracteristicas : (opcional) vetores de características dos blobs, seguidos (senão são calculados só com o blob)
+* mascaras   : (opcional, só com seguimento) máscaras 32x32 dos blobs, para a verificação por modelos binários
+* limiarVerificacao : máximo de bits diferentes do modelo (só com mascaras)
+* cor        : cor com que os blobs foram detetados
+* regras     : tabela de regras (NULL = tabela ativa)
+* nregras    : número de regras
+* deteccoes  : lista de deteções a preencher (com espaço para nblobs; os descritores de forma não são alterados)
+*/
+int vc_classificarBlobs(SVC* seguimento, OVC* blobs, int nblobs, const float* caracteristicas, const unsigned long long* mascaras,
+	int limiarVerificacao, Cor cor, const RSVC* regras, int nregras, DVC* deteccoes)
+{
+	float caracteristicasBlob[VC_NUM_CARACTERISTICAS];
+	int trajetos[256];
+	int i;
+
+	// Verificação de erros
+	if ((blobs == NULL) || (nblobs <= 0) || (nblobs > 256) || (deteccoes == NULL)) return 0;
+
+	if (seguimento != NULL) vc_seguimento_atualizar(seguimento, blobs, nblobs, caracteristicas, mascaras, limiarVerificacao, cor, regras, nregras, trajetos);
+
+	for (i = 0; i < nblobs; i++)
+	{
+		deteccoes[i].blob = blobs[i];
+		deteccoes[i].cor = cor;
+
+		if ((seguimento != NULL) && (trajetos[i] >= 0))
+		{
+			deteccoes[i].trajeto = seguimento->trajetos[trajetos[i]].id;
+			deteccoes[i].sinal = seguimento->trajetos[trajetos[i]].sinal;
+			deteccoes[i].distanciaModelo = seguimento->trajetos[trajetos[i]].distanciaModelo;
+		}
+		else
+		{
+			deteccoes[i].trajeto = 0;
+			deteccoes[i].distanciaModelo = -1;
+			if (caracteristicas != NULL) deteccoes[i].sinal = vc_classificarRegras(regras, nregras, caracteristicas + i * VC_NUM_CARACTERISTICAS, cor);
+			else
+			{
+				vc_caracteristicasBlob(&blobs[i], NULL, caracteristicasBlob);
+				deteccoes[i].sinal = vc_classificarRegras(regras, nregras, caracteristicasBlob, cor);
+			}
+		}
+	}
+
+	return nblobs;
+}
+
+/*
+* Função: vc_desenharBlob
+* ----------------------------
+* Desenha o centro de massa e a caixa delimitadora de um blob numa imagem a cores
+* (as coordenadas do blob são da imagem inteira; dst pode ser uma vista)
+*
+* dst  : estrutura da imagem onde desenhar
+* blob : blob com o centro de massa e a caixa delimitadora calculados
+*/
+static int vc_desenharBlob(IVC* dst, OVC* blob)
+{
+	unsigned char* datadst = (unsigned char*)dst->data;
+	int width = dst->width;
+	int height = dst->height;
+	int channels = dst->channels;
+	int bytesperline = dst->bytesperline;
+	long int pos;
+	int x, y, blobXmin, blobXmax, blobYmin, blobYmax, blobXc, blobYc, tamanhoCentro = 2;
+
+	// As coordenadas do blob são da imagem inteira: passam para as coordenadas de dst
+	blobXc = blob->xc - dst->xoffset;
+	blobYc = blob->yc - dst->yoffset;
+
+	// Marcar o centro de massa
+	for (y = blobYc - tamanhoCentro; y <= blobYc + tamanhoCentro; y++)
+	{
+		for (x = blobXc - tamanhoCentro; x <= blobXc + tamanhoCentro; x++)
+		{
+			pos = y * bytesperline + x * channels;
+
+			if (y >= 0 && y < height && x >= 0 && x < width)
+			{
+				datadst[pos] = (unsigned char)0;
+				datadst[pos + 1] = (unsigned char)0;
+				datadst[pos + 2] = (unsigned char)0;
+			}
+
+		}
+	}
+
+	// Coordenadas da caixa delimitadora
+	blobYmin = blob->y - dst->yoffset;
+	blobYmax = blobYmin + blob->height - 1;
+	blobXmin = blob->x - dst->xoffset;
+	blobXmax = blobXmin + blob->width - 1;
+
+	// A caixa tem de estar dentro da imagem de destino
+	if ((blobXmin < 0) || (blobYmin < 0) || (blobXmax >= width) || (blobYmax >= height)) return 0;
+
+	// Marcar a caixa delimitadora
+	// Limites verticais
+	for (y = blobYmin; y <= blobYmax; y++)
+	{
+		// Limite esquerdo
+		pos = y * bytesperline + blobXmin * channels;
+		datadst[pos] = (unsigned char)0;
+		datadst[pos + 1] = (unsigned char)0;
+		datadst[pos + 2] = (unsigned char)0;
+
+		// Limite direito
+		pos = y * bytesperline + blobXmax * channels;
+		datadst[pos] = (unsigned char)0;
+		datadst[pos + 1] = (unsigned char)0;
+		datadst[pos + 2] = (unsigned char)0;
+	}
+	// Limites horizontais
+	for (x = blobXmin; x <= blobXmax; x++)
+	{
+		// Limite superior
+		pos = blobYmin * bytesperline + x * channels;
+		datadst[pos] = (unsigned char)0;
+		datadst[pos + 1] = (unsigned char)0;
+		datadst[pos + 2] = (unsigned char)0;
+
+		// Limite inferior
+		pos = blobYmax * bytesperline + x * channels;
+		datadst[pos] = (unsigned char)0;
+		datadst[pos + 1] = (unsigned char)0;
+		datadst[pos + 2] = (unsigned char)0;
+	}
+
+	return 1;
+}
+
+/*
+* Função: vc_marcarMaiorBlob
+* ----------------------------
+* Marca o centro de massa e a caixa delimitadora de uma blob
+*
+* src       : estrutura da imagem original(neste caso da camara)
+* dst	    : estrutura da imagem de saida
+* blobs		: estrutura das blobs
+* nblobs    : número de objetos encontrados na imagem
+* maiorBlob : index da maior blob na estrutura
+*/
+int vc_marcarMaiorBlob(IVC* src, IVC* dst, OVC* blobs, int nblobs, int maiorBlob)
+{
+	unsigned char* datasrc = (unsigned char*)src->data;
+	unsigned char* datadst = (unsigned char*)dst->data;
+	int width = src->width;
+	int height = src->height;
+	int channels = src->channels;
+	int y;
+
+	// Verificação de erros
+	if ((width <= 0) || (height <= 0) || (datasrc == NULL) || (datadst == NULL)) return 0;
+	if ((width != dst->width) || (height != dst->height) || (channels != dst->channels)) return 0;
+	if ((blobs == NULL) || (nblobs <= 0) || (maiorBlob >= nblobs)) return 0;
+	if (channels != 3) return 0;
+
+	// Copia dados da imagem original para a nova imagem (linha a linha, pois podem ser vistas)
+	for (y = 0; y < height; y++)
+	{
+		memcpy(datadst + y * dst->bytesperline, datasrc + y * src->bytesperline, width * channels);
+	}
+
+	return vc_desenharBlob(dst, &blobs[maiorBlob]);
+}
+
+/*
+* Função: vc_marcarBlobs
+* ----------------------------
+* Marca o centro de massa e a caixa delimitadora de todos os blobs dados,
+* copiando a imagem original uma única vez
+*
+* src    : estrutura da imagem original (neste caso da camara)
+* dst    : estrutura da imagem de saida
+* blobs  : blobs a marcar (por exemplo, já filtrados com vc_filtrarBlobs)
+* nblobs : número de blobs
+*/
+int vc_marcarBlobs(IVC* src, IVC* dst, OVC* blobs, int nblobs)
+{
+	unsigned char* datasrc = (unsigned char*)src->data;
+	unsigned char* datadst = (unsigned char*)dst->data;
+	int width = src->width;
+	int height = src->height;
+	int channels = src->channels;
+	int i, y;
+
+	// Verificação de erros
+	if ((width <= 0) || (height <= 0) || (datasrc == NULL) || (datadst == NULL)) return 0;
+	if ((width != dst->width) || (height != dst->height) || (channels != dst->channels)) return 0;
+	if ((nblobs > 0) && (blobs == NULL)) return 0;
+	if (channels != 3) return 0;
+
+	// Copia dados da imagem original para a nova imagem
+	for (y = 0; y < height; y++)
+	{
+		memcpy(datadst + y * dst->bytesperline, datasrc + y * src->bytesperline, width * channels);
+	}
+
+	for (i = 0; i < nblobs; i++) vc_desenharBlob(dst, &blobs[i]);
+
+	return 1;
+}
+
+/*
+* Função: vc_identificarSinal
+* ----------------------------
+* Identifica o sinal de transito da imagem
+* (calcula o vetor de características do blob e avalia-o com a tabela de regras ativa)
+*
+* blobs		: estrutura das blobs
+* nblobs    : número de objetos encontrados na imagem
+* maiorBlob : index da maior blob na estrutura
+* cor		: enum com a cor do sinal(azul ou vermelho)
+*/
+Sinal vc_identificarSinal(OVC* blobs, int nblobs, int maiorblob, Cor cor)
+{
+	float caracteristicas[VC_NUM_CARACTERISTICAS];
+
+	// Verificação de erros
+	if ((blobs == NULL) || (nblobs <= 0) || (maiorblob >= nblobs)) return INDEFINIDO;
+	if (cor == INDEFINIDA) return INDEFINIDO;
+
+	vc_caracteristicasBlob(&blobs[maiorblob], NULL, caracteristicas);
+
+	return vc_classificarCaracteristicas(caracteristicas, cor);
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//         FUNÇÕES: VERIFICAÇÃO POR MODELOS BINÁRIOS
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+// Contagem de bits a 1 numa palavra de 64 bits (instrução do processador quando existe)
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#define VC_POPCOUNT64(x) ((int)__popcnt64(x))
+#elif defined(__GNUC__) || defined(__clang__)
+#define VC_POPCOUNT64(x) __builtin_popcountll(x)
+#else
+static int vc_popcount64(unsigned long long x)
+{
+	x = x - ((x >> 1) & 0x5555555555555555ULL);
+	x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+	x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	return (int)((x * 0x0101010101010101ULL) >> 56);
+}
+#define VC_POPCOUNT64(x) vc_popcount64(x)
+#endif
+
+// Modelo de um sinal: máscara 32x32 do blob (linha y nos bits 32 * (y % 2) da palavra y / 2; coluna x no bit x)
+typedef struct {
+	Cor cor;
+	Sinal sinal;
+	unsigned long long bits[VC_MODELO_PALAVRAS];
+} vc_modelo_sinal;
+
+// Modelos gerados com vc_blob_amostrar sobre o maior blob azul de ArrowLeft.ppm (VIRAR_E)
+// e sobre a mesma máscara espelhada na horizontal (VIRAR_D): ver --gerar-modelos em Origem.cpp
+static const vc_modelo_sinal vc_modelos[] = {
+	{ AZUL, VIRAR_E, {
+		0x007FFE00000FF000ULL, 0x03FFFFC001FFFF80ULL, 0x0FFFFFF007FFFFE0ULL, 0x3FFFFFFC1FFFFFF8ULL,
+		0x7FFFC0FE3FFFFFFCULL, 0x7FFFF03E7FFFE07EULL, 0xFFFFF80FFFFFF81FULL, 0xC0000003C0000007ULL,
+		0xC0000007C0000003ULL, 0xFFFFF01FFFFFFC0FULL, 0x7FFFC07E7FFFF03EULL, 0x3FFFFFFC7FFFC0FEULL,
+		0x1FFFFFF83FFFFFFCULL, 0x07FFFFE00FFFFFF0ULL, 0x01FFFF8003FFFFC0ULL, 0x000FF000007FFE00ULL
+	} },
+	{ AZUL, VIRAR_D, {
+		0x007FFE00000FF000ULL, 0x03FFFFC001FFFF80ULL, 0x0FFFFFF007FFFFE0ULL, 0x3FFFFFFC1FFFFFF8ULL,
+		0x7F03FFFE3FFFFFFCULL, 0x7C0FFFFE7E07FFFEULL, 0xF01FFFFFF81FFFFFULL, 0xC0000003E0000003ULL,
+		0xE0000003C0000003ULL, 0xF80FFFFFF03FFFFFULL, 0x7E03FFFE7C0FFFFEULL, 0x3FFFFFFC7F03FFFEULL,
+		0x1FFFFFF83FFFFFFCULL, 0x07FFFFE00FFFFFF0ULL, 0x01FFFF8003FFFFC0ULL, 0x000FF000007FFE00ULL
+	} },
+};
+
+#define VC_NUM_MODELOS ((int)(sizeof(vc_modelos) / sizeof(vc_modelo_sinal)))
+
+/*
+* Função: vc_blob_amostrar
+* ----------------------------
+* Reamostra a máscara de um blob (os píxeis com a sua etiqueta) dentro da caixa delimitadora
+* para uma grelha de 32x32 bits, lendo o píxel do centro de cada célula
+*
+* src  : estrutura da imagem etiquetada (pode ser uma vista)
+* blob : blob com a etiqueta e a caixa delimitadora (coordenadas da imagem inteira)
+* bits : VC_MODELO_PALAVRAS palavras onde guardar a máscara
+*/
+int vc_blob_amostrar(IVC* src, OVC* blob, unsigned long long* bits)
+{
+	unsigned char* data = (unsigned char*)src->data;
+	int bytesperline = src->bytesperline;
+	int x0, y0, gx, gy, x, y;
+	unsigned long long linha;
+	long int pos;
+
+	// Verificação de erros
+	if ((src->width <= 0) || (src->height <= 0) || (data == NULL)) return 0;
+	if (src->channels != 1) return 0;
+	if ((blob == NULL) || (bits == NULL) || (blob->width <= 0) || (blob->height <= 0)) return 0;
+
+	x0 = blob->x - src->xoffset;
+	y0 = blob->y - src->yoffset;
+	if ((x0 < 0) || (y0 < 0) || (x0 + blob->width > src->width) || (y0 + blob->height > src->height)) return 0;
+
+	memset(bits, 0, VC_MODELO_PALAVRAS * sizeof(unsigned long long));
+
+	for (gy = 0; gy < VC_MODELO_LADO; gy++)
+	{
+		// Centro da célula: (2 * g + 1) / (2 * 32) da caixa
+		y = y0 + ((2 * gy + 1) * blob->height) / (2 * VC_MODELO_LADO);
+		pos = y * bytesperline;
+		linha = 0;
+
+		for (gx = 0; gx < VC_MODELO_LADO; gx++)
+		{
+			x = x0 + ((2 * gx + 1) * blob->width) / (2 * VC_MODELO_LADO);
+			linha |= (unsigned long long)(data[pos + x] == blob->label) << gx;
+		}
+
+		bits[gy / 2] |= linha << (32 * (gy % 2));
+	}
+
+	return 1;
+}
+
+/*
+* Função: vc_modelo_distancia
+* ----------------------------
+* Distância de Hamming entre duas máscaras 32x32 (XOR palavra a palavra e contagem dos bits)
+*
+* a, b : máscaras com VC_MODELO_PALAVRAS palavras
+*/
+int vc_modelo_distancia(const unsigned long long* a, const unsigned long long* b)
+{
+	int i, distancia = 0;
+
+	for (i = 0; i < VC_MODELO_PALAVRAS; i++) distancia += VC_POPCOUNT64(a[i] ^ b[i]);
+
+	return distancia;
+}
+
+/*
+* Função: vc_modelo_espelhar
+* ----------------------------
+* Espelha uma máscara 32x32 na horizontal (inverte a ordem dos bits de cada linha)
+*
+* bits    : máscara com VC_MODELO_PALAVRAS palavras
+* espelho : máscara espelhada (não pode ser bits)
+*/
+void vc_modelo_espelhar(const unsigned long long* bits, unsigned long long* espelho)
+{
+	unsigned long long linha, invertida;
+	int y, x;
+
+	memset(espelho, 0, VC_MODELO_PALAVRAS * sizeof(unsigned long long));
+
+	for (y = 0; y < VC_MODELO_LADO; y++)
+	{
+		linha = (bits[y / 2] >> (32 * (y % 2))) & 0xFFFFFFFFULL;
+		invertida = 0;
+		for (x = 0; x < VC_MODELO_LADO; x++) invertida |= ((linha >> x) & 1ULL) << (VC_MODELO_LADO - 1 - x);
+		espelho[y / 2] |= invertida << (32 * (y % 2));
+	}
+}
+
+/*
+* Função: vc_sinal_tem_modelo
+* ----------------------------
+* 1 se há modelos binários deste sinal (com esta cor)
+*
+* sinal : sinal
+* cor   : cor do sinal
+*/
+static int vc_sinal_tem_modelo(Sinal sinal, Cor cor)
+{
+	int m;
+
+	for (m = 0; m < VC_NUM_MODELOS; m++)
+	{
+		if ((vc_modelos[m].cor == cor) && (vc_modelos[m].sinal == sinal)) return 1;
+	}
+
+	return 0;
+}
+
+/*
+* Função: vc_modelo_mais_proximo
+* ----------------------------
+* Compara uma máscara já amostrada com todos os modelos da cor e devolve o sinal do mais próximo
+* (INDEFINIDO se não há modelos desta cor)
+*
+* bits      : máscara do blob (vc_blob_amostrar)
+* cor       : cor com que o blob foi detetado
+* distancia : bits diferentes do modelo mais próximo (-1 = sem modelo)
+*/
+static Sinal vc_modelo_mais_proximo(const unsigned long long* bits, Cor cor, int* distancia)
+{
+	int m, d, melhor = -1, melhorDistancia = VC_MODELO_LADO * VC_MODELO_LADO + 1;
+
+	*distancia = -1;
+
+	for (m = 0; m < VC_NUM_MODELOS; m++)
+	{
+		if (vc_modelos[m].cor != cor) continue;
+
+		d = vc_modelo_distancia(bits, vc_modelos[m].bits);
+		if (d < melhorDistancia)
+		{
+			melhorDistancia = d;
+			melhor = m;
+		}
+	}
+
+	if (melhor < 0) return INDEFINIDO;
+
+	*distancia = melhorDistancia;
+
+	return vc_modelos[melhor].sinal;
+}
+
+/*
+* Função: vc_verificarSinal
+* ----------------------------
+* Verifica um sinal dado pelo classificador comparando a máscara do blob com os modelos
+* da mesma cor: se o sinal tem modelos, fica o sinal do modelo mais próximo, ou INDEFINIDO
+* se nenhum estiver a menos de limiar bits (ex: outro sinal azul parcialmente tapado).
+* Os sinais sem modelos passam sem alteração
+*
+* src       : estrutura da imagem etiquetada (pode ser uma vista)
+* blob      : blob com a etiqueta e a caixa delimitadora (coordenadas da imagem inteira)
+* sinal     : sinal dado pelo classificador
+* cor       : cor com que o blob foi detetado
+* limiar    : máximo de bits diferentes (em VC_MODELO_LADO * VC_MODELO_LADO)
+* distancia : (opcional) bits diferentes do modelo mais próximo (-1 = não verificado)
+*/
+Sinal vc_verificarSinal(IVC* src, OVC* blob, Sinal sinal, Cor cor, int limiar, int* distancia)
+{
+	unsigned long long bits[VC_MODELO_PALAVRAS];
+	Sinal modelo;
+	int d;
+
+	if (distancia != NULL) *distancia = -1;
+
+	if (!vc_sinal_tem_modelo(sinal, cor)) return sinal;
+	if (!vc_blob_amostrar(src, blob, bits)) return sinal;
+
+	modelo = vc_modelo_mais_proximo(bits, cor, &d);
+	if (d < 0) return sinal;
+
+	if (distancia != NULL) *distancia = d;
+
+	return (d <= limiar) ? modelo : INDEFINIDO;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//            FUNÇÕES: CLASSIFICADOR POR TABELA DE REGRAS
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+// Características que as regras compiladas não usam (solidez, buracos e Hu)
+#define VC_REGRA_LIVRE_MIN -FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX
+#define VC_REGRA_LIVRE_MAX FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX
+
+// Tabela compilada: as faixas da proporção de perímetros (perímetro do blob / (largura + altura)),
+// com valores aproximados +/- 0.2. Nas setas, o lado do centro de massa dá a direção.
+// (2.59999967f e 3.39999986f são o float imediatamente abaixo de 2.6f e de 3.4f, ou seja, "< 2.6" e "< 3.4")
+static const RSVC vc_regras_compiladas[] = {
+	// Obrigatório virar à esquerda/direita: proporção de perímetros min: 2.4 max: 2.7
+	{ AZUL, VIRAR_E, { 2.2f, -FLT_MAX, VC_REGRA_LIVRE_MIN }, { 2.9f, -1e-6f, VC_REGRA_LIVRE_MAX } },
+	{ AZUL, VIRAR_D, { 2.2f, 0.0f, VC_REGRA_LIVRE_MIN }, { 2.9f, FLT_MAX, VC_REGRA_LIVRE_MAX } },
+	// Automóveis e motociclos: proporção de perímetros min: 3.2 max: 3.4
+	{ AZUL, AUTOMOVEIS_MOTOCICLOS, { 3.0f, -FLT_MAX, VC_REGRA_LIVRE_MIN }, { 3.6f, FLT_MAX, VC_REGRA_LIVRE_MAX } },
+	// Auto-estrada: proporção de perímetros min: 4.5 max: 4.6
+	{ AZUL, AUTO_ESTRADA, { 4.3f, -FLT_MAX, VC_REGRA_LIVRE_MIN }, { 4.8f, FLT_MAX, VC_REGRA_LIVRE_MAX } },
+	// Sentido proibido: proporção de perímetros min: 2.4 max: 2.4
+	{ VERMELHO, SENTIDO_PROIBIDO, { 2.2f, -FLT_MAX, VC_REGRA_LIVRE_MIN }, { 2.59999967f, FLT_MAX, VC_REGRA_LIVRE_MAX } },
+	// STOP: proporção de perímetros min: 3.1 max: 3.2
+	{ VERMELHO, STOP, { 2.9f, -FLT_MAX, VC_REGRA_LIVRE_MIN }, { 3.39999986f, FLT_MAX, VC_REGRA_LIVRE_MAX } },
+};
+
+// Tabela ativa (a compilada, ou uma carregada de ficheiro)
+static const RSVC* vc_regras = vc_regras_compiladas;
+static int vc_nregras = sizeof(vc_regras_compiladas) / sizeof(RSVC);
+
+/*
+* Função: vc_caracteristicasBlob
+* ----------------------------
+* Preenche o vetor de características de um blob (ver VC_CARAC_*)
+*
+* blob            : blob com o perímetro, a caixa e o centro de massa calculados
+* forma           : (opcional) deteção com os descritores de forma e os momentos (senão ficam a 0)
+* caracteristicas : vetor com VC_NUM_CARACTERISTICAS floats
+*/
+void vc_caracteristicasBlob(OVC* blob, DVC* forma, float* caracteristicas)
+{
+	float perimetroCaixa = (float)(blob->width + blob->height); // *2 para ser mesmo perímetro
+	int centroXCaixa = blob->x + blob->width / 2;
+
+	caracteristicas[VC_CARAC_PERIMETROS] = (float)blob->perimeter / perimetroCaixa;
+	caracteristicas[VC_CARAC_DESVIO_X] = (float)(blob->xc - centroXCaixa) / (float)MAX(blob->width, 1);
+
+	if (forma != NULL)
+	{
+		caracteristicas[VC_CARAC_SOLIDEZ] = forma->solidez;
+		caracteristicas[VC_CARAC_BURACOS] = (float)forma->nburacos;
+		caracteristicas[VC_CARAC_HU1] = (float)forma->momentos.hu[0];
+		caracteristicas[VC_CARAC_HU2] = (float)forma->momentos.hu[1];
+	}
+	else
+	{
+		caracteristicas[VC_CARAC_SOLIDEZ] = 0.0f;
+		caracteristicas[VC_CARAC_BURACOS] = 0.0f;
+		caracteristicas[VC_CARAC_HU1] = 0.0f;
+		caracteristicas[VC_CARAC_HU2] = 0.0f;
+	}
+}
+
+/*
+* Função: vc_classificarRegras
+* ----------------------------
+* Avalia um vetor de características com uma tabela de regras (a primeira regra
+* cumprida dá o sinal). Dentro de cada regra não há saltos: as comparações são todas
+* feitas e juntas com &
+*
+* regras          : tabela de regras (NULL = tabela ativa)
+* nregras         : número de regras
+* caracteristicas : vetor com VC_NUM_CARACTERISTICAS floats
+* cor             : cor com que o blob foi detetado
+*/
+Sinal vc_classificarRegras(const RSVC* regras, int nregras, const float* caracteristicas, Cor cor)
+{
+	const RSVC* regra;
+	int r, f, dentro;
+
+	if (regras == NULL)
+	{
+		regras = vc_regras;
+		nregras = vc_nregras;
+	}
+
+	for (r = 0; r < nregras; r++)
+	{
+		regra = &regras[r];
+
+		dentro = (regra->cor == (int)cor);
+		for (f = 0; f < VC_NUM_CARACTERISTICAS; f++)
+		{
+			dentro &= (caracteristicas[f] >= regra->minimo[f]) & (caracteristicas[f] <= regra->maximo[f]);
+		}
+
+		if (dentro) return (Sinal)regra->sinal;
+	}
+
+	return INDEFINIDO;
+}
+
+/*
+* Função: vc_classificarCaracteristicas
+* ----------------------------
+* Avalia um vetor de características com a tabela de regras ativa
+*
+* caracteristicas : vetor com VC_NUM_CARACTERISTICAS floats
+* cor             : cor com que o blob foi detetado
+*/
+Sinal vc_classificarCaracteristicas(const float* caracteristicas, Cor cor)
+{
+	return vc_classificarRegras(NULL, 0, caracteristicas, cor);
+}
+
+/*
+* Função: vc_classificarLote
+* ----------------------------
+* Classifica n vetores de características guardados seguidos em memória
+*
+* caracteristicas : n * VC_NUM_CARACTERISTICAS floats
+* n               : número de vetores
+* cor             : cor com que os blobs foram detetados
+* sinais          : array onde guardar o sinal de cada vetor
+*/
+int vc_classificarLote(const float* caracteristicas, int n, Cor cor, Sinal* sinais)
+{
+	int i;
+
+	if ((caracteristicas == NULL) || (sinais == NULL) || (n < 0)) return 0;
+
+	for (i = 0; i < n; i++) sinais[i] = vc_classificarCaracteristicas(caracteristicas + i * VC_NUM_CARACTERISTICAS, cor);
+
+	return 1;
+}
+
+/*
+* Função: vc_classificador_definir
+* ----------------------------
+* Troca a tabela de regras ativa. A tabela não é copiada: tem de existir enquanto estiver ativa
+*
+* regras  : tabela de regras (NULL = voltar à tabela compilada)
+* nregras : número de regras
+*/
+int vc_classificador_definir(const RSVC* regras, int nregras)
+{
+	if (regras == NULL)
+	{
+		vc_regras = vc_regras_compiladas;
+		vc_nregras = sizeof(vc_regras_compiladas) / sizeof(RSVC);
+		return 1;
+	}
+
+	if ((nregras <= 0) || (nregras > VC_MAX_REGRAS)) return 0;
+
+	vc_regras = regras;
+	vc_nregras = nregras;
+
+	return 1;
+}
+
+/*
+* Função: vc_classificador_carregar
+* ----------------------------
+* Lê uma tabela de regras de um ficheiro binário: "VCRS", versão (1), número de
+* características, número de regras e as regras (cor, sinal, mínimos e máximos)
+*
+* ficheiro : nome do ficheiro
+* nregras  : endereço onde guardar o número de regras lidas
+*/
+RSVC* vc_classificador_carregar(const char* ficheiro, int* nregras)
+{
+	FILE* file;
+	char assinatura[4];
+	int cabecalho[3]; // Versão, número de características e número de regras
+	RSVC* regras = NULL;
+	int i;
+
+	if ((ficheiro == NULL) || (nregras == NULL)) return NULL;
+	*nregras = 0;
+
+	if ((file = fopen(ficheiro, "rb")) == NULL) return NULL;
+
+	if ((fread(assinatura, 1, 4, file) == 4) && (memcmp(assinatura, "VCRS", 4) == 0) &&
+		(fread(cabecalho, sizeof(int), 3, file) == 3) && (cabecalho[0] == 1) &&
+		(cabecalho[1] == VC_NUM_CARACTERISTICAS) && (cabecalho[2] > 0) && (cabecalho[2] <= VC_MAX_REGRAS))
+	{
+		regras = (RSVC*)malloc(cabecalho[2] * sizeof(RSVC));
+
+		if ((regras != NULL) && (fread(regras, sizeof(RSVC), cabecalho[2], file) == (size_t)cabecalho[2]))
+		{
+			// Cores e sinais têm de existir
+			for (i = 0; i < cabecalho[2]; i++)
+			{
+				if ((regras[i].cor < INDEFINIDA) || (regras[i].cor > VERMELHO) || (regras[i].sinal < INDEFINIDO) || (regras[i].sinal >= VC_NUM_SINAIS)) break;
+			}
+			if (i == cabecalho[2]) *nregras = cabecalho[2];
+		}
+
+		if (*nregras == 0)
+		{
+			free(regras);
+			regras = NULL;
+		}
+	}
+
+	fclose(file);
+
+	return regras;
+}
+
+/*
+* Função: vc_classificador_guardar
+* ----------------------------
+* Escreve uma tabela de regras no formato lido por vc_classificador_carregar
+*
+* ficheiro : nome do ficheiro
+* regras   : tabela de regras (NULL = a tabela compilada)
+* nregras  : número de regras
+*/
+int vc_classificador_guardar(const char* ficheiro, const RSVC* regras, int nregras)
+{
+	FILE* file;
+	int cabecalho[3];
+	int ok;
+
+	if (regras == NULL)
+	{
+		regras = vc_regras_compiladas;
+		nregras = sizeof(vc_regras_compiladas) / sizeof(RSVC);
+	}
+	if ((ficheiro == NULL) || (nregras <= 0) || (nregras > VC_MAX_REGRAS)) return 0;
+
+	if ((file = fopen(ficheiro, "wb")) == NULL) return 0;
+
+	cabecalho[0] = 1;
+	cabecalho[1] = VC_NUM_CARACTERISTICAS;
+	cabecalho[2] = nregras;
+
+	ok = (fwrite("VCRS", 1, 4, file) == 4) && (fwrite(cabecalho, sizeof(int), 3, file) == 3) &&
+		(fwrite(regras, sizeof(RSVC), nregras, file) == (size_t)nregras);
+
+	fclose(file);
+
+	return ok;
+}
+
+/*
+* Função: vc_insertionSort
+* ----------------------------
+* Algoritmo de organização de arrays
+*
+* array[] : array a ordenar
+* tamanho : tamanho do array
+*/
+void vc_insertionSort(int array[], int tamanho)
+{
+	int i, j, atual;
+
+	// Percorrer elementos não ordenados
+	for (i = 1; i < tamanho; i++)
+	{
+		// Elemento a ser comparado com os anteriores
+		atual = array[i];
+
+		j = i - 1;
+		// Percorrer elementos ordenados com índice menor que o atual e valor maior que o atual
+		while (j >= 0 && array[j] > atual)
+		{
+			// Move o elemento um índice para a frente
+			array[j + 1] = array[j];
+			// Continua a percorrer de forma descendente
+			j--;
+		}
+		// Finalmente, coloca-se o elemento atual na posição correta na parte ordenada do array
+		array[j + 1] = atual;
+	}
+}
+
+/*
+* Função: vc_gray_lowpass_median_filter
+* -------------------------------------
+* Algoritmo de organização de arrays
+*
+* src		 : estrutura da imagem de entrada
+* dst		 : estrutura da imagem de saida
+* kernelsize : tamanho do kernel
+*/
+int vc_gray_lowpass_median_filter(IVC* src, IVC* dst, int kernelsize)
+{
+	unsigned char* data = (unsigned char*)src->data;
+	unsigned char* datadst = (unsigned char*)dst->data;
+	int width = src->width;
+	int height = src->height;
+	int bytesperline = src->bytesperline;
+	int channels = src->channels;
+	int x, y, kx, ky, vizinhosCount = 0, centro;
+	int offset = (kernelsize - 1) / 2, tamanhoVizinhos = pow(kernelsize, 2);
+	long int pos, posk;
+	int* vizinhos = (int*)malloc(sizeof(int) * tamanhoVizinhos);
+
+	// Verificação de erros
+	if ((width <= 0) || (height <= 0) || (data == NULL) || (datadst == NULL)) return 0;
+	if ((width != dst->width) || (height != dst->height) || (channels != dst->channels)) return 0;
+	if (channels != 1) return 0;
+	if ((kernelsize <= 1) || (kernelsize % 2 == 0)) return 0; // Kernel tem que ser > 1 e ímpar
+
+	// Percorrer píxeis da imagem original
+	for (y = 1; y < height; y++)
+	{
+		for (x = 1; x < width; x++)
+		{
+			pos = y * dst->bytesperline + x * channels;
+
+			// Percorrer Vizinhos (kernel)
+			for (ky = -offset; ky <= offset; ky++)
+			{
+				for (kx = -offset; kx <= offset; kx++)
+				{
+					if ((y + ky >= 0) && (y + ky < height) && (x + kx >= 0) && (x + kx < width))
+					{
+						posk = (y + ky) * bytesperline + (x + kx) * channels;
+
+						// Adicionar ao array de vizinhos
+						vizinhos[vizinhosCount] = (int)data[posk];
+						vizinhosCount++;
+					}
+				}
+			}
+
+			// Ordenar vizinhos de acordo com o seu valor
+			vc_insertionSort(vizinhos, vizinhosCount);
+
+			// Dar o valor central (mediana)
+			centro = tamanhoVizinhos / 2;
+
+			datadst[pos] = (unsigned char)vizinhos[centro];
+
+			vizinhosCount = 0;
+		}
+	}
+
+	free(vizinhos);
+
+	return 1;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//   FUNÇÕES: MORFOLOGIA BINÁRIA (64 PÍXEIS POR PALAVRA)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+/*
+* Função: vc_binary_morfologia
+* ----------------------------
+* Empacota a imagem binária (1 bit por píxel, != 0 = objeto), aplica a sequência de erosões e
+* dilatações com o elemento estruturante retangular kw x kh (separável: passagem horizontal e
+* vertical) e desempacota para dst (0 ou 255)
+*
+* src, dst   : imagens binárias com as mesmas dimensões (podem ser vistas)
+* kw, kh     : dimensões do elemento estruturante (ímpares, >= 1)
+* operacoes  : sequência de VC_MORF_EROSAO / VC_MORF_DILATACAO
+* noperacoes : número de operações
+*/
+static int vc_binary_morfologia(IVC* src, IVC* dst, int kw, int kh, const int* operacoes, int noperacoes)
+{
+	// Verificação de erros
+	if ((src->width <= 0) || (src->height <= 0) || (src->data == NULL) || (dst->data == NULL)) return 0;
+	if ((src->width != dst->width) || (src->height != dst->height)) return 0;
+	if ((src->channels != 1) || (dst->channels != 1)) return 0;
+	if ((kw < 1) || (kh < 1) || (kw % 2 == 0) || (kh % 2 == 0)) return 0;
+
+	// Empacotar, erosões/dilatações por palavras e desempacotar: nucleos::morfologia (imagem.h)
+	return vc_nucleo_morfologia(src, dst, kw, kh, operacoes, noperacoes);
+}
+
+/*
+* Função: vc_binary_erode
+* ----------------------------
+* Erosão binária com elemento estruturante retangular kw x kh (fora da imagem não conta)
+*
+* src, dst : imagens binárias com as mesmas dimensões
+* kw, kh   : dimensões do elemento estruturante (ímpares)
+*/
+int vc_binary_erode(IVC* src, IVC* dst, int kw, int kh)
+{
+	int operacoes[1] = { VC_MORF_EROSAO };
+
+	return vc_binary_morfologia(src, dst, kw, kh, operacoes, 1);
+}
+
+/*
+* Função: vc_binary_dilate
+* ----------------------------
+* Dilatação binária com elemento estruturante retangular kw x kh
+*
+* src, dst : imagens binárias com as mesmas dimensões
+* kw, kh   : dimensões do elemento estruturante (ímpares)
+*/
+int vc_binary_dilate(IVC* src, IVC* dst, int kw, int kh)
+{
+	int operacoes[1] = { VC_MORF_DILATACAO };
+
+	return vc_binary_morfologia(src, dst, kw, kh, operacoes, 1);
+}
+
+/*
+* Função: vc_binary_open
+* ----------------------------
+* Abertura (erosão seguida de dilatação): elimina os pontos e ramos mais finos que o elemento
+*
+* src, dst : imagens binárias com as mesmas dimensões
+* kw, kh   : dimensões do elemento estruturante (ímpares)
+*/
+int vc_binary_open(IVC* src, IVC* dst, int kw, int kh)
+{
+	int operacoes[2] = { VC_MORF_EROSAO, VC_MORF_DILATACAO };
+
+	return vc_binary_morfologia(src, dst, kw, kh, operacoes, 2);
+}
+
+/*
+* Função: vc_binary_close
+* ----------------------------
+* Fecho (dilatação seguida de erosão): preenche os buracos e falhas mais pequenos que o elemento
+*
+* src, dst : imagens binárias com as mesmas dimensões
+* kw, kh   : dimensões do elemento estruturante (ímpares)
+*/
+int vc_binary_close(IVC* src, IVC* dst, int kw, int kh)
+{
+	int operacoes[2] = { VC_MORF_DILATACAO, VC_MORF_EROSAO };
+
+	return vc_binary_morfologia(src, dst, kw, kh, operacoes, 2);
+}
+
+/*
+* Função: vc_binary_open_close
+* ----------------------------
+* Abertura seguida de fecho, numa só passagem de empacotamento: tira o ruído "salt-and-pepper"
+* de uma máscara binária (pontos isolados e buracos pequenos)
+*
+* src, dst : imagens binárias com as mesmas dimensões
+* kw, kh   : dimensões do elemento estruturante (ímpares)
+*/
+int vc_binary_open_close(IVC* src, IVC* dst, int kw, int kh)
+{
+	int operacoes[4] = { VC_MORF_EROSAO, VC_MORF_DILATACAO, VC_MORF_DILATACAO, VC_MORF_EROSAO };
+
+	return vc_binary_morfologia(src, dst, kw, kh, operacoes, 4);
+}
+
+/*
+* Função: vc_rastreio_iniciar
+* ----------------------------
+* Inicializa o rastreio (começa sem sinal, ou seja, a procurar na imagem inteira)
+*
+* rastreio            : estrutura do rastreio
+* margem              : píxeis a acrescentar a cada lado da última caixa delimitadora
+* intervaloVarrimento : de quantas em quantas frames se processa novamente a imagem inteira
+*/
+void vc_rastreio_iniciar(RVC* rastreio, int margem, int intervaloVarrimento)
+{
+	memset(rastreio, 0, sizeof(RVC));
+	rastreio->ativo = 0;
+	rastreio->cor = INDEFINIDA;
+	rastreio->margem = margem;
+	rastreio->intervaloVarrimento = intervaloVarrimento;
+}
+
+/*
+* Função: vc_rastreio_janela
+* ----------------------------
+* Calcula a janela (ROI) a processar na próxima frame: a última caixa delimitadora
+* expandida pela margem e limitada à imagem.
+* Devolve 0 (processar a imagem inteira) se não há rastreio ativo ou se já passaram
+* intervaloVarrimento frames desde o último varrimento completo
+*
+* rastreio      : estrutura do rastreio
+* width, height : dimensões da imagem inteira
+* x, y, w, h    : janela calculada (só é válida se a função devolver 1)
+*/
+int vc_rastreio_janela(RVC* rastreio, int width, int height, int* x, int* y, int* w, int* h)
+{
+	int xmin, ymin, xmax, ymax;
+
+	// Verificação de erros
+	if ((rastreio == NULL) || (width <= 0) || (height <= 0)) return 0;
+
+	if (!rastreio->ativo) return 0;
+	// Varrimento completo periódico (para encontrar sinais que entraram fora da ROI)
+	if (rastreio->framesDesdeVarrimento >= rastreio->intervaloVarrimento) return 0;
+
+	xmin = MAX(rastreio->blob.x - rastreio->margem, 0);
+	ymin = MAX(rastreio->blob.y - rastreio->margem, 0);
+	xmax = MIN(rastreio->blob.x + rastreio->blob.width - 1 + rastreio->margem, width - 1);
+	ymax = MIN(rastreio->blob.y + rastreio->blob.height - 1 + rastreio->margem, height - 1);
+
+	// Janela demasiado pequena (o etiquetamento limpa o rebordo e o filtro precisa de vizinhos)
+	if ((xmax - xmin < 3) || (ymax - ymin < 3)) return 0;
+
+	*x = xmin;
+	*y = ymin;
+	*w = (xmax - xmin) + 1;
+	*h = (ymax - ymin) + 1;
+
+	return 1;
+}
+
+/*
+* Função: vc_rastreio_atualizar
+* ----------------------------
+* Atualiza o rastreio com o resultado da frame processada
+*
+* rastreio           : estrutura do rastreio
+* blob               : blob detetado nesta frame (coordenadas da imagem inteira) ou NULL se não foi detetado
+* cor                : cor com que o blob foi detetado
+* varrimentoCompleto : 1 se esta frame foi processada na imagem inteira, 0 se foi só na ROI
+*/
+void vc_rastreio_atualizar(RVC* rastreio, OVC* blob, Cor cor, int varrimentoCompleto)
+{
+	if (rastreio == NULL) return;
+
+	// Perdeu o sinal: a próxima frame é processada na imagem inteira
+	if (blob == NULL)
+	{
+		rastreio->ativo = 0;
+		rastreio->cor = INDEFINIDA;
+		rastreio->framesDesdeVarrimento = 0;
+		return;
+	}
+
+	rastreio->ativo = 1;
+	rastreio->blob = *blob;
+	rastreio->cor = cor;
+
+	if (varrimentoCompleto) rastreio->framesDesdeVarrimento = 0;
+	else rastreio->framesDesdeVarrimento++;
+}
+
+/*
+* Função: vc_seguimento_iniciar
+* ----------------------------
+* Inicializa o seguimento temporal (sem trajetos)
+*
+* seguimento : estrutura do seguimento
+*/
+void vc_seguimento_iniciar(SVC* seguimento)
+{
+	memset(seguimento, 0, sizeof(SVC));
+	seguimento->proximoId = 1;
+}
+
+/*
+* Função: vc_sobreposicao_caixas
+* ----------------------------
+* Calcula a sobreposição de duas caixas delimitadoras (interseção a dividir pela união, em %)
+*
+* a, b : blobs com a caixa delimitadora calculada
+*/
+static int vc_sobreposicao_caixas(OVC* a, OVC* b)
+{
+	int x0, y0, x1, y1;
+	long int intersecao, uniao;
+
+	x0 = MAX(a->x, b->x);
+	y0 = MAX(a->y, b->y);
+	x1 = MIN(a->x + a->width, b->x + b->width);
+	y1 = MIN(a->y + a->height, b->y + b->height);
+
+	// As caixas não se tocam
+	if ((x1 <= x0) || (y1 <= y0)) return 0;
+
+	intersecao = (long int)(x1 - x0) * (y1 - y0);
+	uniao = (long int)a->width * a->height + (long int)b->width * b->height - intersecao;
+
+	return (int)(intersecao * 100 / MAX(uniao, 1));
+}
+
+/*
+* Função: vc_trajeto_votar
+* ----------------------------
+* Acrescenta uma classificação ao histórico do trajeto e decide o sinal por votação.
+* O primeiro sinal é aceite logo; depois só muda quando outro sinal tiver mais de
+* metade dos votos do histórico (histerese), para não oscilar com uma frame mal classificada
+*
+* trajeto : trajeto a atualizar
+* voto    : resultado de vc_identificarSinal nesta frame
+*/
+static void vc_trajeto_votar(TVC* trajeto, Sinal voto)
+{
+	int contagem[VC_NUM_SINAIS] = { 0 };
+	Sinal maisVotado = INDEFINIDO;
+	int i;
+
+	// Guarda o voto no buffer circular
+	trajeto->votos[trajeto->proximoVoto] = voto;
+	trajeto->proximoVoto = (trajeto->proximoVoto + 1) % VC_HISTORICO_VOTOS;
+	if (trajeto->nvotos < VC_HISTORICO_VOTOS) trajeto->nvotos++;
+
+	// Conta os votos de cada sinal
+	for (i = 0; i < trajeto->nvotos; i++) contagem[trajeto->votos[i]]++;
+
+	// Sinal mais votado (INDEFINIDO só conta contra os outros, nunca ganha)
+	for (i = INDEFINIDO + 1; i < VC_NUM_SINAIS; i++)
+	{
+		if ((contagem[i] > 0) && ((maisVotado == INDEFINIDO) || (contagem[i] > contagem[maisVotado]))) maisVotado = (Sinal)i;
+	}
+
+	if (trajeto->sinal == INDEFINIDO) trajeto->sinal = maisVotado; // Primeira decisão: sem esperar
+	else if ((maisVotado != trajeto->sinal) && (contagem[maisVotado] * 2 > trajeto->nvotos)) trajeto->sinal = maisVotado;
+
+	trajeto->confianca = contagem[trajeto->sinal] * 100 / trajeto->nvotos;
+}
+
+/*
+* Função: vc_trajeto_classificar
+* ----------------------------
+* Classifica o blob de um trajeto e vota com o resultado. Se o sinal tem modelos binários e
+* a máscara do blob foi dada, o voto passa a ser o do modelo mais próximo, ou INDEFINIDO se
+* nenhum estiver a menos de limiar bits (como em vc_verificarSinal): a verificação é só mais
+* um voto e não muda sozinha a decisão do trajeto. A distância fica guardada no trajeto
+*
+* trajeto         : trajeto do blob
+* caracteristicas : vetor de características do blob
+* mascara         : (opcional) máscara 32x32 do blob (vc_blob_amostrar)
+* limiar          : máximo de bits diferentes do modelo
+* cor, regras, nregras : como em vc_classificarRegras
+*/
+static void vc_trajeto_classificar(TVC* trajeto, const float* caracteristicas, const unsigned long long* mascara, int limiar,
+	Cor cor, const RSVC* regras, int nregras)
+{
+	Sinal voto, modelo;
+	int d;
+
+	voto = vc_classificarRegras(regras, nregras, caracteristicas, cor);
+	trajeto->distanciaModelo = -1;
+
+	if ((mascara != NULL) && vc_sinal_tem_modelo(voto, cor))
+	{
+		modelo = vc_modelo_mais_proximo(mascara, cor, &d);
+		if (d >= 0)
+		{
+			trajeto->distanciaModelo = d;
+			voto = (d <= limiar) ? modelo : INDEFINIDO;
+		}
+	}
+
+	vc_trajeto_votar(trajeto, voto);
+}
+
+/*
+* Função: vc_seguimento_atualizar
+* ----------------------------
+* Associa os blobs desta frame aos trajetos existentes (sobreposição das caixas ou, sem
+* sobreposição, distância entre centros de massa) e cria trajetos para os blobs novos.
+* Só classifica os blobs de trajetos novos, com confiança baixa, cujo blob mudou muito
+* de área, ou a cada VC_INTERVALO_CLASSIFICACAO frames; nos outros casos mantém a decisão
+*
+* seguimento : estrutura do seguimento
+* blobs      : blobs detetados nesta frame (com vc_maiorBlob_info já calculado)
+* nblobs     : número de blobs (pode ser 0, para envelhecer os trajetos)
+* caracteristicas : (opcional) vetores de características dos blobs, seguidos (senão são calculados só com o blob)
+* mascaras   : (opcional) máscaras 32x32 dos blobs (VC_MODELO_PALAVRAS palavras cada), para verificar com
+*              os modelos binários os sinais que os têm, sempre que o trajeto é classificado
+* limiarVerificacao : máximo de bits diferentes do modelo (só com mascaras)
+* cor        : cor com que os blobs foram detetados (só os trajetos desta cor são atualizados)
+* regras     : tabela de regras usada para classificar (NULL = tabela ativa)
+* nregras    : número de regras
+* trajetos   : (opcional) índice do trajeto associado a cada blob, ou -1
+*/
+int vc_seguimento_atualizar(SVC* seguimento, OVC* blobs, int nblobs, const float* caracteristicas, const unsigned long long* mascaras,
+	int limiarVerificacao, Cor cor, const RSVC* regras, int nregras, int* trajetos)
+{
+	float caracteristicasBlob[VC_NUM_CARACTERISTICAS];
+	int associado[VC_MAX_TRAJETOS] = { 0 };
+	int i, t, melhor, melhorPontuacao, pontuacao, limite, dx, dy, variacaoArea;
+	TVC* trajeto;
+
+	// Verificação de erros
+	if (seguimento == NULL) return 0;
+	if ((nblobs > 0) && (blobs == NULL)) return 0;
+
+	for (i = 0; i < nblobs; i++)
+	{
+		melhor = -1;
+		melhorPontuacao = 0;
+
+		// Procura o trajeto da mesma cor, ainda não associado, que melhor corresponde ao blob
+		for (t = 0; t < VC_MAX_TRAJETOS; t++)
+		{
+			trajeto = &seguimento->trajetos[t];
+			if ((trajeto->id == 0) || (trajeto->cor != cor) || associado[t]) continue;
+
+			// Sobreposição das caixas (1..100)
+			pontuacao = vc_sobreposicao_caixas(&trajeto->blob, &blobs[i]);
+
+			// Sem sobreposição: aceita se o centro de massa estiver a menos de meia caixa do anterior
+			if (pontuacao == 0)
+			{
+				dx = blobs[i].xc - trajeto->blob.xc;
+				dy = blobs[i].yc - trajeto->blob.yc;
+				limite = MAX(trajeto->blob.width, trajeto->blob.height) / 2;
+				if (dx * dx + dy * dy <= limite * limite) pontuacao = 1;
+			}
+
+			if (pontuacao > melhorPontuacao)
+			{
+				melhorPontuacao = pontuacao;
+				melhor = t;
+			}
+		}
+
+		// Blob novo: ocupa uma posição livre
+		if (melhor < 0)
+		{
+			for (t = 0; t < VC_MAX_TRAJETOS; t++)
+			{
+				if (seguimento->trajetos[t].id == 0)
+				{
+					melhor = t;
+					break;
+				}
+			}
+
+			// Não há espaço para mais trajetos
+			if (melhor < 0)
+			{
+				if (trajetos != NULL) trajetos[i] = -1;
+				continue;
+			}
+
+			trajeto = &seguimento->trajetos[melhor];
+			memset(trajeto, 0, sizeof(TVC));
+			trajeto->id = seguimento->proximoId++;
+			trajeto->cor = cor;
+			trajeto->sinal = INDEFINIDO;
+		}
+
+		trajeto = &seguimento->trajetos[melhor];
+		associado[melhor] = 1;
+		trajeto->blob = blobs[i];
+		trajeto->framesPerdido = 0;
+		trajeto->framesDesdeClassificacao++;
+
+		// Variação da área desde a última classificação (em %)
+		variacaoArea = blobs[i].area - trajeto->areaClassificacao;
+		if (variacaoArea < 0) variacaoArea = -variacaoArea;
+		variacaoArea = variacaoArea * 100 / MAX(trajeto->areaClassificacao, 1);
+
+		// Classificação completa só quando é necessária
+		if ((trajeto->nvotos < VC_HISTORICO_VOTOS / 2) ||
+			(trajeto->confianca < VC_CONFIANCA_MINIMA) ||
+			(trajeto->framesDesdeClassificacao >= VC_INTERVALO_CLASSIFICACAO) ||
+			(variacaoArea > 25))
+		{
+			if (caracteristicas == NULL) vc_caracteristicasBlob(&blobs[i], NULL, caracteristicasBlob);
+			vc_trajeto_classificar(trajeto, (caracteristicas != NULL) ? caracteristicas + i * VC_NUM_CARACTERISTICAS : caracteristicasBlob,
+				(mascaras != NULL) ? mascaras + i * VC_MODELO_PALAVRAS : NULL, limiarVerificacao, cor, regras, nregras);
+			seguimento->nclassificacoes++;
+
+			trajeto->framesDesdeClassificacao = 0;
+			trajeto->areaClassificacao = blobs[i].area;
+		}
+
+		if (trajetos != NULL) trajetos[i] = melhor;
+	}
+
+	// Envelhece os trajetos desta cor que não foram vistos nesta frame
+	for (t = 0; t < VC_MAX_TRAJETOS; t++)
+	{
+		trajeto = &seguimento->trajetos[t];
+		if ((trajeto->id == 0) || (trajeto->cor != cor) || associado[t]) continue;
+
+		trajeto->framesPerdido++;
+		if (trajeto->framesPerdido > VC_MAX_FRAMES_PERDIDO) memset(trajeto, 0, sizeof(TVC));
+	}
+
+	return 1;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//        FUNÇÕES: DETEÇÃO DE ALTERAÇÕES ENTRE FRAMES
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+/*
+* Função: vc_alteracoes_novo
+* ----------------------------
+* Aloca a deteção de alterações para frames com as dimensões dadas
+*
+* width, height : dimensões das frames
+* limiar        : diferença média (por amostra e canal, 0 a 255) a partir da qual um bloco mudou
+*/
+AVC* vc_alteracoes_novo(int width, int height, int limiar)
+{
+	AVC* alteracoes;
+	int nblocos;
+
+	// Verificação de erros
+	if ((width <= 0) || (height <= 0)) return NULL;
+
+	alteracoes = (AVC*)calloc(1, sizeof(AVC));
+	if (alteracoes == NULL) return NULL;
+
+	alteracoes->width = width;
+	alteracoes->height = height;
+	alteracoes->blocosX = (width + VC_BLOCO_ALTERACOES - 1) / VC_BLOCO_ALTERACOES;
+	alteracoes->blocosY = (height + VC_BLOCO_ALTERACOES - 1) / VC_BLOCO_ALTERACOES;
+	alteracoes->limiar = limiar;
+	alteracoes->cor = INDEFINIDA;
+	nblocos = alteracoes->blocosX * alteracoes->blocosY;
+
+	alteracoes->referencia = (unsigned char*)malloc((size_t)nblocos * VC_AMOSTRAS_BLOCO);
+	alteracoes->valido = (unsigned char*)calloc(nblocos, sizeof(unsigned char));
+	// Cada janela é uma sequência de blocos numa linha, por isso nunca há mais janelas que blocos
+	alteracoes->janelas = (int(*)[4])malloc((size_t)nblocos * sizeof(int[4]));
+	alteracoes->candidatos = (DVC*)malloc(VC_MAX_DETECOES * sizeof(DVC));
+
+	if ((alteracoes->referencia == NULL) || (alteracoes->valido == NULL) ||
+		(alteracoes->janelas == NULL) || (alteracoes->candidatos == NULL))
+	{
+		return vc_alteracoes_libertar(alteracoes);
+	}
+
+	return alteracoes;
+}
+
+/*
+* Função: vc_alteracoes_libertar
+* ----------------------------
+* Liberta a deteção de alterações
+*
+* alteracoes : estrutura da deteção de alterações
+*/
+AVC* vc_alteracoes_libertar(AVC* alteracoes)
+{
+	if (alteracoes != NULL)
+	{
+		free(alteracoes->referencia);
+		free(alteracoes->valido);
+		free(alteracoes->janelas);
+		free(alteracoes->candidatos);
+		free(alteracoes);
+	}
+
+	return NULL;
+}
+
+/*
+* Função: vc_alteracoes_comparar
+* ----------------------------
+* Compara cada bloco da frame com a referência (soma das diferenças absolutas de uma amostra
+* dos píxeis). Os blocos que mudaram passam a ter a frame atual como referência e deixam de ter
+* resultado válido para qualquer cor. A referência só muda quando o bloco muda, por isso uma
+* variação lenta acaba por ultrapassar o limiar.
+* O número de blocos alterados fica em alteracoes->nalterados
+*
+* alteracoes : estrutura da deteção de alterações
+* frame      : frame BGR com as dimensões dadas em vc_alteracoes_novo
+*/
+int vc_alteracoes_comparar(AVC* alteracoes, IVC* frame)
+{
+	AVC* a = alteracoes;
+	unsigned char* data, * referencia;
+	int bytesperline, bx, by, b, x, y, xmax, ymax, pos, k, soma;
+
+	// Verificação de erros
+	if ((a == NULL) || (frame == NULL) || (frame->data == NULL)) return 0;
+	if ((frame->width != a->width) || (frame->height != a->height) || (frame->channels != 3)) return 0;
+
+	data = (unsigned char*)frame->data;
+	bytesperline = frame->bytesperline;
+	a->nalterados = 0;
+
+	for (by = 0, b = 0; by < a->blocosY; by++)
+	{
+		ymax = MIN((by + 1) * VC_BLOCO_ALTERACOES, a->height);
+
+		for (bx = 0; bx < a->blocosX; bx++, b++)
+		{
+			xmax = MIN((bx + 1) * VC_BLOCO_ALTERACOES, a->width);
+			referencia = a->referencia + (size_t)b * VC_AMOSTRAS_BLOCO;
+			soma = 0;
+			k = 0;
+
+			for (y = by * VC_BLOCO_ALTERACOES; y < ymax; y += VC_PASSO_ALTERACOES)
+			{
+				for (x = bx * VC_BLOCO_ALTERACOES; x < xmax; x += VC_PASSO_ALTERACOES, k += 3)
+				{
+					pos = y * bytesperline + x * 3;
+					soma += abs((int)data[pos] - (int)referencia[k]);
+					soma += abs((int)data[pos + 1] - (int)referencia[k + 1]);
+					soma += abs((int)data[pos + 2] - (int)referencia[k + 2]);
+				}
+			}
+
+			if (a->iniciado && (soma <= a->limiar * k)) continue;
+
+			// Bloco alterado: nova referência e nenhuma cor tem resultado válido
+			for (y = by * VC_BLOCO_ALTERACOES, k = 0; y < ymax; y += VC_PASSO_ALTERACOES)
+			{
+				for (x = bx * VC_BLOCO_ALTERACOES; x < xmax; x += VC_PASSO_ALTERACOES, k += 3)
+				{
+					pos = y * bytesperline + x * 3;
+					referencia[k] = data[pos];
+					referencia[k + 1] = data[pos + 1];
+					referencia[k + 2] = data[pos + 2];
+				}
+			}
+			a->valido[b] = 0;
+			a->nalterados++;
+		}
+	}
+
+	a->iniciado = 1;
+
+	return 1;
+}
+
+/*
+* Função: vc_alteracoes_invalidar
+* ----------------------------
+* Descarta o resultado guardado de todos os blocos (a referência mantém-se)
+*
+* alteracoes : estrutura da deteção de alterações
+*/
+void vc_alteracoes_invalidar(AVC* alteracoes)
+{
+	if (alteracoes == NULL) return;
+
+	memset(alteracoes->valido, 0, (size_t)alteracoes->blocosX * alteracoes->blocosY);
+	alteracoes->ncandidatos = 0;
+	alteracoes->cor = INDEFINIDA;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//    FUNÇÕES: GRAVAÇÃO E REPRODUÇÃO DE MÁSCARAS (RLE)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+// Cabeçalho do ficheiro ("VCMS" + versão) e de cada registo (8 ints)
+#define VC_MASCARAS_CABECALHO (4 + sizeof(int))
+#define VC_MASCARAS_CABECALHO_REGISTO (8 * sizeof(int))
+
+/*
+* Função: vc_mascaras_ficheiro_abrir
+* ----------------------------
+* Abre o ficheiro das máscaras para acrescentar registos no fim (se não existir, é criado
+* com o cabeçalho). Devolve NULL se o ficheiro existir e não for um ficheiro de máscaras
+*
+* ficheiro : nome do ficheiro
+*/
+static FILE* vc_mascaras_ficheiro_abrir(const char* ficheiro)
+{
+	FILE* file;
+	char cabecalho[VC_MASCARAS_CABECALHO];
+	int versao = 1, ok;
+	size_t lidos;
+
+	if (ficheiro == NULL) return NULL;
+
+	// "a+b": as escritas vão sempre para o fim, mas o cabeçalho pode ser lido
+	if ((file = fopen(ficheiro, "a+b")) == NULL) return NULL;
+
+	fseek(file, 0, SEEK_SET);
+	lidos = fread(cabecalho, 1, VC_MASCARAS_CABECALHO, file);
+	fseek(file, 0, SEEK_END); // Entre uma leitura e uma escrita tem de haver um fseek
+	if (lidos == 0)
+	{
+		ok = (fwrite("VCMS", 1, 4, file) == 4) && (fwrite(&versao, sizeof(int), 1, file) == 1);
+	}
+	else
+	{
+		ok = (lidos == VC_MASCARAS_CABECALHO) && (memcmp(cabecalho, "VCMS", 4) == 0) && (memcmp(cabecalho + 4, &versao, sizeof(int)) == 0);
+	}
+
+	if (!ok)
+	{
+		fclose(file);
+		return NULL;
+	}
+
+	return file;
+}
+
+/*
+* Função: vc_mascaras_gravacao_nova
+* ----------------------------
+* Abre o ficheiro das máscaras para acrescentar registos no fim (ver vc_mascaras_ficheiro_abrir)
+*
+* ficheiro : nome do ficheiro
+*/
+GMVC* vc_mascaras_gravacao_nova(const char* ficheiro)
+{
+	GMVC* gravacao;
+	FILE* file = vc_mascaras_ficheiro_abrir(ficheiro);
+
+	if (file == NULL) return NULL;
+
+	if ((gravacao = (GMVC*)calloc(1, sizeof(GMVC))) == NULL)
+	{
+		fclose(file);
+		return NULL;
+	}
+	gravacao->ficheiro = file;
+
+	return gravacao;
+}
+
+/*
+* Função: vc_mascaras_gravacao_encaminhar
+* ----------------------------
+* Gravação sem escritas no disco na thread que processa: o ficheiro é aberto só para confirmar
+* (ou escrever) o cabeçalho e cada registo codificado é entregue a escrever, que o deve
+* acrescentar ao fim do ficheiro (por exemplo, na thread de uma gravação assíncrona)
+*
+* ficheiro : nome do ficheiro
+* escrever : recebe o registo (cabeçalho e segmentos seguidos) e o tamanho em bytes; devolve 0 se não o aceitou
+* destino  : primeiro argumento de escrever
+*/
+GMVC* vc_mascaras_gravacao_encaminhar(const char* ficheiro, int (*escrever)(void* destino, const void* registo, long bytes), void* destino)
+{
+	GMVC* gravacao;
+	FILE* file;
+
+	if (escrever == NULL) return NULL;
+
+	file = vc_mascaras_ficheiro_abrir(ficheiro);
+	if (file == NULL) return NULL;
+	if ((fclose(file) != 0) || ((gravacao = (GMVC*)calloc(1, sizeof(GMVC))) == NULL)) return NULL;
+
+	gravacao->escrever = escrever;
+	gravacao->destino = destino;
+
+	return gravacao;
+}
+
+/*
+* Função: vc_mascaras_gravar
+* ----------------------------
+* Acrescenta um registo com a máscara codificada por segmentos (início e comprimento de cada
+* sequência de píxeis != 0 em cada linha). O fundo é saltado 8 píxeis de cada vez
+*
+* gravacao : gravação aberta
+* mascara  : imagem binária (pode ser uma vista; xoffset e yoffset ficam no registo)
+* frame    : índice da frame
+* cor      : cor segmentada
+*/
+int vc_mascaras_gravar(GMVC* gravacao, IVC* mascara, long frame, Cor cor)
+{
+	unsigned char* linha;
+	unsigned short* c, * contagem, * codigo;
+	unsigned long long palavra;
+	long maximo, n, nsegmentos = 0;
+	int cabecalho[8], x, y, inicio, width, height;
+
+	// Verificação de erros
+	if ((gravacao == NULL) || ((gravacao->ficheiro == NULL) && (gravacao->escrever == NULL)) || (mascara == NULL) || (mascara->data == NULL)) return 0;
+	if ((mascara->channels != 1) || (mascara->width <= 0) || (mascara->height <= 0) || (mascara->width > 65535)) return 0;
+
+	width = mascara->width;
+	height = mascara->height;
+
+	// Pior caso: um segmento a cada 2 píxeis (e 1 de enchimento), depois do cabeçalho
+	maximo = VC_MASCARAS_CABECALHO_REGISTO / sizeof(unsigned short) + (long)height * (width + 2) + 1;
+	if (maximo > gravacao->tamanhoCodigo)
+	{
+		codigo = (unsigned short*)realloc(gravacao->codigo, maximo * sizeof(unsigned short));
+		if (codigo == NULL) return 0;
+		gravacao->codigo = codigo;
+		gravacao->tamanhoCodigo = maximo;
+	}
+
+	c = gravacao->codigo + VC_MASCARAS_CABECALHO_REGISTO / sizeof(unsigned short);
+	for (y = 0; y < height; y++)
+	{
+		linha = mascara->data + y * mascara->bytesperline;
+		contagem = c++;
+		*contagem = 0;
+
+		for (x = 0; x < width;)
+		{
+			// Fundo: 8 píxeis de cada vez
+			while (x + 8 <= width)
+			{
+				memcpy(&palavra, linha + x, 8);
+				if (palavra != 0) break;
+				x += 8;
+			}
+			while ((x < width) && (linha[x] == 0)) x++;
+			if (x == width) break;
+
+			inicio = x;
+			while ((x < width) && (linha[x] != 0)) x++;
+			*c++ = (unsigned short)inicio;
+			*c++ = (unsigned short)(x - inicio);
+			(*contagem)++;
+		}
+		nsegmentos += *contagem;
+	}
+
+	// Completa o registo até um múltiplo de 4 bytes
+	n = (long)(c - gravacao->codigo) - VC_MASCARAS_CABECALHO_REGISTO / sizeof(unsigned short);
+	if (n % 2)
+	{
+		*c = 0;
+		n++;
+	}
+
+	cabecalho[0] = (int)(VC_MASCARAS_CABECALHO_REGISTO + n * sizeof(unsigned short));
+	cabecalho[1] = (int)frame;
+	cabecalho[2] = (int)cor;
+	cabecalho[3] = mascara->xoffset;
+	cabecalho[4] = mascara->yoffset;
+	cabecalho[5] = width;
+	cabecalho[6] = height;
+	cabecalho[7] = (int)nsegmentos;
+
+	// O cabeçalho fica no início do espaço do código: o registo inteiro é um só bloco
+	memcpy(gravacao->codigo, cabecalho, VC_MASCARAS_CABECALHO_REGISTO);
+	if (gravacao->escrever != NULL)
+	{
+		if (!gravacao->escrever(gravacao->destino, gravacao->codigo, cabecalho[0])) return 0;
+	}
+	else if (fwrite(gravacao->codigo, 1, cabecalho[0], gravacao->ficheiro) != (size_t)cabecalho[0]) return 0;
+
+	gravacao->registos++;
+	gravacao->bytes += cabecalho[0];
+
+	return 1;
+}
+
+/*
+* Função: vc_mascaras_gravacao_libertar
+* ----------------------------
+* Fecha o ficheiro das máscaras e liberta a gravação
+*
+* gravacao : gravação
+*/
+GMVC* vc_mascaras_gravacao_libertar(GMVC* gravacao)
+{
+	if (gravacao != NULL)
+	{
+		if (gravacao->ficheiro != NULL) fclose(gravacao->ficheiro);
+		free(gravacao->codigo);
+		free(gravacao);
+	}
+
+	return NULL;
+}
+
+/*
+* Função: vc_mascaras_reproducao_abrir
+* ----------------------------
+* Mapeia em memória um ficheiro de máscaras e percorre os cabeçalhos dos registos (conta-os e
+* calcula a frame que os contém a todos). Um registo cortado a meio (gravação interrompida) é o fim
+*
+* ficheiro : nome do ficheiro
+*/
+RMVC* vc_mascaras_reproducao_abrir(const char* ficheiro)
+{
+	RMVC* reproducao;
+	unsigned char* mapa;
+	long tamanho = 0, posicao;
+	int cabecalho[8], versao = 1;
+
+	if (ficheiro == NULL) return NULL;
+
+	mapa = (unsigned char*)vc_mapear_ficheiro(ficheiro, &tamanho);
+	if (mapa == NULL) return NULL;
+
+	if ((tamanho < (long)VC_MASCARAS_CABECALHO) || (memcmp(mapa, "VCMS", 4) != 0) || (memcmp(mapa + 4, &versao, sizeof(int)) != 0) ||
+		((reproducao = (RMVC*)calloc(1, sizeof(RMVC))) == NULL))
+	{
+		vc_desmapear_ficheiro(mapa, tamanho);
+		return NULL;
+	}
+
+	reproducao->mapa = mapa;
+	reproducao->tamanho = tamanho;
+
+	for (posicao = VC_MASCARAS_CABECALHO; posicao + (long)VC_MASCARAS_CABECALHO_REGISTO <= tamanho; posicao += cabecalho[0])
+	{
+		memcpy(cabecalho, mapa + posicao, sizeof(cabecalho));
+		if ((cabecalho[0] < (int)VC_MASCARAS_CABECALHO_REGISTO) || (cabecalho[0] % 4) || (posicao + cabecalho[0] > tamanho)) break;
+		if ((cabecalho[3] < 0) || (cabecalho[4] < 0) || (cabecalho[5] <= 0) || (cabecalho[6] <= 0)) break;
+
+		reproducao->registos++;
+		reproducao->width = MAX(reproducao->width, cabecalho[3] + cabecalho[5]);
+		reproducao->height = MAX(reproducao->height, cabecalho[4] + cabecalho[6]);
+	}
+	reproducao->fim = posicao;
+
+	vc_mascaras_reproducao_reiniciar(reproducao);
+
+	return reproducao;
+}
+
+/*
+* Função: vc_mascaras_reproduzir
+* ----------------------------
+* Descodifica o próximo registo em dst, na posição onde a máscara estava na frame
+* (as linhas da máscara são apagadas e os segmentos preenchidos a 255)
+*
+* reproducao : reprodução aberta
+* dst        : imagem binária com pelo menos reproducao->width x reproducao->height
+* mascara    : fica uma vista sobre a máscara em dst (com a posição na frame)
+* frame, cor : (opcionais) frame e cor do registo
+*/
+int vc_mascaras_reproduzir(RMVC* reproducao, IVC* dst, IVC* mascara, long* frame, Cor* cor)
+{
+	const unsigned short* c, * fim;
+	unsigned char* linha;
+	int cabecalho[8], y, k, n, inicio, comprimento;
+
+	// Verificação de erros
+	if ((reproducao == NULL) || (dst == NULL) || (mascara == NULL) || (dst->channels != 1)) return 0;
+	if (reproducao->posicao + (long)VC_MASCARAS_CABECALHO_REGISTO > reproducao->fim) return 0;
+
+	memcpy(cabecalho, reproducao->mapa + reproducao->posicao, sizeof(cabecalho));
+	if (!vc_image_view(dst, mascara, cabecalho[3], cabecalho[4], cabecalho[5], cabecalho[6])) return 0;
+
+	c = (const unsigned short*)(reproducao->mapa + reproducao->posicao + VC_MASCARAS_CABECALHO_REGISTO);
+	fim = (const unsigned short*)(reproducao->mapa + reproducao->posicao + cabecalho[0]);
+
+	for (y = 0; y < mascara->height; y++)
+	{
+		linha = mascara->data + y * mascara->bytesperline;
+		memset(linha, 0, mascara->width);
+
+		n = (c < fim) ? *c++ : 0;
+		for (k = 0; (k < n) && (c + 2 <= fim); k++)
+		{
+			inicio = *c++;
+			comprimento = *c++;
+			if (inicio + comprimento <= mascara->width) memset(linha + inicio, 255, comprimento);
+		}
+	}
+
+	if (frame != NULL) *frame = cabecalho[1];
+	if (cor != NULL) *cor = (Cor)cabecalho[2];
+	reproducao->posicao += cabecalho[0];
+
+	return 1;
+}
+
+/*
+* Função: vc_mascaras_reproducao_reiniciar
+* ----------------------------
+* Volta ao primeiro registo
+*
+* reproducao : reprodução aberta
+*/
+void vc_mascaras_reproducao_reiniciar(RMVC* reproducao)
+{
+	if (reproducao != NULL) reproducao->posicao = VC_MASCARAS_CABECALHO;
+}
+
+/*
+* Função: vc_mascaras_reproducao_libertar
+* ----------------------------
+* Desfaz o mapeamento do ficheiro e liberta a reprodução
+*
+* reproducao : reprodução
+*/
+RMVC* vc_mascaras_reproducao_libertar(RMVC* reproducao)
+{
+	if (reproducao != NULL)
+	{
+		vc_desmapear_ficheiro(reproducao->mapa, reproducao->tamanho);
+		free(reproducao);
+	}
+
+	return NULL;
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//     FUNÇÕES: FRAMES EM MEMÓRIA PARTILHADA (SÓ EM LINUX)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+#ifdef __linux__
+
+/*
+* Função: vc_memoria_mapear
+* ----------------------------
+* Mapeia a memória partilhada (o descritor é fechado) e cria a estrutura que a descreve
+*
+* descritor : descritor devolvido por shm_open
+* tamanho   : bytes a mapear
+* nome      : nome da memória partilhada
+* produtor  : 1 = foi criada aqui
+*/
+static FPVC* vc_memoria_mapear(int descritor, long tamanho, const char* nome, int produtor)
+{
+	FPVC* memoria;
+	void* mapa;
+
+	mapa = mmap(NULL, (size_t)tamanho, PROT_READ | PROT_WRITE, MAP_SHARED, descritor, 0);
+	close(descritor);
+	if (mapa == MAP_FAILED) return NULL;
+
+	memoria = (FPVC*)calloc(1, sizeof(FPVC));
+	if (memoria == NULL)
+	{
+		munmap(mapa, (size_t)tamanho);
+		return NULL;
+	}
+
+	memoria->cabecalho = (MPVC*)mapa;
+	memoria->tamanho = tamanho;
+	memoria->produtor = produtor;
+	memoria->slot = -1;
+	snprintf(memoria->nome, sizeof(memoria->nome), "%s", nome);
+
+	return memoria;
+}
+
+/*
+* Função: vc_memoria_vista
+* ----------------------------
+* Preenche frame como uma vista sobre um slot do anel (os dados continuam na memória partilhada)
+*
+* memoria : anel mapeado
+* slot    : índice do slot
+* frame   : imagem a preencher
+*/
+static void vc_memoria_vista(FPVC* memoria, int slot, IVC* frame)
+{
+	MPVC* c = memoria->cabecalho;
+
+	frame->data = (unsigned char*)c + c->dados + (long)slot * c->tamanhoSlot;
+	frame->width = c->width;
+	frame->height = c->height;
+	frame->channels = 3;
+	frame->levels = 255;
+	frame->bytesperline = c->bytesperline;
+	frame->xoffset = 0;
+	frame->yoffset = 0;
+}
+
+/*
+* Função: vc_memoria_criar
+* ----------------------------
+* Cria o anel: o cabeçalho seguido de nslots slots de width x height BGR, cada um a começar
+* numa página nova (por isso os consumidores podem mapear os slots só para leitura). Um anel
+* anterior com o mesmo nome é removido
+*
+* nome          : nome da memória partilhada ("/nome")
+* width, height : dimensões das frames
+* nslots        : número de slots (2 a VC_MEMORIA_MAX_SLOTS)
+*/
+FPVC* vc_memoria_criar(const char* nome, int width, int height, int nslots)
+{
+	FPVC* memoria;
+	MPVC* c;
+	long pagina = sysconf(_SC_PAGESIZE), slot, dados, tamanho;
+	int descritor;
+
+	if ((nome == NULL) || (width <= 0) || (height <= 0) || (nslots < 2) || (nslots > VC_MEMORIA_MAX_SLOTS)) return NULL;
+
+	slot = (((long)width * 3 * height + pagina - 1) / pagina) * pagina;
+	dados = (((long)sizeof(MPVC) + pagina - 1) / pagina) * pagina;
+	tamanho = dados + slot * nslots;
+	if (tamanho > 0x7fffffff) return NULL;
+
+	shm_unlink(nome);
+	descritor = shm_open(nome, O_CREAT | O_EXCL | O_RDWR, 0600);
+	if (descritor < 0) return NULL;
+	if (ftruncate(descritor, tamanho) != 0)
+	{
+		close(descritor);
+		shm_unlink(nome);
+		return NULL;
+	}
+
+	memoria = vc_memoria_mapear(descritor, tamanho, nome, 1);
+	if (memoria == NULL)
+	{
+		shm_unlink(nome);
+		return NULL;
+	}
+
+	// A memória nova vem a zeros: nenhuma frame publicada e todos os slots vazios
+	c = memoria->cabecalho;
+	c->versao = 2;
+	c->width = width;
+	c->height = height;
+	c->bytesperline = width * 3;
+	c->nslots = nslots;
+	c->tamanhoSlot = (int)slot;
+	c->dados = (int)dados;
+	// A magia é escrita por último: quem a vê tem o resto do cabeçalho
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	memcpy(c->magia, "VCFR", 4);
+
+	return memoria;
+}
+
+/*
+* Função: vc_memoria_slot
+* ----------------------------
+* Dá ao produtor o próximo slot para preencher no lugar: o seguinte ao último que escreveu
+* que não esteja reservado por um consumidor. O slot é marcado como vazio antes de ser
+* reescrito e só depois se confirma que não tem reservas (o consumidor reserva e só depois
+* confirma a marca, por isso um dos dois vê sempre o outro). Se todos estiverem reservados,
+* o slot seguinte é reescrito na mesma e o consumidor sabe-o em vc_memoria_confirmar
+*
+* memoria : anel criado com vc_memoria_criar
+* frame   : devolve a vista sobre o slot
+*/
+int vc_memoria_slot(FPVC* memoria, IVC* frame)
+{
+	MPVC* c;
+	unsigned int anterior;
+	int slot = 0, i;
+
+	if ((memoria == NULL) || (!memoria->produtor) || (frame == NULL)) return 0;
+
+	c = memoria->cabecalho;
+	memoria->atual = c->sequencia + 1;
+	if (memoria->atual == 0) memoria->atual = 1; // 0 está reservado para "nenhuma frame"
+
+	for (i = 1; i <= c->nslots; i++)
+	{
+		slot = (memoria->slot + i) % c->nslots;
+		if (slot < 0) slot += c->nslots;
+
+		anterior = __atomic_exchange_n(&c->slots[slot], 0u, __ATOMIC_SEQ_CST);
+		// A marca tem de ficar visível antes de ler as reservas (e de qualquer escrita nos dados do slot)
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		if ((i == c->nslots) || (__atomic_load_n(&c->reservas[slot], __ATOMIC_SEQ_CST) == 0)) break;
+
+		// Reservado: a frame que lá está continua intacta
+		__atomic_store_n(&c->slots[slot], anterior, __ATOMIC_RELEASE);
+	}
+	memoria->slot = slot;
+
+	vc_memoria_vista(memoria, slot, frame);
+
+	return 1;
+}
+
+/*
+* Função: vc_memoria_publicar
+* ----------------------------
+* Publica o slot preenchido depois de vc_memoria_slot e acorda os consumidores à espera
+*
+* memoria : anel criado com vc_memoria_criar
+*/
+int vc_memoria_publicar(FPVC* memoria)
+{
+	MPVC* c;
+	int slot;
+
+	if ((memoria == NULL) || (!memoria->produtor) || (memoria->atual == 0) || (memoria->slot < 0)) return 0;
+
+	c = memoria->cabecalho;
+	slot = memoria->slot;
+
+	// Os dados do slot ficam visíveis antes do número da frame
+	__atomic_store_n(&c->slots[slot], memoria->atual, __ATOMIC_RELEASE);
+	__atomic_store_n(&c->sequencia, memoria->atual, __ATOMIC_RELEASE);
+	syscall(SYS_futex, &c->sequencia, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+
+	memoria->frames++;
+
+	return 1;
+}
+
+/*
+* Função: vc_memoria_abrir
+* ----------------------------
+* Liga-se a um anel criado por outro processo (NULL se não existir ou se o cabeçalho não for válido).
+* Só o cabeçalho pode ser escrito (reservas); os slots ficam só de leitura
+*
+* nome : nome da memória partilhada
+*/
+FPVC* vc_memoria_abrir(const char* nome)
+{
+	FPVC* memoria;
+	MPVC* c;
+	struct stat estado;
+	int descritor;
+
+	if (nome == NULL) return NULL;
+
+	descritor = shm_open(nome, O_RDWR, 0);
+	if (descritor < 0) return NULL;
+	if ((fstat(descritor, &estado) != 0) || (estado.st_size < (off_t)sizeof(MPVC)) || (estado.st_size > 0x7fffffff))
+	{
+		close(descritor);
+		return NULL;
+	}
+
+	memoria = vc_memoria_mapear(descritor, (long)estado.st_size, nome, 0);
+	if (memoria == NULL) return NULL;
+
+	c = memoria->cabecalho;
+	if ((memcmp(c->magia, "VCFR", 4) != 0) || (c->versao != 2)) return vc_memoria_fechar(memoria);
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if ((c->nslots < 2) || (c->nslots > VC_MEMORIA_MAX_SLOTS) || (c->width <= 0) || (c->height <= 0) ||
+		(c->bytesperline < c->width * 3) || ((long)c->bytesperline * c->height > c->tamanhoSlot) ||
+		((long)c->dados + (long)c->tamanhoSlot * c->nslots > memoria->tamanho) || (c->dados % sysconf(_SC_PAGESIZE)) ||
+		(mprotect((unsigned char*)c + c->dados, (size_t)(memoria->tamanho - c->dados), PROT_READ) != 0))
+	{
+		return vc_memoria_fechar(memoria);
+	}
+
+	return memoria;
+}
+
+/*
+* Função: vc_memoria_proxima
+* ----------------------------
+* Espera por uma frame nova e entrega a mais recente como uma vista sobre o slot, sem cópia.
+* O slot é reservado (o produtor salta-o) até vc_memoria_confirmar. As frames publicadas
+* entretanto são contadas como perdidas
+* Devolve 1 = frame, 0 = não chegou nenhuma em esperaMs, -1 = o produtor terminou
+*
+* memoria  : anel aberto com vc_memoria_abrir
+* frame    : devolve a vista sobre o slot (válida até vc_memoria_confirmar)
+* esperaMs : tempo máximo de espera (0 = não espera)
+*/
+int vc_memoria_proxima(FPVC* memoria, IVC* frame, int esperaMs)
+{
+	MPVC* c;
+	struct timespec espera;
+	unsigned int sequencia;
+	int slot, esperou = 0;
+
+	if ((memoria == NULL) || (memoria->produtor) || (frame == NULL)) return 0;
+
+	c = memoria->cabecalho;
+
+	// Uma reserva que não foi confirmada é libertada
+	if (memoria->slot >= 0)
+	{
+		__atomic_fetch_sub(&c->reservas[memoria->slot], 1u, __ATOMIC_SEQ_CST);
+		memoria->slot = -1;
+	}
+
+	while (1)
+	{
+		sequencia = __atomic_load_n(&c->sequencia, __ATOMIC_ACQUIRE);
+
+		if ((sequencia != 0) && (sequencia != memoria->atual))
+		{
+			for (slot = 0; (slot < c->nslots) && (__atomic_load_n(&c->slots[slot], __ATOMIC_ACQUIRE) != sequencia); slot++);
+
+			// Reserva e só depois confirma que a frame ainda lá está (ver vc_memoria_slot)
+			if (slot < c->nslots)
+			{
+				__atomic_fetch_add(&c->reservas[slot], 1u, __ATOMIC_SEQ_CST);
+				__atomic_thread_fence(__ATOMIC_SEQ_CST);
+				if (__atomic_load_n(&c->slots[slot], __ATOMIC_SEQ_CST) == sequencia)
+				{
+					if (memoria->atual != 0) memoria->perdidas += (long)(sequencia - memoria->atual - 1);
+					memoria->atual = sequencia;
+					memoria->slot = slot;
+					memoria->frames++;
+					vc_memoria_vista(memoria, slot, frame);
+					return 1;
+				}
+				__atomic_fetch_sub(&c->reservas[slot], 1u, __ATOMIC_SEQ_CST);
+			}
+
+			// O slot já está a ser reescrito: há uma frame ainda mais recente a caminho
+			continue;
+		}
+
+		if (__atomic_load_n(&c->terminado, __ATOMIC_ACQUIRE)) return -1;
+		if ((esperaMs <= 0) || (esperou)) return 0;
+
+		// Dorme até o produtor mudar a sequência (ou até acabar o tempo)
+		espera.tv_sec = esperaMs / 1000;
+		espera.tv_nsec = (long)(esperaMs % 1000) * 1000000L;
+		syscall(SYS_futex, &c->sequencia, FUTEX_WAIT, sequencia, &espera, NULL, 0);
+		esperou = 1;
+	}
+}
+
+/*
+* Função: vc_memoria_confirmar
+* ----------------------------
+* Depois de processar a frame entregue por vc_memoria_proxima, verifica se o produtor não
+* reescreveu o slot entretanto (0 = a frame pode ter ficado misturada com outra; só acontece
+* quando o produtor encontrou todos os slots reservados) e liberta a reserva
+*
+* memoria : anel aberto com vc_memoria_abrir
+*/
+int vc_memoria_confirmar(FPVC* memoria)
+{
+	MPVC* c;
+	int slot, intacta;
+
+	if ((memoria == NULL) || (memoria->produtor) || (memoria->slot < 0)) return 0;
+
+	c = memoria->cabecalho;
+	slot = memoria->slot;
+
+	// As leituras dos dados terminam antes de voltar a ler a marca do slot
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	intacta = (__atomic_load_n(&c->slots[slot], __ATOMIC_RELAXED) == memoria->atual);
+
+	__atomic_fetch_sub(&c->reservas[slot], 1u, __ATOMIC_SEQ_CST);
+	memoria->slot = -1;
+
+	if (intacta) return 1;
+
+	memoria->sobrescritas++;
+	return 0;
+}
+
+/*
+* Função: vc_memoria_fechar
+* ----------------------------
+* Desfaz o mapeamento. O produtor marca ainda o anel como terminado (acordando os consumidores)
+* e remove o nome; os consumidores ligados mantêm o mapeamento até o fecharem
+*
+* memoria : anel
+*/
+FPVC* vc_memoria_fechar(FPVC* memoria)
+{
+	if (memoria != NULL)
+	{
+		// Um consumidor que fecha a meio de uma frame liberta a reserva
+		if (!memoria->produtor && (memoria->slot >= 0)) __atomic_fetch_sub(&memoria->cabecalho->reservas[memoria->slot], 1u, __ATOMIC_SEQ_CST);
+
+		if (memoria->produtor)
+		{
+			__atomic_store_n(&memoria->cabecalho->terminado, 1u, __ATOMIC_RELEASE);
+			// Quem já estava no futex acorda agora; quem entrar depois acorda ao fim de esperaMs
+			syscall(SYS_futex, &memoria->cabecalho->sequencia, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+			shm_unlink(memoria->nome);
+		}
+		munmap(memoria->cabecalho, (size_t)memoria->tamanho);
+		free(memoria);
+	}
+
+	return NULL;
+}
+
+#else
+
+// Noutros sistemas (o projeto do Visual Studio) não há anel de memória partilhada
+FPVC* vc_memoria_criar(const char* nome, int width, int height, int nslots)
+{
+	(void)nome; (void)width; (void)height; (void)nslots;
+	return NULL;
+}
+
+int vc_memoria_slot(FPVC* memoria, IVC* frame)
+{
+	(void)memoria; (void)frame;
+	return 0;
+}
+
+int vc_memoria_publicar(FPVC* memoria)
+{
+	(void)memoria;
+	return 0;
+}
+
+FPVC* vc_memoria_abrir(const char* nome)
+{
+	(void)nome;
+	return NULL;
+}
+
+int vc_memoria_proxima(FPVC* memoria, IVC* frame, int esperaMs)
+{
+	(void)memoria; (void)frame; (void)esperaMs;
+	return 0;
+}
+
+int vc_memoria_confirmar(FPVC* memoria)
+{
+	(void)memoria;
+	return 0;
+}
+
+FPVC* vc_memoria_fechar(FPVC* memoria)
+{
+	(void)memoria;
+	return NULL;
+}
+
+#endif
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//      FUNÇÕES: PERFIL DE DESEMPENHO POR ETAPA
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+/*
+* Função: vc_perfil_tempo
+* ----------------------------
+* Tempo atual em nanossegundos (só serve para diferenças). O relógio é monótono, como o
+* std::chrono::steady_clock: não salta quando a hora do sistema é acertada (NTP)
+*/
+static long long vc_perfil_tempo(void)
+{
+#ifdef _WIN32
+	static LARGE_INTEGER frequencia = { 0 };
+	LARGE_INTEGER agora;
+
+	if (frequencia.QuadPart == 0) QueryPerformanceFrequency(&frequencia);
+	QueryPerformanceCounter(&agora);
+
+	return (long long)(agora.QuadPart / frequencia.QuadPart) * 1000000000LL + (agora.QuadPart % frequencia.QuadPart) * 1000000000LL / frequencia.QuadPart;
+#else
+	struct timespec agora;
+
+	clock_gettime(CLOCK_MONOTONIC, &agora);
+
+	return (long long)agora.tv_sec * 1000000000LL + agora.tv_nsec;
+#endif
+}
+
+/*
+* Função: vc_perfil_ler
+* ----------------------------
+* Lê os contadores do processador (todos numa só leitura do grupo) e o tempo para valores.
+* Os contadores que não abriram ficam a 0
+*
+* perfil  : perfil
+* valores : VC_NUM_CONTADORES + 1 valores (o último é o tempo, em ns)
+*/
+static void vc_perfil_ler(PFVC* perfil, long long* valores)
+{
+	int c;
+#ifdef __linux__
+	unsigned long long grupo[1 + VC_NUM_CONTADORES];
+	int i = 0;
+
+	if ((perfil->ncontadores > 0) && (read(perfil->grupo, grupo, (1 + perfil->ncontadores) * sizeof(unsigned long long)) > 0))
+	{
+		// Os valores vêm pela ordem em que os contadores foram abertos
+		for (c = 0; c < VC_NUM_CONTADORES; c++) valores[c] = (perfil->descritores[c] >= 0) ? (long long)grupo[1 + i++] : 0;
+	}
+	else
+#endif
+	{
+		for (c = 0; c < VC_NUM_CONTADORES; c++) valores[c] = 0;
+	}
+
+	valores[VC_NUM_CONTADORES] = vc_perfil_tempo();
+}
+
+/*
+* Função: vc_perfil_novo
+* ----------------------------
+* Cria um perfil e abre os contadores do processador (perf_event_open, só em Linux) num grupo,
+* para serem lidos ao mesmo tempo. Os contadores medem só a thread que cria o perfil e só o
+* código do utilizador. Os que não estiverem disponíveis (outro sistema, contentor sem acesso,
+* perf_event_paranoid, máquina virtual) ficam de fora e o perfil mede pelo menos o tempo
+*/
+PFVC* vc_perfil_novo(void)
+{
+	PFVC* perfil = (PFVC*)calloc(1, sizeof(PFVC));
+	int c;
+#ifdef __linux__
+	// Pela ordem de VC_CONTADOR_*
+	const unsigned int tipos[VC_NUM_CONTADORES] = { PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE };
+	const unsigned long long configuracoes[VC_NUM_CONTADORES] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+		PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+		PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES };
+	struct perf_event_attr atributos;
+#endif
+
+	if (perfil == NULL) return NULL;
+
+	perfil->grupo = -1;
+	for (c = 0; c < VC_NUM_CONTADORES; c++) perfil->descritores[c] = -1;
+
+#ifdef __linux__
+	for (c = 0; c < VC_NUM_CONTADORES; c++)
+	{
+		memset(&atributos, 0, sizeof(atributos));
+		atributos.size = sizeof(atributos);
+		atributos.type = tipos[c];
+		atributos.config = configuracoes[c];
+		atributos.read_format = PERF_FORMAT_GROUP;
+		atributos.exclude_kernel = 1;
+		atributos.exclude_hv = 1;
+
+		// O primeiro que abrir é o líder do grupo
+		perfil->descritores[c] = (int)syscall(SYS_perf_event_open, &atributos, 0, -1, perfil->grupo, 0);
+		if (perfil->descritores[c] < 0) continue;
+
+		if (perfil->grupo < 0) perfil->grupo = perfil->descritores[c];
+		perfil->ncontadores++;
+	}
+#endif
+
+	return perfil;
+}
+
+/*
+* Função: vc_perfil_libertar
+* ----------------------------
+* Fecha os contadores e liberta o perfil
+*
+* perfil : perfil
+*/
+PFVC* vc_perfil_libertar(PFVC* perfil)
+{
+	if (perfil != NULL)
+	{
+#ifdef __linux__
+		int c;
+
+		for (c = 0; c < VC_NUM_CONTADORES; c++)
+		{
+			if (perfil->descritores[c] >= 0) close(perfil->descritores[c]);
+		}
+#endif
+		free(perfil);
+	}
+
+	return NULL;
+}
+
+/*
+* Função: vc_perfil_reiniciar
+* ----------------------------
+* Põe os totais de todas as etapas a zero
+*
+* perfil : perfil
+*/
+void vc_perfil_reiniciar(PFVC* perfil)
+{
+	if (perfil == NULL) return;
+
+	memset(perfil->total, 0, sizeof(perfil->total));
+	memset(perfil->pixeis, 0, sizeof(perfil->pixeis));
+	memset(perfil->chamadas, 0, sizeof(perfil->chamadas));
+}
+
+/*
+* Função: vc_perfil_inicio
+* ----------------------------
+* Marca o início de uma etapa (sem perfil não faz nada)
+*
+* perfil : perfil (ou NULL)
+*/
+void vc_perfil_inicio(PFVC* perfil)
+{
+	if (perfil != NULL) vc_perfil_ler(perfil, perfil->inicio);
+}
+
+/*
+* Função: vc_perfil_fim
+* ----------------------------
+* Acumula na etapa o que os contadores e o relógio andaram desde vc_perfil_inicio
+*
+* perfil : perfil (ou NULL)
+* etapa  : VC_ETAPA_*
+* pixeis : píxeis processados pela etapa (para as médias por píxel)
+*/
+void vc_perfil_fim(PFVC* perfil, int etapa, long pixeis)
+{
+	long long fim[VC_NUM_CONTADORES + 1];
+	int c;
+
+	if ((perfil == NULL) || (etapa < 0) || (etapa >= VC_NUM_ETAPAS)) return;
+
+	vc_perfil_ler(perfil, fim);
+	for (c = 0; c <= VC_NUM_CONTADORES; c++) perfil->total[etapa][c] += fim[c] - perfil->inicio[c];
+	perfil->pixeis[etapa] += pixeis;
+	perfil->chamadas[etapa]++;
+}
+
+/*
+* Função: vc_perfil_relatorio
+* ----------------------------
+* Escreve, por etapa: chamadas, tempo, instruções por ciclo (IPC) e falhas (cache L1 de dados,
+* último nível de cache e previsão de saltos) por píxel. "-" = contador indisponível
+*
+* perfil : perfil
+* file   : destino (ex: stdout)
+*/
+void vc_perfil_relatorio(PFVC* perfil, FILE* file)
+{
+	const char* nomes[VC_NUM_ETAPAS] = { "hsv", "segmentacao", "filtro", "etiquetagem", "contornos", "classificacao", "marcacao" };
+	long long* t;
+	double pixeis;
+	char ipc[16], falhas[3][16];
+	int e, c;
+
+	if ((perfil == NULL) || (file == NULL)) return;
+
+	if (perfil->ncontadores == 0) fprintf(file, "Contadores do processador indisponíveis (perf_event_open): só o tempo\n");
+
+	fprintf(file, "%-14s %8s %10s %9s %6s %10s %10s %10s\n", "etapa", "chamadas", "ms/chamada", "ns/pixel", "IPC", "L1/pixel", "LLC/pixel", "saltos/px");
+	for (e = 0; e < VC_NUM_ETAPAS; e++)
+	{
+		if (perfil->chamadas[e] == 0) continue;
+
+		t = perfil->total[e];
+		pixeis = (perfil->pixeis[e] > 0) ? (double)perfil->pixeis[e] : 1.0;
+
+		if ((perfil->descritores[VC_CONTADOR_CICLOS] >= 0) && (perfil->descritores[VC_CONTADOR_INSTRUCOES] >= 0) && (t[VC_CONTADOR_CICLOS] > 0))
+		{
+			snprintf(ipc, sizeof(ipc), "%.2f", (double)t[VC_CONTADOR_INSTRUCOES] / t[VC_CONTADOR_CICLOS]);
+		}
+		else snprintf(ipc, sizeof(ipc), "-");
+
+		for (c = VC_CONTADOR_FALHAS_L1; c <= VC_CONTADOR_FALHAS_SALTOS; c++)
+		{
+			if (perfil->descritores[c] >= 0) snprintf(falhas[c - VC_CONTADOR_FALHAS_L1], sizeof(falhas[0]), "%.4f", t[c] / pixeis);
+			else snprintf(falhas[c - VC_CONTADOR_FALHAS_L1], sizeof(falhas[0]), "-");
+		}
+
+		fprintf(file, "%-14s %8ld %10.3f %9.2f %6s %10s %10s %10s\n", nomes[e], perfil->chamadas[e],
+			t[VC_NUM_CONTADORES] / 1e6 / perfil->chamadas[e], t[VC_NUM_CONTADORES] / pixeis, ipc, falhas[0], falhas[1], falhas[2]);
+	}
+}
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//            FUNÇÕES: PROCESSAMENTO DE UMA FRAME
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+/*
+* Função: vc_processamento_novo
+* ----------------------------
+* Aloca as imagens e inicializa o estado para processar um vídeo
+*
+* width  : largura das frames
+* height : altura das frames
+*/
+PVC* vc_processamento_novo(int width, int height)
+{
+	PVC* processamento = (PVC*)calloc(1, sizeof(PVC));
+
+	if (processamento == NULL) return NULL;
+
+	processamento->imagemCamera = vc_image_new(width, height, 3, 255);
+	processamento->imagemHSV = vc_image_new(width, height, 3, 255);
+	processamento->imagemSegmentada = vc_image_new(width, height, 1, 255);
+	processamento->imagemSemRuido = vc_image_new(width, height, 1, 255);
+	processamento->imagemLabels = vc_image_new(width, height, 1, 255);
+	processamento->imagemBoundingBox = vc_image_new(width, height, 3, 255);
+	// Metade da resolução chega para os fatores 2 e 4 da pirâmide
+	processamento->imagemReduzida = vc_image_new(MAX(width / 2, 1), MAX(height / 2, 1), 3, 255);
+	// Blocos 32x32; mudam se a diferença média passar de 10 (acima do ruído de uma câmara fixa)
+	processamento->alteracoes = vc_alteracoes_novo(width, height, 10);
+	processamento->ocupacao = vc_ocupacao_novo(width, height);
+	// Cada janela dos blocos alterados tem pelo menos um bloco; as da pirâmide são uma por candidato
+	if (processamento->alteracoes != NULL)
+	{
+		processamento->maxRegioesMascaras = processamento->alteracoes->blocosX * processamento->alteracoes->blocosY + VC_MAX_DETECOES;
+		processamento->regioesMascaras = (int(*)[4])malloc((size_t)processamento->maxRegioesMascaras * sizeof(int[4]));
+	}
+
+	if ((processamento->imagemCamera == NULL) || (processamento->imagemHSV == NULL) ||
+		(processamento->imagemSegmentada == NULL) || (processamento->imagemSemRuido == NULL) ||
+		(processamento->imagemLabels == NULL) || (processamento->imagemBoundingBox == NULL) ||
+		(processamento->imagemReduzida == NULL) || (processamento->alteracoes == NULL) ||
+		(processamento->ocupacao == NULL) || (processamento->regioesMascaras == NULL))
+	{
+		return vc_processamento_libertar(processamento);
+	}
+
+	// Valores usados até agora no main
+	processamento->modoRastreio = 1;
+	processamento->modoMultiObjeto = 0;
+	processamento->areaMinima = 6000;
+	processamento->larguraMinima = 0;
+	processamento->alturaMinima = 0;
+	processamento->kernelMediana = 7;
+	processamento->filtroRuido = VC_FILTRO_MEDIANA;
+	processamento->kernelMorfologia = 3; // Com ruído até ~2%, 3x3 erra tão pouco como a mediana 7x7 (ver --benchmark-ruido)
+	processamento->fatorPiramide = 1;
+	processamento->modoVerificacao = 0;
+	processamento->limiarVerificacao = 160; // ~15% dos 1024 bits
+	processamento->modoAlteracoes = 0;
+	processamento->modoOcupacao = 1;
+	vc_limites_iniciar(processamento->limites);
+	processamento->tabelaCores = NULL;
+	processamento->gravacaoMascaras = NULL;
+	processamento->perfil = NULL;
+	processamento->frames = 0;
+	processamento->cor = AZUL;
+
+	// Margem de 48 píxeis à volta da última deteção e varrimento completo a cada 30 frames
+	vc_rastreio_iniciar(&processamento->rastreio, 48, 30);
+	vc_seguimento_iniciar(&processamento->seguimento);
+
+	return processamento;
+}
+
+/*
+* Função: vc_processamento_libertar
+* ----------------------------
+* Liberta as imagens e a estrutura do processamento
+*
+* processamento : estrutura do processamento
+*/
+PVC* vc_processamento_libertar(PVC* processamento)
+{
+	if (processamento != NULL)
+	{
+		vc_image_free(processamento->imagemCamera);
+		vc_image_free(processamento->imagemHSV);
+		vc_image_free(processamento->imagemSegmentada);
+		vc_image_free(processamento->imagemSemRuido);
+		vc_image_free(processamento->imagemLabels);
+		vc_image_free(processamento->imagemBoundingBox);
+		vc_image_free(processamento->imagemReduzida);
+		vc_alteracoes_libertar(processamento->alteracoes);
+		vc_ocupacao_libertar(processamento->ocupacao);
+		free(processamento->regioesMascaras);
+		free(processamento);
+	}
+
+	return NULL;
+}
+
+/*
+* Função: vc_caixaEnvolvente
+* ----------------------------
+* Calcula a caixa delimitadora que contém as caixas de todos os blobs
+*
+* blobs  : blobs com a caixa delimitadora calculada
+* nblobs : número de blobs (> 0)
+* caixa  : blob onde guardar a caixa (e o centro de massa do maior blob)
+*/
+static void vc_caixaEnvolvente(OVC* blobs, int nblobs, OVC* caixa)
+{
+	int i, xmax, ymax;
+
+	*caixa = blobs[0];
+	xmax = blobs[0].x + blobs[0].width - 1;
+	ymax = blobs[0].y + blobs[0].height - 1;
+
+	for (i = 1; i < nblobs; i++)
+	{
+		caixa->x = MIN(caixa->x, blobs[i].x);
+		caixa->y = MIN(caixa->y, blobs[i].y);
+		xmax = MAX(xmax, blobs[i].x + blobs[i].width - 1);
+		ymax = MAX(ymax, blobs[i].y + blobs[i].height - 1);
+	}
+
+	caixa->width = (xmax - caixa->x) + 1;
+	caixa->height = (ymax - caixa->y) + 1;
+}
+
+/*
+* Função: vc_processamento_vistas
+* ----------------------------
+* Preenche as vistas das imagens de trabalho do processamento sobre a mesma região
+*
+* processamento : estrutura do processamento
+* x, y, w, h    : região (nas coordenadas da imagem inteira)
+* restantes     : vistas a preencher
+*/
+static void vc_processamento_vistas(PVC* processamento, int x, int y, int w, int h,
+	IVC* hsv, IVC* segmentada, IVC* semRuido, IVC* labels)
+{
+	vc_image_view(processamento->imagemHSV, hsv, x, y, w, h);
+	vc_image_view(processamento->imagemSegmentada, segmentada, x, y, w, h);
+	vc_image_view(processamento->imagemSemRuido, semRuido, x, y, w, h);
+	vc_image_view(processamento->imagemLabels, labels, x, y, w, h);
+}
+
+/*
+* Função: vc_filtro_kernel
+* ----------------------------
+* Tamanho do kernel do filtro de ruído escolhido (mediana ou elemento estruturante)
+*
+* processamento : estrutura do processamento
+*/
+static int vc_filtro_kernel(PVC* processamento)
+{
+	return (processamento->filtroRuido == VC_FILTRO_MEDIANA) ? processamento->kernelMediana : processamento->kernelMorfologia;
+}
+
+/*
+* Função: vc_filtro_alcance
+* ----------------------------
+* Píxeis à volta de uma região de que o filtro de ruído precisa para dar dentro dela o mesmo
+* que na imagem inteira (com folga): cada erosão ou dilatação chega a kernel / 2 píxeis
+*
+* filtro : VC_FILTRO_*
+* kernel : tamanho do kernel (mediana ou elemento estruturante)
+*/
+static int vc_filtro_alcance(int filtro, int kernel)
+{
+	if (filtro == VC_FILTRO_ABERTURA) return 2 * kernel;
+	if (filtro == VC_FILTRO_ABERTURA_FECHO) return 4 * kernel;
+
+	return kernel;
+}
+
+/*
+* Função: vc_filtro_margem
+* ----------------------------
+* Alcance do filtro de ruído escolhido, com o kernel da resolução original
+*
+* processamento : estrutura do processamento (filtro e kernel)
+*/
+static int vc_filtro_margem(PVC* processamento)
+{
+	return vc_filtro_alcance(processamento->filtroRuido, vc_filtro_kernel(processamento));
+}
+
+/*
+* Função: vc_filtrar_ruido
+* ----------------------------
+* Elimina o ruído "salt-and-pepper" da máscara com o filtro escolhido
+*
+* processamento   : estrutura do processamento (filtro)
+* segmentada      : máscara segmentada
+* semRuido        : máscara filtrada (mesmas dimensões)
+* kernel          : tamanho do kernel (já reduzido, na pirâmide)
+*/
+static void vc_filtrar_ruido(PVC* processamento, IVC* segmentada, IVC* semRuido, int kernel)
+{
+	if (processamento->filtroRuido == VC_FILTRO_ABERTURA) vc_binary_open(segmentada, semRuido, kernel, kernel);
+	else if (processamento->filtroRuido == VC_FILTRO_ABERTURA_FECHO) vc_binary_open_close(segmentada, semRuido, kernel, kernel);
+	else vc_gray_lowpass_median_filter(segmentada, semRuido, kernel);
+}
 
-	// Percorre cada blob
-	for (i = 0; i < nblobs; i++)
+/*
+* Função: vc_janelas_juntar
+* ----------------------------
+* Junta as janelas que se sobrepõem até não haver sobreposições (senão a mesma região
+* seria processada duas vezes). Devolve o novo número de janelas
+*
+* janelas  : janelas (x0, y0, x1, y1, inclusive)
+* njanelas : número de janelas
+*/
+static int vc_janelas_juntar(int (*janelas)[4], int njanelas)
+{
+	int i, j, juntou;
+
+	do
 	{
-		blobs[i].area = 0;
+		juntou = 0;
+		for (i = 0; i < njanelas; i++)
+		{
+			for (j = i + 1; j < njanelas; j++)
+			{
+				if ((janelas[i][0] <= janelas[j][2]) && (janelas[j][0] <= janelas[i][2]) &&
+					(janelas[i][1] <= janelas[j][3]) && (janelas[j][1] <= janelas[i][3]))
+				{
+					janelas[i][0] = MIN(janelas[i][0], janelas[j][0]);
+					janelas[i][1] = MIN(janelas[i][1], janelas[j][1]);
+					janelas[i][2] = MAX(janelas[i][2], janelas[j][2]);
+					janelas[i][3] = MAX(janelas[i][3], janelas[j][3]);
+
+					// A última janela passa para a posição j
+					njanelas--;
+					janelas[j][0] = janelas[njanelas][0];
+					janelas[j][1] = janelas[njanelas][1];
+					janelas[j][2] = janelas[njanelas][2];
+					janelas[j][3] = janelas[njanelas][3];
+					juntou = 1;
+					j--;
+				}
+			}
+		}
+	} while (juntou);
 
-		// Percorre cada píxel da imagem etiquetada
-		for (y = 1; y < height - 1; y++)
+	return njanelas;
+}
+
+/*
+* Função: vc_ocupacao_janelas
+* ----------------------------
+* Janelas (nas coordenadas da máscara) à volta dos blocos ocupados, alargadas halo píxeis e juntas
+* as que se sobrepõem. Fora delas a máscara filtrada é vazia, por isso cada blob fica todo numa janela.
+* Devolve o número de janelas, ou -1 se a máscara não for esparsa (compensa processá-la inteira)
+*
+* ocupacao      : mapa de ocupação da máscara
+* width, height : dimensões da máscara
+* halo          : margem à volta dos blocos ocupados
+*/
+static int vc_ocupacao_janelas(OCVC* ocupacao, int width, int height, int halo)
+{
+	int (*janelas)[4] = ocupacao->janelas;
+	int bx, by, inicio, njanelas = 0;
+
+	// Com muitos blocos ocupados, as janelas já cobrem quase tudo e juntá-las custa mais do que poupam
+	if (4 * ocupacao->nocupados > ocupacao->blocosX * ocupacao->blocosY) return -1;
+
+	// Uma janela por sequência de blocos ocupados na mesma linha (as vizinhas são juntas a seguir)
+	for (by = 0; by < ocupacao->blocosY; by++)
+	{
+		for (bx = 0; bx < ocupacao->blocosX; bx++)
 		{
-			for (x = 1; x < width - 1; x++)
+			if (ocupacao->contagem[by * ocupacao->blocosX + bx] == 0) continue;
+
+			inicio = bx;
+			while ((bx + 1 < ocupacao->blocosX) && (ocupacao->contagem[by * ocupacao->blocosX + bx + 1] > 0)) bx++;
+
+			janelas[njanelas][0] = MAX(inicio * VC_BLOCO_OCUPACAO - halo, 0);
+			janelas[njanelas][1] = MAX(by * VC_BLOCO_OCUPACAO - halo, 0);
+			janelas[njanelas][2] = MIN((bx + 1) * VC_BLOCO_OCUPACAO - 1 + halo, width - 1);
+			janelas[njanelas][3] = MIN((by + 1) * VC_BLOCO_OCUPACAO - 1 + halo, height - 1);
+			njanelas++;
+		}
+	}
+
+	return vc_janelas_juntar(janelas, njanelas);
+}
+
+/*
+* Função: vc_etiquetar_janelas
+* ----------------------------
+* Filtra e etiqueta só as janelas do mapa de ocupação (o resto da máscara filtrada e das etiquetas
+* fica a 0). Os blobs são devolvidos pela ordem em que a etiquetagem da região inteira os daria
+* (ordem do primeiro píxel de cada um), por isso o resultado é o mesmo
+*
+* processamento  : estrutura do processamento (filtro e mínimos)
+* ocupacao       : mapa com as janelas calculadas
+* njanelas       : número de janelas
+* segmentada, ...: imagens (ou vistas) da região, todas com as mesmas dimensões
+* kernel         : kernel do filtro (já reduzido, na pirâmide)
+* areaMinima     : área mínima (já reduzida, na pirâmide)
+* fator          : fator de redução das imagens
+* nblobs         : número de blobs devolvidos
+* momentos       : (opcional) array paralelo com os momentos "crus"
+*/
+static OVC* vc_etiquetar_janelas(PVC* processamento, OCVC* ocupacao, int njanelas, IVC* segmentada, IVC* semRuido, IVC* labels,
+	int kernel, int areaMinima, int fator, int* nblobs, MVC** momentos)
+{
+	PVC* p = processamento;
+	IVC seg, sem, lab;
+	OVC* blobs = NULL, * novos, * ovc, blob;
+	MVC* mnovos = NULL, * mvc, mom;
+	long* chaves = NULL, * lvc, chave;
+	unsigned char* linha;
+	int nnovos, i, j, k, x, y, w, h, n = 0;
+
+	*nblobs = 0;
+	if (momentos != NULL) *momentos = NULL;
+
+	// Fora das janelas não há nada (como se a região inteira fosse filtrada e etiquetada)
+	for (y = 0; y < semRuido->height; y++)
+	{
+		memset(semRuido->data + y * semRuido->bytesperline, 0, semRuido->width);
+		memset(labels->data + y * labels->bytesperline, 0, labels->width);
+	}
+
+	for (i = 0; i < njanelas; i++)
+	{
+		x = ocupacao->janelas[i][0];
+		y = ocupacao->janelas[i][1];
+		w = ocupacao->janelas[i][2] - x + 1;
+		h = ocupacao->janelas[i][3] - y + 1;
+
+		vc_image_view(segmentada, &seg, x, y, w, h);
+		vc_image_view(semRuido, &sem, x, y, w, h);
+		vc_image_view(labels, &lab, x, y, w, h);
+
+		vc_perfil_inicio(p->perfil);
+		vc_filtrar_ruido(p, &seg, &sem, kernel);
+		vc_perfil_fim(p->perfil, VC_ETAPA_FILTRO, (long)w * h);
+
+		vc_perfil_inicio(p->perfil);
+		novos = vc_binary_blob_labelling_filtrado(&sem, &lab, &nnovos, areaMinima, p->larguraMinima / fator, p->alturaMinima / fator,
+			(momentos != NULL) ? &mnovos : NULL);
+		vc_perfil_fim(p->perfil, VC_ETAPA_ETIQUETAGEM, (long)w * h);
+		if (novos == NULL) continue;
+
+		ovc = (OVC*)realloc(blobs, (n + nnovos) * sizeof(OVC));
+		lvc = (long*)realloc(chaves, (n + nnovos) * sizeof(long));
+		mvc = (momentos != NULL) ? (MVC*)realloc(*momentos, (n + nnovos) * sizeof(MVC)) : NULL;
+		if (ovc != NULL) blobs = ovc;
+		if (lvc != NULL) chaves = lvc;
+		if (mvc != NULL) *momentos = mvc;
+		if ((ovc == NULL) || (lvc == NULL) || ((momentos != NULL) && (mvc == NULL)))
+		{
+			free(novos);
+			free(mnovos);
+			n = 0;
+			break;
+		}
+
+		for (j = 0; j < nnovos; j++)
+		{
+			// Chave = posição (na ordem de varrimento) do primeiro píxel do blob, na primeira linha da caixa
+			linha = lab.data + (novos[j].y - lab.yoffset) * lab.bytesperline;
+			for (x = novos[j].x - lab.xoffset; linha[x] != novos[j].label; x++);
+			chaves[n] = (long)novos[j].y * 65536 + x + lab.xoffset;
+
+			// Inserção ordenada pela chave
+			blob = novos[j];
+			chave = chaves[n];
+			if (momentos != NULL) mom = mnovos[j];
+			for (k = n; (k > 0) && (chaves[k - 1] > chave); k--)
 			{
-				pos = y * bytesperline + x; // * channels; (channels = 1)
+				blobs[k] = blobs[k - 1];
+				chaves[k] = chaves[k - 1];
+				if (momentos != NULL) (*momentos)[k] = (*momentos)[k - 1];
+			}
+			blobs[k] = blob;
+			chaves[k] = chave;
+			if (momentos != NULL) (*momentos)[k] = mom;
+			n++;
+		}
 
-				// Se o píxel pertencer ao blob de que estamos à procura
-				if (data[pos] == blobs[i].label)
+		free(novos);
+		free(mnovos);
+		mnovos = NULL;
+	}
+
+	free(chaves);
+	if (n == 0)
+	{
+		free(blobs);
+		if (momentos != NULL)
+		{
+			free(*momentos);
+			*momentos = NULL;
+		}
+		return NULL;
+	}
+
+	*nblobs = n;
+
+	return blobs;
+}
+
+/*
+* Função: vc_candidatos_blobs
+* ----------------------------
+* A etiquetagem já deu a área, a caixa e o centro de massa; falta o perímetro e os descritores
+* de forma, que saem do contorno de cada blob (sem voltar a percorrer a região inteira).
+* Acrescenta os blobs a candidatos e devolve quantos foram
+*
+* labels        : imagem (ou vista) etiquetada onde estão os blobs
+* blobs         : blobs da etiquetagem
+* momentos      : (opcional) momentos "crus" de cada blob
+* nblobs        : número de blobs
+* fator         : fator de redução (> 1 = procura grosseira da pirâmide, onde só interessa a caixa)
+* cor           : cor segmentada
+* candidatos    : array onde acrescentar os candidatos
+* maxCandidatos : espaço livre em candidatos
+*/
+static int vc_candidatos_blobs(IVC* labels, OVC* blobs, MVC* momentos, int nblobs, int fator, Cor cor,
+	DVC* candidatos, int maxCandidatos)
+{
+	CVC contorno;
+	int i, n = 0;
+
+	for (i = 0; (i < nblobs) && (n < maxCandidatos); i++)
+	{
+		memset(&candidatos[n], 0, sizeof(DVC));
+		if ((fator == 1) && vc_blob_contorno(labels, &blobs[i], &contorno))
+		{
+			candidatos[n].verticesHull = contorno.verticesHull;
+			candidatos[n].cantos = contorno.cantos;
+			candidatos[n].nburacos = contorno.nburacos;
+			candidatos[n].solidez = contorno.solidez;
+			vc_contorno_libertar(&contorno);
+		}
+		if (momentos != NULL)
+		{
+			candidatos[n].momentos = momentos[i];
+			vc_momentos_invariantes(&candidatos[n].momentos);
+		}
+		candidatos[n].blob = blobs[i];
+		candidatos[n].cor = cor;
+		n++;
+	}
+
+	return n;
+}
+
+/*
+* Função: vc_processar_regiao
+* ----------------------------
+* Converte para HSV e segmenta a cor atual (ou segmenta pela tabela de cores), filtra, etiqueta (eliminando os blobs pequenos)
+* e segue o contorno exterior dos blobs que ficaram (descritores de forma); o perímetro, os buracos
+* e os momentos vêm da própria etiquetagem. Acrescenta-os a candidatos e devolve quantos foram.
+* Com fator > 1 as imagens estão reduzidas: os mínimos de área e de caixa e o kernel da
+* mediana são reduzidos na mesma proporção (a área com folga, pois só se procuram candidatos).
+* Com modoOcupacao e uma máscara esparsa, só filtra e etiqueta à volta dos blocos com píxeis da cor
+*
+* processamento  : estrutura do processamento (cor e mínimos)
+* camera, ...    : imagens (ou vistas) de entrada e de trabalho, todas com as mesmas dimensões
+* fator          : fator de redução das imagens (1 = resolução original)
+* candidatos     : array onde acrescentar os blobs (só são preenchidos o blob, a cor, a forma e os momentos)
+* maxCandidatos  : espaço livre em candidatos
+*/
+static int vc_processar_regiao(PVC* processamento, IVC* camera, IVC* hsv, IVC* segmentada, IVC* semRuido, IVC* labels,
+	int fator, DVC* candidatos, int maxCandidatos)
+{
+	PVC* p = processamento;
+	OCVC* ocupacao = p->modoOcupacao ? p->ocupacao : NULL;
+	OVC* blobs;
+	MVC* momentos = NULL;
+	int nblobs, n, njanelas = -1, i;
+	int kernel = vc_filtro_kernel(p), areaMinima = p->areaMinima;
+	long pixeis = (long)camera->width * camera->height, pixeisBlobs = 0;
+
+	if (fator > 1)
+	{
+		kernel = (kernel / fator) | 1; // Tem de ser ímpar...
+		if (kernel < 3) kernel = 3; // ... e > 1
+		areaMinima = areaMinima / (fator * fator * 2);
+	}
+
+	if (p->modoCroma && vc_croma_atual(&p->caixas[p->cor], &p->limites[p->cor]))
+	{
+		// Segmentar diretamente a imagem BGR com a caixa de crominância da cor (sem HSV nem tabela)
+		vc_perfil_inicio(p->perfil);
+		if (!vc_croma_segmentar(&p->caixas[p->cor], camera, segmentada, ocupacao)) ocupacao = NULL;
+		vc_perfil_fim(p->perfil, VC_ETAPA_SEGMENTACAO, pixeis);
+	}
+	else if (vc_tabela_cores_atual(p->tabelaCores, p->limites))
+	{
+		// Segmentar diretamente a imagem BGR (uma consulta da tabela por píxel, sem HSV)
+		// (o mapa de ocupação é contado na mesma passagem)
+		vc_perfil_inicio(p->perfil);
+		if (!vc_tabela_cores_segmentar(p->tabelaCores, camera, segmentada, p->cor, ocupacao)) ocupacao = NULL;
+		vc_perfil_fim(p->perfil, VC_ETAPA_SEGMENTACAO, pixeis);
+	}
+	else
+	{
+		// Converter BGR para HSV
+		vc_perfil_inicio(p->perfil);
+		vc_bgr_to_hsv(camera, hsv);
+		vc_perfil_fim(p->perfil, VC_ETAPA_HSV, pixeis);
+
+		// Segmentar imagem HSV
+		vc_perfil_inicio(p->perfil);
+		vc_hsv_segmentar_limites(hsv, segmentada, &p->limites[p->cor]);
+		if ((ocupacao != NULL) && !vc_ocupacao_contar(ocupacao, segmentada)) ocupacao = NULL;
+		vc_perfil_fim(p->perfil, VC_ETAPA_SEGMENTACAO, pixeis);
+	}
+
+	// Janelas à volta dos blocos com píxeis da cor (mais 1 píxel: o rebordo que a etiquetagem limpa)
+	if (ocupacao != NULL)
+	{
+		njanelas = vc_ocupacao_janelas(ocupacao, segmentada->width, segmentada->height, vc_filtro_alcance(p->filtroRuido, kernel) + 1);
+	}
+
+	if (njanelas >= 0)
+	{
+		// Máscara esparsa: filtrar e etiquetar só as janelas
+		blobs = vc_etiquetar_janelas(p, ocupacao, njanelas, segmentada, semRuido, labels, kernel, areaMinima, fator, &nblobs,
+			(fator == 1) ? &momentos : NULL);
+	}
+	else
+	{
+		// Eliminar ruído "salt-and-pepper"
+		vc_perfil_inicio(p->perfil);
+		vc_filtrar_ruido(p, segmentada, semRuido, kernel);
+		vc_perfil_fim(p->perfil, VC_ETAPA_FILTRO, pixeis);
+
+		// Etiquetar blobs da imagem
+		// (os blobs sem tamanho para serem um sinal de trânsito são eliminados logo na etiquetagem)
+		// (os momentos são acumulados na mesma passagem; na procura grosseira da pirâmide não são precisos)
+		vc_perfil_inicio(p->perfil);
+		blobs = vc_binary_blob_labelling_filtrado(semRuido, labels, &nblobs, areaMinima, p->larguraMinima / fator, p->alturaMinima / fator,
+			(fator == 1) ? &momentos : NULL);
+		vc_perfil_fim(p->perfil, VC_ETAPA_ETIQUETAGEM, pixeis);
+	}
+
+	// Região da máscara filtrada a gravar no fim da frame (só na resolução original; uma região
+	// reprocessada depois de alargada substitui a anterior, ver vc_processar_blocos)
+	if ((fator == 1) && (p->gravacaoMascaras != NULL) && (p->nregioesMascaras < p->maxRegioesMascaras))
+	{
+		p->regioesMascaras[p->nregioesMascaras][0] = semRuido->xoffset;
+		p->regioesMascaras[p->nregioesMascaras][1] = semRuido->yoffset;
+		p->regioesMascaras[p->nregioesMascaras][2] = semRuido->width;
+		p->regioesMascaras[p->nregioesMascaras][3] = semRuido->height;
+		p->nregioesMascaras++;
+	}
+
+	if (blobs == NULL) return 0;
+
+	// Os contornos só percorrem o contorno exterior de cada blob
+	for (i = 0; i < nblobs; i++) pixeisBlobs += blobs[i].perimeter;
+
+	vc_perfil_inicio(p->perfil);
+	n = vc_candidatos_blobs(labels, blobs, momentos, nblobs, fator, p->cor, candidatos, maxCandidatos);
+	vc_perfil_fim(p->perfil, VC_ETAPA_CONTORNOS, pixeisBlobs);
+
+	free(blobs);
+	free(momentos);
+
+	return n;
+}
+
+/*
+* Função: vc_processar_piramide
+* ----------------------------
+* Procura os candidatos numa versão reduzida da frame e refina-os na resolução original,
+* processando só janelas à volta de cada candidato (as janelas que se sobrepõem são juntas)
+*
+* processamento : estrutura do processamento (com fatorPiramide 2 ou 4)
+* candidatos    : array onde guardar os blobs refinados
+* maxCandidatos : tamanho de candidatos
+*/
+static int vc_processar_piramide(PVC* processamento, DVC* candidatos, int maxCandidatos)
+{
+	PVC* p = processamento;
+	IVC reduzida, hsv, segmentada, semRuido, labels, camera;
+	DVC grosseiros[VC_MAX_DETECOES];
+	int janelas[VC_MAX_DETECOES][4]; // x0, y0, x1, y1 (inclusive) na resolução original
+	int fator = p->fatorPiramide;
+	int width = p->imagemCamera->width, height = p->imagemCamera->height;
+	int w = width / fator, h = height / fator;
+	int margem = 2 * fator + vc_filtro_margem(p); // Erro da posição na imagem reduzida + vizinhos do filtro
+	int ngrosseiros, njanelas, i, n = 0;
+
+	// Imagem reduzida (o buffer tem metade da resolução; com fator 4 só se usa uma parte)
+	if (!vc_image_view(p->imagemReduzida, &reduzida, 0, 0, w, h)) return 0;
+	if (!vc_bgr_reduzir(p->imagemCamera, &reduzida, fator)) return 0;
+
+	// Procura grosseira: as imagens de trabalho da resolução original servem de buffers (canto superior esquerdo)
+	vc_processamento_vistas(p, 0, 0, w, h, &hsv, &segmentada, &semRuido, &labels);
+	ngrosseiros = vc_processar_regiao(p, &reduzida, &hsv, &segmentada, &semRuido, &labels, fator, grosseiros, VC_MAX_DETECOES);
+
+	// Janelas na resolução original
+	for (i = 0; i < ngrosseiros; i++)
+	{
+		janelas[i][0] = MAX(grosseiros[i].blob.x * fator - margem, 0);
+		janelas[i][1] = MAX(grosseiros[i].blob.y * fator - margem, 0);
+		janelas[i][2] = MIN((grosseiros[i].blob.x + grosseiros[i].blob.width) * fator - 1 + margem, width - 1);
+		janelas[i][3] = MIN((grosseiros[i].blob.y + grosseiros[i].blob.height) * fator - 1 + margem, height - 1);
+	}
+
+	// Junta as janelas que se sobrepõem (senão o mesmo sinal seria refinado duas vezes)
+	njanelas = vc_janelas_juntar(janelas, ngrosseiros);
+
+	// Refinamento na resolução original, só dentro de cada janela
+	for (i = 0; i < njanelas; i++)
+	{
+		w = janelas[i][2] - janelas[i][0] + 1;
+		h = janelas[i][3] - janelas[i][1] + 1;
+		if ((w < 4) || (h < 4)) continue;
+
+		vc_image_view(p->imagemCamera, &camera, janelas[i][0], janelas[i][1], w, h);
+		vc_processamento_vistas(p, janelas[i][0], janelas[i][1], w, h, &hsv, &segmentada, &semRuido, &labels);
+		n += vc_processar_regiao(p, &camera, &hsv, &segmentada, &semRuido, &labels, 1, candidatos + n, maxCandidatos - n);
+	}
+
+	return n;
+}
+
+/*
+* Função: vc_processar_blocos
+* ----------------------------
+* Varrimento completo com deteção de alterações: só processa janelas à volta dos blocos que
+* ainda não têm resultado válido para a cor atual; os candidatos guardados fora dessas janelas
+* são reutilizados. Um candidato guardado que toque numa janela é descartado e a janela passa
+* a contê-lo (é procurado de novo); um blob novo encostado ao limite interior da janela pode
+* continuar fora dela, por isso a janela é alargada e o processamento repetido
+*
+* processamento : estrutura do processamento (com alteracoes já comparadas com a frame)
+* candidatos    : array onde guardar os blobs
+* maxCandidatos : tamanho de candidatos
+*/
+static int vc_processar_blocos(PVC* processamento, DVC* candidatos, int maxCandidatos)
+{
+	PVC* p = processamento;
+	AVC* a = p->alteracoes;
+	IVC camera, hsv, segmentada, semRuido, labels;
+	OVC* blob;
+	int (*janelas)[4] = a->janelas;
+	int bit = 1 << p->cor;
+	int width = p->imagemCamera->width, height = p->imagemCamera->height;
+	int margem = vc_filtro_margem(p); // Vizinhos do filtro de ruído
+	int nblocos = a->blocosX * a->blocosY, ninvalidos = 0;
+	int njanelas = 0, bx, by, b, inicio, i, j, n, nnovos, w, h, refazer, toca;
+
+	// O resultado guardado só serve para a cor e o filtro de ruído com que foi procurado
+	// (o escalonador pode mudar o kernel entre frames)
+	if ((a->kernel != vc_filtro_kernel(p)) || (a->filtro != p->filtroRuido))
+	{
+		vc_alteracoes_invalidar(a);
+		a->kernel = vc_filtro_kernel(p);
+		a->filtro = p->filtroRuido;
+	}
+	if (a->cor != p->cor) a->ncandidatos = 0;
+
+	for (b = 0; b < nblocos; b++)
+	{
+		if (!(a->valido[b] & bit)) ninvalidos++;
+	}
+
+	if (2 * ninvalidos > nblocos)
+	{
+		// Mais de metade da frame: processa-a inteira
+		janelas[0][0] = 0;
+		janelas[0][1] = 0;
+		janelas[0][2] = width - 1;
+		janelas[0][3] = height - 1;
+		njanelas = 1;
+	}
+	else
+	{
+		// Uma janela por sequência de blocos sem resultado na mesma linha (as vizinhas são juntas a seguir)
+		for (by = 0; by < a->blocosY; by++)
+		{
+			for (bx = 0; bx < a->blocosX; bx++)
+			{
+				if (a->valido[by * a->blocosX + bx] & bit) continue;
+
+				inicio = bx;
+				while ((bx + 1 < a->blocosX) && !(a->valido[by * a->blocosX + bx + 1] & bit)) bx++;
+
+				janelas[njanelas][0] = MAX(inicio * VC_BLOCO_ALTERACOES - margem, 0);
+				janelas[njanelas][1] = MAX(by * VC_BLOCO_ALTERACOES - margem, 0);
+				janelas[njanelas][2] = MIN((bx + 1) * VC_BLOCO_ALTERACOES - 1 + margem, width - 1);
+				janelas[njanelas][3] = MIN((by + 1) * VC_BLOCO_ALTERACOES - 1 + margem, height - 1);
+				njanelas++;
+			}
+		}
+	}
+
+	do
+	{
+		refazer = 0;
+		// As janelas são todas processadas outra vez: só as máscaras desta passagem são gravadas
+		p->nregioesMascaras = 0;
+
+		// Os candidatos guardados que tocam numa janela são procurados de novo nela
+		for (i = 0; i < a->ncandidatos; i++)
+		{
+			blob = &a->candidatos[i].blob;
+			for (j = 0; j < njanelas; j++)
+			{
+				if ((blob->x <= janelas[j][2]) && (janelas[j][0] <= blob->x + blob->width - 1) &&
+					(blob->y <= janelas[j][3]) && (janelas[j][1] <= blob->y + blob->height - 1))
 				{
-					// Área (= somatório do nº de píxeis do blob)
-					blobs[i].area++;
+					janelas[j][0] = MIN(janelas[j][0], MAX(blob->x - margem, 0));
+					janelas[j][1] = MIN(janelas[j][1], MAX(blob->y - margem, 0));
+					janelas[j][2] = MAX(janelas[j][2], MIN(blob->x + blob->width - 1 + margem, width - 1));
+					janelas[j][3] = MAX(janelas[j][3], MIN(blob->y + blob->height - 1 + margem, height - 1));
+				}
+			}
+		}
+		njanelas = vc_janelas_juntar(janelas, njanelas);
+
+		// Candidatos guardados que ficam fora de todas as janelas (as etiquetas deles em imagemLabels não são tocadas)
+		for (i = 0, n = 0; (i < a->ncandidatos) && (n < maxCandidatos); i++)
+		{
+			blob = &a->candidatos[i].blob;
+			for (j = 0; j < njanelas; j++)
+			{
+				if ((blob->x <= janelas[j][2]) && (janelas[j][0] <= blob->x + blob->width - 1) &&
+					(blob->y <= janelas[j][3]) && (janelas[j][1] <= blob->y + blob->height - 1)) break;
+			}
+			if (j == njanelas) candidatos[n++] = a->candidatos[i];
+		}
+
+		// Processar as janelas
+		for (i = 0; (i < njanelas) && !refazer; i++)
+		{
+			w = janelas[i][2] - janelas[i][0] + 1;
+			h = janelas[i][3] - janelas[i][1] + 1;
+			if ((w < 4) || (h < 4)) continue;
+
+			vc_image_view(p->imagemCamera, &camera, janelas[i][0], janelas[i][1], w, h);
+			vc_processamento_vistas(p, janelas[i][0], janelas[i][1], w, h, &hsv, &segmentada, &semRuido, &labels);
+			nnovos = vc_processar_regiao(p, &camera, &hsv, &segmentada, &semRuido, &labels, 1, candidatos + n, maxCandidatos - n);
+
+			// Blobs encostados a um limite da janela que não é o da imagem: alarga a janela desse lado
+			for (j = n; j < n + nnovos; j++)
+			{
+				blob = &candidatos[j].blob;
+				toca = 0;
+				if ((janelas[i][0] > 0) && (blob->x < janelas[i][0] + margem))
+				{
+					janelas[i][0] = MAX(janelas[i][0] - VC_BLOCO_ALTERACOES, 0);
+					toca = 1;
 				}
+				if ((janelas[i][1] > 0) && (blob->y < janelas[i][1] + margem))
+				{
+					janelas[i][1] = MAX(janelas[i][1] - VC_BLOCO_ALTERACOES, 0);
+					toca = 1;
+				}
+				if ((janelas[i][2] < width - 1) && (blob->x + blob->width - 1 > janelas[i][2] - margem))
+				{
+					janelas[i][2] = MIN(janelas[i][2] + VC_BLOCO_ALTERACOES, width - 1);
+					toca = 1;
+				}
+				if ((janelas[i][3] < height - 1) && (blob->y + blob->height - 1 > janelas[i][3] - margem))
+				{
+					janelas[i][3] = MIN(janelas[i][3] + VC_BLOCO_ALTERACOES, height - 1);
+					toca = 1;
+				}
+				refazer |= toca;
+			}
+			n += nnovos;
+		}
+	} while (refazer);
+
+	// Todos os blocos passam a ter resultado válido para esta cor
+	for (b = 0; b < nblocos; b++) a->valido[b] |= bit;
+	memcpy(a->candidatos, candidatos, n * sizeof(DVC));
+	a->ncandidatos = n;
+	a->cor = p->cor;
+
+	if (njanelas == 0) a->framesReutilizadas++;
+	a->blocosProcessados += ninvalidos;
+
+	return n;
+}
+
+/*
+* Função: vc_deteccoes_verificar
+* ----------------------------
+* Confirma com os modelos binários os sinais das deteções que os têm (com modoVerificacao).
+* Só serve sem seguimento (vc_processar_mascara): com seguimento, a verificação é um voto do trajeto
+* (as máscaras estão em imagemLabels, que cobre a imagem inteira, como as coordenadas dos blobs)
+*
+* processamento : estrutura do processamento (deteções já classificadas)
+*/
+static void vc_deteccoes_verificar(PVC* processamento)
+{
+	PVC* p = processamento;
+	int i;
+
+	for (i = 0; i < p->ndeteccoes; i++)
+	{
+		if (p->modoVerificacao)
+		{
+			p->deteccoes[i].sinal = vc_verificarSinal(p->imagemLabels, &p->deteccoes[i].blob, p->deteccoes[i].sinal,
+				p->deteccoes[i].cor, p->limiarVerificacao, &p->deteccoes[i].distanciaModelo);
+		}
+		else p->deteccoes[i].distanciaModelo = -1;
+	}
+}
+
+/*
+* Função: vc_candidatos_maior
+* ----------------------------
+* Deixa só o candidato de maior área (na primeira posição). Devolve o novo número de candidatos
+*
+* candidatos  : candidatos
+* ncandidatos : número de candidatos
+*/
+static int vc_candidatos_maior(DVC* candidatos, int ncandidatos)
+{
+	int i, maiorBlob = 0;
+
+	if (ncandidatos <= 1) return ncandidatos;
+
+	for (i = 1; i < ncandidatos; i++)
+	{
+		if (candidatos[i].blob.area > candidatos[maiorBlob].blob.area) maiorBlob = i;
+	}
+	candidatos[0] = candidatos[maiorBlob];
+
+	return 1;
+}
+
+/*
+* Função: vc_mascaras_regioes_gravar
+* ----------------------------
+* Grava as máscaras filtradas das regiões processadas na frame atual (vistas sobre imagemSemRuido)
+*
+* processamento : estrutura do processamento (com gravacaoMascaras)
+*/
+static void vc_mascaras_regioes_gravar(PVC* processamento)
+{
+	PVC* p = processamento;
+	IVC mascara;
+	int i;
+
+	if (p->gravacaoMascaras == NULL) return;
+
+	for (i = 0; i < p->nregioesMascaras; i++)
+	{
+		if (vc_image_view(p->imagemSemRuido, &mascara, p->regioesMascaras[i][0], p->regioesMascaras[i][1],
+			p->regioesMascaras[i][2], p->regioesMascaras[i][3]))
+		{
+			vc_mascaras_gravar(p->gravacaoMascaras, &mascara, p->frames, p->cor);
+		}
+	}
+	p->nregioesMascaras = 0;
+}
+
+/*
+* Função: vc_processar_frame
+* ----------------------------
+* Processa a frame que está em processamento->imagemCamera: escolhe a região (ROI, imagem
+* inteira, pirâmide ou só os blocos alterados), segmenta a cor atual, filtra, etiqueta, calcula
+* as medidas dos candidatos, classifica-os e marca-os em imagemBoundingBox.
+* Com modoAlteracoes, uma frame igual à anterior (nenhum bloco alterado) com deteções devolve
+* as mesmas deteções sem processar nada (imagemBoundingBox fica a da frame anterior).
+* Devolve o número de deteções; se for 0, troca a cor a procurar na próxima frame
+*
+* processamento : estrutura do processamento
+*/
+int vc_processar_frame(PVC* processamento)
+{
+	PVC* p = processamento;
+	// Vistas sobre as imagens (a ROI ou a imagem inteira)
+	IVC camera, hsv, segmentada, semRuido, labels;
+	DVC* candidatos; // Os candidatos que ficarem passam a ser as deteções
+	OVC blobs[VC_MAX_DETECOES];
+	float caracteristicas[VC_MAX_DETECOES * VC_NUM_CARACTERISTICAS];
+	unsigned long long mascaras[VC_MAX_DETECOES * VC_MODELO_PALAVRAS];
+	OVC caixa;
+	int ncandidatos = 0, i, alteracoes, porBlocos = 0;
+	int roiX, roiY, roiW, roiH;
+	long pixeisBlobs = 0;
+
+	// Verificação de erros
+	if ((p == NULL) || (p->imagemCamera == NULL)) return 0;
+
+	p->frames++;
+
+	// Blocos que mudaram desde a última vez que foram processados
+	alteracoes = p->modoAlteracoes && vc_alteracoes_comparar(p->alteracoes, p->imagemCamera);
+
+	// Nada mudou: as deteções da frame anterior continuam certas (e a ROI, o seguimento e a cor também)
+	if (alteracoes && (p->alteracoes->nalterados == 0) && (p->ndeteccoes > 0))
+	{
+		p->alteracoes->framesReutilizadas++;
+		return p->ndeteccoes;
+	}
+
+	candidatos = p->deteccoes;
+	p->ndeteccoes = 0;
+	p->nregioesMascaras = 0;
+
+	// Escolher a região a processar: só a ROI à volta dos sinais seguidos, ou a imagem inteira
+	p->varrimentoCompleto = !(p->modoRastreio && vc_rastreio_janela(&p->rastreio, p->imagemCamera->width, p->imagemCamera->height, &roiX, &roiY, &roiW, &roiH));
+
+	if (p->varrimentoCompleto)
+	{
+		roiX = 0;
+		roiY = 0;
+		roiW = p->imagemCamera->width;
+		roiH = p->imagemCamera->height;
+	}
+	else
+	{
+		// Na ROI só se procura a cor do sinal que está a ser seguido
+		p->cor = p->rastreio.cor;
+	}
+
+	if (p->varrimentoCompleto && ((p->fatorPiramide == 2) || (p->fatorPiramide == 4)))
+	{
+		// Procura na imagem reduzida e refina na resolução original
+		ncandidatos = vc_processar_piramide(p, candidatos, VC_MAX_DETECOES);
+	}
+	else if (p->varrimentoCompleto && alteracoes)
+	{
+		// Só as regiões que mudaram (o resto vem da última procura desta cor)
+		ncandidatos = vc_processar_blocos(p, candidatos, VC_MAX_DETECOES);
+		porBlocos = 1;
+	}
+	else
+	{
+		// Todas as vistas cobrem a mesma região, por isso as coordenadas dos blobs vêm na imagem inteira
+		vc_image_view(p->imagemCamera, &camera, roiX, roiY, roiW, roiH);
+		vc_processamento_vistas(p, roiX, roiY, roiW, roiH, &hsv, &segmentada, &semRuido, &labels);
+		ncandidatos = vc_processar_regiao(p, &camera, &hsv, &segmentada, &semRuido, &labels, 1, candidatos, VC_MAX_DETECOES);
+	}
+
+	// A ROI e a pirâmide escrevem nas imagens de trabalho (e só procuram numa parte): o resultado guardado por blocos deixa de servir
+	if (!porBlocos && (p->alteracoes != NULL)) vc_alteracoes_invalidar(p->alteracoes);
+
+	// Gravar as máscaras filtradas da frame (uma vez cada região, com as janelas já definitivas)
+	vc_mascaras_regioes_gravar(p);
+
+	// Sem o modo multi-objeto, só fica o maior blob
+	if (!p->modoMultiObjeto) ncandidatos = vc_candidatos_maior(candidatos, ncandidatos);
+
+	if (ncandidatos == 0)
+	{ // Não detetou o sinal (tentar a outra cor para a próxima frame)
+		// Envelhece os trajetos da cor procurada nesta frame
+		vc_seguimento_atualizar(&p->seguimento, NULL, 0, NULL, NULL, 0, p->cor, p->regras, p->nregras, NULL);
+
+		// Se estava a seguir um sinal, a próxima frame volta à imagem inteira com a mesma cor
+		if (p->varrimentoCompleto)
+		{
+			if (p->cor == AZUL) p->cor = VERMELHO;
+			else if (p->cor == VERMELHO) p->cor = AZUL;
+		}
+
+		vc_rastreio_atualizar(&p->rastreio, NULL, p->cor, p->varrimentoCompleto);
+	}
+	else
+	{
+		vc_perfil_inicio(p->perfil);
+
+		// Blobs, vetores de características e máscaras dos modelos seguidos em memória (classificação em lote)
+		// (as máscaras estão em imagemLabels, que cobre a imagem inteira, como as coordenadas dos blobs)
+		for (i = 0; i < ncandidatos; i++)
+		{
+			blobs[i] = candidatos[i].blob;
+			vc_caracteristicasBlob(&candidatos[i].blob, &candidatos[i], caracteristicas + i * VC_NUM_CARACTERISTICAS);
+			if (p->modoVerificacao && !vc_blob_amostrar(p->imagemLabels, &blobs[i], mascaras + i * VC_MODELO_PALAVRAS))
+			{
+				memset(mascaras + i * VC_MODELO_PALAVRAS, 0, VC_MODELO_PALAVRAS * sizeof(unsigned long long));
 			}
+			pixeisBlobs += (long)blobs[i].width * blobs[i].height;
 		}
 
-		// Compara o tamanho do blob atual com o maior até agora
-		if (blobs[i].area > blobAreaMax)
-		{ // Este blob é agora o maior
-			blobAreaMax = blobs[i].area;
-			*maiorBlob = i;
-		}
+		// Identificar os sinais de trânsito (decisão estável do trajeto associado a cada blob)
+		// (as deteções já são os candidatos: só se acrescenta o sinal e o trajeto; a forma fica)
+		// (a verificação com os modelos binários é um voto do trajeto, quando ele é classificado)
+		p->ndeteccoes = vc_classificarBlobs(&p->seguimento, blobs, ncandidatos, caracteristicas, p->modoVerificacao ? mascaras : NULL,
+			p->limiarVerificacao, p->cor, p->regras, p->nregras, p->deteccoes);
+
+		vc_perfil_fim(p->perfil, VC_ETAPA_CLASSIFICACAO, pixeisBlobs);
+
+		// Marcar bounding box e centro de massa dos sinais (na imagem inteira)
+		vc_perfil_inicio(p->perfil);
+		vc_marcarBlobs(p->imagemCamera, p->imagemBoundingBox, blobs, ncandidatos);
+		vc_perfil_fim(p->perfil, VC_ETAPA_MARCACAO, (long)p->imagemCamera->width * p->imagemCamera->height);
+
+		// Seguir estes sinais nas próximas frames (a ROI cobre todos)
+		vc_caixaEnvolvente(blobs, ncandidatos, &caixa);
+		vc_rastreio_atualizar(&p->rastreio, &caixa, p->cor, p->varrimentoCompleto);
 	}
-	return 1;
+
+	return p->ndeteccoes;
 }
 
 /*
-* Função: vc_maiorBlob_info
+* Função: vc_processar_mascara
 * ----------------------------
-* Calcula o perimetro, centro de massa e caixa delimitadora de uma blob
+* Só as etapas depois do filtro de ruído: etiqueta a máscara, calcula as medidas e os descritores
+* dos blobs e classifica-os (sem seguimento, rastreio nem marcação). Serve para medir estas etapas
+* com máscaras gravadas. Devolve o número de deteções (em processamento->deteccoes)
 *
-* src       : estrutura da imagem etiquetada
-* blobs	    : estrutura das blobs
-* nblobs    : número de objetos encontrados na imagem
-* maiorBlob : index da maior blob na estrutura
+* processamento : estrutura do processamento (mínimos e modoVerificacao)
+* mascara       : máscara filtrada, numa vista sobre imagemSemRuido (a posição dá as coordenadas na frame)
+* cor           : cor da máscara
 */
-int vc_maiorBlob_info(IVC* src, OVC* blobs, int nblobs, int maiorBlob)
+int vc_processar_mascara(PVC* processamento, IVC* mascara, Cor cor)
 {
-	unsigned char* data = (unsigned char*)src->data;
-	int width = src->width;
-	int height = src->height;
-	int bytesperline = src->bytesperline;
-	int channels = src->channels;
-	int x, y, label;
-	long int pos;
-	int xmin, xmax, ymin, ymax;
-	long int sumx, sumy;
+	PVC* p = processamento;
+	IVC labels;
+	OVC* blobs;
+	MVC* momentos = NULL;
+	OVC caixas[VC_MAX_DETECOES];
+	float caracteristicas[VC_MAX_DETECOES * VC_NUM_CARACTERISTICAS];
+	int nblobs, n, i;
+	long pixeisBlobs = 0;
 
 	// Verificação de erros
-	if ((width <= 0) || (height <= 0) || (data == NULL)) return 0;
-	if (channels != 1) return 0;
-	if ((blobs == NULL) || (nblobs <= 0) || (maiorBlob >= nblobs)) return 0;
+	if ((p == NULL) || (mascara == NULL)) return 0;
 
-	// Inicialização nos extremos possíveis
-	xmin = width - 1;
-	ymin = height - 1;
-	xmax = 0;
-	ymax = 0;
-
-	sumx = 0;
-	sumy = 0;
+	p->ndeteccoes = 0;
 
-	label = blobs[maiorBlob].label;
+	// As etiquetas ficam na mesma posição da máscara (imagemLabels cobre a frame inteira)
+	if (!vc_image_view(p->imagemLabels, &labels, mascara->xoffset, mascara->yoffset, mascara->width, mascara->height)) return 0;
 
-	// Percorre cada píxel da imagem etiquetada
-	for (y = 1; y < height - 1; y++)
-	{
-		for (x = 1; x < width - 1; x++)
-		{
-			pos = y * bytesperline + x; // *channels; (channels = 1)
+	vc_perfil_inicio(p->perfil);
+	blobs = vc_binary_blob_labelling_filtrado(mascara, &labels, &nblobs, p->areaMinima, p->larguraMinima, p->alturaMinima, &momentos);
+	vc_perfil_fim(p->perfil, VC_ETAPA_ETIQUETAGEM, (long)mascara->width * mascara->height);
+	if (blobs == NULL) return 0;
 
-			// Se o píxel pertencer ao blob de que estamos à procura
-			if (data[pos] == label)
-			{
-				// Somatórios que vão ser usados no cálculo do centro de massa
-				sumx += x;
-				sumy += y;
+	for (i = 0; i < nblobs; i++) pixeisBlobs += blobs[i].perimeter;
 
-				// Coordenadas dos vértices da caixa delimitadora
-				if (xmin > x) xmin = x;
-				if (ymin > y) ymin = y;
-				if (xmax < x) xmax = x;
-				if (ymax < y) ymax = y;
+	vc_perfil_inicio(p->perfil);
+	n = vc_candidatos_blobs(&labels, blobs, momentos, nblobs, 1, cor, p->deteccoes, VC_MAX_DETECOES);
+	vc_perfil_fim(p->perfil, VC_ETAPA_CONTORNOS, pixeisBlobs);
+	free(blobs);
+	free(momentos);
 
-				// Perímetro (está a usar em "cruz", não conta os da diagonal)
-				// Se pelo menos um dos quatro vizinhos não pertence ao mesmo label, então é um pixel de contorno
-				if ((data[pos - 1] != label) || (data[pos + 1] != label) || (data[pos - bytesperline] != label) || (data[pos + bytesperline] != label))
-				{
-					blobs[maiorBlob].perimeter++;
-				}
-			}
-		}
+	pixeisBlobs = 0;
+	vc_perfil_inicio(p->perfil);
+	for (i = 0; i < n; i++)
+	{
+		caixas[i] = p->deteccoes[i].blob;
+		vc_caracteristicasBlob(&p->deteccoes[i].blob, &p->deteccoes[i], caracteristicas + i * VC_NUM_CARACTERISTICAS);
+		pixeisBlobs += (long)caixas[i].width * caixas[i].height;
 	}
 
-	// Caixa delimitadora
-	blobs[maiorBlob].x = xmin;
-	blobs[maiorBlob].y = ymin;
-	blobs[maiorBlob].width = (xmax - xmin) + 1;
-	blobs[maiorBlob].height = (ymax - ymin) + 1;
-
-	// Centro de Massa
-	// x médio (média de todos os valores/coordenadas em x)
-	blobs[maiorBlob].xc = round((float)sumx / (float)MAX(blobs[maiorBlob].area, 1)); // Usa-se o MAX para nunca dar 0
-	// y médio (média de todos os valores/coordenadas em y)
-	blobs[maiorBlob].yc = round((float)sumy / (float)MAX(blobs[maiorBlob].area, 1));
+	p->ndeteccoes = vc_classificarBlobs(NULL, caixas, n, caracteristicas, NULL, 0, cor, p->regras, p->nregras, p->deteccoes);
+	vc_deteccoes_verificar(p);
+	vc_perfil_fim(p->perfil, VC_ETAPA_CLASSIFICACAO, pixeisBlobs);
 
-	return 1;
+	return p->ndeteccoes;
 }
 
-
 /*
-* Função: vc_marcarMaiorBlob
+* Função: vc_processar_independente
 * ----------------------------
-* Marca o centro de massa e a caixa delimitadora de uma blob
+* Parte de vc_processar_frame que não depende das outras frames: procura as duas cores na frame
+* inteira (ou na pirâmide), calcula as características e compara cada candidato com os modelos.
+* Não usa a ROI, as alterações nem a cor da frame anterior e não mexe no seguimento, por isso
+* frames diferentes podem ser processadas ao mesmo tempo, cada uma com o seu PVC.
+* Devolve o número de candidatos das duas cores
 *
-* src       : estrutura da imagem original(neste caso da camara)
-* dst	    : estrutura da imagem de saida
-* blobs		: estrutura das blobs
-* nblobs    : número de objetos encontrados na imagem
-* maiorBlob : index da maior blob na estrutura
+* processamento : estrutura do processamento (imagemCamera com a frame)
+* resultado     : onde guardar os candidatos (resultado->frame não é alterado)
 */
-int vc_marcarMaiorBlob(IVC* src, IVC* dst, OVC* blobs, int nblobs, int maiorBlob)
+int vc_processar_independente(PVC* processamento, FOVC* resultado)
 {
-	unsigned char* datasrc = (unsigned char*)src->data;
-	unsigned char* datadst = (unsigned char*)dst->data;
-	int width = src->width;
-	int height = src->height;
-	int channels = src->channels;
-	int bytesperline = src->bytesperline;
-	long int pos;
-	int x, y, blobXmin, blobXmax, blobYmin, blobYmax, tamanhoCentro = 2;
+	PVC* p = processamento;
+	IVC camera, hsv, segmentada, semRuido, labels;
+	DVC* candidatos;
+	Cor cor;
+	int width, height, n, i, total = 0;
 
 	// Verificação de erros
-	if ((width <= 0) || (height <= 0) || (datasrc == NULL) || (datadst == NULL)) return 0;
-	if ((width != dst->width) || (height != dst->height) || (channels != dst->channels)) return 0;
-	if ((blobs == NULL) || (nblobs <= 0) || (maiorBlob >= nblobs)) return 0;
-	if (channels != 3) return 0;
+	if ((p == NULL) || (p->imagemCamera == NULL) || (resultado == NULL)) return 0;
 
-	// Copia dados da imagem original para a nova imagem
-	memcpy(datadst, datasrc, bytesperline * height);
+	width = p->imagemCamera->width;
+	height = p->imagemCamera->height;
 
-	// Marcar o centro de massa
-	for (y = blobs[maiorBlob].yc - tamanhoCentro; y <= blobs[maiorBlob].yc + tamanhoCentro; y++)
+	resultado->ncandidatos[INDEFINIDA] = 0;
+	for (cor = AZUL; cor <= VERMELHO; cor++)
 	{
-		for (x = blobs[maiorBlob].xc - tamanhoCentro; x <= blobs[maiorBlob].xc + tamanhoCentro; x++)
+		candidatos = resultado->candidatos[cor];
+		p->cor = cor;
+
+		if ((p->fatorPiramide == 2) || (p->fatorPiramide == 4)) n = vc_processar_piramide(p, candidatos, VC_MAX_DETECOES);
+		else
 		{
-			pos = y * bytesperline + x * channels;
+			vc_image_view(p->imagemCamera, &camera, 0, 0, width, height);
+			vc_processamento_vistas(p, 0, 0, width, height, &hsv, &segmentada, &semRuido, &labels);
+			n = vc_processar_regiao(p, &camera, &hsv, &segmentada, &semRuido, &labels, 1, candidatos, VC_MAX_DETECOES);
+		}
 
-			if (y >= 0 && y < height && x >= 0 && x < width)
+		if (!p->modoMultiObjeto) n = vc_candidatos_maior(candidatos, n);
+
+		// A máscara dos modelos tem de ser amostrada já: as etiquetas da próxima cor apagam estas
+		for (i = 0; i < n; i++)
+		{
+			vc_caracteristicasBlob(&candidatos[i].blob, &candidatos[i], resultado->caracteristicas[cor] + i * VC_NUM_CARACTERISTICAS);
+			if (!vc_blob_amostrar(p->imagemLabels, &candidatos[i].blob, resultado->mascaras[cor] + i * VC_MODELO_PALAVRAS))
 			{
-				datadst[pos] = (unsigned char)0;
-				datadst[pos + 1] = (unsigned char)0;
-				datadst[pos + 2] = (unsigned char)0;
+				memset(resultado->mascaras[cor] + i * VC_MODELO_PALAVRAS, 0, VC_MODELO_PALAVRAS * sizeof(unsigned long long));
 			}
-
+			candidatos[i].distanciaModelo = -1;
 		}
-	}
-
-	// Coordenadas da caixa delimitadora
-	blobYmin = blobs[maiorBlob].y;
-	blobYmax = blobYmin + blobs[maiorBlob].height - 1;
-	blobXmin = blobs[maiorBlob].x;
-	blobXmax = blobXmin + blobs[maiorBlob].width - 1;
-
-	// Marcar a caixa delimitadora
-	// Limites verticais
-	for (y = blobYmin; y <= blobYmax; y++)
-	{
-		// Limite esquerdo
-		pos = y * bytesperline + blobXmin * channels;
-		datadst[pos] = (unsigned char)0;
-		datadst[pos + 1] = (unsigned char)0;
-		datadst[pos + 2] = (unsigned char)0;
-
-		// Limite direito
-		pos = y * bytesperline + blobXmax * channels;
-		datadst[pos] = (unsigned char)0;
-		datadst[pos + 1] = (unsigned char)0;
-		datadst[pos + 2] = (unsigned char)0;
-	}
-	// Limites horizontais
-	for (x = blobXmin; x <= blobXmax; x++)
-	{
-		// Limite superior
-		pos = blobYmin * bytesperline + x * channels;
-		datadst[pos] = (unsigned char)0;
-		datadst[pos + 1] = (unsigned char)0;
-		datadst[pos + 2] = (unsigned char)0;
 
-		// Limite inferior
-		pos = blobYmax * bytesperline + x * channels;
-		datadst[pos] = (unsigned char)0;
-		datadst[pos + 1] = (unsigned char)0;
-		datadst[pos + 2] = (unsigned char)0;
+		resultado->ncandidatos[cor] = n;
+		total += n;
 	}
 
-	return 1;
+	return total;
 }
 
 /*
-* Função: vc_identificarSinal
+* Função: vc_processar_resultado
 * ----------------------------
-* Identifica o sinal de transito da imagem
+* Parte de vc_processar_frame que depende das frames anteriores: segue os candidatos das duas
+* cores (decisão estável de cada trajeto) e confirma com os modelos os sinais que os têm.
+* Os resultados têm de chegar pela ordem das frames. Devolve o número de deteções (em processamento->deteccoes)
 *
-* blobs		: estrutura das blobs
-* nblobs    : número de objetos encontrados na imagem
-* maiorBlob : index da maior blob na estrutura
-* cor		: enum com a cor do sinal(azul ou vermelho)
+* processamento : estrutura do processamento (seguimento e opções da verificação)
+* resultado     : resultado de vc_processar_independente
 */
-Sinal vc_identificarSinal(OVC* blobs, int nblobs, int maiorblob, Cor cor)
+int vc_processar_resultado(PVC* processamento, FOVC* resultado)
 {
-	float perimetroCaixa, perimetroBlob, proporcaoPerimetros;
-	int centroXCaixa;
-	// Inicialização do sinal
-	Sinal sinal = INDEFINIDO;
+	PVC* p = processamento;
+	OVC blobs[VC_MAX_DETECOES];
+	DVC* deteccoes;
+	Cor cor;
+	int n, i;
 
 	// Verificação de erros
-	if ((blobs == NULL) || (nblobs <= 0) || (maiorblob >= nblobs)) return INDEFINIDO;
-	if (cor == INDEFINIDA) return INDEFINIDO;
+	if ((p == NULL) || (resultado == NULL)) return 0;
 
-	// Divisão do perímetro do maior blob pela perímetro da caixa delimitadora
-	perimetroCaixa = blobs[maiorblob].width + blobs[maiorblob].height; // *2 para ser mesmo perímetro
-	perimetroBlob = blobs[maiorblob].perimeter;
-	proporcaoPerimetros = perimetroBlob / perimetroCaixa;
+	p->frames++;
+	p->ndeteccoes = 0;
 
-	// Se for um sinal azul
-	if (cor == AZUL)
+	for (cor = AZUL; cor <= VERMELHO; cor++)
 	{
-		// (Valores aproximados +/- 0.2)
+		n = MIN(resultado->ncandidatos[cor], VC_MAX_DETECOES - p->ndeteccoes);
 
-		// Obrigatório virar à direita/esquerda: proporção de perímetros min: 2.4 max: 2.7
-		if (proporcaoPerimetros >= 2.2f && proporcaoPerimetros <= 2.9f)
+		if (n == 0)
 		{
-			// X central da caixa delimitadora
-			centroXCaixa = blobs[maiorblob].x + blobs[maiorblob].width / 2;
-
-			// Se o centro de massa está à esquerda do centro da caixa delimitadora... 
-			if (blobs[maiorblob].xc < centroXCaixa) sinal = VIRAR_E;
-			else sinal = VIRAR_D;
+			// Envelhece os trajetos desta cor
+			vc_seguimento_atualizar(&p->seguimento, NULL, 0, NULL, NULL, 0, cor, p->regras, p->nregras, NULL);
+			continue;
 		}
 
-		// Automóveis e motociclos: proporção de perímetros min: 3.2 max: 3.4
-		else if (proporcaoPerimetros >= 3.0f && proporcaoPerimetros <= 3.6f) sinal = AUTOMOVEIS_MOTOCICLOS;
-
-		// Auto-estrada: proporção de perímetros min: 4.5 max: 4.6
-		else if (proporcaoPerimetros >= 4.3f && proporcaoPerimetros <= 4.8f) sinal = AUTO_ESTRADA;
-	}
+		// As deteções começam por ser os candidatos (a forma e os momentos ficam)
+		deteccoes = p->deteccoes + p->ndeteccoes;
+		for (i = 0; i < n; i++)
+		{
+			deteccoes[i] = resultado->candidatos[cor][i];
+			blobs[i] = deteccoes[i].blob;
+		}
 
-	else if (cor == VERMELHO)
-	{
-		// Sentido proibido: proporção de perímetros min: 2.4 max: 2.4
-		if (proporcaoPerimetros >= 2.2f && proporcaoPerimetros < 2.6f) sinal = SENTIDO_PROIBIDO;
+		// A verificação com os modelos binários é um voto do trajeto (como em vc_processar_frame)
+		vc_classificarBlobs(&p->seguimento, blobs, n, resultado->caracteristicas[cor], p->modoVerificacao ? resultado->mascaras[cor] : NULL,
+			p->limiarVerificacao, cor, p->regras, p->nregras, deteccoes);
 
-		// STOP: proporção de perímetros min: 3.1 max: 3.2
-		else if (proporcaoPerimetros >= 2.9f && proporcaoPerimetros < 3.4f) sinal = STOP;
+		p->ndeteccoes += n;
 	}
 
-	// Identificar a forma de acordo com o cálculo anterior
-	//printf("Razao Perimetros = %f\n\n", proporcaoPerimetros);
-
-	return sinal;
+	return p->ndeteccoes;
 }
 
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//         FUNÇÕES: ESCALONADOR COM PRAZO POR FRAME
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
 /*
-* Função: vc_insertionSort
+* Função: vc_escalonador_aplicar
 * ----------------------------
-* Algoritmo de organização de arrays
+* Passa para o processamento as opções do nível de degradação atual
+* (a partir das opções configuradas, por isso também serve para recuperar)
 *
-* array[] : array a ordenar
-* tamanho : tamanho do array
+* escalonador   : estrutura do escalonador
+* processamento : estrutura do processamento
 */
-void vc_insertionSort(int array[], int tamanho)
+static void vc_escalonador_aplicar(EVC* escalonador, PVC* processamento)
 {
-	int i, j, atual;
-
-	// Percorrer elementos não ordenados
-	for (i = 1; i < tamanho; i++)
+	EVC* e = escalonador;
+
+	processamento->kernelMediana = e->kernelMediana;
+	processamento->kernelMorfologia = e->kernelMorfologia;
+	processamento->fatorPiramide = e->fatorPiramide;
+	processamento->modoRastreio = e->modoRastreio;
+	processamento->rastreio.intervaloVarrimento = e->intervaloVarrimento;
+
+	// O kernel do filtro de ruído que estiver ativo (mediana ou abertura / fecho, ver vc_processar_kernel)
+	if ((e->nivel >= VC_NIVEL_MEDIANA) && (e->kernelMediana > 3)) processamento->kernelMediana = 3;
+	if ((e->nivel >= VC_NIVEL_MEDIANA) && (e->kernelMorfologia > 3)) processamento->kernelMorfologia = 3;
+	if ((e->nivel >= VC_NIVEL_PIRAMIDE) && (e->fatorPiramide < 2)) processamento->fatorPiramide = 2;
+	if (e->nivel >= VC_NIVEL_ROI)
 	{
-		// Elemento a ser comparado com os anteriores
-		atual = array[i];
-
-		j = i - 1;
-		// Percorrer elementos ordenados com índice menor que o atual e valor maior que o atual
-		while (j >= 0 && array[j] > atual)
-		{
-			// Move o elemento um índice para a frente
-			array[j + 1] = array[j];
-			// Continua a percorrer de forma descendente
-			j--;
-		}
-		// Finalmente, coloca-se o elemento atual na posição correta na parte ordenada do array
-		array[j + 1] = atual;
+		// Enquanto há um sinal seguido só se processa a ROI (a imagem inteira só volta a ser
+		// processada quando o rastreio o perde)
+		processamento->modoRastreio = 1;
+		processamento->rastreio.intervaloVarrimento = INT_MAX;
 	}
 }
 
 /*
-* Função: vc_gray_lowpass_median_filter
-* -------------------------------------
-* Algoritmo de organização de arrays
+* Função: vc_escalonador_iniciar
+* ----------------------------
+* Inicializa o escalonador; as opções atuais do processamento ficam como nível 0
 *
-* src		 : estrutura da imagem de entrada
-* dst		 : estrutura da imagem de saida
-* kernelsize : tamanho do kernel
+* escalonador   : estrutura do escalonador
+* processamento : estrutura do processamento (já com as opções configuradas)
+* fps           : frames por segundo da fonte (<= 0 = desconhecido, usa 30)
 */
-int vc_gray_lowpass_median_filter(IVC* src, IVC* dst, int kernelsize)
+void vc_escalonador_iniciar(EVC* escalonador, PVC* processamento, double fps)
 {
-	unsigned char* data = (unsigned char*)src->data;
-	unsigned char* datadst = (unsigned char*)dst->data;
-	int width = src->width;
-	int height = src->height;
-	int bytesperline = src->bytesperline;
-	int channels = src->channels;
-	int x, y, kx, ky, vizinhosCount = 0, centro;
-	int offset = (kernelsize - 1) / 2, tamanhoVizinhos = pow(kernelsize, 2);
-	long int pos, posk;
-	int* vizinhos = (int*)malloc(sizeof(int) * tamanhoVizinhos);
-
-	// Verificação de erros
-	if ((width <= 0) || (height <= 0) || (data == NULL) || (datadst == NULL)) return 0;
-	if ((width != dst->width) || (height != dst->height) || (channels != dst->channels)) return 0;
-	if (channels != 1) return 0;
-	if ((kernelsize <= 1) || (kernelsize % 2 == 0)) return 0; // Kernel tem que ser > 1 e ímpar
+	memset(escalonador, 0, sizeof(EVC));
+
+	escalonador->periodo = 1.0 / ((fps > 0.0) ? fps : 30.0);
+	escalonador->nivel = VC_NIVEL_TOTAL;
+	escalonador->kernelMediana = processamento->kernelMediana;
+	escalonador->kernelMorfologia = processamento->kernelMorfologia;
+	escalonador->fatorPiramide = processamento->fatorPiramide;
+	escalonador->modoRastreio = processamento->modoRastreio;
+	escalonador->intervaloVarrimento = processamento->rastreio.intervaloVarrimento;
+}
 
-	// Percorrer píxeis da imagem original
-	for (y = 1; y < height; y++)
+/*
+* Função: vc_escalonador_processar
+* ----------------------------
+* Decide se a próxima frame é processada. Se o processamento está mais de uma frame atrás
+* da fonte, a frame já esperou demasiado no buffer e é descartada (não gasta tempo de
+* processamento, por isso o atraso diminui um período)
+*
+* escalonador : estrutura do escalonador
+*/
+int vc_escalonador_processar(EVC* escalonador)
+{
+	if (escalonador->atraso >= escalonador->periodo)
 	{
-		for (x = 1; x < width; x++)
-		{
-			pos = y * bytesperline + x * channels;
+		escalonador->atraso -= escalonador->periodo;
+		escalonador->framesSaltadas++;
+		return 0;
+	}
 
-			// Percorrer Vizinhos (kernel)
-			for (ky = -offset; ky <= offset; ky++)
-			{
-				for (kx = -offset; kx <= offset; kx++)
-				{
-					if ((y + ky >= 0) && (y + ky < height) && (x + kx >= 0) && (x + kx < width))
-					{
-						posk = (y + ky) * bytesperline + (x + kx) * channels;
+	return 1;
+}
 
-						// Adicionar ao array de vizinhos
-						vizinhos[vizinhosCount] = (int)data[posk];
-						vizinhosCount++;
-					}
-				}
-			}
+/*
+* Função: vc_escalonador_registar
+* ----------------------------
+* Regista o tempo gasto com uma frame e ajusta o nível de degradação: sobe um nível quando a
+* média se aproxima do período e desce um nível só com bastante folga e sem atraso (histerese,
+* para não oscilar entre níveis)
+*
+* escalonador   : estrutura do escalonador
+* processamento : estrutura do processamento (recebe as opções do novo nível)
+* duracao       : segundos gastos com a frame (leitura e descodificação incluídas)
+*/
+void vc_escalonador_registar(EVC* escalonador, PVC* processamento, double duracao)
+{
+	EVC* e = escalonador;
 
-			// Ordenar vizinhos de acordo com o seu valor
-			vc_insertionSort(vizinhos, vizinhosCount);
+	e->framesProcessadas++;
+	if (e->nivel > VC_NIVEL_TOTAL) e->framesDegradadas++;
+	if (duracao > e->periodo) e->framesForaDoPrazo++;
 
-			// Dar o valor central (mediana)
-			centro = tamanhoVizinhos / 2;
+	// O que passa do período acumula-se (as frames da fonte ficam à espera); o que sobra recupera
+	e->atraso += duracao - e->periodo;
+	if (e->atraso < 0.0) e->atraso = 0.0;
 
-			datadst[pos] = (unsigned char)vizinhos[centro];
+	if (e->framesProcessadas == 1) e->mediaDuracao = duracao;
+	else e->mediaDuracao = 0.8 * e->mediaDuracao + 0.2 * duracao;
 
-			vizinhosCount = 0;
-		}
-	}
+	// Cada nível é medido durante algumas frames antes de voltar a mudar
+	e->framesNoNivel++;
 
-	free(vizinhos);
+	if ((e->mediaDuracao > 0.9 * e->periodo) && (e->framesNoNivel >= 5) && (e->nivel < VC_NIVEL_MAXIMO))
+	{
+		e->nivel++;
+		e->framesNoNivel = 0;
+	}
+	else if ((e->mediaDuracao < 0.5 * e->periodo) && (e->atraso == 0.0) && (e->framesNoNivel >= 30) && (e->nivel > VC_NIVEL_TOTAL))
+	{
+		e->nivel--;
+		e->framesNoNivel = 0;
+	}
 
-	return 1;
-}
\ No newline at end of file
+	vc_escalonador_aplicar(e, processamento);
+}
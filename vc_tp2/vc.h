@@ -5,6 +5,8 @@ Autores:
 -Cláudio Silva
 */
 
+#pragma once
+
 // Se VC_DEBUG estiver definido e não comentado, quando acontecerem erros aparecem mensagens de erro.
 // Caso contrário não aparecem mensagens de erro.
 #define VC_DEBUG
@@ -12,6 +14,8 @@ Autores:
 #define MAX(a,b) (a > b ? a : b) // Macro para calcular o máximo
 #define MIN(a,b) (a < b ? a : b) // Macro para calcular o mínimo
 
+#include <stdio.h> // FILE (vc_write_image_file)
+
 // enum para representar os vários sinais de trânsito identificados
 typedef enum {
 	INDEFINIDO, // Valor para inicializações
@@ -23,6 +27,8 @@ typedef enum {
 	STOP, // Paragem obrigatória em cruzamentos ou entroncamentos
 } Sinal;
 
+#define VC_NUM_SINAIS (STOP + 1) // Número de valores do enum Sinal (STOP é o último)
+
 // enum para representar a cor principal dos sinais de trânsito
 typedef enum {
 	INDEFINIDA, // Valor para inicializações
@@ -39,9 +45,33 @@ typedef struct {
 	int width, height;      // largura e altura da imagem
 	int channels;			// Binário/Cinzentos=1; RGB=3 (a cores)
 	int levels;				// Binário=1; Cinzentos [1,255]; RGB [1,255]
-	int bytesperline;		// width * channels
+	int bytesperline;		// width * channels (numa vista, é o bytesperline da imagem-mãe)
+	int xoffset, yoffset;	// Posição da imagem na imagem-mãe (0 se não for uma vista)
 } IVC;                      // IVC = Imagem de Visão por Computador
 
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//   ESTRUTURA DA ALOCAÇÃO DOS DADOS (PÁGINAS GRANDES E NUMA)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+// Como são alocados os dados das imagens e das tabelas de cores (vc_alocacao_definir)
+#define VC_ALOCACAO_NORMAL 0		// malloc
+#define VC_ALOCACAO_GRANDES 1		// Páginas grandes transparentes (Linux: zona alinhada a 2 MiB com MADV_HUGEPAGE)
+#define VC_ALOCACAO_RESERVADAS 2	// Páginas grandes reservadas (Linux: MAP_HUGETLB; Windows: MEM_LARGE_PAGES); sem elas, como GRANDES
+#define VC_NUMA_MAX_NOS 8
+
+typedef struct {
+	int modo;					// VC_ALOCACAO_* das próximas alocações
+	long blocos;				// Blocos de dados que existem agora (imagens e tabelas de cores)
+	long long bytes;			// Bytes pedidos nesses blocos
+	long long bytesNormais;		// Bytes em zonas com páginas normais (malloc)
+	long long bytesGrandes;		// Bytes em zonas com páginas grandes transparentes pedidas
+	long long bytesReservadas;	// Bytes em páginas grandes reservadas
+	long falhas;				// Pedidos de páginas grandes que não foram atendidos (desde o início)
+	long long paginasGrandesProcesso; // Páginas grandes transparentes que o processo tem de facto (-1 = não se sabe)
+	int nos;					// Nós NUMA do sistema
+	long long bytesNo[VC_NUMA_MAX_NOS]; // Bytes das zonas com páginas grandes em cada nó
+} MAVC; // MAVC = Memória Alocada de Visão por Computador
+
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 //                   ESTRUTURA DE UM BLOB (OBJECTO)
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
@@ -54,8 +84,403 @@ typedef struct {
 	int xc, yc;					// Centro-de-massa (xc = x centro; yc = y centro)
 	int perimeter;				// Perímetro
 	int label;					// Etiqueta
+	int nburacos;				// Número de buracos (contado na etiquetagem)
 } OVC; // OVC = Objeto de Visão por Computador
 
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//              ESTRUTURA DO CONTORNO DE UM BLOB
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+typedef struct {
+	int perimetro;				// Píxeis de contorno (exterior e buracos), a mesma medida de vc_maiorBlob_info
+	int comprimento;			// Número de passos do contorno exterior (= tamanho da cadeia)
+	int nburacos;				// Número de buracos
+	unsigned char* cadeia;		// Código de cadeia de Freeman do contorno exterior (0 = este, 2 = norte, 4 = oeste, 6 = sul)
+	int xinicio, yinicio;		// Primeiro píxel do contorno exterior (coordenadas da imagem inteira)
+	int verticesHull;			// Número de vértices do invólucro convexo do contorno exterior
+	int cantos;					// Número de cantos (mudanças de direção acentuadas) do contorno exterior
+	float solidez;				// Área dentro do contorno exterior / área do invólucro convexo
+} CVC; // CVC = Contorno de Visão por Computador
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//              ESTRUTURA DOS MOMENTOS DE UM BLOB
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+typedef struct {
+	// Momentos "crus" m_pq = soma(x^p * y^q), até à ordem 3 (coordenadas da imagem etiquetada)
+	double m00, m10, m01, m20, m11, m02, m30, m21, m12, m03;
+	// Momentos centrais (em relação ao centro de massa; invariantes à translação)
+	double mu20, mu11, mu02, mu30, mu21, mu12, mu03;
+	// Invariantes de Hu (translação, escala e rotação)
+	double hu[7];
+} MVC; // MVC = Momentos de Visão por Computador
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//                ESTRUTURA DO RASTREIO POR ROI
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+typedef struct {
+	int ativo;					// 1 = há um sinal a ser seguido (processa só a ROI); 0 = procura na imagem inteira
+	OVC blob;					// Última deteção (coordenadas na imagem inteira)
+	Cor cor;					// Cor do sinal que está a ser seguido
+	int margem;					// Número de píxeis a acrescentar a cada lado da caixa delimitadora
+	int intervaloVarrimento;	// De quantas em quantas frames se volta a processar a imagem inteira
+	int framesDesdeVarrimento;	// Frames processadas só na ROI desde o último varrimento completo
+} RVC; // RVC = Rastreio de Visão por Computador
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//          ESTRUTURAS DO SEGUIMENTO TEMPORAL DE SINAIS
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+#define VC_MAX_TRAJETOS 16			// Número máximo de sinais seguidos ao mesmo tempo
+#define VC_HISTORICO_VOTOS 8		// Número de classificações guardadas por trajeto
+#define VC_MAX_FRAMES_PERDIDO 5		// Frames sem associação até o trajeto ser apagado
+#define VC_CONFIANCA_MINIMA 75		// Abaixo desta confiança (%) o sinal volta a ser classificado em todas as frames
+#define VC_INTERVALO_CLASSIFICACAO 15 // Com confiança alta, classifica de novo a cada N frames
+
+typedef struct {
+	int id;							// Identificador do trajeto (0 = posição livre)
+	OVC blob;						// Última posição associada (coordenadas da imagem inteira)
+	Cor cor;						// Cor com que o sinal foi detetado
+	Sinal votos[VC_HISTORICO_VOTOS]; // Últimas classificações (buffer circular)
+	int nvotos;						// Número de votos válidos no histórico
+	int proximoVoto;				// Posição do próximo voto no histórico
+	Sinal sinal;					// Sinal decidido (só muda com maioria no histórico - histerese)
+	int confianca;					// Percentagem de votos do histórico iguais ao sinal decidido
+	int framesPerdido;				// Frames seguidas em que não foi associado a nenhum blob
+	int framesDesdeClassificacao;	// Frames desde a última classificação completa
+	int areaClassificacao;			// Área do blob na última classificação
+	int distanciaModelo;			// Bits diferentes do modelo binário na última classificação (-1 = não verificado)
+} TVC; // TVC = Trajeto de Visão por Computador
+
+typedef struct {
+	TVC trajetos[VC_MAX_TRAJETOS];
+	int proximoId;					// Próximo identificador a atribuir
+	int nclassificacoes;			// Número de classificações completas (estatística)
+} SVC; // SVC = Seguimento de Visão por Computador
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//                ESTRUTURA DE UMA DETEÇÃO
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+typedef struct {
+	OVC blob;					// Blob do sinal (coordenadas da imagem inteira)
+	Cor cor;					// Cor com que foi detetado
+	Sinal sinal;				// Sinal identificado
+	int trajeto;				// Identificador do trajeto no seguimento (0 = sem seguimento)
+	// Descritores de forma do contorno (ver CVC)
+	int verticesHull;
+	int cantos;
+	int nburacos;
+	float solidez;
+	// Momentos do blob (ver MVC; a zero se não foram calculados)
+	MVC momentos;
+	int distanciaModelo;		// Bits diferentes do modelo mais próximo na verificação (-1 = não verificado)
+} DVC; // DVC = Deteção de Visão por Computador
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//              ESTRUTURA DO CLASSIFICADOR POR TABELA
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+// Vetor de características de um blob (posições)
+#define VC_CARAC_PERIMETROS 0		// Perímetro do blob / (largura + altura) da caixa
+#define VC_CARAC_DESVIO_X 1			// (xc - centro x da caixa) / largura (< 0 = massa à esquerda)
+#define VC_CARAC_SOLIDEZ 2			// Solidez do contorno exterior
+#define VC_CARAC_BURACOS 3			// Número de buracos
+#define VC_CARAC_HU1 4				// Primeiro invariante de Hu
+#define VC_CARAC_HU2 5				// Segundo invariante de Hu
+#define VC_NUM_CARACTERISTICAS 6
+
+#define VC_MAX_REGRAS 64
+
+// Regra: o sinal é dado se a cor for a mesma e todas as características estiverem
+// dentro dos intervalos [minimo, maximo]; a primeira regra que for cumprida ganha
+typedef struct {
+	int cor;								// Cor
+	int sinal;								// Sinal
+	float minimo[VC_NUM_CARACTERISTICAS];
+	float maximo[VC_NUM_CARACTERISTICAS];
+} RSVC; // RSVC = Regra de Sinal de Visão por Computador
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//              VERIFICAÇÃO POR MODELOS BINÁRIOS
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+// Máscara do blob reamostrada numa grelha de 32x32 bits (2 linhas por palavra de 64 bits)
+#define VC_MODELO_LADO 32
+#define VC_MODELO_PALAVRAS (VC_MODELO_LADO * VC_MODELO_LADO / 64)
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//        ESTRUTURAS DA SEGMENTAÇÃO POR COR (LIMITES E TABELA)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+typedef struct {
+	int hmin1, hmax1;			// Tonalidade (graus)
+	int hmin2, hmax2;			// Segundo intervalo de tonalidade (-1 = não há)
+	int smin, smax;				// Saturação (%)
+	int vmin, vmax;				// Value (%)
+} LVC; // LVC = Limites de cor de Visão por Computador
+
+// Uma entrada por cada cor BGR (16 MiB)
+#define VC_TABELA_CORES_ENTRADAS (1 << 24)
+
+typedef struct {
+	unsigned char* classes;		// Índice = b | (g << 8) | (r << 16); bit (1 << cor) = a cor BGR passa os limites dessa cor
+	LVC limites[3];				// Limites com que foi construída (índice = Cor)
+	void* mapa;					// != NULL: classes está num ficheiro mapeado em memória (só de leitura)
+	long tamanhoMapa;
+} TCVC; // TCVC = Tabela de Cores de Visão por Computador
+
+// Espaços da segmentação por crominância (testes inteiros feitos diretamente sobre o BGR, sem HSV)
+#define VC_CROMA_YCBCR 0			// Y, Cb e Cr (BT.601, de 0 a 255)
+#define VC_CROMA_RG 1				// Intensidade (R + G + B) / 3 e r, g normalizados (255 * R / (R + G + B))
+
+typedef struct {
+	int espaco;					// VC_CROMA_*
+	int minimo[3], maximo[3];	// Caixa em cada eixo (Y, Cb, Cr ou intensidade, r, g), de 0 a 255 (minimo > maximo = vazia)
+	LVC limites;				// Limites HSV com que foi calibrada (vc_croma_calibrar)
+} CXVC; // CXVC = Caixa de crominância de Visão por Computador
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//          ESTRUTURA DO MAPA DE OCUPAÇÃO DA MÁSCARA
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+// A máscara segmentada é dividida em blocos; a segmentação conta os píxeis da cor em cada um
+#define VC_BLOCO_OCUPACAO 32
+
+typedef struct {
+	int blocosX, blocosY;		// Blocos da última máscara contada (a máscara pode ser uma vista)
+	int maxBlocos;				// Espaço alocado (blocos da maior máscara)
+	int* contagem;				// Píxeis da cor em cada bloco (blocosX * blocosY, por linhas)
+	int nocupados;				// Blocos com pelo menos um píxel da cor
+	int (*janelas)[4];			// Espaço para as janelas a processar (x0, y0, x1, y1)
+} OCVC; // OCVC = Ocupação de Visão por Computador
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//        ESTRUTURA DA DETEÇÃO DE ALTERAÇÕES ENTRE FRAMES
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+// A frame é dividida em blocos; cada bloco é comparado (soma das diferenças absolutas) com o que tinha
+// da última vez que mudou, usando só um píxel em cada VC_PASSO_ALTERACOES x VC_PASSO_ALTERACOES
+#define VC_BLOCO_ALTERACOES 32
+#define VC_PASSO_ALTERACOES 4
+#define VC_AMOSTRAS_BLOCO ((VC_BLOCO_ALTERACOES / VC_PASSO_ALTERACOES) * (VC_BLOCO_ALTERACOES / VC_PASSO_ALTERACOES) * 3)
+
+typedef struct {
+	int width, height;
+	int blocosX, blocosY;
+	int limiar;					// Diferença média (por amostra e canal) a partir da qual o bloco mudou
+	int iniciado;				// 0 = ainda não há referência (todos os blocos contam como alterados)
+	unsigned char* referencia;	// VC_AMOSTRAS_BLOCO amostras (BGR) por bloco
+	unsigned char* valido;		// Por bloco: bit (1 << cor) = a última procura dessa cor no bloco continua válida
+	int nalterados;				// Blocos alterados na última comparação
+	int (*janelas)[4];			// Espaço para as janelas a reprocessar (x0, y0, x1, y1)
+
+	// Resultado guardado: todos os candidatos da última procura por blocos (antes de escolher o maior)
+	DVC* candidatos;
+	int ncandidatos;
+	Cor cor;					// Cor com que foram procurados
+	int kernel, filtro;			// Filtro de ruído (kernel e VC_FILTRO_*) com que foram procurados
+
+	// Métricas
+	long framesReutilizadas;	// Frames em que não foi preciso processar nenhuma região
+	long blocosProcessados;
+} AVC; // AVC = Alterações de Visão por Computador
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//     ESTRUTURAS DA GRAVAÇÃO E REPRODUÇÃO DE MÁSCARAS (RLE)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+// Ficheiro: "VCMS" + int versão, seguido de registos (só se acrescentam no fim).
+// Registo: 8 ints (tamanho do registo em bytes, frame, cor, x, y, largura, altura, número de segmentos)
+// e, para cada linha, um unsigned short com o número de segmentos seguido de pares (início, comprimento)
+// em unsigned short; o registo é completado até um múltiplo de 4 bytes
+typedef struct {
+	FILE* ficheiro;				// NULL quando os registos são entregues a escrever
+	int (*escrever)(void* destino, const void* registo, long bytes); // (opcional) recebe cada registo completo (ver vc_mascaras_gravacao_encaminhar)
+	void* destino;
+	unsigned short* codigo;		// Espaço para codificar um registo (cabeçalho e segmentos seguidos)
+	long tamanhoCodigo;			// Em unsigned shorts
+	long registos, bytes;		// Gravados (ou entregues a escrever) desde que foi aberto
+} GMVC; // GMVC = Gravação de Máscaras de Visão por Computador
+
+typedef struct {
+	unsigned char* mapa;		// Ficheiro mapeado em memória (só de leitura)
+	long tamanho;
+	long posicao;				// Início do próximo registo
+	long fim;					// Fim do último registo completo (um registo cortado a meio é ignorado)
+	long registos;				// Registos completos no ficheiro
+	int width, height;			// Dimensões da frame que contém todas as máscaras
+} RMVC; // RMVC = Reprodução de Máscaras de Visão por Computador
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//   ESTRUTURAS DAS FRAMES EM MEMÓRIA PARTILHADA (SÓ EM LINUX)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+// Anel de frames BGR escrito por outro processo; o cabeçalho está no início da memória partilhada
+#define VC_MEMORIA_MAX_SLOTS 16
+
+typedef struct {
+	char magia[4];				// "VCFR"
+	int versao;
+	int width, height, bytesperline;
+	int nslots;
+	int tamanhoSlot;			// Bytes de cada slot
+	int dados;					// Posição do primeiro slot (a seguir ao cabeçalho, alinhada à página)
+	unsigned int sequencia;		// Última frame publicada (1, 2, ...; 0 = nenhuma); os consumidores esperam por ela com um futex
+	unsigned int terminado;		// 1 = o produtor terminou
+	unsigned int slots[VC_MEMORIA_MAX_SLOTS]; // Frame que está em cada slot (0 = a ser escrito)
+	unsigned int reservas[VC_MEMORIA_MAX_SLOTS]; // Consumidores a processar cada slot (o produtor salta-os enquanto puder)
+} MPVC; // MPVC = Memória Partilhada de Visão por Computador
+
+typedef struct {
+	MPVC* cabecalho;			// Início da memória partilhada mapeada
+	long tamanho;
+	int produtor;				// 1 = foi criada aqui (publica frames e remove-a ao fechar)
+	unsigned int atual;			// Frame entregue ao consumidor (ou a ser escrita pelo produtor)
+	int slot;					// Slot dessa frame (-1 = nenhum; no consumidor, reservado até vc_memoria_confirmar)
+	char nome[64];
+
+	// Métricas do consumidor
+	long frames;				// Entregues
+	long perdidas;				// Publicadas e nunca entregues (o consumidor só recebe a mais recente)
+	long sobrescritas;			// Reescritas pelo produtor enquanto eram processadas (só quando todos os slots estavam reservados)
+} FPVC; // FPVC = Frames em memória Partilhada de Visão por Computador
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//          ESTRUTURA DO PERFIL DE DESEMPENHO POR ETAPA
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+// Etapas do processamento de uma frame
+#define VC_ETAPA_HSV 0				// Conversão BGR -> HSV
+#define VC_ETAPA_SEGMENTACAO 1		// Segmentação da cor (limites HSV ou tabela de cores)
+#define VC_ETAPA_FILTRO 2			// Filtro de ruído da máscara
+#define VC_ETAPA_ETIQUETAGEM 3
+#define VC_ETAPA_CONTORNOS 4		// Contornos e descritores de forma dos blobs
+#define VC_ETAPA_CLASSIFICACAO 5	// Características, classificação e verificação por modelos
+#define VC_ETAPA_MARCACAO 6			// Cópia da frame com os sinais marcados
+#define VC_NUM_ETAPAS 7
+
+// Contadores do processador
+#define VC_CONTADOR_CICLOS 0
+#define VC_CONTADOR_INSTRUCOES 1
+#define VC_CONTADOR_FALHAS_L1 2		// Falhas de leitura na cache L1 de dados
+#define VC_CONTADOR_FALHAS_LLC 3	// Falhas no último nível de cache
+#define VC_CONTADOR_FALHAS_SALTOS 4	// Saltos mal previstos
+#define VC_NUM_CONTADORES 5
+
+typedef struct {
+	int descritores[VC_NUM_CONTADORES];	// perf_event_open (-1 = indisponível)
+	int grupo;					// Descritor do líder do grupo (lido de uma vez)
+	int ncontadores;			// Contadores abertos (0 = só o tempo)
+	long long inicio[VC_NUM_CONTADORES + 1]; // Leitura no início da etapa atual (o último é o tempo, em ns)
+
+	// Totais por etapa
+	long long total[VC_NUM_ETAPAS][VC_NUM_CONTADORES + 1];
+	long long pixeis[VC_NUM_ETAPAS];
+	long chamadas[VC_NUM_ETAPAS];
+} PFVC; // PFVC = PerFil de Visão por Computador
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//            ESTRUTURA DO PROCESSAMENTO DE UM VÍDEO
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+#define VC_MAX_DETECOES 255 // O etiquetamento está limitado a 254 etiquetas
+
+// Filtros de ruído da máscara segmentada
+#define VC_FILTRO_MEDIANA 0			// Mediana
+#define VC_FILTRO_ABERTURA 1		// Abertura binária (tira os pontos isolados)
+#define VC_FILTRO_ABERTURA_FECHO 2	// Abertura seguida de fecho (tira os pontos e preenche os buracos pequenos)
+
+typedef struct {
+	// Imagens (alocadas uma única vez para cada vídeo)
+	IVC* imagemCamera;			// Frame a processar (BGR), preenchida por quem chama
+	IVC* imagemHSV, * imagemSegmentada, * imagemSemRuido, * imagemLabels;
+	IVC* imagemBoundingBox;		// Frame com os sinais marcados (só é válida se ndeteccoes > 0)
+	IVC* imagemReduzida;		// Frame reduzida (BGR) usada na procura grosseira da pirâmide
+
+	// Opções
+	int modoRastreio;			// 1 = depois de detetar, processa só a ROI à volta dos sinais (ver RVC)
+	int modoMultiObjeto;		// 1 = classifica todos os blobs com área suficiente; 0 = só o maior
+	int areaMinima;				// Área mínima de um blob para ser considerado um sinal
+	int larguraMinima, alturaMinima; // Dimensões mínimas da caixa delimitadora (0 = sem restrição)
+	int kernelMediana;			// Tamanho do kernel do filtro de mediana
+	int filtroRuido;			// VC_FILTRO_*
+	int kernelMorfologia;		// Lado do elemento estruturante da abertura / fecho
+	int fatorPiramide;			// 2 ou 4 = procura na frame reduzida e refina na original; 1 = desligado
+	int modoVerificacao;		// 1 = confirma os sinais que têm modelos comparando a máscara com eles
+	int limiarVerificacao;		// Máximo de bits diferentes (em 1024) para o sinal ser aceite
+	int modoAlteracoes;			// 1 = reutiliza o resultado dos blocos que não mudaram desde a frame anterior
+	int modoOcupacao;			// 1 = filtra e etiqueta só à volta dos blocos da máscara com píxeis da cor
+	LVC limites[3];				// Limites da segmentação de cada cor (índice = Cor)
+	int modoCroma;				// 1 = segmenta com caixas[cor] (se foram calibradas com estes limites) em vez da tabela / HSV
+	CXVC caixas[3];				// Caixas de crominância de cada cor (índice = Cor)
+	TCVC* tabelaCores;			// != NULL: segmenta por consulta da tabela, se foi construída com estes limites (não é libertada aqui)
+	const RSVC* regras;			// Tabela de regras do classificador (NULL = tabela ativa; não é libertada aqui)
+	int nregras;
+	GMVC* gravacaoMascaras;		// != NULL: grava as máscaras filtradas na resolução original, uma vez por frame no fim de vc_processar_frame (não é libertada aqui)
+	PFVC* perfil;				// != NULL: mede cada etapa (só na thread que criou o perfil; não é libertado aqui)
+
+	// Regiões filtradas na resolução original na frame atual (só com gravacaoMascaras; x, y, largura, altura)
+	int (*regioesMascaras)[4];
+	int nregioesMascaras, maxRegioesMascaras;
+
+	// Estado entre frames
+	long frames;				// Frames processadas (a frame dos registos das máscaras gravadas)
+	Cor cor;					// Cor a procurar na próxima frame
+	RVC rastreio;
+	SVC seguimento;
+	AVC* alteracoes;
+	OCVC* ocupacao;				// Mapa de ocupação da última máscara segmentada
+
+	// Resultado da última frame processada
+	DVC deteccoes[VC_MAX_DETECOES];
+	int ndeteccoes;
+	int varrimentoCompleto;		// 1 = a frame foi processada na imagem inteira; 0 = só na ROI
+} PVC; // PVC = Processamento de Visão por Computador
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//      ESTRUTURA DO RESULTADO DE UMA FRAME (MODO OFFLINE)
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+// O que se pode calcular de uma frame sem depender das outras (as duas cores, na frame inteira).
+// O seguimento e a classificação dependem das frames anteriores e são feitos depois, pela ordem das frames
+typedef struct {
+	long frame;
+	int ncandidatos[3];			// Índice = Cor (AZUL e VERMELHO)
+	DVC candidatos[3][VC_MAX_DETECOES]; // Blob, cor, forma e momentos
+	float caracteristicas[3][VC_MAX_DETECOES * VC_NUM_CARACTERISTICAS];
+	unsigned long long mascaras[3][VC_MAX_DETECOES * VC_MODELO_PALAVRAS]; // Máscara 32x32 de cada candidato (verificação por modelos)
+} FOVC; // FOVC = Frame Offline de Visão por Computador
+
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//          ESTRUTURA DO ESCALONADOR COM PRAZO POR FRAME
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+// Níveis de degradação (cada um inclui os anteriores)
+#define VC_NIVEL_TOTAL 0			// Opções configuradas
+#define VC_NIVEL_MEDIANA 1			// Kernel do filtro de ruído (mediana ou abertura / fecho) 3x3
+#define VC_NIVEL_PIRAMIDE 2			// Procura na frame reduzida a metade
+#define VC_NIVEL_ROI 3				// Com um sinal seguido, processa só a ROI (sem varrimentos completos periódicos)
+#define VC_NIVEL_MAXIMO VC_NIVEL_ROI
+
+typedef struct {
+	double periodo;				// Prazo de cada frame (segundos) = 1 / fps da fonte
+	double mediaDuracao;		// Média (exponencial) do tempo de processamento de uma frame
+	double atraso;				// Quanto o processamento está atrás da fonte (frames por ler acumulam-se)
+	int nivel;					// Nível de degradação atual (VC_NIVEL_*)
+	int framesNoNivel;			// Frames processadas desde a última mudança de nível
+
+	// Opções configuradas (as do nível 0)
+	int kernelMediana, kernelMorfologia, fatorPiramide, modoRastreio, intervaloVarrimento;
+
+	// Métricas
+	long framesProcessadas;
+	long framesSaltadas;		// Descartadas para recuperar o atraso
+	long framesDegradadas;		// Processadas com nível > 0
+	long framesForaDoPrazo;		// Processamento mais demorado que o período
+} EVC; // EVC = Escalonador de Visão por Computador
+
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 //                    PROTÓTIPOS DE FUNÇÕES
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
@@ -64,12 +489,32 @@ typedef struct {
 IVC* vc_image_new(int width, int height, int channels, int levels); // o levels é o nível máximo e não o número de níveis
 IVC* vc_image_free(IVC* image);
 
-// FUNÇÃO: ESCRITA DE IMAGENS (PBM, PGM E PPM) [imagens existentes]
+// FUNÇÕES: ALOCAÇÃO DOS DADOS DAS IMAGENS (páginas grandes e NUMA em Linux; em Windows, só páginas reservadas)
+// As zonas com páginas grandes são tocadas por quem aloca: as páginas ficam no nó NUMA dessa thread
+int vc_alocacao_definir(int modo);
+void vc_alocacao_estatistica(MAVC* estatistica);
+void vc_alocacao_relatorio(FILE* file);
+int vc_numa_nos(void);
+// Nó da CPU onde a thread está a correr
+int vc_numa_no(void);
+// Fixa a thread às CPUs do nó e as páginas que ela tocar passam a ser desse nó (no < 0 volta às CPUs que a thread tinha)
+int vc_numa_fixar(int no);
+
+// FUNÇÃO: CRIA UMA VISTA (SUB-IMAGEM) SOBRE UMA REGIÃO DE OUTRA IMAGEM [não copia nem aloca dados]
+// (a vista partilha os dados da imagem-mãe, por isso não se deve usar vc_image_free na vista)
+int vc_image_view(IVC* src, IVC* view, int x, int y, int width, int height);
+
+// FUNÇÕES: ESCRITA DE IMAGENS (PBM, PGM E PPM) [imagens existentes]
 int vc_write_image(char* filename, IVC* image);
+// Escreve no ficheiro já aberto (várias imagens seguidas = fluxo de PNM concatenados)
+int vc_write_image_file(FILE* file, IVC* image);
 
 // FUNÇÃO: CONVERTE IMAGEM BGR PARA IMAGEM HSV
 int vc_bgr_to_hsv(IVC* src, IVC* dst);
 
+// FUNÇÃO: REDUZ UMA IMAGEM A CORES POR UM FATOR INTEIRO (média de cada bloco fator x fator)
+int vc_bgr_reduzir(IVC* src, IVC* dst, int fator);
+
 // FUNÇÃO: SELECIONA PARTES DE UMA IMAGEM DE ACORDO COM A COR ESCOLHIDA
 int vc_hsv_segmentation(IVC* src, IVC* dst, int hmin, int hmax, int smin,
 	int smax, int vmin, int vmax);
@@ -78,11 +523,61 @@ int vc_hsv_segmentation(IVC* src, IVC* dst, int hmin, int hmax, int smin,
 int vc_hsv_red_segmentation(IVC* src, IVC* dst, int hmin1, int hmax1, int hmin2, int hmax2,
 	int smin, int smax, int vmin, int vmax);
 
+// FUNÇÕES: LIMITES DE SEGMENTAÇÃO DE CADA COR
+// Preenche limites[3] (índice = Cor) com os limites usados até agora para o azul e o vermelho
+void vc_limites_iniciar(LVC* limites);
+// Segmenta uma imagem HSV com os limites de uma cor
+int vc_hsv_segmentar_limites(IVC* src, IVC* dst, const LVC* limites);
+
+// FUNÇÕES: TABELA COM A CLASSE DE COR DE CADA VALOR BGR (segmentação sem HSV, com uma consulta por píxel)
+TCVC* vc_tabela_cores_nova(const LVC* limites);
+// Preenche as entradas com vermelho em [rinicio, rfim) (partes diferentes podem ser feitas em paralelo)
+int vc_tabela_cores_construir(TCVC* tabela, int rinicio, int rfim);
+// Mapeia o ficheiro em memória; NULL se não existir ou se foi construído com outros limites
+TCVC* vc_tabela_cores_carregar(const char* ficheiro, const LVC* limites);
+int vc_tabela_cores_guardar(TCVC* tabela, const char* ficheiro);
+TCVC* vc_tabela_cores_libertar(TCVC* tabela);
+// 1 se a tabela foi construída com estes limites (senão tem de ser construída outra vez)
+int vc_tabela_cores_atual(TCVC* tabela, const LVC* limites);
+// Segmenta uma imagem BGR: 255 nos píxeis da cor dada; ocupacao (opcional) fica com o mapa de ocupação de dst
+int vc_tabela_cores_segmentar(TCVC* tabela, IVC* src, IVC* dst, Cor cor, OCVC* ocupacao);
+
+// FUNÇÕES: SEGMENTAÇÃO POR CROMINÂNCIA (alternativa ao HSV: só somas, multiplicações e comparações por píxel)
+// Segmenta uma imagem BGR: 255 nos píxeis dentro da caixa; ocupacao (opcional) como em vc_tabela_cores_segmentar
+int vc_croma_segmentar(const CXVC* caixa, IVC* src, IVC* dst, OCVC* ocupacao);
+// Caixa do espaço dado que mais se aproxima dos limites HSV (testa as 2^24 cores); falsosPositivos e
+// falsosNegativos (opcionais) = cores em que a caixa difere da segmentação HSV
+int vc_croma_calibrar(const LVC* limites, int espaco, CXVC* caixa, long* falsosPositivos, long* falsosNegativos);
+// 1 se a caixa foi calibrada com estes limites
+int vc_croma_atual(const CXVC* caixa, const LVC* limites);
+
+// FUNÇÕES: MAPA DE OCUPAÇÃO DE UMA MÁSCARA (píxeis != 0 em cada bloco VC_BLOCO_OCUPACAO x VC_BLOCO_OCUPACAO)
+// width, height = dimensões da maior máscara a contar
+OCVC* vc_ocupacao_novo(int width, int height);
+OCVC* vc_ocupacao_libertar(OCVC* ocupacao);
+int vc_ocupacao_contar(OCVC* ocupacao, IVC* mascara);
+// Para quem conta na mesma passagem que segmenta: blocos a zero antes (0 se não couber) e blocos ocupados depois
+int vc_ocupacao_preparar(OCVC* ocupacao, int width, int height);
+void vc_ocupacao_fechar(OCVC* ocupacao);
+
+// FUNÇÃO: CONFIRMA QUE A CONVERSÃO E A SEGMENTAÇÃO HSV (SÓ COM INTEIROS) DÃO O MESMO QUE A VERSÃO COM FLOATS
+// (testa as 2^24 cores; devolve o número de cores diferentes, 0 = tudo igual, -1 = erro)
+int vc_hsv_verificar(void);
+
 // Recebe imagem binária e devolve imagem em tons de cinzento (etiquetada)
 // nlabels = quantos objetos encontrou (apontador para poder alterar nlabels como vem em arg da função)
 // (tem de ser apontador para podermos alterar)
 OVC* vc_binary_blob_labelling(IVC* src, IVC* dst, int* nlabels);
 
+// Igual a vc_binary_blob_labelling, mas elimina (passa a fundo e não devolve) os objetos com área
+// ou caixa delimitadora menores que os mínimos dados; os blobs devolvidos já têm área, caixa e centro de massa
+// momentos = (opcional) devolve um array, paralelo aos blobs, com os momentos "crus" (libertar com free)
+OVC* vc_binary_blob_labelling_filtrado(IVC* src, IVC* dst, int* nlabels, int areaMinima, int larguraMinima, int alturaMinima,
+	MVC** momentos);
+
+// FUNÇÃO: CALCULA OS MOMENTOS CENTRAIS E OS INVARIANTES DE HU A PARTIR DOS MOMENTOS "CRUS"
+int vc_momentos_invariantes(MVC* momentos);
+
 // FUNÇÃO: CALCULA A ÁREA DE CADA BLOB E IDENTIFICA O MAIOR
 // (src = imagem já etiquetada, proveniente de vc_binary_blob_labelling)
 int vc_encontrarMaiorBlob(IVC* src, OVC* blobs, int nblobs, int* maiorBlob);
@@ -91,16 +586,177 @@ int vc_encontrarMaiorBlob(IVC* src, OVC* blobs, int nblobs, int* maiorBlob);
 // (src = imagem já etiquetada, proveniente de vc_binary_blob_labelling)
 int vc_maiorBlob_info(IVC* src, OVC* blobs, int nblobs, int maiorBlob);
 
+// FUNÇÃO: CALCULA A ÁREA, O PERÍMETRO, O CENTRO DE MASSA E A CAIXA DELIMITADORA DE TODOS OS BLOBS
+// (numa só passagem; maiorBlob é opcional)
+int vc_blobs_info(IVC* src, OVC* blobs, int nblobs, int* maiorBlob);
+
+// FUNÇÃO: SEGUE O CONTORNO EXTERIOR DE UM BLOB A PARTIR DO SEU PRIMEIRO PÍXEL
+// (custo proporcional ao contorno; perímetro e buracos vêm da etiquetagem; libertar com vc_contorno_libertar)
+int vc_blob_contorno(IVC* src, OVC* blob, CVC* contorno);
+void vc_contorno_libertar(CVC* contorno);
+
+// FUNÇÃO: MANTÉM SÓ OS BLOBS COM ÁREA >= areaMinima (devolve quantos ficaram)
+int vc_filtrarBlobs(OVC* blobs, int nblobs, int areaMinima);
+
+// FUNÇÃO: CLASSIFICA TODOS OS BLOBS E PREENCHE A LISTA DE DETEÇÕES DA FRAME (seguimento é opcional)
+// caracteristicas (opcional) = vetores de características dos blobs (senão só se usa o blob); regras = NULL usa a tabela ativa
+// mascaras (opcional, com seguimento) = máscaras 32x32 dos blobs: verificação por modelos binários como voto do trajeto
+int vc_classificarBlobs(SVC* seguimento, OVC* blobs, int nblobs, const float* caracteristicas, const unsigned long long* mascaras,
+	int limiarVerificacao, Cor cor, const RSVC* regras, int nregras, DVC* deteccoes);
+
 // FUNÇÃO: MARCA A CAIXA DELIMITADORA E O CENTRO DE MASSA DO MAIOR BLOB NUMA NOVA IMAGEM
 // (definido só para imagens a cores)
 int vc_marcarMaiorBlob(IVC* src, IVC* dst, OVC* blobs, int nblobs, int maiorBlob);
 
+// FUNÇÃO: MARCA A CAIXA DELIMITADORA E O CENTRO DE MASSA DE TODOS OS BLOBS NUMA NOVA IMAGEM
+int vc_marcarBlobs(IVC* src, IVC* dst, OVC* blobs, int nblobs);
+
 // FUNÇÃO: IDENTIFICA O SINAL DE TRÂNSITO
 Sinal vc_identificarSinal(OVC* blobs, int nblobs, int maiorblob, Cor cor);
 
+// FUNÇÕES: VERIFICAÇÃO POR MODELOS BINÁRIOS (máscara do blob em 32x32 bits, comparada com XOR + popcount)
+// Reamostra a caixa do blob na imagem etiquetada (pode ser uma vista) para VC_MODELO_PALAVRAS palavras
+int vc_blob_amostrar(IVC* src, OVC* blob, unsigned long long* bits);
+// Número de bits diferentes entre duas máscaras
+int vc_modelo_distancia(const unsigned long long* a, const unsigned long long* b);
+// Espelha uma máscara na horizontal (modelo do sinal simétrico)
+void vc_modelo_espelhar(const unsigned long long* bits, unsigned long long* espelho);
+// Confirma (ou corrige para o modelo mais próximo da mesma cor) o sinal dado; INDEFINIDO se nenhum
+// modelo estiver a menos de limiar bits. Sinais sem modelos são devolvidos sem alteração
+Sinal vc_verificarSinal(IVC* src, OVC* blob, Sinal sinal, Cor cor, int limiar, int* distancia);
+
+// FUNÇÕES: CLASSIFICADOR POR TABELA DE REGRAS
+// Vetor de características de um blob (forma = deteção com os descritores de forma e momentos; opcional)
+void vc_caracteristicasBlob(OVC* blob, DVC* forma, float* caracteristicas);
+// Classifica um vetor, ou n vetores contíguos (n * VC_NUM_CARACTERISTICAS floats), com a tabela ativa
+Sinal vc_classificarCaracteristicas(const float* caracteristicas, Cor cor);
+// Como vc_classificarCaracteristicas, mas com uma tabela dada (regras = NULL usa a tabela ativa)
+Sinal vc_classificarRegras(const RSVC* regras, int nregras, const float* caracteristicas, Cor cor);
+int vc_classificarLote(const float* caracteristicas, int n, Cor cor, Sinal* sinais);
+// Troca a tabela ativa (regras = NULL volta à tabela compilada); a tabela não é copiada
+int vc_classificador_definir(const RSVC* regras, int nregras);
+// Ficheiro binário compacto com uma tabela (libertar a tabela carregada com free)
+RSVC* vc_classificador_carregar(const char* ficheiro, int* nregras);
+int vc_classificador_guardar(const char* ficheiro, const RSVC* regras, int nregras);
+
 // FUNÇÃO: ORDENA UM ARRAY COM O ALGORITMO DE INSERTION SORT
 void vc_insertionSort(int array[], int tamanho);
 
 // FUNÇÃO: FILTRO DE MEDIANA (PASSA-BAIXO)
 // (elimina ruído "salt-and-pepper")
-int vc_gray_lowpass_median_filter(IVC* src, IVC* dst, int kernelsize);
\ No newline at end of file
+int vc_gray_lowpass_median_filter(IVC* src, IVC* dst, int kernelsize);
+
+// FUNÇÕES: MORFOLOGIA BINÁRIA COM ELEMENTO ESTRUTURANTE RETANGULAR kw x kh (ímpares)
+// (trabalham com 64 píxeis por palavra; fora da imagem não conta, por isso a abertura não come os rebordos)
+// Operações elementares (uma abertura é EROSAO seguida de DILATACAO)
+#define VC_MORF_EROSAO 0
+#define VC_MORF_DILATACAO 1
+int vc_binary_erode(IVC* src, IVC* dst, int kw, int kh);
+int vc_binary_dilate(IVC* src, IVC* dst, int kw, int kh);
+int vc_binary_open(IVC* src, IVC* dst, int kw, int kh);
+int vc_binary_close(IVC* src, IVC* dst, int kw, int kh);
+// Abertura seguida de fecho (alternativa à mediana para tirar o ruído "salt-and-pepper" de uma máscara)
+int vc_binary_open_close(IVC* src, IVC* dst, int kw, int kh);
+
+// FUNÇÕES: NÚCLEOS DA CONVERSÃO HSV, DA SEGMENTAÇÃO E DA MORFOLOGIA (nucleos.cpp: os templates de imagem.h com 3 ou 1 canais)
+// Não verificam nada: são chamadas pelas funções acima depois de verificarem as imagens
+void vc_nucleo_bgr_to_hsv(IVC* src, IVC* dst);
+// limites em bytes (hmin1, hmax1, hmin2, hmax2, smin, smax, vmin, vmax); intervalos de tonalidade = 1 ou 2
+void vc_nucleo_hsv_segmentar(IVC* src, IVC* dst, const int* limites, int intervalos);
+// ocupacao (opcional) já preparada com vc_ocupacao_preparar
+void vc_nucleo_tabela_cores_segmentar(const unsigned char* classes, IVC* src, IVC* dst, Cor cor, OCVC* ocupacao);
+void vc_nucleo_croma_segmentar(const CXVC* caixa, IVC* src, IVC* dst, OCVC* ocupacao);
+// 0 se não houver memória
+int vc_nucleo_morfologia(IVC* src, IVC* dst, int kw, int kh, const int* operacoes, int noperacoes);
+
+// FUNÇÕES: RASTREIO DO ÚLTIMO SINAL DETETADO (processa só uma ROI à volta da última deteção)
+void vc_rastreio_iniciar(RVC* rastreio, int margem, int intervaloVarrimento);
+// Devolve 1 e a janela a processar se houver rastreio ativo, ou 0 se se deve processar a imagem inteira
+int vc_rastreio_janela(RVC* rastreio, int width, int height, int* x, int* y, int* w, int* h);
+// blob = NULL indica que o sinal se perdeu (volta a procurar na imagem inteira)
+void vc_rastreio_atualizar(RVC* rastreio, OVC* blob, Cor cor, int varrimentoCompleto);
+
+// FUNÇÕES: SEGUIMENTO TEMPORAL DOS SINAIS (associação de blobs entre frames e votação da classificação)
+void vc_seguimento_iniciar(SVC* seguimento);
+// blobs = blobs detetados nesta frame, já com vc_maiorBlob_info calculado; todos com a cor dada
+// caracteristicas (opcional) = vetores de características dos blobs, usados quando é preciso classificar
+// mascaras (opcional) = máscaras 32x32 dos blobs (vc_blob_amostrar): o modelo mais próximo (ou INDEFINIDO, acima
+// de limiarVerificacao bits) passa a ser o voto dos sinais que têm modelos
+// regras = tabela de regras com que se classifica (NULL = tabela ativa)
+// trajetos (opcional) = índice, em seguimento->trajetos, do trajeto associado a cada blob (-1 se não houver espaço)
+int vc_seguimento_atualizar(SVC* seguimento, OVC* blobs, int nblobs, const float* caracteristicas, const unsigned long long* mascaras,
+	int limiarVerificacao, Cor cor, const RSVC* regras, int nregras, int* trajetos);
+
+// FUNÇÕES: DETEÇÃO DE ALTERAÇÕES ENTRE FRAMES (por blocos)
+AVC* vc_alteracoes_novo(int width, int height, int limiar);
+AVC* vc_alteracoes_libertar(AVC* alteracoes);
+// Compara a frame com a referência; os blocos alterados perdem o resultado guardado (ver nalterados)
+int vc_alteracoes_comparar(AVC* alteracoes, IVC* frame);
+// Descarta todo o resultado guardado (por exemplo, depois de mudar as opções do processamento)
+void vc_alteracoes_invalidar(AVC* alteracoes);
+
+// FUNÇÕES: GRAVAÇÃO DE MÁSCARAS FILTRADAS EM RLE E REPRODUÇÃO (para medir a etiquetagem e a classificação sem vídeo)
+// Abre o ficheiro para acrescentar registos (cria-o se não existir)
+GMVC* vc_mascaras_gravacao_nova(const char* ficheiro);
+// Como vc_mascaras_gravacao_nova, mas cada registo (um bloco de bytes) é entregue a escrever, que o
+// acrescenta ao ficheiro noutra thread (ex: gravacao_enviar_dados); o ficheiro só é aberto aqui, para o cabeçalho
+GMVC* vc_mascaras_gravacao_encaminhar(const char* ficheiro, int (*escrever)(void* destino, const void* registo, long bytes), void* destino);
+// Grava a máscara (pode ser uma vista: a posição dela na frame fica no registo)
+int vc_mascaras_gravar(GMVC* gravacao, IVC* mascara, long frame, Cor cor);
+GMVC* vc_mascaras_gravacao_libertar(GMVC* gravacao);
+// Mapeia o ficheiro em memória (só os registos completos contam)
+RMVC* vc_mascaras_reproducao_abrir(const char* ficheiro);
+// Descodifica o próximo registo em dst (width x height, 1 canal), na posição onde foi gravado; mascara fica
+// uma vista sobre ele. Devolve 0 no fim do ficheiro
+int vc_mascaras_reproduzir(RMVC* reproducao, IVC* dst, IVC* mascara, long* frame, Cor* cor);
+void vc_mascaras_reproducao_reiniciar(RMVC* reproducao);
+RMVC* vc_mascaras_reproducao_libertar(RMVC* reproducao);
+
+// FUNÇÕES: FRAMES EM MEMÓRIA PARTILHADA (POSIX shm + futex; noutros sistemas devolvem NULL / 0)
+// Produtor: cria o anel (remove um anterior com o mesmo nome, por exemplo "/vc_frames")
+FPVC* vc_memoria_criar(const char* nome, int width, int height, int nslots);
+// Produtor: frame = vista sobre o próximo slot, para ser preenchida no lugar; depois vc_memoria_publicar
+int vc_memoria_slot(FPVC* memoria, IVC* frame);
+int vc_memoria_publicar(FPVC* memoria);
+// Consumidor: liga-se a um anel existente (os slots ficam só de leitura)
+FPVC* vc_memoria_abrir(const char* nome);
+// Consumidor: espera (até esperaMs) por uma frame nova e dá a mais recente como vista (só de leitura) sobre o
+// slot, sem cópia; o slot fica reservado (o produtor não o reescreve) até vc_memoria_confirmar
+// Devolve 1 = frame, 0 = não chegou nenhuma, -1 = o produtor terminou
+int vc_memoria_proxima(FPVC* memoria, IVC* frame, int esperaMs);
+// Consumidor: depois de processar, 1 se o slot não foi reescrito entretanto (senão a frame pode ter partes de
+// outra e o resultado deve ser descartado); liberta a reserva do slot
+int vc_memoria_confirmar(FPVC* memoria);
+// O produtor marca o anel como terminado e remove-o; o consumidor só desfaz o mapeamento
+FPVC* vc_memoria_fechar(FPVC* memoria);
+
+// FUNÇÕES: PERFIL DE DESEMPENHO POR ETAPA (contadores do processador só em Linux; sem eles, só o tempo)
+PFVC* vc_perfil_novo(void);
+PFVC* vc_perfil_libertar(PFVC* perfil);
+void vc_perfil_reiniciar(PFVC* perfil);
+// Envolvem cada etapa (com perfil == NULL não fazem nada)
+void vc_perfil_inicio(PFVC* perfil);
+void vc_perfil_fim(PFVC* perfil, int etapa, long pixeis);
+void vc_perfil_relatorio(PFVC* perfil, FILE* file);
+
+// FUNÇÕES: PROCESSAMENTO COMPLETO DE UMA FRAME (HSV, segmentação, mediana, etiquetagem, classificação e marcação)
+PVC* vc_processamento_novo(int width, int height);
+PVC* vc_processamento_libertar(PVC* processamento);
+// Processa processamento->imagemCamera; devolve o número de deteções (em processamento->deteccoes)
+int vc_processar_frame(PVC* processamento);
+// Etiqueta, descreve e classifica uma máscara já filtrada (uma vista sobre imagemSemRuido, por exemplo
+// de vc_mascaras_reproduzir), sem seguimento nem rastreio; devolve o número de deteções
+int vc_processar_mascara(PVC* processamento, IVC* mascara, Cor cor);
+// Modo offline: vc_processar_independente pode correr em paralelo (um PVC por thread) e não muda o
+// estado entre frames; vc_processar_resultado faz o seguimento e a classificação e tem de receber
+// os resultados pela ordem das frames (sempre com o mesmo PVC). Devolvem o número de candidatos / deteções
+int vc_processar_independente(PVC* processamento, FOVC* resultado);
+int vc_processar_resultado(PVC* processamento, FOVC* resultado);
+
+// FUNÇÕES: ESCALONADOR COM PRAZO POR FRAME (degrada a qualidade e salta frames quando o processamento não acompanha a fonte)
+// Guarda as opções atuais de processamento como nível 0; fps <= 0 usa 30
+void vc_escalonador_iniciar(EVC* escalonador, PVC* processamento, double fps);
+// Antes de cada frame: 1 = processar, 0 = saltar (descartar) para recuperar o atraso
+int vc_escalonador_processar(EVC* escalonador);
+// Depois de processar: duracao = segundos gastos com a frame (sem contar a espera pela fonte)
+void vc_escalonador_registar(EVC* escalonador, PVC* processamento, double duracao);
\ No newline at end of file